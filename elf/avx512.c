@@ -10,6 +10,31 @@
 
 #define BUF_SIZE_MAP_NS 256
 
+#define __inline __attribute__((always_inline)) inline
+
+/* avx_config_array indices */
+#define AVX_CONFIG_FLAGS 0
+#define AVX_CONFIG_FILTER_GEN 1
+#define AVX_CONFIG_FPU_TS_OFFSET 2
+#define AVX_CONFIG_MAX 3
+
+/* avx_config_array flags, set by userspace at load time */
+#define AVX_CONFIG_STREAM_EVENTS (1 << 0)
+#define AVX_CONFIG_FIRST_USE (1 << 1)
+
+/* number of slots (log2) in the AVX-active cgroup filter */
+#define AVX_FILTER_BITS 12
+
+/* flush a pending per-CPU event record after this many switches */
+#define STREAM_FLUSH_COUNT 64
+
+/*
+ * default capacity of the per-cgroup maps, overridden by userspace at load
+ * time. The maps are LRU so cgroups of exited containers eventually get
+ * evicted even if userspace never gets around to removing them.
+ */
+#define CGROUP_MAP_SIZE 1024
+
 typedef struct bpf_map_def {
 	unsigned int type;
 	unsigned int key_size;
@@ -35,38 +60,266 @@ static int (*bpf_map_update_elem)(void *map, void *key, void *value,
 static void *(*bpf_map_lookup_elem)(void *map, void *key) = (void *)
 	BPF_FUNC_map_lookup_elem;
 
+static int (*bpf_perf_event_output)(void *ctx, void *map, u64 flags,
+				    void *data, u64 size) = (void *)
+	BPF_FUNC_perf_event_output;
+
 struct bpf_map_def
 	SEC("maps/all_context_switch_count") all_context_switch_count_hash = {
-		.type = BPF_MAP_TYPE_HASH,
+		.type = BPF_MAP_TYPE_LRU_PERCPU_HASH,
 		.key_size = sizeof(u64),
 		.value_size = sizeof(u32),
-		.max_entries = 1024,
+		.max_entries = CGROUP_MAP_SIZE,
 	};
 
 struct bpf_map_def
 	SEC("maps/avx_context_switch_count") avx_context_switch_count_hash = {
-		.type = BPF_MAP_TYPE_PERCPU_HASH,
+		.type = BPF_MAP_TYPE_LRU_PERCPU_HASH,
 		.key_size = sizeof(u64),
 		.value_size = sizeof(u32),
-		.max_entries = 1024,
+		.max_entries = CGROUP_MAP_SIZE,
 	};
 
 struct bpf_map_def
 	SEC("maps/avx_timestamp") avx_timestamp_hash = {
-		.type = BPF_MAP_TYPE_HASH,
+		.type = BPF_MAP_TYPE_LRU_HASH,
 		.key_size = sizeof(u64),
 		.value_size = sizeof(u32),
-		.max_entries = 1024,
+		.max_entries = CGROUP_MAP_SIZE,
 	};
 
 struct bpf_map_def
 	SEC("maps/last_update_ns") last_update_ns_hash = {
-		.type = BPF_MAP_TYPE_HASH,
+		.type = BPF_MAP_TYPE_LRU_HASH,
 		.key_size = sizeof(u64),
 		.value_size = sizeof(u64),
-		.max_entries = 1024,
+		.max_entries = CGROUP_MAP_SIZE,
+	};
+
+struct bpf_map_def
+	SEC("maps/avx_residency_ns") avx_residency_ns_hash = {
+		.type = BPF_MAP_TYPE_LRU_PERCPU_HASH,
+		.key_size = sizeof(u64),
+		.value_size = sizeof(u64),
+		.max_entries = CGROUP_MAP_SIZE,
+	};
+
+/* AVX512 activity of every CPU, read by userspace without resetting */
+struct cpu_stats {
+	u64 avx_switches;
+	u64 residency_ns;
+};
+
+struct bpf_map_def
+	SEC("maps/avx_cpu_stats") avx_cpu_stats_array = {
+		.type = BPF_MAP_TYPE_PERCPU_ARRAY,
+		.key_size = sizeof(u32),
+		.value_size = sizeof(struct cpu_stats),
+		.max_entries = 1,
+	};
+
+/*
+ * The last time slice of every CPU. sched_switch closes the slice of the
+ * task being switched out, and x86_fpu_regs_deactivated, which follows it
+ * for the same task, accounts the slice as AVX512 residency if the task
+ * used AVX512 during it.
+ */
+struct cpu_slice {
+	u64 start_ns;
+	u64 cgroup_id;
+	u64 len_ns;
+};
+
+struct bpf_map_def
+	SEC("maps/avx_slice") avx_slice_array = {
+		.type = BPF_MAP_TYPE_PERCPU_ARRAY,
+		.key_size = sizeof(u32),
+		.value_size = sizeof(struct cpu_slice),
+		.max_entries = 1,
+	};
+
+struct bpf_map_def
+	SEC("maps/avx_config") avx_config_array = {
+		.type = BPF_MAP_TYPE_ARRAY,
+		.key_size = sizeof(u32),
+		.value_size = sizeof(u32),
+		.max_entries = AVX_CONFIG_MAX,
+	};
+
+/*
+ * AVX-active cgroup filter. A slot, picked by hashing the cgroup ID, is
+ * stamped with the current filter generation whenever a cgroup in the
+ * slot shows AVX512 activity. sched_switch can then reject cgroups with
+ * no recent AVX512 activity with a single array lookup. Userspace resets
+ * the filter by bumping the generation in avx_config_array.
+ */
+struct bpf_map_def
+	SEC("maps/avx_cgroup_filter") avx_cgroup_filter_array = {
+		.type = BPF_MAP_TYPE_ARRAY,
+		.key_size = sizeof(u32),
+		.value_size = sizeof(u32),
+		.max_entries = 1 << AVX_FILTER_BITS,
+	};
+
+/*
+ * In streaming mode per-cgroup deltas are accumulated into a per-CPU
+ * pending record which is pushed to userspace through avx_events_perf
+ * whenever the cgroup running on the CPU changes or the record fills up.
+ * Userspace also folds the pending records when polled, so a CPU going
+ * idle does not hold back activity. seq identifies the accumulation
+ * round of a record, letting userspace subtract what it has already
+ * folded once the record gets pushed.
+ */
+struct avx_event {
+	u64 cgroup_id;
+	u64 last_update_ns;
+	u64 residency_ns;
+	u32 avx_count;
+	u32 all_count;
+	u64 seq;
+};
+
+struct bpf_map_def
+	SEC("maps/avx_pending") avx_pending_array = {
+		.type = BPF_MAP_TYPE_PERCPU_ARRAY,
+		.key_size = sizeof(u32),
+		.value_size = sizeof(struct avx_event),
+		.max_entries = 1,
+	};
+
+/* max_entries is filled in by the loader with the number of possible CPUs */
+struct bpf_map_def
+	SEC("maps/avx_events") avx_events_perf = {
+		.type = BPF_MAP_TYPE_PERF_EVENT_ARRAY,
+		.key_size = sizeof(int),
+		.value_size = sizeof(u32),
+		.max_entries = 0,
+	};
+
+static __inline u32 *filter_slot(u64 cgroup_id)
+{
+	u32 key = (cgroup_id * 0x9e3779b97f4a7c15ULL) >> (64 - AVX_FILTER_BITS);
+
+	return bpf_map_lookup_elem(&avx_cgroup_filter_array, &key);
+}
+
+static __inline u32 *filter_gen(void)
+{
+	u32 key = AVX_CONFIG_FILTER_GEN;
+
+	return bpf_map_lookup_elem(&avx_config_array, &key);
+}
+
+/* filter_check returns 0 if cgroup_id certainly had no recent AVX512 activity */
+static __inline int filter_check(u64 cgroup_id)
+{
+	u32 *slot = filter_slot(cgroup_id);
+	u32 *gen = filter_gen();
+
+	if (!slot || !gen) {
+		return 1;
+	}
+
+	return *slot == *gen;
+}
+
+static __inline void filter_mark(u64 cgroup_id)
+{
+	u32 *slot = filter_slot(cgroup_id);
+	u32 *gen = filter_gen();
+
+	if (slot && gen && *slot != *gen) {
+		*slot = *gen;
+	}
+}
+
+/* cgroup IDs of cgroups using AVX512 for the first time, if enabled */
+struct bpf_map_def
+	SEC("maps/avx_first_use") avx_first_use_perf = {
+		.type = BPF_MAP_TYPE_PERF_EVENT_ARRAY,
+		.key_size = sizeof(int),
+		.value_size = sizeof(u32),
+		.max_entries = 0,
 	};
 
+static __inline int config_enabled(u32 flag)
+{
+	u32 key = AVX_CONFIG_FLAGS;
+	u32 *flags;
+
+	flags = bpf_map_lookup_elem(&avx_config_array, &key);
+
+	return flags && (*flags & flag);
+}
+
+static __inline int stream_enabled(void)
+{
+	return config_enabled(AVX_CONFIG_STREAM_EVENTS);
+}
+
+static __inline struct avx_event *stream_pending(void *ctx, u64 cgroup_id)
+{
+	struct avx_event *ev;
+	u32 key = 0;
+
+	ev = bpf_map_lookup_elem(&avx_pending_array, &key);
+	if (!ev) {
+		return 0;
+	}
+
+	if (ev->cgroup_id == cgroup_id && ev->all_count < STREAM_FLUSH_COUNT) {
+		return ev;
+	}
+
+	if (ev->cgroup_id != 0 && (ev->avx_count || ev->all_count)) {
+		bpf_perf_event_output(ctx, &avx_events_perf, BPF_F_CURRENT_CPU,
+				      ev, sizeof(*ev));
+	}
+
+	ev->cgroup_id = cgroup_id;
+	ev->last_update_ns = 0;
+	ev->residency_ns = 0;
+	ev->avx_count = 0;
+	ev->all_count = 0;
+	/* bumped last, a concurrent poll sees the reset counts with the old seq */
+	ev->seq++;
+
+	return ev;
+}
+
+static __inline void slice_close(u64 cgroup_id, u64 now)
+{
+	struct cpu_slice *slice;
+	u32 key = 0;
+
+	slice = bpf_map_lookup_elem(&avx_slice_array, &key);
+	if (!slice) {
+		return;
+	}
+
+	slice->cgroup_id = cgroup_id;
+	slice->len_ns = slice->start_ns ? now - slice->start_ns : 0;
+	slice->start_ns = now;
+}
+
+/* slice_take returns the length of the last closed slice if it belongs to cgroup_id */
+static __inline u64 slice_take(u64 cgroup_id)
+{
+	struct cpu_slice *slice;
+	u32 key = 0;
+	u64 len;
+
+	slice = bpf_map_lookup_elem(&avx_slice_array, &key);
+	if (!slice || slice->cgroup_id != cgroup_id) {
+		return 0;
+	}
+
+	len = slice->len_ns;
+	slice->len_ns = 0;
+
+	return len;
+}
+
 SEC("tracepoint/sched/sched_switch")
 int tracepoint__sched_switch(void *args)
 {
@@ -74,6 +327,32 @@ int tracepoint__sched_switch(void *args)
 	u32 *count, *found;
 	u32 new_count = 1;
 
+	/*
+	 * Slices are closed for all cgroups and slice_take decides whether one
+	 * gets claimed. A cgroup using AVX512 continuously is only marked in a
+	 * new filter generation once its first slice ends, which would be lost.
+	 */
+	slice_close(cgroup_id, bpf_ktime_get_ns());
+
+	if (!filter_check(cgroup_id)) {
+		return 0;
+	}
+
+	if (stream_enabled()) {
+		struct avx_event *ev;
+
+		/* only cgroups that have ever had AVX activity are streamed */
+		if (!bpf_map_lookup_elem(&avx_timestamp_hash, &cgroup_id)) {
+			return 0;
+		}
+
+		ev = stream_pending(args, cgroup_id);
+		if (ev) {
+			ev->all_count++;
+		}
+		return 0;
+	}
+
 	found = bpf_map_lookup_elem(&avx_context_switch_count_hash, &cgroup_id);
 
 	/* store sched_switch counts only for cgroups that have AVX activity */
@@ -81,9 +360,10 @@ int tracepoint__sched_switch(void *args)
 		return 0;
 	}
 
+	/* per-CPU value, no need for atomic increments */
 	count = bpf_map_lookup_elem(&all_context_switch_count_hash, &cgroup_id);
 	if (count) {
-		__sync_fetch_and_add(count, 1);
+		(*count)++;
 	} else {
 		bpf_map_update_elem(&all_context_switch_count_hash, &cgroup_id,
 				    &new_count, BPF_ANY);
@@ -91,6 +371,7 @@ int tracepoint__sched_switch(void *args)
 	return 0;
 }
 
+/* userspace verifies the offset of fpu against the tracepoint format */
 struct x86_fpu_args {
 	u64 pad;
 	struct fpu *fpu;
@@ -99,12 +380,31 @@ struct x86_fpu_args {
 	u64 xcomp_bv;
 };
 
+/*
+ * fpu_ts_offset returns the offset of avx512_timestamp in struct fpu. The
+ * loader relocates it from the kernel BTF, so the same object works with
+ * kernels built with a different struct fpu layout than our headers. The
+ * offset from our headers is only used if the kernel has no BTF.
+ */
+static __inline u64 fpu_ts_offset(void)
+{
+	u32 key = AVX_CONFIG_FPU_TS_OFFSET;
+	u32 *offset;
+
+	offset = bpf_map_lookup_elem(&avx_config_array, &key);
+	if (offset && *offset) {
+		return *offset;
+	}
+
+	return __builtin_offsetof(struct fpu, avx512_timestamp);
+}
+
 SEC("tracepoint/x86_fpu/x86_fpu_regs_deactivated")
 int tracepoint__x86_fpu_regs_deactivated(struct x86_fpu_args *args)
 {
 	u32 *counter;
 	u32 ts;
-	bpf_probe_read(&ts, sizeof(u32), (void *)&args->fpu->avx512_timestamp);
+	bpf_probe_read(&ts, sizeof(u32), (char *)args->fpu + fpu_ts_offset());
 
 	if (ts == 0) {
 		return 0;
@@ -122,18 +422,57 @@ int tracepoint__x86_fpu_regs_deactivated(struct x86_fpu_args *args)
 		return 0;
 	}
 	bpf_map_update_elem(&avx_timestamp_hash, &cgroup_id, &ts, BPF_ANY);
+	filter_mark(cgroup_id);
+
+	if (!tsp && config_enabled(AVX_CONFIG_FIRST_USE)) {
+		bpf_perf_event_output(args, &avx_first_use_perf, BPF_F_CURRENT_CPU,
+				      &cgroup_id, sizeof(cgroup_id));
+	}
+
+	u64 now = bpf_ktime_get_ns();
+	u64 residency = slice_take(cgroup_id);
+	struct cpu_stats *stats;
+	u32 zero = 0;
+
+	stats = bpf_map_lookup_elem(&avx_cpu_stats_array, &zero);
+	if (stats) {
+		stats->avx_switches++;
+		stats->residency_ns += residency;
+	}
+
+	if (stream_enabled()) {
+		struct avx_event *ev = stream_pending(args, cgroup_id);
+
+		if (ev) {
+			ev->avx_count++;
+			ev->last_update_ns = now;
+			ev->residency_ns += residency;
+		}
+		return 0;
+	}
+
+	if (residency) {
+		u64 *total;
+
+		total = bpf_map_lookup_elem(&avx_residency_ns_hash, &cgroup_id);
+		if (total) {
+			*total += residency;
+		} else {
+			bpf_map_update_elem(&avx_residency_ns_hash, &cgroup_id,
+					    &residency, BPF_ANY);
+		}
+	}
 
 	u32 count = 1;
 	counter = bpf_map_lookup_elem(&avx_context_switch_count_hash, &cgroup_id);
 	if (counter) {
-		__sync_fetch_and_add(counter, 1);
+		(*counter)++;
 	} else {
 		bpf_map_update_elem(&avx_context_switch_count_hash, &cgroup_id,
 				    &count, BPF_ANY);
 	}
 
-	u64 last = bpf_ktime_get_ns();
-	bpf_map_update_elem(&last_update_ns_hash, &cgroup_id, &last, BPF_ANY);
+	bpf_map_update_elem(&last_update_ns_hash, &cgroup_id, &now, BPF_ANY);
 
 	return 0;
 }
@@ -145,6 +484,8 @@ Notes about Linux version:
    * We don't check LINUX_VERSION_CODE build time. It's user's responsibility to provide new enough headers.
    * Build failures may happen due to too old kernel headers (currently, Linux >= 5.1 headers are needed).
    * Our dependency to Kernel ABI is x86_fpu tracepoint parameters and struct fpu.
+   * The offset of avx512_timestamp in struct fpu is relocated at load time from
+     the kernel BTF (/sys/kernel/btf/vmlinux) when available.
    * The host kernel needs to run Linux >= 5.2 and the version is checked upon eBPF loading.
    * We build the minimum supported version in SEC("version") section.
    * Max supported version is not checked but the check may be added later.
@@ -0,0 +1,323 @@
+
+#include <uapi/linux/bpf.h>
+#include <linux/types.h>
+
+#define SEC(NAME) __attribute__((section(NAME), used))
+
+#ifndef KERNEL_VERSION
+    #define KERNEL_VERSION(a,b,c) (((a) << 16) + ((b) << 8) + (c))
+#endif
+
+#define BUF_SIZE_MAP_NS 256
+
+#define __inline __attribute__((always_inline)) inline
+
+/* number of log2 run queue latency buckets, the last one is open-ended */
+#define SCHEDLAT_SLOTS 24
+
+/* prev_state of sched_switch for preempted tasks, see __trace_sched_switch_state() */
+#define SCHEDLAT_TASK_REPORT_MAX 0x100
+
+/* maximum number of runnable tasks tracked at any time */
+#define TASK_MAP_SIZE 16384
+
+/*
+ * default capacity of the per-cgroup maps, overridden by userspace at load
+ * time. The maps are LRU so cgroups of exited containers eventually get
+ * evicted even if userspace never gets around to removing them.
+ */
+#define CGROUP_MAP_SIZE 1024
+
+typedef struct bpf_map_def {
+	unsigned int type;
+	unsigned int key_size;
+	unsigned int value_size;
+	unsigned int max_entries;
+	unsigned int map_flags;
+	unsigned int pinning;
+	char namespace[BUF_SIZE_MAP_NS];
+} bpf_map_def;
+
+static u64 (*bpf_get_current_cgroup_id)(void) = (void *)
+	BPF_FUNC_get_current_cgroup_id;
+
+static u64 (*bpf_ktime_get_ns)(void) = (void *)
+	BPF_FUNC_ktime_get_ns;
+
+static int (*bpf_map_update_elem)(void *map, void *key, void *value,
+				  u64 flags) = (void *)BPF_FUNC_map_update_elem;
+
+static void *(*bpf_map_lookup_elem)(void *map, void *key) = (void *)
+	BPF_FUNC_map_lookup_elem;
+
+static int (*bpf_map_delete_elem)(void *map, void *key) = (void *)
+	BPF_FUNC_map_delete_elem;
+
+/*
+ * Run queue latency histogram and migration counts of a cgroup. Bucket i
+ * counts waits of [2^i, 2^(i+1)) microseconds, bucket 0 waits below 2 us.
+ */
+struct cgroup_stats {
+	u64 slots[SCHEDLAT_SLOTS];
+	u64 wait_ns;
+	u64 migrations;
+	u64 cross_node;
+};
+
+struct bpf_map_def
+	SEC("maps/schedlat_cgroup_stats") schedlat_cgroup_stats_hash = {
+		.type = BPF_MAP_TYPE_LRU_PERCPU_HASH,
+		.key_size = sizeof(u64),
+		.value_size = sizeof(struct cgroup_stats),
+		.max_entries = CGROUP_MAP_SIZE,
+	};
+
+/* time each runnable task was put on a run queue, by pid */
+struct bpf_map_def
+	SEC("maps/schedlat_enqueue_ns") schedlat_enqueue_ns_hash = {
+		.type = BPF_MAP_TYPE_LRU_HASH,
+		.key_size = sizeof(u32),
+		.value_size = sizeof(u64),
+		.max_entries = TASK_MAP_SIZE,
+	};
+
+/*
+ * Scheduling events of a task not yet accounted to its cgroup. The cgroup
+ * of a task is only known in the context of the task itself, so the events
+ * are accounted when the task is next switched out.
+ */
+struct task_pending {
+	u32 pid;
+	u32 migrations;
+	u32 cross_node;
+	u32 pad;
+	u64 wait_ns;
+};
+
+struct bpf_map_def
+	SEC("maps/schedlat_migrations") schedlat_migrations_hash = {
+		.type = BPF_MAP_TYPE_LRU_HASH,
+		.key_size = sizeof(u32),
+		.value_size = sizeof(struct task_pending),
+		.max_entries = TASK_MAP_SIZE,
+	};
+
+/* the task switched in on every CPU and its run queue latency */
+struct bpf_map_def
+	SEC("maps/schedlat_running") schedlat_running_array = {
+		.type = BPF_MAP_TYPE_PERCPU_ARRAY,
+		.key_size = sizeof(u32),
+		.value_size = sizeof(struct task_pending),
+		.max_entries = 1,
+	};
+
+/*
+ * NUMA node of every CPU, filled in by userspace. max_entries is filled
+ * in by the loader with the number of possible CPUs.
+ */
+struct bpf_map_def
+	SEC("maps/schedlat_cpu_node") schedlat_cpu_node_array = {
+		.type = BPF_MAP_TYPE_ARRAY,
+		.key_size = sizeof(u32),
+		.value_size = sizeof(u32),
+		.max_entries = 0,
+	};
+
+/* userspace verifies the offsets of these against the tracepoint formats */
+struct sched_wakeup_args {
+	u64 pad;
+	char comm[16];
+	int pid;
+	int prio;
+	int success;
+	int target_cpu;
+};
+
+struct sched_switch_args {
+	u64 pad;
+	char prev_comm[16];
+	int prev_pid;
+	int prev_prio;
+	long long prev_state;
+	char next_comm[16];
+	int next_pid;
+	int next_prio;
+};
+
+struct sched_migrate_task_args {
+	u64 pad;
+	char comm[16];
+	int pid;
+	int prio;
+	int orig_cpu;
+	int dest_cpu;
+};
+
+static __inline u32 log2_slot(u64 us)
+{
+	u32 slot = 0;
+
+#pragma unroll
+	for (int i = 0; i < SCHEDLAT_SLOTS - 1; i++) {
+		if (us > 1) {
+			us >>= 1;
+			slot++;
+		}
+	}
+
+	return slot;
+}
+
+static __inline void enqueue(u32 pid)
+{
+	u64 now = bpf_ktime_get_ns();
+
+	if (pid == 0) {
+		return;
+	}
+
+	bpf_map_update_elem(&schedlat_enqueue_ns_hash, &pid, &now, BPF_ANY);
+}
+
+/* account adds the pending events of the current task to its cgroup */
+static __inline void account(struct task_pending *p)
+{
+	u64 cgroup_id = bpf_get_current_cgroup_id();
+	struct cgroup_stats *stats;
+
+	stats = bpf_map_lookup_elem(&schedlat_cgroup_stats_hash, &cgroup_id);
+	if (!stats) {
+		struct cgroup_stats zero = {};
+
+		bpf_map_update_elem(&schedlat_cgroup_stats_hash, &cgroup_id,
+				    &zero, BPF_NOEXIST);
+		stats = bpf_map_lookup_elem(&schedlat_cgroup_stats_hash,
+					    &cgroup_id);
+		if (!stats) {
+			return;
+		}
+	}
+
+	/* per-CPU value, no need for atomic increments */
+	if (p->wait_ns) {
+		u32 slot = log2_slot(p->wait_ns / 1000);
+
+		if (slot < SCHEDLAT_SLOTS) {
+			stats->slots[slot]++;
+		}
+		stats->wait_ns += p->wait_ns;
+	}
+	stats->migrations += p->migrations;
+	stats->cross_node += p->cross_node;
+}
+
+SEC("tracepoint/sched/sched_wakeup")
+int tracepoint__sched_wakeup(struct sched_wakeup_args *args)
+{
+	enqueue(args->pid);
+	return 0;
+}
+
+SEC("tracepoint/sched/sched_wakeup_new")
+int tracepoint__sched_wakeup_new(struct sched_wakeup_args *args)
+{
+	enqueue(args->pid);
+	return 0;
+}
+
+SEC("tracepoint/sched/sched_switch")
+int tracepoint__sched_switch(struct sched_switch_args *args)
+{
+	u32 prev = args->prev_pid, next = args->next_pid;
+	struct task_pending *running, *migrated;
+	u32 key = 0;
+	u64 *tsp;
+
+	running = bpf_map_lookup_elem(&schedlat_running_array, &key);
+	if (!running) {
+		return 0;
+	}
+
+	/* the task being switched out is current, account its pending events */
+	if (prev != 0) {
+		if (running->pid == prev && running->wait_ns) {
+			account(running);
+		}
+
+		migrated = bpf_map_lookup_elem(&schedlat_migrations_hash, &prev);
+		if (migrated) {
+			migrated->wait_ns = 0;
+			account(migrated);
+			bpf_map_delete_elem(&schedlat_migrations_hash, &prev);
+		}
+	}
+
+	/* a preempted task goes right back to the run queue */
+	if (args->prev_state == 0 || args->prev_state == SCHEDLAT_TASK_REPORT_MAX) {
+		enqueue(prev);
+	}
+
+	running->pid = next;
+	running->wait_ns = 0;
+
+	if (next == 0) {
+		return 0;
+	}
+
+	tsp = bpf_map_lookup_elem(&schedlat_enqueue_ns_hash, &next);
+	if (!tsp) {
+		return 0;
+	}
+
+	running->wait_ns = bpf_ktime_get_ns() - *tsp;
+	bpf_map_delete_elem(&schedlat_enqueue_ns_hash, &next);
+
+	return 0;
+}
+
+SEC("tracepoint/sched/sched_migrate_task")
+int tracepoint__sched_migrate_task(struct sched_migrate_task_args *args)
+{
+	u32 pid = args->pid, orig = args->orig_cpu, dest = args->dest_cpu;
+	struct task_pending *p;
+	u32 *orig_node, *dest_node;
+
+	if (pid == 0 || orig == dest) {
+		return 0;
+	}
+
+	p = bpf_map_lookup_elem(&schedlat_migrations_hash, &pid);
+	if (!p) {
+		struct task_pending zero = { .pid = pid };
+
+		bpf_map_update_elem(&schedlat_migrations_hash, &pid, &zero,
+				    BPF_NOEXIST);
+		p = bpf_map_lookup_elem(&schedlat_migrations_hash, &pid);
+		if (!p) {
+			return 0;
+		}
+	}
+
+	/* migrations of the same task can race on different CPUs */
+	__sync_fetch_and_add(&p->migrations, 1);
+
+	orig_node = bpf_map_lookup_elem(&schedlat_cpu_node_array, &orig);
+	dest_node = bpf_map_lookup_elem(&schedlat_cpu_node_array, &dest);
+	if (orig_node && dest_node && *orig_node != *dest_node) {
+		__sync_fetch_and_add(&p->cross_node, 1);
+	}
+
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
+
+/*
+Notes about Linux version:
+   * Our dependency to Kernel ABI is the sched_wakeup, sched_switch and
+     sched_migrate_task tracepoint parameters. Their offsets are checked
+     against the tracepoint formats upon eBPF loading.
+   * The host kernel needs to run Linux >= 5.2 and the version is checked upon eBPF loading.
+   * We build the minimum supported version in SEC("version") section.
+*/
+unsigned int _version SEC("version") = KERNEL_VERSION(5, 2, 0);
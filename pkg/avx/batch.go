@@ -0,0 +1,179 @@
+/*
+Copyright 2020 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package avx
+
+import (
+	"encoding/binary"
+	"io/ioutil"
+	"runtime"
+	"strconv"
+	"strings"
+	"unsafe"
+
+	bpf "github.com/cilium/ebpf"
+	"github.com/pkg/errors"
+	"golang.org/x/sys/unix"
+)
+
+const (
+	// bpf(2) batch commands, available since Linux 5.6
+	bpfMapLookupBatch          = 24
+	bpfMapLookupAndDeleteBatch = 25
+	// initial number of map entries to transfer with a single batch command
+	batchSize = 256
+	// path to the set of possible CPUs, the number of values in per-CPU maps
+	possibleCPUsPath = "/sys/devices/system/cpu/possible"
+)
+
+// bpfBatchAttr is the batch part of union bpf_attr.
+type bpfBatchAttr struct {
+	inBatch   uint64
+	outBatch  uint64
+	keys      uint64
+	values    uint64
+	count     uint32
+	mapFd     uint32
+	elemFlags uint64
+	flags     uint64
+}
+
+// batchReader reads eBPF maps with u64 keys using bpf(2) batch commands.
+type batchReader struct {
+	ncpu    int    // number of possible CPUs
+	keys    []byte // reused key buffer
+	values  []byte // reused value buffer
+	entries int    // number of entries the buffers can hold
+	calls   int    // number of bpf(2) calls issued
+}
+
+// newBatchReader creates a reader for batched map access.
+func newBatchReader() (*batchReader, error) {
+	ncpu, err := possibleCPUs()
+	if err != nil {
+		return nil, err
+	}
+	return &batchReader{
+		ncpu:    ncpu,
+		entries: batchSize,
+	}, nil
+}
+
+// possibleCPUs returns the number of possible CPUs.
+func possibleCPUs() (int, error) {
+	data, err := ioutil.ReadFile(possibleCPUsPath)
+	if err != nil {
+		return 0, errors.Wrap(err, "unable to read possible CPUs")
+	}
+
+	n := 0
+	for _, r := range strings.Split(strings.TrimSpace(string(data)), ",") {
+		bounds := strings.SplitN(r, "-", 2)
+		lo, err := strconv.Atoi(bounds[0])
+		if err != nil {
+			return 0, errors.Errorf("invalid possible CPUs %q", string(data))
+		}
+		hi := lo
+		if len(bounds) == 2 {
+			if hi, err = strconv.Atoi(bounds[1]); err != nil {
+				return 0, errors.Errorf("invalid possible CPUs %q", string(data))
+			}
+		}
+		if hi+1 > n {
+			n = hi + 1
+		}
+	}
+
+	return n, nil
+}
+
+// perCPUSize returns the size of all per-CPU values of an entry with the given value size.
+func (r *batchReader) perCPUSize(valueSize int) int {
+	return ((valueSize + 7) &^ 7) * r.ncpu
+}
+
+// sumPerCPU32 sums per-CPU u32 values of a batch entry.
+func (r *batchReader) sumPerCPU32(value []byte) uint64 {
+	var sum uint64
+	for cpu := 0; cpu < r.ncpu; cpu++ {
+		sum += uint64(binary.LittleEndian.Uint32(value[cpu*8:]))
+	}
+	return sum
+}
+
+// sumPerCPU64 sums per-CPU u64 values of a batch entry.
+func (r *batchReader) sumPerCPU64(value []byte) uint64 {
+	var sum uint64
+	for cpu := 0; cpu < r.ncpu; cpu++ {
+		sum += binary.LittleEndian.Uint64(value[cpu*8:])
+	}
+	return sum
+}
+
+// drain reads, and optionally deletes, all entries of the map calling fn for each.
+func (r *batchReader) drain(m *bpf.Map, valueSize int, del bool, fn func(key uint64, value []byte)) error {
+	var inBatch, outBatch uint64
+
+	cmd := uintptr(bpfMapLookupBatch)
+	if del {
+		cmd = bpfMapLookupAndDeleteBatch
+	}
+
+	first := true
+	for {
+		if len(r.keys) < 8*r.entries {
+			r.keys = make([]byte, 8*r.entries)
+		}
+		if len(r.values) < valueSize*r.entries {
+			r.values = make([]byte, valueSize*r.entries)
+		}
+
+		attr := bpfBatchAttr{
+			outBatch: uint64(uintptr(unsafe.Pointer(&outBatch))),
+			keys:     uint64(uintptr(unsafe.Pointer(&r.keys[0]))),
+			values:   uint64(uintptr(unsafe.Pointer(&r.values[0]))),
+			count:    uint32(r.entries),
+			mapFd:    uint32(m.FD()),
+		}
+		if !first {
+			attr.inBatch = uint64(uintptr(unsafe.Pointer(&inBatch)))
+		}
+
+		_, _, errno := unix.Syscall(unix.SYS_BPF, cmd, uintptr(unsafe.Pointer(&attr)), unsafe.Sizeof(attr))
+		runtime.KeepAlive(&inBatch)
+		runtime.KeepAlive(&outBatch)
+		r.calls++
+
+		for i := 0; i < int(attr.count); i++ {
+			key := binary.LittleEndian.Uint64(r.keys[8*i:])
+			fn(key, r.values[valueSize*i:valueSize*(i+1)])
+		}
+
+		switch {
+		case errno == unix.ENOENT:
+			return nil
+		case errno == unix.ENOSPC && attr.count == 0:
+			// a single hash bucket does not fit into our buffers
+			r.entries *= 2
+			continue
+		case errno != 0:
+			return errno
+		}
+
+		inBatch = outBatch
+		first = false
+	}
+}
@@ -0,0 +1,186 @@
+/*
+Copyright 2020 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package avx
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/binary"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+
+	"github.com/pkg/errors"
+)
+
+const (
+	// Path to the kernel BTF type information.
+	kernelBTFPath = "/sys/kernel/btf/vmlinux"
+	// BTF header magic.
+	btfMagic = 0xeb9f
+	// BTF header length up to and including the string section length.
+	btfHeaderLen = 24
+
+	// BTF type kinds we need to know about to walk the type section.
+	btfKindInt       = 1
+	btfKindArray     = 3
+	btfKindStruct    = 4
+	btfKindUnion     = 5
+	btfKindEnum      = 6
+	btfKindFuncProto = 13
+	btfKindVar       = 14
+	btfKindDatasec   = 15
+	btfKindDeclTag   = 17
+	btfKindEnum64    = 19
+	btfKindMax       = 19
+
+	// argument offset of struct fpu * in the x86_fpu tracepoints, x86_fpu_args in elf/avx512.c
+	fpuArgOffset = 8
+)
+
+// btfMemberOffset returns the byte offset of a member in a struct in the given BTF blob.
+func btfMemberOffset(data []byte, structName, memberName string) (uint32, error) {
+	var bo binary.ByteOrder
+
+	if len(data) < btfHeaderLen {
+		return 0, errors.New("BTF data too short")
+	}
+	switch {
+	case binary.LittleEndian.Uint16(data) == btfMagic:
+		bo = binary.LittleEndian
+	case binary.BigEndian.Uint16(data) == btfMagic:
+		bo = binary.BigEndian
+	default:
+		return 0, errors.New("invalid BTF magic")
+	}
+
+	hdrLen := bo.Uint32(data[4:])
+	typeOff, typeLen := bo.Uint32(data[8:]), bo.Uint32(data[12:])
+	strOff, strLen := bo.Uint32(data[16:]), bo.Uint32(data[20:])
+
+	if uint64(hdrLen)+uint64(typeOff)+uint64(typeLen) > uint64(len(data)) ||
+		uint64(hdrLen)+uint64(strOff)+uint64(strLen) > uint64(len(data)) {
+		return 0, errors.New("truncated BTF data")
+	}
+	types := data[hdrLen+typeOff : hdrLen+typeOff+typeLen]
+	strs := data[hdrLen+strOff : hdrLen+strOff+strLen]
+
+	name := func(off uint32) string {
+		if off >= uint32(len(strs)) {
+			return ""
+		}
+		if end := bytes.IndexByte(strs[off:], 0); end >= 0 {
+			return string(strs[off : off+uint32(end)])
+		}
+		return ""
+	}
+
+	for pos := 0; pos+12 <= len(types); {
+		nameOff := bo.Uint32(types[pos:])
+		info := bo.Uint32(types[pos+4:])
+		kind := (info >> 24) & 0x1f
+		vlen := int(info & 0xffff)
+		kflag := info>>31 != 0
+		pos += 12
+
+		var extra int
+		switch kind {
+		case btfKindInt, btfKindVar, btfKindDeclTag:
+			extra = 4
+		case btfKindArray:
+			extra = 12
+		case btfKindStruct, btfKindUnion, btfKindDatasec, btfKindEnum64:
+			extra = 12 * vlen
+		case btfKindEnum, btfKindFuncProto:
+			extra = 8 * vlen
+		default:
+			if kind > btfKindMax {
+				return 0, errors.Errorf("unknown BTF type kind %d", kind)
+			}
+		}
+		if pos+extra > len(types) {
+			return 0, errors.New("truncated BTF type section")
+		}
+
+		if kind == btfKindStruct && name(nameOff) == structName {
+			for m := 0; m < vlen; m++ {
+				member := types[pos+12*m:]
+				if name(bo.Uint32(member)) != memberName {
+					continue
+				}
+				bits := bo.Uint32(member[8:])
+				if kflag {
+					bits &= 0xffffff
+				}
+				if bits%8 != 0 {
+					return 0, errors.Errorf("%s.%s is a bitfield", structName, memberName)
+				}
+				return bits / 8, nil
+			}
+			return 0, errors.Errorf("struct %s has no member %s", structName, memberName)
+		}
+
+		pos += extra
+	}
+
+	return 0, errors.Errorf("struct %s not found", structName)
+}
+
+// fpuTimestampOffset returns the offset of avx512_timestamp in struct fpu of the running kernel.
+func fpuTimestampOffset() (uint32, error) {
+	data, err := ioutil.ReadFile(kernelBTFPath)
+	if err != nil {
+		return 0, err
+	}
+	return btfMemberOffset(data, "fpu", "avx512_timestamp")
+}
+
+// checkFpuTracepointFormat verifies that the x86_fpu tracepoint arguments match x86_fpu_args.
+func checkFpuTracepointFormat() error {
+	path := filepath.Join(kernelTracepointPath, "x86_fpu/x86_fpu_regs_deactivated", "format")
+	f, err := os.Open(path)
+	if err != nil {
+		return errors.Wrap(err, "unable to read fpu tracepoint format")
+	}
+	defer f.Close()
+
+	// the interesting line looks like
+	//     field:struct fpu * fpu;	offset:8;	size:8;	signed:0;
+	scanner := bufio.NewScanner(f)
+	for scanner.Scan() {
+		fields := strings.Split(strings.TrimSpace(scanner.Text()), ";")
+		if len(fields) < 2 || !strings.HasSuffix(fields[0], " fpu") {
+			continue
+		}
+		offset, err := strconv.Atoi(strings.TrimPrefix(strings.TrimSpace(fields[1]), "offset:"))
+		if err != nil {
+			return errors.Wrapf(err, "invalid fpu tracepoint format %q", scanner.Text())
+		}
+		if offset != fpuArgOffset {
+			return errors.Errorf("unexpected fpu argument offset %d (!= %d) in fpu tracepoint",
+				offset, fpuArgOffset)
+		}
+		return nil
+	}
+	if err := scanner.Err(); err != nil {
+		return errors.Wrap(err, "unable to read fpu tracepoint format")
+	}
+
+	return errors.New("no fpu argument in fpu tracepoint format")
+}
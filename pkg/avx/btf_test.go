@@ -0,0 +1,139 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package avx
+
+import (
+	"bytes"
+	"encoding/binary"
+	"testing"
+)
+
+type btfMember struct {
+	name   string
+	offset uint32 // in bits
+}
+
+type btfStruct struct {
+	name    string
+	kflag   bool
+	members []btfMember
+}
+
+// buildBTF builds a little-endian BTF blob with an int followed by the given structs.
+func buildBTF(structs ...btfStruct) []byte {
+	strs := &bytes.Buffer{}
+	strs.WriteByte(0)
+	str := func(s string) uint32 {
+		off := uint32(strs.Len())
+		strs.WriteString(s)
+		strs.WriteByte(0)
+		return off
+	}
+
+	types := &bytes.Buffer{}
+	put := func(vals ...uint32) {
+		for _, v := range vals {
+			binary.Write(types, binary.LittleEndian, v)
+		}
+	}
+
+	put(str("int"), btfKindInt<<24, 4, 32)
+	for _, s := range structs {
+		info := uint32(btfKindStruct<<24 | len(s.members))
+		if s.kflag {
+			info |= 1 << 31
+		}
+		put(str(s.name), info, 64)
+		for _, m := range s.members {
+			put(str(m.name), 1, m.offset)
+		}
+	}
+
+	hdr := &bytes.Buffer{}
+	binary.Write(hdr, binary.LittleEndian, uint16(btfMagic))
+	hdr.Write([]byte{1, 0})
+	for _, v := range []uint32{btfHeaderLen, 0, uint32(types.Len()), uint32(types.Len()), uint32(strs.Len())} {
+		binary.Write(hdr, binary.LittleEndian, v)
+	}
+
+	return append(append(hdr.Bytes(), types.Bytes()...), strs.Bytes()...)
+}
+
+func TestBTFMemberOffset(t *testing.T) {
+	fpu := btfStruct{
+		name: "fpu",
+		members: []btfMember{
+			{name: "last_cpu", offset: 0},
+			{name: "avx512_timestamp", offset: 64},
+		},
+	}
+	other := btfStruct{
+		name:    "task_struct",
+		members: []btfMember{{name: "avx512_timestamp", offset: 128}},
+	}
+
+	tcases := []struct {
+		name          string
+		data          []byte
+		expectedError bool
+		expected      uint32
+	}{
+		{
+			name:     "member found",
+			data:     buildBTF(other, fpu),
+			expected: 8,
+		},
+		{
+			name: "member found with kind flag",
+			data: buildBTF(btfStruct{
+				name:    "fpu",
+				kflag:   true,
+				members: []btfMember{{name: "avx512_timestamp", offset: 5<<24 | 128}},
+			}),
+			expected: 16,
+		},
+		{
+			name:          "missing member",
+			data:          buildBTF(btfStruct{name: "fpu", members: []btfMember{{name: "last_cpu"}}}),
+			expectedError: true,
+		},
+		{
+			name:          "missing struct",
+			data:          buildBTF(other),
+			expectedError: true,
+		},
+		{
+			name:          "invalid magic",
+			data:          make([]byte, btfHeaderLen),
+			expectedError: true,
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			offset, err := btfMemberOffset(tc.data, "fpu", "avx512_timestamp")
+			if tc.expectedError {
+				if err == nil {
+					t.Errorf("expected error, got offset %d", offset)
+				}
+				return
+			}
+			if err != nil {
+				t.Errorf("unexpected error: %v", err)
+			} else if offset != tc.expected {
+				t.Errorf("expected offset %d, got %d", tc.expected, offset)
+			}
+		})
+	}
+}
@@ -16,27 +16,22 @@ limitations under the License.
 
 package avx
 
-//go:generate go run elfdump.go
-
 import (
-	"bytes"
+	"encoding/binary"
 	"flag"
-	"fmt"
-	"io/ioutil"
+	"os"
 	"path/filepath"
 	"regexp"
-	"strconv"
-	"strings"
-	"sync"
 	"syscall"
+	"time"
 	"unsafe"
 
 	bpf "github.com/cilium/ebpf"
 	"github.com/intel/cri-resource-manager/pkg/cgroups"
+	"github.com/intel/cri-resource-manager/pkg/ebpf"
 	logger "github.com/intel/cri-resource-manager/pkg/log"
 	"github.com/pkg/errors"
 	"github.com/prometheus/client_golang/prometheus"
-	"golang.org/x/sys/unix"
 )
 
 const (
@@ -48,10 +43,49 @@ const (
 	AllSwitchCountName = "all_switch_count_per_cgroup"
 	// LastUpdateNs is the Prometheuse Gauge name for per cgroup AVX512 activity timestamp.
 	LastUpdateNs = "last_update_ns"
+	// AVXResidencyNsName is the Prometheuse Gauge name for AVX512 residency time per cgroup.
+	AVXResidencyNsName = "avx512_residency_ns_per_cgroup"
+	// CPUResidencyNsName is the Prometheuse Gauge name for AVX512 residency time per CPU.
+	CPUResidencyNsName = "avx512_residency_ns_per_cpu"
+	// CoreSwitchCountName is the Prometheuse Gauge name for AVX512 task switches per core.
+	CoreSwitchCountName = "avx_task_switches_per_core"
+	// CoreResidencyNsName is the Prometheuse Gauge name for AVX512 residency time per core.
+	CoreResidencyNsName = "avx512_residency_ns_per_core"
+	// PackageSwitchCountName is the Prometheuse Gauge name for AVX512 task switches per package.
+	PackageSwitchCountName = "avx_task_switches_per_package"
+	// PackageResidencyNsName is the Prometheuse Gauge name for AVX512 residency time per package.
+	PackageResidencyNsName = "avx512_residency_ns_per_package"
+	// NodeSwitchCountName is the Prometheuse Gauge name for AVX512 task switches per NUMA node.
+	NodeSwitchCountName = "avx_task_switches_per_node"
+	// NodeResidencyNsName is the Prometheuse Gauge name for AVX512 residency time per NUMA node.
+	NodeResidencyNsName = "avx512_residency_ns_per_node"
+	// ProgRunCountName is the Prometheuse Counter name for the number of eBPF program runs.
+	ProgRunCountName = "avx_ebpf_program_run_count"
+	// ProgRunTimeNsName is the Prometheuse Counter name for the total run time of eBPF programs.
+	ProgRunTimeNsName = "avx_ebpf_program_run_time_ns"
+	// ProgAvgRunTimeNsName is the Prometheuse Gauge name for the average run time of eBPF programs.
+	ProgAvgRunTimeNsName = "avx_ebpf_program_avg_run_time_ns"
+	// CollectDurationName is the Prometheuse Gauge name for the duration of AVX512 metrics collection.
+	CollectDurationName = "avx_collect_duration_seconds"
+	// CollectSyscallsName is the Prometheuse Gauge name for bpf(2) calls of AVX512 metrics collection.
+	CollectSyscallsName = "avx_collect_bpf_syscalls"
 	// Path to kernel tracepoints
-	kernelTracepointPath = "/sys/kernel/debug/tracing/events"
+	kernelTracepointPath = ebpf.TracepointPath
 	// rlimit value (512k) needed to lock map data in memory
 	mapMemLockLimit = 524288
+	// default capacity of the per-cgroup eBPF maps
+	defaultCgroupMapSize = 1024
+	// interval for sweeping cgroups that no longer exist from the eBPF maps
+	sweepInterval = 5 * time.Minute
+	// minimum kernel version for batched eBPF map operations
+	batchKernelVersion = 5<<16 + 6<<8
+)
+
+// avx_config_array indices, AVX_CONFIG_* in elf/avx512.c
+const (
+	configFlags = iota
+	configFilterGen
+	configFpuTsOffset
 )
 
 // Prometheus Metric descriptor indices and descriptor table
@@ -60,6 +94,19 @@ const (
 	avxSwitchCountDesc
 	allSwitchCountDesc
 	lastUpdateNsDesc
+	avxResidencyNsDesc
+	cpuResidencyNsDesc
+	coreSwitchCountDesc
+	coreResidencyNsDesc
+	packageSwitchCountDesc
+	packageResidencyNsDesc
+	nodeSwitchCountDesc
+	nodeResidencyNsDesc
+	progRunCountDesc
+	progRunTimeNsDesc
+	progAvgRunTimeNsDesc
+	collectDurationDesc
+	collectSyscallsDesc
 	numDescriptors
 )
 
@@ -92,137 +139,279 @@ var descriptors = [numDescriptors]*prometheus.Desc{
 			"container_id",
 		}, nil,
 	),
+	avxResidencyNsDesc: prometheus.NewDesc(
+		AVXResidencyNsName,
+		"On-CPU time (ns) of task time slices where AVX512 instructions were used in a particular cgroup.",
+		[]string{
+			"container_id",
+		}, nil,
+	),
+	cpuResidencyNsDesc: prometheus.NewDesc(
+		CPUResidencyNsName,
+		"On-CPU time (ns) of task time slices where AVX512 instructions were used on the CPU.",
+		[]string{
+			"cpu_id",
+		}, nil,
+	),
+	coreSwitchCountDesc: prometheus.NewDesc(
+		CoreSwitchCountName,
+		"Number of task switches on the core where AVX512 instructions were used.",
+		[]string{
+			"package_id",
+			"core_id",
+		}, nil,
+	),
+	coreResidencyNsDesc: prometheus.NewDesc(
+		CoreResidencyNsName,
+		"On-CPU time (ns) of task time slices where AVX512 instructions were used on the core.",
+		[]string{
+			"package_id",
+			"core_id",
+		}, nil,
+	),
+	packageSwitchCountDesc: prometheus.NewDesc(
+		PackageSwitchCountName,
+		"Number of task switches on the package where AVX512 instructions were used.",
+		[]string{
+			"package_id",
+		}, nil,
+	),
+	packageResidencyNsDesc: prometheus.NewDesc(
+		PackageResidencyNsName,
+		"On-CPU time (ns) of task time slices where AVX512 instructions were used on the package.",
+		[]string{
+			"package_id",
+		}, nil,
+	),
+	nodeSwitchCountDesc: prometheus.NewDesc(
+		NodeSwitchCountName,
+		"Number of task switches on the NUMA node where AVX512 instructions were used.",
+		[]string{
+			"node_id",
+		}, nil,
+	),
+	nodeResidencyNsDesc: prometheus.NewDesc(
+		NodeResidencyNsName,
+		"On-CPU time (ns) of task time slices where AVX512 instructions were used on the NUMA node.",
+		[]string{
+			"node_id",
+		}, nil,
+	),
+	progRunCountDesc: prometheus.NewDesc(
+		ProgRunCountName,
+		"Number of times the AVX512 eBPF program has run.",
+		[]string{
+			"program",
+		}, nil,
+	),
+	progRunTimeNsDesc: prometheus.NewDesc(
+		ProgRunTimeNsName,
+		"Total run time (ns) of the AVX512 eBPF program.",
+		[]string{
+			"program",
+		}, nil,
+	),
+	progAvgRunTimeNsDesc: prometheus.NewDesc(
+		ProgAvgRunTimeNsName,
+		"Average run time (ns) per invocation of the AVX512 eBPF program.",
+		[]string{
+			"program",
+		}, nil,
+	),
+	collectDurationDesc: prometheus.NewDesc(
+		CollectDurationName,
+		"Time it took to collect and send AVX512 metrics, excluding these self statistics.",
+		nil, nil,
+	),
+	collectSyscallsDesc: prometheus.NewDesc(
+		CollectSyscallsName,
+		"Number of bpf(2) calls issued while collecting AVX512 metrics.",
+		nil, nil,
+	),
 }
 
 var (
-	bpfBinaryName  = "avx512.o"
-	bpfInstallpath = "/usr/libexec/bpf"
+	// bpfObjectName is the name of our eBPF object, elf/avx512.c.
+	bpfObjectName = "avx512"
+
+	// tracepoints are the programs of elf/avx512.c and the tracepoints they attach to.
+	tracepoints = map[string]string{
+		"tracepoint__x86_fpu_regs_deactivated": "x86_fpu/x86_fpu_regs_deactivated",
+		"tracepoint__sched_switch":             "sched/sched_switch",
+	}
+
+	// streamEvents enables streaming AVX512 activity from the eBPF programs.
+	streamEvents = false
+
+	// firstUseEvents enables notifications about cgroups starting to use AVX512.
+	firstUseEvents = true
+
+	// selfStatsEnabled enables exporting the run-time overhead of AVX512 collection.
+	selfStatsEnabled = false
+
+	// cgroupMapSize is the capacity of the per-cgroup eBPF maps.
+	cgroupMapSize uint = defaultCgroupMapSize
+
+	// cgroupMaps are the per-cgroup eBPF maps, with entries for removed cgroups swept periodically.
+	cgroupMaps = []string{
+		"all_context_switch_count_hash",
+		"avx_context_switch_count_hash",
+		"avx_timestamp_hash",
+		"last_update_ns_hash",
+		"avx_residency_ns_hash",
+	}
+
+	// pinnedMaps are the counter maps kept in bpffs across restarts, with the
+	// last update timestamps the counters are reported with. They are drained
+	// on every scrape, so what survives a restart is the activity not scraped
+	// yet. The rest, like first use timestamps, time slices, the AVX512 cgroup
+	// filter or pending stream records, refer to the state of the previous instance.
+	pinnedMaps = []string{
+		"all_context_switch_count_hash",
+		"avx_context_switch_count_hash",
+		"avx_residency_ns_hash",
+		"last_update_ns_hash",
+	}
 
 	// our logger instance
 	log = logger.NewLogger("avx")
 )
 
 type collector struct {
-	root string
-	ebpf *bpf.Collection
-	fds  []int
+	root   string
+	cgid   *cgroups.CgroupID
+	obj    *ebpf.Object
+	ebpf   *bpf.Collection
+	stream *eventStream
+	// current generation of the AVX-active cgroup filter
+	filterGen uint32
+	// time of the last sweep of removed cgroups
+	lastSweep time.Time
+	// CPU topology for aggregating per-CPU activity
+	topology *cpuTopology
+	// last read cumulative per-CPU activity
+	lastCPUStats []cpuStats
+	// batched map reader, nil if batch operations are not supported
+	batch *batchReader
+	// number of bpf(2) calls issued during the ongoing scrape
+	syscalls int
+	// self-overhead statistics, nil if disabled
+	stats *selfStats
 }
 
-func enablePerfTracepoint(prog *bpf.Program, tracepoint string) (int, error) {
+// NewCollector creates new Prometheus collector for AVX metrics
+func NewCollector() (prometheus.Collector, error) {
 
-	id, err := ioutil.ReadFile(filepath.Join(kernelTracepointPath, tracepoint, "id"))
-	if err != nil {
-		return -1, errors.Wrap(err, "unable to read tracepoint ID")
+	mapSizes := make(map[string]uint32)
+	for _, name := range cgroupMaps {
+		mapSizes[name] = uint32(cgroupMapSize)
 	}
 
-	tid, err := strconv.Atoi(strings.TrimSpace(string(id)))
+	obj, err := ebpf.Load(bpfObjectName, &ebpf.Options{
+		MapSizes: mapSizes,
+		MemLock:  mapMemLockLimit,
+		Pin:      pinnedMaps,
+	})
 	if err != nil {
-		return -1, errors.New("unable to convert tracepoint ID")
+		return nil, err
 	}
+	collection := obj.Collection
 
-	attr := unix.PerfEventAttr{
-		Type:        unix.PERF_TYPE_TRACEPOINT,
-		Config:      uint64(tid), // tracepoint id
-		Sample_type: unix.PERF_SAMPLE_RAW,
-		Sample:      1,
-		Wakeup:      1,
+	if err := relocateFpu(collection); err != nil {
+		obj.Close()
+		return nil, err
 	}
 
-	pfd, err := unix.PerfEventOpen(&attr, -1, 0, -1, unix.PERF_FLAG_FD_CLOEXEC)
-	if err != nil {
-		return -1, errors.Wrap(err, "unable to open perf events")
+	var stream *eventStream
+	if streamEvents {
+		if stream, err = newEventStream(collection); err != nil {
+			obj.Close()
+			return nil, errors.Wrap(err, "unable to set up AVX512 event stream")
+		}
 	}
 
-	if _, _, errno := unix.Syscall(unix.SYS_IOCTL, uintptr(pfd), unix.PERF_EVENT_IOC_ENABLE, 0); errno != 0 {
-		return -1, errors.Errorf("unable to set up perf events: %s", errno)
+	root := cgroups.GetV2Dir()
+	c := &collector{
+		root:   root,
+		cgid:   cgroups.NewCgroupID(root),
+		obj:    obj,
+		ebpf:   collection,
+		stream: stream,
 	}
 
-	if _, _, errno := unix.Syscall(unix.SYS_IOCTL, uintptr(pfd), unix.PERF_EVENT_IOC_SET_BPF, uintptr(prog.FD())); errno != 0 {
-		return -1, errors.Errorf("unable to attach bpf program to perf events: %s", errno)
+	// Keep cgroup lookups out of the metrics collection path by tracking
+	// cgroup creation and removal. Misses still fall back to a full walk.
+	if err := c.cgid.Watch(); err != nil {
+		log.Warn("failed to watch cgroups, resolving cgroup IDs by walking: %v", err)
 	}
 
-	return pfd, nil
-}
-
-func getKernelVersion() uint32 {
-
-	var uts unix.Utsname
-
-	err := unix.Uname(&uts)
-	if err != nil {
-		return 0
+	for name, tracepoint := range tracepoints {
+		if err := obj.AttachTracepoint(name, tracepoint); err != nil {
+			c.close()
+			return nil, err
+		}
 	}
 
-	str := string(bytes.SplitN(uts.Release[:], []byte{0}, 2)[0])
-
-	ver := strings.SplitN(str, ".", 3)
-
-	major, err := strconv.ParseUint(ver[0], 10, 8)
-	if err != nil {
-		return 0
-	}
-	minor, err := strconv.ParseUint(ver[1], 10, 8)
-	if err != nil {
-		return uint32(major << 16)
+	if ebpf.KernelVersion() >= batchKernelVersion {
+		if c.batch, err = newBatchReader(); err != nil {
+			log.Warn("failed to set up batched eBPF map reads: %v", err)
+		}
 	}
 
-	// ignore patch version
-	return uint32(major<<16 + minor<<8)
-}
-
-func kernelVersionStr(v uint32) string {
-	return fmt.Sprintf("%d.%d.0", v>>16, (v>>8)&0xff)
-}
-
-// NewCollector creates new Prometheus collector for AVX metrics
-func NewCollector() (prometheus.Collector, error) {
-
-	// Set rlimit to be able to lock map values in memory
-	memlockLimit := &unix.Rlimit{
-		Cur: mapMemLockLimit,
-		Max: mapMemLockLimit,
-	}
-	err := unix.Setrlimit(unix.RLIMIT_MEMLOCK, memlockLimit)
-	if err != nil {
-		return nil, errors.Wrap(err, "unable to set rlimit")
+	if firstUseEvents {
+		if err := startFirstUseNotifier(collection, c.cgid); err != nil {
+			log.Warn("failed to set up AVX512 first use notifications: %v", err)
+		}
 	}
 
-	spec, err := bpf.LoadCollectionSpec(filepath.Join(bpfInstallpath, bpfBinaryName))
-	if err != nil {
-		log.Info("Unable to load user eBPF (%v). Using default CollectionSpec from ELF program bytes", err)
-		spec, err = bpf.LoadCollectionSpecFromReader(bytes.NewReader(program[:]))
-		if err != nil {
-			return nil, errors.Wrap(err, "unable to load default CollectionSpec from ELF program bytes")
+	if selfStatsEnabled {
+		if c.stats, err = newSelfStats(); err != nil {
+			log.Warn("failed to enable eBPF run-time statistics: %v", err)
 		}
 	}
 
-	hostVer := getKernelVersion()
-	progVer := spec.Programs["tracepoint__x86_fpu_regs_deactivated"].KernelVersion
+	if c.topology, err = newCPUTopology(); err != nil {
+		log.Warn("failed to discover CPU topology, AVX512 activity won't be aggregated: %v", err)
+	}
 
-	if hostVer < progVer {
-		return nil, errors.Wrapf(err, "The host kernel version (v%s) is too old to run the AVX512 collector program. Minimum version is v%s.", kernelVersionStr(hostVer), kernelVersionStr(progVer))
+	// Until the first filter generation is set up every slot matches
+	// and sched_switch falls back to looking up the counter maps.
+	c.resetFilter()
+
+	return c, nil
+}
+
+// close tears down the collector, stopping the event stream and detaching the eBPF programs.
+func (c *collector) close() {
+	if c.stream != nil {
+		c.stream.close()
+		c.stream = nil
 	}
+	c.cgid.Close()
+	c.obj.Close()
+}
 
-	collection, err := bpf.NewCollection(spec)
-	if err != nil {
-		return nil, errors.Wrap(err, "unable to create new Collection")
+// relocateFpu passes the struct fpu layout of the running kernel to the eBPF programs.
+func relocateFpu(collection *bpf.Collection) error {
+	if err := checkFpuTracepointFormat(); err != nil {
+		return err
 	}
 
-	ffd, err := enablePerfTracepoint(collection.Programs["tracepoint__x86_fpu_regs_deactivated"], "x86_fpu/x86_fpu_regs_deactivated")
+	offset, err := fpuTimestampOffset()
 	if err != nil {
-		return nil, errors.Wrap(err, "unable to enable fpu tracepoint")
+		if os.IsNotExist(err) {
+			log.Info("no kernel BTF, assuming struct fpu layout of build time kernel headers")
+			return nil
+		}
+		return errors.Wrap(err, "unable to find struct fpu layout in kernel BTF")
 	}
+	log.Debug("relocated fpu.avx512_timestamp to offset %d", offset)
 
-	sfd, err := enablePerfTracepoint(collection.Programs["tracepoint__sched_switch"], "sched/sched_switch")
-	if err != nil {
-		return nil, errors.Wrap(err, "unable to enable sched tracepoint")
+	if err := collection.Maps["avx_config_array"].Put(uint32(configFpuTsOffset), offset); err != nil {
+		return errors.Wrap(err, "unable to relocate struct fpu")
 	}
 
-	return &collector{
-		root: cgroups.GetV2Dir(),
-		ebpf: collection,
-		fds:  []int{ffd, sfd},
-	}, nil
+	return nil
 }
 
 // Describe implements prometheus.Collector interface
@@ -241,39 +430,150 @@ func nowNanoseconds() uint64 {
 	return 1000*1000*1000*uint64(sec) + uint64(nsec)
 }
 
+// avxSample is the AVX512 activity gathered for a single scrape.
+type avxSample struct {
+	avx  map[uint64]uint32 // AVX512 task switches per cgroup
+	all  map[uint64]uint32 // all task switches per cgroup
+	last map[uint64]uint64 // last AVX512 activity timestamp per cgroup
+	resi map[uint64]uint64 // AVX512 residency (ns) per cgroup
+	cpus map[int]cpuStats  // AVX512 activity per CPU
+}
+
+func newAvxSample() *avxSample {
+	return &avxSample{
+		avx:  make(map[uint64]uint32),
+		all:  make(map[uint64]uint32),
+		last: make(map[uint64]uint64),
+		resi: make(map[uint64]uint64),
+		cpus: make(map[int]cpuStats),
+	}
+}
+
+// containerIDRegexp matches container IDs in cgroup directory names.
+var containerIDRegexp = regexp.MustCompile(`[a-z0-9]{64}`)
+
 // Collect implements prometheus.Collector interface
-func (c collector) Collect(ch chan<- prometheus.Metric) {
-	var (
-		wg sync.WaitGroup
+func (c *collector) Collect(ch chan<- prometheus.Metric) {
+	var sample *avxSample
+
+	start := time.Now()
+	c.syscalls = 0
+
+	if time.Since(c.lastSweep) >= sweepInterval {
+		c.sweepMaps()
+	}
+
+	// Start a new AVX-active cgroup filter generation before taking the
+	// sample so sched_switch only tracks cgroups that show AVX512
+	// activity again.
+	c.resetFilter()
+
+	if c.stream != nil {
+		sample = c.stream.snapshot()
+	} else {
+		sample = c.drainMaps()
+	}
 
+	sample.cpus = c.readCPUStats()
+	c.syscalls++
+
+	c.emit(ch, sample)
+
+	if c.stats != nil {
+		c.stats.emit(ch, c.ebpf, time.Since(start), c.syscalls)
+	}
+}
+
+// drainMaps reads and resets the per-cgroup counters maintained by the eBPF programs.
+func (c *collector) drainMaps() *avxSample {
+	if c.batch != nil {
+		sample, err := c.drainMapsBatch()
+		if err == nil {
+			return sample
+		}
+		// Entries drained before the failure are gone from the maps,
+		// so the fallback picks up from the partial sample.
+		log.Warn("batched eBPF map reads failed, falling back to iteration: %v", err)
+		c.batch = nil
+		return c.iterateMaps(sample)
+	}
+
+	return c.iterateMaps(newAvxSample())
+}
+
+// drainMapsBatch drains the per-cgroup counters with batched lookup-and-delete operations.
+// On failure the activity drained so far is returned along with the error.
+func (c *collector) drainMapsBatch() (*avxSample, error) {
+	b := c.batch
+	sample := newAvxSample()
+
+	calls := b.calls
+	defer func() {
+		c.syscalls += b.calls - calls
+	}()
+
+	err := b.drain(c.ebpf.Maps["avx_context_switch_count_hash"], b.perCPUSize(4), true,
+		func(key uint64, value []byte) {
+			sample.avx[key] = uint32(b.sumPerCPU32(value))
+		})
+	if err != nil {
+		return sample, errors.Wrap(err, "avx_context_switch_count_hash")
+	}
+
+	err = b.drain(c.ebpf.Maps["all_context_switch_count_hash"], b.perCPUSize(4), true,
+		func(key uint64, value []byte) {
+			sample.all[key] = uint32(b.sumPerCPU32(value))
+		})
+	if err != nil {
+		return sample, errors.Wrap(err, "all_context_switch_count_hash")
+	}
+
+	err = b.drain(c.ebpf.Maps["avx_residency_ns_hash"], b.perCPUSize(8), true,
+		func(key uint64, value []byte) {
+			sample.resi[key] = b.sumPerCPU64(value)
+		})
+	if err != nil {
+		return sample, errors.Wrap(err, "avx_residency_ns_hash")
+	}
+
+	if len(sample.avx) > 0 {
+		err = b.drain(c.ebpf.Maps["last_update_ns_hash"], 8, false,
+			func(key uint64, value []byte) {
+				if _, ok := sample.avx[key]; ok {
+					sample.last[key] = binary.LittleEndian.Uint64(value)
+				}
+			})
+		if err != nil {
+			return sample, errors.Wrap(err, "last_update_ns_hash")
+		}
+	}
+
+	return sample, nil
+}
+
+// iterateMaps drains the per-cgroup counters by iterating over and deleting entries one by one,
+// adding them to the given sample.
+func (c *collector) iterateMaps(sample *avxSample) *avxSample {
+	var (
 		key       uint64
 		perCPUVal []uint32
 	)
 
-	cgroupids := make(map[uint64]uint32)
-	lastCPUs := make(map[string]uint32)
-
-	cg := cgroups.NewCgroupID(c.root)
-
 	m := c.ebpf.Maps["avx_context_switch_count_hash"]
 	iter := m.Iterate()
 
 	for iter.Next(&key, &perCPUVal) {
+		// MapIterator.Next is a NextKey and a Lookup
+		c.syscalls += 2
 		var sum uint32
-		for cpuID, count := range perCPUVal {
-			if count == 0 {
-				continue
-			}
+		for _, count := range perCPUVal {
 			sum = sum + count
-
-			cpuX := fmt.Sprintf("CPU%d", cpuID)
-			lastCPUs[cpuX] = lastCPUs[cpuX] + count
-
 		}
-		cgroupids[key] = sum
+		sample.avx[key] += sum
 		log.Debug("cgroupid %d => counter %d", key, sum)
 
 		// reset the counter by deleting the key
+		c.syscalls++
 		err := m.Delete(key)
 		if err != nil {
 			log.Error("%+v", err)
@@ -283,72 +583,64 @@ func (c collector) Collect(ch chan<- prometheus.Metric) {
 		log.Error("unable to iterate all elements of avx_context_switch_count: %+v", iter.Err())
 	}
 
-	for lastCPU, count := range lastCPUs {
-		ch <- prometheus.MustNewConstMetric(
-			descriptors[lastCPUDesc],
-			prometheus.GaugeValue,
-			float64(count),
-			lastCPU)
-	}
-
-	for cgroupid, counter := range cgroupids {
-		wg.Add(1)
-		go func(cgroupid_ uint64, counter_ uint32) {
-			var allCount uint32
-			var lastUpdate uint64
+	for cgroupid := range sample.avx {
+		var allCount uint32
+		var lastUpdate uint64
 
-			defer wg.Done()
-
-			path, err := cg.Find(cgroupid_)
-			if err != nil {
-				log.Error("failed to find cgroup by id: %v", err)
-				return
-			}
-
-			re := regexp.MustCompile(`[a-z0-9]{64}`)
-
-			ch <- prometheus.MustNewConstMetric(
-				descriptors[avxSwitchCountDesc],
-				prometheus.GaugeValue,
-				float64(counter_),
-				re.FindStringSubmatch(filepath.Base(path))[0])
-
-			if err := c.ebpf.Maps["all_context_switch_count_hash"].Lookup(uint64(cgroupid_), &allCount); err != nil {
-				log.Error("unable to find 'all' context switch count: %+v", err)
-				return
+		// counts already drained by a failed batch are in the sample
+		c.syscalls += 2
+		if err := c.ebpf.Maps["all_context_switch_count_hash"].Lookup(cgroupid, &perCPUVal); err == nil {
+			for _, count := range perCPUVal {
+				allCount += count
 			}
 			log.Debug("all: %d", allCount)
+			sample.all[cgroupid] += allCount
+		} else if _, ok := sample.all[cgroupid]; !ok {
+			log.Error("unable to find 'all' context switch count: %+v", err)
+		}
 
-			if err := c.ebpf.Maps["last_update_ns_hash"].Lookup(uint64(cgroupid_), &lastUpdate); err != nil {
-				log.Error("unable to find last update timestamp: %+v", err)
-				return
-			}
-			log.Debug("last: %d", lastUpdate)
+		if err := c.ebpf.Maps["last_update_ns_hash"].Lookup(cgroupid, &lastUpdate); err != nil {
+			log.Error("unable to find last update timestamp: %+v", err)
+			continue
+		}
+		log.Debug("last: %d", lastUpdate)
 
-			ch <- prometheus.MustNewConstMetric(
-				descriptors[allSwitchCountDesc],
-				prometheus.GaugeValue,
-				float64(allCount),
-				re.FindStringSubmatch(filepath.Base(path))[0])
+		if lastUpdate > sample.last[cgroupid] {
+			sample.last[cgroupid] = lastUpdate
+		}
+	}
 
-			ch <- prometheus.MustNewConstMetric(
-				descriptors[lastUpdateNsDesc],
-				prometheus.GaugeValue,
-				float64(nowNanoseconds()-lastUpdate),
-				re.FindStringSubmatch(filepath.Base(path))[0])
+	var perCPUNs []uint64
+	m = c.ebpf.Maps["avx_residency_ns_hash"]
+	iter = m.Iterate()
 
-		}(cgroupid, counter)
+	for iter.Next(&key, &perCPUNs) {
+		c.syscalls += 2
+		var sum uint64
+		for _, ns := range perCPUNs {
+			sum += ns
+		}
+		sample.resi[key] += sum
+
+		// reset the counter by deleting the key
+		c.syscalls++
+		err := m.Delete(key)
+		if err != nil {
+			log.Error("%+v", err)
+		}
 	}
 
-	// We need to wait so that the response channel doesn't get closed.
-	wg.Wait()
+	if iter.Err() != nil {
+		log.Error("unable to iterate all elements of avx_residency_ns: %+v", iter.Err())
+	}
 
 	m = c.ebpf.Maps["all_context_switch_count_hash"]
 	iter = m.Iterate()
 
-	var val uint32
-	for iter.Next(&key, &val) {
+	for iter.Next(&key, &perCPUVal) {
+		c.syscalls += 2
 		// reset the counter by deleting the key
+		c.syscalls++
 		err := m.Delete(key)
 		if err != nil {
 			log.Error("%+v", err)
@@ -358,9 +650,137 @@ func (c collector) Collect(ch chan<- prometheus.Metric) {
 	if iter.Err() != nil {
 		log.Error("unable to reset all elements of all_context_switch_count: %+v", iter.Err())
 	}
+
+	return sample
+}
+
+// sweepMaps removes entries of cgroups that no longer exist from the per-cgroup maps.
+func (c *collector) sweepMaps() {
+	c.lastSweep = time.Now()
+
+	live, err := c.cgid.Refresh()
+	if err != nil {
+		log.Error("failed to list cgroups for sweeping eBPF maps: %v", err)
+		return
+	}
+
+	for _, name := range cgroupMaps {
+		var (
+			key  uint64
+			next uint64
+			gone []uint64
+		)
+
+		m, ok := c.ebpf.Maps[name]
+		if !ok {
+			continue
+		}
+
+		// collect keys first, deleting while walking the map might restart the walk
+		for k := interface{}(nil); ; k = key {
+			c.syscalls++
+			if err := m.NextKey(k, &next); err != nil {
+				if !errors.Is(err, bpf.ErrKeyNotExist) {
+					log.Error("unable to walk %s: %v", name, err)
+				}
+				break
+			}
+			if _, ok := live[next]; !ok {
+				gone = append(gone, next)
+			}
+			key = next
+		}
+
+		for _, key := range gone {
+			c.syscalls++
+			if err := m.Delete(key); err != nil && !errors.Is(err, bpf.ErrKeyNotExist) {
+				log.Error("unable to delete removed cgroup %d from %s: %v", key, name, err)
+			}
+		}
+
+		if len(gone) > 0 {
+			log.Debug("swept %d removed cgroups from %s", len(gone), name)
+		}
+	}
+}
+
+// resetFilter invalidates all entries of the AVX-active cgroup filter.
+func (c *collector) resetFilter() {
+	m, ok := c.ebpf.Maps["avx_config_array"]
+	if !ok {
+		return
+	}
+
+	c.filterGen++
+	if c.filterGen == 0 {
+		// zero is the value of never marked slots
+		c.filterGen++
+	}
+	c.syscalls++
+	if err := m.Put(uint32(configFilterGen), c.filterGen); err != nil {
+		log.Error("unable to reset AVX-active cgroup filter: %v", err)
+	}
+}
+
+// emit sends the metrics for the given sample to the Prometheus channel.
+func (c *collector) emit(ch chan<- prometheus.Metric, sample *avxSample) {
+	c.emitCPUStats(ch, sample.cpus)
+
+	now := nowNanoseconds()
+	for cgroupid, counter := range sample.avx {
+		// Unknown cgroups are resolved by a single walk shared by all lookups.
+		path, err := c.cgid.Find(cgroupid)
+		if err != nil {
+			log.Debug("failed to find cgroup by id: %v", err)
+			continue
+		}
+
+		id := containerIDRegexp.FindStringSubmatch(filepath.Base(path))
+		if id == nil {
+			log.Debug("no container ID in cgroup path %q", path)
+			continue
+		}
+
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[avxSwitchCountDesc],
+			prometheus.GaugeValue,
+			float64(counter),
+			id[0])
+
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[avxResidencyNsDesc],
+			prometheus.GaugeValue,
+			float64(sample.resi[cgroupid]),
+			id[0])
+
+		allCount, ok := sample.all[cgroupid]
+		if !ok {
+			continue
+		}
+
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[allSwitchCountDesc],
+			prometheus.GaugeValue,
+			float64(allCount),
+			id[0])
+
+		if lastUpdate, ok := sample.last[cgroupid]; ok {
+			ch <- prometheus.MustNewConstMetric(
+				descriptors[lastUpdateNsDesc],
+				prometheus.GaugeValue,
+				float64(now-lastUpdate),
+				id[0])
+		}
+	}
 }
 
 func init() {
-	flag.StringVar(&bpfInstallpath, "bpf-install-path", bpfInstallpath,
-		"Path to eBPF install directory")
+	flag.BoolVar(&streamEvents, "avx-stream-events", streamEvents,
+		"Stream AVX512 activity from eBPF through a perf buffer instead of draining maps on every scrape")
+	flag.BoolVar(&firstUseEvents, "avx-first-use-events", firstUseEvents,
+		"Notify immediately about cgroups starting to use AVX512")
+	flag.BoolVar(&selfStatsEnabled, "avx-self-stats", selfStatsEnabled,
+		"Export run-time statistics of the AVX512 eBPF programs and the collector itself")
+	flag.UintVar(&cgroupMapSize, "avx-cgroup-map-size", cgroupMapSize,
+		"Maximum number of cgroups tracked in the AVX512 eBPF maps")
 }
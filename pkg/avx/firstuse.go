@@ -0,0 +1,101 @@
+/*
+Copyright 2020 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package avx
+
+import (
+	"encoding/binary"
+	"os"
+	"sync"
+
+	bpf "github.com/cilium/ebpf"
+	"github.com/cilium/ebpf/perf"
+	"github.com/intel/cri-resource-manager/pkg/cgroups"
+	"github.com/pkg/errors"
+)
+
+// FirstUseFn is a function notified about a cgroup using AVX512 for the first time.
+type FirstUseFn func(cgroupPath string)
+
+var (
+	// registered first use notification functions
+	firstUseFns []FirstUseFn
+	// lock for firstUseFns
+	firstUseLock sync.RWMutex
+)
+
+// NotifyFirstUse registers a function to call when a cgroup starts using AVX512.
+// Notifications are delivered directly by the eBPF program, without waiting for
+// the next metrics collection. The function is called from a goroutine of its own
+// and should not block.
+func NotifyFirstUse(fn FirstUseFn) {
+	firstUseLock.Lock()
+	defer firstUseLock.Unlock()
+	firstUseFns = append(firstUseFns, fn)
+}
+
+// startFirstUseNotifier enables first use notifications and starts delivering them.
+func startFirstUseNotifier(collection *bpf.Collection, cgid *cgroups.CgroupID) error {
+	events, ok := collection.Maps["avx_first_use_perf"]
+	if !ok {
+		return errors.New("eBPF program has no avx_first_use_perf map")
+	}
+
+	reader, err := perf.NewReader(events, os.Getpagesize())
+	if err != nil {
+		return errors.Wrap(err, "unable to create perf reader")
+	}
+
+	if err := setConfigFlag(collection.Maps["avx_config_array"], configFirstUse); err != nil {
+		reader.Close()
+		return errors.Wrap(err, "unable to enable first use notifications")
+	}
+
+	go func() {
+		for {
+			rec, err := reader.Read()
+			if err != nil {
+				if perf.IsClosed(err) {
+					return
+				}
+				log.Error("failed to read AVX512 first use event: %v", err)
+				continue
+			}
+			if rec.LostSamples != 0 {
+				log.Warn("lost %d AVX512 first use events", rec.LostSamples)
+				continue
+			}
+			if len(rec.RawSample) < 8 {
+				continue
+			}
+
+			path, err := cgid.Find(binary.LittleEndian.Uint64(rec.RawSample))
+			if err != nil {
+				log.Debug("failed to find cgroup of AVX512 first use: %v", err)
+				continue
+			}
+			log.Debug("cgroup %s started using AVX512", path)
+
+			firstUseLock.RLock()
+			for _, fn := range firstUseFns {
+				fn(path)
+			}
+			firstUseLock.RUnlock()
+		}
+	}()
+
+	return nil
+}
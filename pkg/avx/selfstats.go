@@ -0,0 +1,140 @@
+/*
+Copyright 2020 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package avx
+
+import (
+	"encoding/binary"
+	"io/ioutil"
+	"runtime"
+	"time"
+	"unsafe"
+
+	bpf "github.com/cilium/ebpf"
+	"github.com/pkg/errors"
+	"github.com/prometheus/client_golang/prometheus"
+	"golang.org/x/sys/unix"
+)
+
+const (
+	// bpf(2) commands and constants for run-time statistics
+	bpfObjGetInfoByFd = 15
+	bpfEnableStats    = 32
+	bpfStatsRunTime   = 0
+	// sysctl for enabling run-time statistics on kernels without BPF_ENABLE_STATS
+	bpfStatsSysctl = "/proc/sys/kernel/bpf_stats_enabled"
+	// size of struct bpf_prog_info up to and including run_cnt
+	bpfProgInfoLen = 208
+	// offsets of run_time_ns and run_cnt in struct bpf_prog_info
+	bpfProgInfoRunTimeNs = 192
+	bpfProgInfoRunCnt    = 200
+)
+
+// selfStats exports the run-time overhead of AVX512 metrics collection.
+type selfStats struct {
+	fd   int                  // BPF_ENABLE_STATS fd, keeps statistics enabled
+	info [bpfProgInfoLen]byte // reused struct bpf_prog_info buffer
+}
+
+// newSelfStats enables kernel run-time statistics for eBPF programs.
+func newSelfStats() (*selfStats, error) {
+	attr := struct {
+		typ uint32
+	}{
+		typ: bpfStatsRunTime,
+	}
+
+	fd, _, errno := unix.Syscall(unix.SYS_BPF, bpfEnableStats, uintptr(unsafe.Pointer(&attr)), unsafe.Sizeof(attr))
+	if errno == 0 {
+		return &selfStats{fd: int(fd)}, nil
+	}
+
+	// BPF_ENABLE_STATS is only available since Linux 5.8, fall back to the sysctl.
+	if err := ioutil.WriteFile(bpfStatsSysctl, []byte("1"), 0644); err != nil {
+		return nil, errors.Wrap(err, "unable to enable eBPF run-time statistics")
+	}
+	log.Warn("enabled eBPF run-time statistics globally using %s", bpfStatsSysctl)
+
+	return &selfStats{fd: -1}, nil
+}
+
+// programStats returns the number of runs and the total run time of an eBPF program.
+func (s *selfStats) programStats(prog *bpf.Program) (uint64, uint64, error) {
+	attr := struct {
+		bpfFd   uint32
+		infoLen uint32
+		info    uint64
+	}{
+		bpfFd:   uint32(prog.FD()),
+		infoLen: bpfProgInfoLen,
+		info:    uint64(uintptr(unsafe.Pointer(&s.info[0]))),
+	}
+
+	_, _, errno := unix.Syscall(unix.SYS_BPF, bpfObjGetInfoByFd, uintptr(unsafe.Pointer(&attr)), unsafe.Sizeof(attr))
+	runtime.KeepAlive(s)
+	if errno != 0 {
+		return 0, 0, errno
+	}
+	if attr.infoLen < bpfProgInfoLen {
+		return 0, 0, errors.New("kernel does not report eBPF run-time statistics")
+	}
+
+	runTime := binary.LittleEndian.Uint64(s.info[bpfProgInfoRunTimeNs:])
+	runCnt := binary.LittleEndian.Uint64(s.info[bpfProgInfoRunCnt:])
+
+	return runCnt, runTime, nil
+}
+
+// emit sends the self-overhead metrics to the Prometheus channel.
+func (s *selfStats) emit(ch chan<- prometheus.Metric, collection *bpf.Collection, duration time.Duration, syscalls int) {
+	for name, prog := range collection.Programs {
+		runCnt, runTime, err := s.programStats(prog)
+		if err != nil {
+			log.Error("unable to get run-time statistics of %s: %v", name, err)
+			continue
+		}
+
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[progRunCountDesc],
+			prometheus.CounterValue,
+			float64(runCnt),
+			name)
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[progRunTimeNsDesc],
+			prometheus.CounterValue,
+			float64(runTime),
+			name)
+
+		avg := 0.0
+		if runCnt > 0 {
+			avg = float64(runTime) / float64(runCnt)
+		}
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[progAvgRunTimeNsDesc],
+			prometheus.GaugeValue,
+			avg,
+			name)
+	}
+
+	ch <- prometheus.MustNewConstMetric(
+		descriptors[collectDurationDesc],
+		prometheus.GaugeValue,
+		duration.Seconds())
+	ch <- prometheus.MustNewConstMetric(
+		descriptors[collectSyscallsDesc],
+		prometheus.GaugeValue,
+		float64(syscalls))
+}
@@ -0,0 +1,262 @@
+/*
+Copyright 2020 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package avx
+
+import (
+	"encoding/binary"
+	"os"
+	"sync"
+
+	bpf "github.com/cilium/ebpf"
+	"github.com/cilium/ebpf/perf"
+	"github.com/pkg/errors"
+)
+
+const (
+	// configStreamEvents is AVX_CONFIG_STREAM_EVENTS in elf/avx512.c.
+	configStreamEvents = 1 << 0
+	// configFirstUse is AVX_CONFIG_FIRST_USE in elf/avx512.c.
+	configFirstUse = 1 << 1
+	// eventSize is the size of struct avx_event in elf/avx512.c.
+	eventSize = 40
+	// perCPUBufferPages is the size of the per-CPU perf buffer in pages.
+	perCPUBufferPages = 16
+	// foldedMaxAge is the number of snapshots to wait for a folded record to be pushed.
+	foldedMaxAge = 2
+)
+
+// avxEvent is struct avx_event in elf/avx512.c.
+type avxEvent struct {
+	CgroupID     uint64
+	LastUpdateNs uint64
+	ResidencyNs  uint64
+	AvxCount     uint32
+	AllCount     uint32
+	Seq          uint64
+}
+
+// foldedKey identifies a pending record by CPU and accumulation round.
+type foldedKey struct {
+	cpu int
+	seq uint64
+}
+
+// folded is the part of a pending record already folded into a snapshot.
+type folded struct {
+	avxEvent
+	snapshot uint64 // snapshot the record was last folded into
+}
+
+// eventStream folds AVX512 activity records streamed by the eBPF programs.
+type eventStream struct {
+	sync.Mutex
+	reader    *perf.Reader
+	pending   *bpf.Map
+	sample    *avxSample
+	lost      uint64
+	folded    map[foldedKey]*folded
+	snapshots uint64
+}
+
+// newEventStream switches the eBPF programs to streaming mode and starts consuming records.
+func newEventStream(collection *bpf.Collection) (*eventStream, error) {
+	events, ok := collection.Maps["avx_events_perf"]
+	if !ok {
+		return nil, errors.New("eBPF program has no avx_events_perf map")
+	}
+	config, ok := collection.Maps["avx_config_array"]
+	if !ok {
+		return nil, errors.New("eBPF program has no avx_config_array map")
+	}
+	pending, ok := collection.Maps["avx_pending_array"]
+	if !ok {
+		return nil, errors.New("eBPF program has no avx_pending_array map")
+	}
+
+	reader, err := perf.NewReader(events, perCPUBufferPages*os.Getpagesize())
+	if err != nil {
+		return nil, errors.Wrap(err, "unable to create perf reader")
+	}
+
+	if err := setConfigFlag(config, configStreamEvents); err != nil {
+		reader.Close()
+		return nil, errors.Wrap(err, "unable to enable eBPF event streaming")
+	}
+
+	s := &eventStream{
+		reader:  reader,
+		pending: pending,
+		sample:  newAvxSample(),
+		folded:  make(map[foldedKey]*folded),
+	}
+	go s.run()
+
+	return s, nil
+}
+
+// run consumes records until the reader gets closed.
+func (s *eventStream) run() {
+	for {
+		rec, err := s.reader.Read()
+		if err != nil {
+			if perf.IsClosed(err) {
+				return
+			}
+			log.Error("failed to read AVX512 event: %v", err)
+			continue
+		}
+
+		if rec.LostSamples != 0 {
+			s.Lock()
+			s.lost += rec.LostSamples
+			s.Unlock()
+			continue
+		}
+
+		raw := rec.RawSample
+		if len(raw) < eventSize {
+			log.Error("short AVX512 event record (%d < %d bytes)", len(raw), eventSize)
+			continue
+		}
+
+		ev := avxEvent{
+			CgroupID:     binary.LittleEndian.Uint64(raw[0:8]),
+			LastUpdateNs: binary.LittleEndian.Uint64(raw[8:16]),
+			ResidencyNs:  binary.LittleEndian.Uint64(raw[16:24]),
+			AvxCount:     binary.LittleEndian.Uint32(raw[24:28]),
+			AllCount:     binary.LittleEndian.Uint32(raw[28:32]),
+			Seq:          binary.LittleEndian.Uint64(raw[32:40]),
+		}
+
+		s.Lock()
+		key := foldedKey{cpu: rec.CPU, seq: ev.Seq}
+		if f, ok := s.folded[key]; ok {
+			ev = unfolded(ev, f.avxEvent)
+			delete(s.folded, key)
+		}
+		s.fold(ev)
+		s.Unlock()
+	}
+}
+
+// fold adds the activity of a record to the current sample.
+func (s *eventStream) fold(ev avxEvent) {
+	sample := s.sample
+	if ev.AvxCount != 0 {
+		sample.avx[ev.CgroupID] += ev.AvxCount
+		sample.resi[ev.CgroupID] += ev.ResidencyNs
+		if ev.LastUpdateNs > sample.last[ev.CgroupID] {
+			sample.last[ev.CgroupID] = ev.LastUpdateNs
+		}
+	}
+	sample.all[ev.CgroupID] += ev.AllCount
+}
+
+// foldPending folds the activity still accumulating in the per-CPU pending
+// records. Without this a CPU which goes idle, or keeps running the same
+// cgroup, would hold back its activity until its next flush.
+func (s *eventStream) foldPending() {
+	var events []avxEvent
+
+	if err := s.pending.Lookup(uint32(0), &events); err != nil {
+		log.Error("unable to read pending AVX512 activity: %v", err)
+		return
+	}
+
+	for cpu, ev := range events {
+		if ev.CgroupID == 0 {
+			continue
+		}
+		key := foldedKey{cpu: cpu, seq: ev.Seq}
+		f, ok := s.folded[key]
+		// the eBPF program resets a record by storing the new cgroup ID
+		// first, so we might have copied it with the old counts and seq,
+		// pick it up once pushed or with the next snapshot instead
+		if ok && ev.CgroupID != f.CgroupID {
+			continue
+		}
+		if !ok {
+			f = &folded{avxEvent: avxEvent{CgroupID: ev.CgroupID, Seq: ev.Seq}}
+			s.folded[key] = f
+		}
+		// a record caught in the middle of a reset has counts below what
+		// we've folded already, pick it up with the next snapshot instead
+		if ev.AvxCount < f.AvxCount || ev.AllCount < f.AllCount || ev.ResidencyNs < f.ResidencyNs {
+			continue
+		}
+		s.fold(unfolded(ev, f.avxEvent))
+		f.avxEvent = ev
+		f.snapshot = s.snapshots
+	}
+
+	// forget records which were pushed empty or got lost
+	for key, f := range s.folded {
+		if s.snapshots-f.snapshot > foldedMaxAge {
+			delete(s.folded, key)
+		}
+	}
+}
+
+// unfolded returns the activity of a record not folded yet.
+func unfolded(ev, f avxEvent) avxEvent {
+	if ev.AvxCount < f.AvxCount || ev.AllCount < f.AllCount || ev.ResidencyNs < f.ResidencyNs {
+		return avxEvent{CgroupID: ev.CgroupID}
+	}
+	ev.AvxCount -= f.AvxCount
+	ev.AllCount -= f.AllCount
+	ev.ResidencyNs -= f.ResidencyNs
+	if ev.LastUpdateNs <= f.LastUpdateNs {
+		ev.LastUpdateNs = 0
+	}
+	return ev
+}
+
+// snapshot returns the activity folded since the last snapshot and starts a new one.
+func (s *eventStream) snapshot() *avxSample {
+	next := newAvxSample()
+
+	s.Lock()
+	s.foldPending()
+	sample, lost := s.sample, s.lost
+	s.sample, s.lost = next, 0
+	s.snapshots++
+	s.Unlock()
+
+	if lost != 0 {
+		log.Warn("lost %d AVX512 event records, perf buffer too small?", lost)
+	}
+
+	return sample
+}
+
+// close stops consuming records.
+func (s *eventStream) close() {
+	if err := s.reader.Close(); err != nil {
+		log.Error("failed to close AVX512 event stream: %v", err)
+	}
+}
+
+// setConfigFlag sets the given flag in avx_config_array.
+func setConfigFlag(config *bpf.Map, flag uint32) error {
+	var flags uint32
+
+	if err := config.Lookup(uint32(configFlags), &flags); err != nil {
+		return err
+	}
+
+	return config.Put(uint32(configFlags), flags|flag)
+}
@@ -0,0 +1,201 @@
+/*
+Copyright 2020 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package avx
+
+import (
+	"fmt"
+	"strconv"
+
+	"github.com/intel/cri-resource-manager/pkg/sysfs"
+	"github.com/prometheus/client_golang/prometheus"
+)
+
+// cpuStats is struct cpu_stats in elf/avx512.c.
+type cpuStats struct {
+	AvxSwitches uint64
+	ResidencyNs uint64
+}
+
+// coreKey identifies a physical core.
+type coreKey struct {
+	pkg  int
+	core int
+}
+
+// cpuTopology maps CPUs to the cores, packages and NUMA nodes we aggregate activity for.
+type cpuTopology struct {
+	cpuLabel  map[int]string
+	cpuCore   map[int]coreKey
+	cpuPkg    map[int]int
+	cpuNode   map[int]int
+	coreLabel map[coreKey][2]string
+	pkgLabel  map[int]string
+	nodeLabel map[int]string
+}
+
+// newCPUTopology discovers the CPU topology of the system.
+func newCPUTopology() (*cpuTopology, error) {
+	sys, err := sysfs.DiscoverSystem(sysfs.DiscoverCPUTopology)
+	if err != nil {
+		return nil, err
+	}
+
+	t := &cpuTopology{
+		cpuLabel:  make(map[int]string),
+		cpuCore:   make(map[int]coreKey),
+		cpuPkg:    make(map[int]int),
+		cpuNode:   make(map[int]int),
+		coreLabel: make(map[coreKey][2]string),
+		pkgLabel:  make(map[int]string),
+		nodeLabel: make(map[int]string),
+	}
+
+	for _, id := range sys.CPUIDs() {
+		cpu := sys.CPU(id)
+		pkg, node := int(cpu.PackageID()), int(cpu.NodeID())
+		core := coreKey{pkg: pkg, core: int(cpu.CoreID())}
+
+		t.cpuLabel[int(id)] = fmt.Sprintf("CPU%d", id)
+		t.cpuCore[int(id)] = core
+		t.cpuPkg[int(id)] = pkg
+		t.cpuNode[int(id)] = node
+		t.coreLabel[core] = [2]string{strconv.Itoa(pkg), strconv.Itoa(core.core)}
+		t.pkgLabel[pkg] = strconv.Itoa(pkg)
+		t.nodeLabel[node] = strconv.Itoa(node)
+	}
+
+	return t, nil
+}
+
+// readCPUStats returns the per-CPU AVX512 activity since the previous call.
+func (c *collector) readCPUStats() map[int]cpuStats {
+	var stats []cpuStats
+
+	m, ok := c.ebpf.Maps["avx_cpu_stats_array"]
+	if !ok {
+		return nil
+	}
+	if err := m.Lookup(uint32(0), &stats); err != nil {
+		log.Error("unable to read per-CPU AVX512 activity: %v", err)
+		return nil
+	}
+
+	// The counters are never reset, so there is nothing to race with the
+	// eBPF programs. Report the difference to the previous read instead.
+	delta := make(map[int]cpuStats)
+	for cpu, s := range stats {
+		if cpu < len(c.lastCPUStats) {
+			prev := c.lastCPUStats[cpu]
+			s.AvxSwitches -= prev.AvxSwitches
+			s.ResidencyNs -= prev.ResidencyNs
+		}
+		if s.AvxSwitches != 0 || s.ResidencyNs != 0 {
+			delta[cpu] = s
+		}
+	}
+	c.lastCPUStats = stats
+
+	return delta
+}
+
+// emitCPUStats sends per-CPU, per-core, per-package and per-node AVX512 activity.
+func (c *collector) emitCPUStats(ch chan<- prometheus.Metric, stats map[int]cpuStats) {
+	t := c.topology
+
+	cores := make(map[coreKey]cpuStats)
+	pkgs := make(map[int]cpuStats)
+	nodes := make(map[int]cpuStats)
+
+	for cpu, s := range stats {
+		label := ""
+		if t != nil {
+			label = t.cpuLabel[cpu]
+		}
+		if label == "" {
+			label = fmt.Sprintf("CPU%d", cpu)
+		}
+
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[lastCPUDesc],
+			prometheus.GaugeValue,
+			float64(s.AvxSwitches),
+			label)
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[cpuResidencyNsDesc],
+			prometheus.GaugeValue,
+			float64(s.ResidencyNs),
+			label)
+
+		if t == nil {
+			continue
+		}
+		if core, ok := t.cpuCore[cpu]; ok {
+			cores[core] = cores[core].add(s)
+		}
+		if pkg, ok := t.cpuPkg[cpu]; ok {
+			pkgs[pkg] = pkgs[pkg].add(s)
+		}
+		if node, ok := t.cpuNode[cpu]; ok {
+			nodes[node] = nodes[node].add(s)
+		}
+	}
+
+	for core, s := range cores {
+		label := t.coreLabel[core]
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[coreSwitchCountDesc],
+			prometheus.GaugeValue,
+			float64(s.AvxSwitches),
+			label[0], label[1])
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[coreResidencyNsDesc],
+			prometheus.GaugeValue,
+			float64(s.ResidencyNs),
+			label[0], label[1])
+	}
+	for pkg, s := range pkgs {
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[packageSwitchCountDesc],
+			prometheus.GaugeValue,
+			float64(s.AvxSwitches),
+			t.pkgLabel[pkg])
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[packageResidencyNsDesc],
+			prometheus.GaugeValue,
+			float64(s.ResidencyNs),
+			t.pkgLabel[pkg])
+	}
+	for node, s := range nodes {
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[nodeSwitchCountDesc],
+			prometheus.GaugeValue,
+			float64(s.AvxSwitches),
+			t.nodeLabel[node])
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[nodeResidencyNsDesc],
+			prometheus.GaugeValue,
+			float64(s.ResidencyNs),
+			t.nodeLabel[node])
+	}
+}
+
+func (s cpuStats) add(o cpuStats) cpuStats {
+	return cpuStats{
+		AvxSwitches: s.AvxSwitches + o.AvxSwitches,
+		ResidencyNs: s.ResidencyNs + o.ResidencyNs,
+	}
+}
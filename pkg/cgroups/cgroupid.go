@@ -1,27 +1,51 @@
 package cgroups
 
 import (
+	"bytes"
 	"encoding/binary"
 	"fmt"
 	"os"
 	"path/filepath"
 	"sync"
+	"time"
+	"unsafe"
 
 	"golang.org/x/sys/unix"
 )
 
+const (
+	// missingTTL is the time an ID not found by a walk is considered to be gone.
+	missingTTL = 30 * time.Second
+	// watchMask is the inotify events we watch cgroup directories for.
+	watchMask = unix.IN_CREATE | unix.IN_DELETE | unix.IN_MOVED_FROM | unix.IN_MOVED_TO | unix.IN_ONLYDIR
+)
+
 // CgroupID implements mapping kernel cgroup IDs to cgroupfs paths with transparent caching.
+//
+// The cache is meant to be long-lived. Once Watch is called the cache is
+// kept up to date incrementally, using inotify on the cgroup hierarchy.
+// Lookups for unknown IDs are resolved with a full walk of the cgroup
+// hierarchy which refreshes the whole cache, so a burst of lookups for new
+// cgroups costs a single walk. IDs not found by a walk, or removed while
+// watched, are considered to be gone for missingTTL.
 type CgroupID struct {
-	root  string
-	cache map[uint64]string
+	root    string
+	cache   map[uint64]string
+	paths   map[string]uint64
+	missing map[uint64]time.Time
+	watch   *os.File
+	fd      int
+	wds     map[int32]string
 	sync.Mutex
 }
 
 // NewCgroupID creates a new CgroupID map/cache.
 func NewCgroupID(root string) *CgroupID {
 	return &CgroupID{
-		root:  root,
-		cache: make(map[uint64]string),
+		root:    root,
+		cache:   make(map[uint64]string),
+		paths:   make(map[string]uint64),
+		missing: make(map[uint64]time.Time),
 	}
 }
 
@@ -36,43 +60,240 @@ func getID(path string) uint64 {
 
 // Find finds the path for the given cgroup id.
 func (cgid *CgroupID) Find(id uint64) (string, error) {
-	found := false
-	var p string
-
 	cgid.Lock()
 	defer cgid.Unlock()
 
+	if path, ok := cgid.cache[id]; ok {
+		return path, nil
+	}
+	if cgid.isMissing(id) {
+		return "", fmt.Errorf("cgroupid %v not found", id)
+	}
+
+	if err := cgid.refresh(); err != nil {
+		return "", err
+	}
+
 	if path, ok := cgid.cache[id]; ok {
 		return path, nil
 	}
 
+	cgid.missing[id] = time.Now()
+	return "", fmt.Errorf("cgroupid %v not found", id)
+}
+
+// Refresh rebuilds the cache with a full walk of the cgroup hierarchy and
+// returns the IDs of all existing cgroups.
+func (cgid *CgroupID) Refresh() (map[uint64]struct{}, error) {
+	cgid.Lock()
+	defer cgid.Unlock()
+
+	if err := cgid.refresh(); err != nil {
+		return nil, err
+	}
+
+	ids := make(map[uint64]struct{}, len(cgid.cache))
+	for id := range cgid.cache {
+		ids[id] = struct{}{}
+	}
+
+	return ids, nil
+}
+
+// isMissing checks if id is known to be gone, the caller must hold the lock.
+func (cgid *CgroupID) isMissing(id uint64) bool {
+	since, ok := cgid.missing[id]
+	if !ok {
+		return false
+	}
+	if time.Since(since) >= missingTTL {
+		delete(cgid.missing, id)
+		return false
+	}
+	return true
+}
+
+// refresh rebuilds the cache, the caller must hold the lock.
+func (cgid *CgroupID) refresh() error {
+	cache := make(map[uint64]string, len(cgid.cache))
+	paths := make(map[string]uint64, len(cgid.paths))
+
 	err := filepath.Walk(cgid.root, func(path string, info os.FileInfo, err error) error {
 		if err != nil {
 			if os.IsNotExist(err) {
 				return nil
 			}
-			fmt.Printf("WalkFunc called with an error (path %q: %v\n)", path, err)
 			return err
 		}
 
-		if found {
-			return filepath.SkipDir
+		if info.IsDir() {
+			if id := getID(path); id != 0 {
+				cache[id] = path
+				paths[path] = id
+			}
 		}
+		return nil
+	})
+
+	if err != nil {
+		return err
+	}
+
+	cgid.cache = cache
+	cgid.paths = paths
 
-		if info.IsDir() && id == getID(path) {
-			found = true
-			p = path
-			return filepath.SkipDir
+	// negative entries survive the walk, unless expired or found
+	for id := range cgid.missing {
+		if _, ok := cache[id]; ok || !cgid.isMissing(id) {
+			delete(cgid.missing, id)
 		}
+	}
+
+	return nil
+}
+
+// Watch starts keeping the cache up to date with inotify on the cgroup hierarchy.
+func (cgid *CgroupID) Watch() error {
+	cgid.Lock()
+	defer cgid.Unlock()
+
+	if cgid.watch != nil {
 		return nil
-	})
+	}
 
+	fd, err := unix.InotifyInit1(unix.IN_CLOEXEC | unix.IN_NONBLOCK)
 	if err != nil {
-		return "", err
-	} else if !found {
-		return "", fmt.Errorf("cgroupid %v not found", id)
-	} else {
-		cgid.cache[id] = p
-		return p, nil
+		return fmt.Errorf("failed to create inotify instance: %v", err)
+	}
+	// os.File for the runtime poller, so Close unblocks the reader
+	cgid.watch = os.NewFile(uintptr(fd), "cgroupid-inotify")
+	cgid.fd = fd
+	cgid.wds = make(map[int32]string)
+
+	if err := cgid.addTree(cgid.root); err != nil {
+		cgid.watch.Close()
+		cgid.watch = nil
+		return err
+	}
+
+	go cgid.readEvents(cgid.watch)
+
+	return nil
+}
+
+// Close stops keeping the cache up to date.
+func (cgid *CgroupID) Close() {
+	cgid.Lock()
+	defer cgid.Unlock()
+
+	if cgid.watch != nil {
+		cgid.watch.Close()
+		cgid.watch = nil
+		cgid.wds = nil
+	}
+}
+
+// addTree watches and caches a directory and all directories below it, the
+// caller must hold the lock. Directories created before their parent gets
+// watched are picked up by the walk.
+func (cgid *CgroupID) addTree(dir string) error {
+	return filepath.Walk(dir, func(path string, info os.FileInfo, err error) error {
+		if err != nil {
+			if os.IsNotExist(err) {
+				return nil
+			}
+			return err
+		}
+		if !info.IsDir() {
+			return nil
+		}
+
+		wd, err := unix.InotifyAddWatch(cgid.fd, path, watchMask)
+		if err != nil {
+			if err == unix.ENOENT {
+				return filepath.SkipDir
+			}
+			return fmt.Errorf("failed to watch cgroup %s: %v", path, err)
+		}
+		cgid.wds[int32(wd)] = path
+
+		if id := getID(path); id != 0 {
+			cgid.cache[id] = path
+			cgid.paths[path] = id
+			delete(cgid.missing, id)
+		}
+		return nil
+	})
+}
+
+// removeTree drops a removed directory and all directories below it, the
+// caller must hold the lock.
+func (cgid *CgroupID) removeTree(dir string) {
+	prefix := dir + string(filepath.Separator)
+	now := time.Now()
+	for path, id := range cgid.paths {
+		if path == dir || len(path) > len(prefix) && path[:len(prefix)] == prefix {
+			delete(cgid.paths, path)
+			delete(cgid.cache, id)
+			cgid.missing[id] = now
+		}
+	}
+}
+
+// readEvents updates the cache with inotify events until the watch is closed.
+func (cgid *CgroupID) readEvents(watch *os.File) {
+	buf := make([]byte, 64*(unix.SizeofInotifyEvent+unix.NAME_MAX+1))
+
+	for {
+		n, err := watch.Read(buf)
+		if err != nil {
+			return
+		}
+
+		cgid.Lock()
+		if cgid.watch != watch {
+			cgid.Unlock()
+			return
+		}
+		for offs := 0; offs+unix.SizeofInotifyEvent <= n; {
+			ev := (*unix.InotifyEvent)(unsafe.Pointer(&buf[offs]))
+			name := buf[offs+unix.SizeofInotifyEvent : offs+unix.SizeofInotifyEvent+int(ev.Len)]
+			offs += unix.SizeofInotifyEvent + int(ev.Len)
+			cgid.handleEvent(ev, string(bytes.TrimRight(name, "\x00")))
+		}
+		cgid.Unlock()
+	}
+}
+
+// handleEvent updates the cache with a single inotify event, the caller
+// must hold the lock.
+func (cgid *CgroupID) handleEvent(ev *unix.InotifyEvent, name string) {
+	switch {
+	case ev.Mask&unix.IN_Q_OVERFLOW != 0:
+		// events got dropped, resynchronize with a full walk
+		if err := cgid.refresh(); err != nil {
+			cgid.cache = make(map[uint64]string)
+			cgid.paths = make(map[string]uint64)
+		}
+		return
+	case ev.Mask&unix.IN_IGNORED != 0:
+		delete(cgid.wds, ev.Wd)
+		return
+	case ev.Mask&unix.IN_ISDIR == 0:
+		return
+	}
+
+	dir, ok := cgid.wds[ev.Wd]
+	if !ok {
+		return
+	}
+	path := filepath.Join(dir, name)
+
+	switch {
+	case ev.Mask&(unix.IN_CREATE|unix.IN_MOVED_TO) != 0:
+		// on errors a later miss falls back to a full walk
+		cgid.addTree(path)
+	case ev.Mask&(unix.IN_DELETE|unix.IN_MOVED_FROM) != 0:
+		cgid.removeTree(path)
 	}
 }
@@ -0,0 +1,91 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroups
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+func TestCgroupIDWatch(t *testing.T) {
+	root, err := ioutil.TempDir("", "cgroupid-test-")
+	if err != nil {
+		t.Fatalf("failed to create tmpdir: %v", err)
+	}
+	defer os.RemoveAll(root)
+
+	if getID(root) == 0 {
+		t.Skip("no file handle support for test directory")
+	}
+
+	mkdir := func(dir string) string {
+		path := filepath.Join(root, dir)
+		if err := os.MkdirAll(path, 0755); err != nil {
+			t.Fatalf("failed to create %s: %v", path, err)
+		}
+		return path
+	}
+
+	mkdir("kubepods.slice")
+	cgid := NewCgroupID(root)
+	if err := cgid.Watch(); err != nil {
+		t.Fatalf("failed to watch %s: %v", root, err)
+	}
+	defer cgid.Close()
+
+	// poll waits for the cache to agree with cond
+	poll := func(cond func() bool) bool {
+		for i := 0; i < 100; i++ {
+			cgid.Lock()
+			ok := cond()
+			cgid.Unlock()
+			if ok {
+				return true
+			}
+			time.Sleep(10 * time.Millisecond)
+		}
+		return false
+	}
+
+	path := mkdir("kubepods.slice/pod.slice/container.scope")
+	id := getID(path)
+	if !poll(func() bool { return cgid.cache[id] == path }) {
+		t.Fatalf("created cgroup %s not picked up", path)
+	}
+
+	if err := os.RemoveAll(filepath.Dir(path)); err != nil {
+		t.Fatalf("failed to remove %s: %v", filepath.Dir(path), err)
+	}
+	if !poll(func() bool { _, ok := cgid.cache[id]; return !ok }) {
+		t.Fatalf("removed cgroup %s not dropped", path)
+	}
+
+	// negative entries survive a walk
+	if _, err := cgid.Refresh(); err != nil {
+		t.Fatalf("failed to refresh: %v", err)
+	}
+	if _, err := cgid.Find(id); err == nil {
+		t.Errorf("found removed cgroup %s", path)
+	}
+	cgid.Lock()
+	missing := cgid.isMissing(id)
+	cgid.Unlock()
+	if !missing {
+		t.Errorf("removed cgroup %s not remembered as missing", path)
+	}
+}
@@ -95,11 +95,15 @@ func readCgroupFileLines(filePath string) ([]string, error) {
 		return nil, err
 	}
 
+	return splitCgroupFileLines(f), nil
+}
+
+func splitCgroupFileLines(f []byte) []string {
 	data := string(f)
 
 	rawLines := strings.Split(data, "\n")
 
-	lines := make([]string, 0)
+	lines := make([]string, 0, len(rawLines))
 
 	// Sanitize the lines and remove empty ones.
 	for _, rawLine := range rawLines {
@@ -108,21 +112,25 @@ func readCgroupFileLines(filePath string) ([]string, error) {
 		}
 	}
 
-	return lines, nil
+	return lines
 }
 
 func readCgroupSingleNumber(filePath string) (int64, error) {
-
-	// File looks like this:
-	//
-	// 4
-
 	lines, err := readCgroupFileLines(filePath)
 
 	if err != nil {
 		return 0, err
 	}
 
+	return parseCgroupSingleNumber(lines)
+}
+
+func parseCgroupSingleNumber(lines []string) (int64, error) {
+
+	// File looks like this:
+	//
+	// 4
+
 	if len(lines) != 1 {
 		return 0, fmt.Errorf("error parsing file")
 	}
@@ -163,6 +171,10 @@ func GetBlkioThrottleBytes(cgroupPath string) (BlkioThrottleBytes, error) {
 		return BlkioThrottleBytes{}, err
 	}
 
+	return parseBlkioThrottleBytes(entry, lines)
+}
+
+func parseBlkioThrottleBytes(entry string, lines []string) (BlkioThrottleBytes, error) {
 	if len(lines) == 1 && lines[0] == "Total 0" {
 		return BlkioThrottleBytes{}, nil
 	}
@@ -241,6 +253,14 @@ func GetCPUAcctStats(cgroupPath string) ([]CPUAcctUsage, error) {
 		return nil, err
 	}
 
+	return parseCPUAcctStats(lines)
+}
+
+func parseCPUAcctStats(lines []string) ([]CPUAcctUsage, error) {
+	if len(lines) == 0 {
+		return nil, fmt.Errorf("error parsing file")
+	}
+
 	result := make([]CPUAcctUsage, 0, len(lines)-1)
 
 	for _, line := range lines[1:] {
@@ -278,6 +298,10 @@ func GetCPUSetMemoryMigrate(cgroupPath string) (bool, error) {
 		return false, err
 	}
 
+	return parseCPUSetMemoryMigrate(number)
+}
+
+func parseCPUSetMemoryMigrate(number int64) (bool, error) {
 	if number == 0 {
 		return false, nil
 	} else if number == 1 {
@@ -374,6 +398,10 @@ func GetNumaStats(cgroupPath string) (NumaStat, error) {
 		return NumaStat{}, err
 	}
 
+	return parseNumaStats(entry, lines)
+}
+
+func parseNumaStats(entry string, lines []string) (NumaStat, error) {
 	result := NumaStat{}
 	for _, line := range lines {
 		split := strings.Split(line, " ")
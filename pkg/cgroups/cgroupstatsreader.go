@@ -0,0 +1,222 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroups
+
+import (
+	"io"
+	"os"
+	"path/filepath"
+	"strings"
+)
+
+const (
+	// initial size of the buffer used for reading cgroup statistics
+	statsBufferSize = 4096
+)
+
+// statsFile is a cgroup statistics file kept open for repeated reads.
+type statsFile struct {
+	path string
+	file *os.File
+}
+
+// hugetlbFiles are the usage statistics files of a single huge page size.
+type hugetlbFiles struct {
+	size  string
+	usage *statsFile
+	max   *statsFile
+}
+
+// StatsReader reads the statistics of a single cgroup.
+//
+// The statistics files are opened on first use and then re-read from the
+// beginning with pread(2) into a buffer reused across reads. A StatsReader
+// is not safe for concurrent use, and should be closed once the cgroup goes
+// away.
+type StatsReader struct {
+	numaStat    *statsFile
+	memUsage    *statsFile
+	memMaxUsage *statsFile
+	memMigrate  *statsFile
+	cpuAcct     *statsFile
+	blkio       *statsFile
+	hugetlbDir  string
+	hugetlb     []hugetlbFiles
+	buf         []byte
+}
+
+// NewStatsReader creates a statistics reader for the given cgroup directory.
+func NewStatsReader(root, dir string) *StatsReader {
+	path := func(controller, entry string) *statsFile {
+		return &statsFile{path: filepath.Join(root, controller, dir, entry)}
+	}
+
+	return &StatsReader{
+		numaStat:    path("memory", "memory.numa_stat"),
+		memUsage:    path("memory", "memory.usage_in_bytes"),
+		memMaxUsage: path("memory", "memory.max_usage_in_bytes"),
+		memMigrate:  path("cpuset", "cpuset.memory_migrate"),
+		cpuAcct:     path("cpuacct", "cpuacct.usage_all"),
+		blkio:       path("blkio", "blkio.throttle.io_service_bytes_recursive"),
+		hugetlbDir:  filepath.Join(root, "hugetlb", dir),
+	}
+}
+
+// Close closes all statistics files of the reader.
+func (r *StatsReader) Close() {
+	for _, f := range []*statsFile{r.numaStat, r.memUsage, r.memMaxUsage, r.memMigrate, r.cpuAcct, r.blkio} {
+		f.close()
+	}
+	for _, h := range r.hugetlb {
+		h.usage.close()
+		h.max.close()
+	}
+	r.hugetlb = nil
+	r.buf = nil
+}
+
+// close closes the statistics file.
+func (f *statsFile) close() {
+	if f.file != nil {
+		f.file.Close()
+		f.file = nil
+	}
+}
+
+// readLines reads the full content of a statistics file, returning it as a set of lines.
+func (r *StatsReader) readLines(f *statsFile) ([]string, error) {
+	if f.file == nil {
+		file, err := os.Open(f.path)
+		if err != nil {
+			return nil, err
+		}
+		f.file = file
+	}
+
+	if r.buf == nil {
+		r.buf = make([]byte, statsBufferSize)
+	}
+
+	n := 0
+	for {
+		if n == len(r.buf) {
+			r.buf = append(r.buf, make([]byte, len(r.buf))...)
+		}
+		cnt, err := f.file.ReadAt(r.buf[n:], int64(n))
+		n += cnt
+		if err == io.EOF {
+			break
+		}
+		if err != nil {
+			return nil, err
+		}
+	}
+
+	return splitCgroupFileLines(r.buf[:n]), nil
+}
+
+// readSingleNumber reads a single number from a statistics file.
+func (r *StatsReader) readSingleNumber(f *statsFile) (int64, error) {
+	lines, err := r.readLines(f)
+	if err != nil {
+		return 0, err
+	}
+	return parseCgroupSingleNumber(lines)
+}
+
+// NumaStats returns parsed cgroup NUMA statistics.
+func (r *StatsReader) NumaStats() (NumaStat, error) {
+	lines, err := r.readLines(r.numaStat)
+	if err != nil {
+		return NumaStat{}, err
+	}
+	return parseNumaStats(r.numaStat.path, lines)
+}
+
+// MemoryUsage returns cgroup memory usage.
+func (r *StatsReader) MemoryUsage() (MemoryUsage, error) {
+	usage, err := r.readSingleNumber(r.memUsage)
+	if err != nil {
+		return MemoryUsage{}, err
+	}
+	maxUsage, err := r.readSingleNumber(r.memMaxUsage)
+	if err != nil {
+		return MemoryUsage{}, err
+	}
+	return MemoryUsage{Bytes: usage, MaxBytes: maxUsage}, nil
+}
+
+// CPUSetMemoryMigrate returns whether memory migration is enabled.
+func (r *StatsReader) CPUSetMemoryMigrate() (bool, error) {
+	number, err := r.readSingleNumber(r.memMigrate)
+	if err != nil {
+		return false, err
+	}
+	return parseCPUSetMemoryMigrate(number)
+}
+
+// CPUAcctStats returns CPU accounting statistics.
+func (r *StatsReader) CPUAcctStats() ([]CPUAcctUsage, error) {
+	lines, err := r.readLines(r.cpuAcct)
+	if err != nil {
+		return nil, err
+	}
+	return parseCPUAcctStats(lines)
+}
+
+// HugetlbUsage returns huge page statistics.
+func (r *StatsReader) HugetlbUsage() ([]HugetlbUsage, error) {
+	if r.hugetlb == nil {
+		usageFiles, err := filepath.Glob(filepath.Join(r.hugetlbDir, "hugetlb.*.usage_in_bytes"))
+		if err != nil {
+			return nil, err
+		}
+		r.hugetlb = make([]hugetlbFiles, 0, len(usageFiles))
+		for _, file := range usageFiles {
+			r.hugetlb = append(r.hugetlb, hugetlbFiles{
+				size:  strings.SplitN(filepath.Base(file), ".", 3)[1],
+				usage: &statsFile{path: file},
+				max:   &statsFile{path: strings.TrimSuffix(file, ".usage_in_bytes") + ".max_usage_in_bytes"},
+			})
+		}
+	}
+
+	result := make([]HugetlbUsage, 0, len(r.hugetlb))
+	for _, h := range r.hugetlb {
+		bytes, err := r.readSingleNumber(h.usage)
+		if err != nil {
+			return nil, err
+		}
+		max, err := r.readSingleNumber(h.max)
+		if err != nil {
+			return nil, err
+		}
+		result = append(result, HugetlbUsage{
+			Size:     h.size,
+			Bytes:    bytes,
+			MaxBytes: max,
+		})
+	}
+	return result, nil
+}
+
+// BlkioThrottleBytes returns the amount of bytes transferred to/from the disk.
+func (r *StatsReader) BlkioThrottleBytes() (BlkioThrottleBytes, error) {
+	lines, err := r.readLines(r.blkio)
+	if err != nil {
+		return BlkioThrottleBytes{}, err
+	}
+	return parseBlkioThrottleBytes(r.blkio.path, lines)
+}
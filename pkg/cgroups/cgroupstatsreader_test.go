@@ -0,0 +1,97 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroups
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+)
+
+func TestStatsReader(t *testing.T) {
+	root, err := ioutil.TempDir("", "cgroupstats-test-")
+	if err != nil {
+		t.Fatalf("failed to create tmpdir: %v", err)
+	}
+	defer os.RemoveAll(root)
+
+	dir := "kubepods.slice/test.scope"
+	write := func(controller, entry, content string) {
+		path := filepath.Join(root, controller, dir, entry)
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			t.Fatalf("failed to create %s: %v", filepath.Dir(path), err)
+		}
+		if err := ioutil.WriteFile(path, []byte(content), 0644); err != nil {
+			t.Fatalf("failed to write %s: %v", path, err)
+		}
+	}
+
+	write("memory", "memory.usage_in_bytes", "4096\n")
+	write("memory", "memory.max_usage_in_bytes", "8192\n")
+	write("hugetlb", "hugetlb.2MB.usage_in_bytes", "2097152\n")
+	write("hugetlb", "hugetlb.2MB.max_usage_in_bytes", "4194304\n")
+
+	r := NewStatsReader(root, dir)
+	defer r.Close()
+
+	// missing files are reported as errors, until they are created
+	if _, err := r.CPUSetMemoryMigrate(); err == nil {
+		t.Errorf("expected error for missing cpuset.memory_migrate")
+	}
+	write("cpuset", "cpuset.memory_migrate", "1\n")
+	if migrate, err := r.CPUSetMemoryMigrate(); err != nil || !migrate {
+		t.Errorf("expected memory migration enabled, got %v, %v", migrate, err)
+	}
+
+	tcases := []struct {
+		name     string
+		usage    string
+		expected int64
+	}{
+		{name: "initial content", usage: "4096\n", expected: 4096},
+		{name: "longer content", usage: "1234567890\n", expected: 1234567890},
+		{name: "shorter content", usage: "1\n", expected: 1},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			write("memory", "memory.usage_in_bytes", tc.usage)
+			usage, err := r.MemoryUsage()
+			if err != nil {
+				t.Errorf("unexpected error: %v", err)
+			} else if usage.Bytes != tc.expected || usage.MaxBytes != 8192 {
+				t.Errorf("expected usage %d/%d, got %d/%d",
+					tc.expected, 8192, usage.Bytes, usage.MaxBytes)
+			}
+		})
+	}
+
+	// content exceeding the initial buffer size
+	lines := []string{"cpu user system"}
+	for i := 0; i < 512; i++ {
+		lines = append(lines, "0 3723082232186 2456599218")
+	}
+	write("cpuacct", "cpuacct.usage_all", strings.Join(lines, "\n")+"\n")
+	if acct, err := r.CPUAcctStats(); err != nil || len(acct) != 512 {
+		t.Errorf("expected 512 CPU accounting entries, got %d, %v", len(acct), err)
+	}
+
+	hugetlb, err := r.HugetlbUsage()
+	if err != nil || len(hugetlb) != 1 ||
+		hugetlb[0] != (HugetlbUsage{Size: "2MB", Bytes: 2097152, MaxBytes: 4194304}) {
+		t.Errorf("unexpected hugetlb usage %v, %v", hugetlb, err)
+	}
+}
@@ -102,8 +102,14 @@ var descriptors = [numDescriptors]*prometheus.Desc{
 var (
 	// cgroupRoot is the mount point for the cgroup (v1) filesystem
 	cgroupRoot = "/sys/fs/cgroup"
+	// numWorkers is the number of goroutines used to collect statistics
+	numWorkers = 4
 	// our logger instance
 	log = logger.NewLogger("cgroupstats")
+	// containerIDRegexp matches container IDs in cgroup directory names
+	containerIDRegexp = regexp.MustCompile(`[a-z0-9]{64}`)
+	// containers we collect statistics for
+	reg = &registry{containers: make(map[string]*container)}
 )
 
 const (
@@ -113,11 +119,131 @@ const (
 type collector struct {
 }
 
+// container is a single container we collect statistics for.
+type container struct {
+	sync.Mutex
+	id     string               // container ID
+	dir    string               // cgroup directory, relative to the controllers
+	reader *cgroups.StatsReader // statistics reader, nil once removed
+}
+
+// registry is the set of containers we collect statistics for.
+//
+// Containers are either tracked explicitly, by the resource manager following
+// the container lifecycle, or discovered by walking the cgroup hierarchy on
+// every collection. In both cases statistics readers are kept around until
+// the container goes away, so the cgroup files need to be opened only once.
+type registry struct {
+	sync.Mutex
+	tracked    bool                  // whether containers are tracked explicitly
+	containers map[string]*container // containers by ID
+}
+
 // NewCollector creates new Prometheus collector
 func NewCollector() (prometheus.Collector, error) {
 	return &collector{}, nil
 }
 
+// SyncContainers starts tracking the given containers (ID to cgroup directory) explicitly.
+func SyncContainers(containers map[string]string) {
+	reg.Lock()
+	defer reg.Unlock()
+
+	reg.tracked = true
+	reg.sync(containers)
+}
+
+// AddContainer starts collecting statistics for a tracked container.
+func AddContainer(id, dir string) {
+	reg.Lock()
+	defer reg.Unlock()
+
+	if reg.tracked {
+		reg.add(id, dir)
+	}
+}
+
+// RemoveContainer stops collecting statistics for a tracked container.
+func RemoveContainer(id string) {
+	reg.Lock()
+	defer reg.Unlock()
+
+	if reg.tracked {
+		reg.remove(id)
+	}
+}
+
+// StopTracking reverts to discovering containers by walking the cgroup hierarchy.
+func StopTracking() {
+	reg.Lock()
+	defer reg.Unlock()
+
+	reg.tracked = false
+}
+
+// sync updates the registry to the given set of containers.
+func (r *registry) sync(containers map[string]string) {
+	for id, ctr := range r.containers {
+		if dir, ok := containers[id]; !ok || dir != ctr.dir {
+			r.remove(id)
+		}
+	}
+	for id, dir := range containers {
+		r.add(id, dir)
+	}
+}
+
+// add starts collecting statistics for a container.
+func (r *registry) add(id, dir string) {
+	if ctr, ok := r.containers[id]; ok {
+		if ctr.dir == dir {
+			return
+		}
+		r.remove(id)
+	}
+	r.containers[id] = &container{
+		id:     id,
+		dir:    dir,
+		reader: cgroups.NewStatsReader(cgroupRoot, dir),
+	}
+}
+
+// remove stops collecting statistics for a container, closing its statistics reader.
+func (r *registry) remove(id string) {
+	ctr, ok := r.containers[id]
+	if !ok {
+		return
+	}
+	delete(r.containers, id)
+
+	ctr.Lock()
+	defer ctr.Unlock()
+	ctr.reader.Close()
+	ctr.reader = nil
+}
+
+// snapshot returns the containers to collect statistics for.
+func (r *registry) snapshot() []*container {
+	r.Lock()
+	defer r.Unlock()
+
+	if !r.tracked {
+		containers := make(map[string]string)
+		for _, dir := range walkCgroups() {
+			if id := containerIDRegexp.FindString(filepath.Base(dir)); id != "" {
+				containers[id] = dir
+			}
+		}
+		r.sync(containers)
+	}
+
+	containers := make([]*container, 0, len(r.containers))
+	for _, ctr := range r.containers {
+		containers = append(containers, ctr)
+	}
+	return containers
+}
+
 // Describe implements prometheus.Collector interface
 func (c *collector) Describe(ch chan<- *prometheus.Desc) {
 	for _, d := range descriptors {
@@ -320,91 +446,91 @@ func walkCgroups() []string {
 	return containerDirs
 }
 
-func cgroupPath(controller, path string) string {
-	return filepath.Join(cgroupRoot, controller, path)
-}
-
 // Collect implements prometheus.Collector interface
-func (c collector) Collect(ch chan<- prometheus.Metric) {
+func (c *collector) Collect(ch chan<- prometheus.Metric) {
 	var wg sync.WaitGroup
 
-	// We don't bail out on errors because those can happen if there is a race condition between
-	// the destruction of a container and us getting to read the cgroup data. We just don't report
-	// the values we don't get.
+	containers := reg.snapshot()
+	queue := make(chan *container)
 
-	collectors := []func(string, *regexp.Regexp){
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			numa, err := cgroups.GetNumaStats(cgroupPath("memory", path))
-			if err == nil {
-				updateNumaStatMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], numa)
-			} else {
-				log.Error("failed to collect NUMA stats for %s: %v", path, err)
-			}
-		},
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			memory, err := cgroups.GetMemoryUsage(cgroupPath("memory", path))
-			if err == nil {
-				updateMemoryUsageMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], memory)
-			} else {
-				log.Error("failed to collect memory usage stats for %s: %v", path, err)
-			}
-		},
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			migrate, err := cgroups.GetCPUSetMemoryMigrate(cgroupPath("cpuset", path))
-			if err == nil {
-				updateMemoryMigrateMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], migrate)
-			} else {
-				log.Error("failed to collect memory migration stats for %s: %v", path, err)
-			}
-		},
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			cpuAcctUsage, err := cgroups.GetCPUAcctStats(cgroupPath("cpuacct", path))
-			if err == nil {
-				updateCPUAcctUsageMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], cpuAcctUsage)
-			} else {
-				log.Error("failed to collect CPU accounting stats for %s: %v", path, err)
-			}
-		},
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			hugeTlbUsage, err := cgroups.GetHugetlbUsage(cgroupPath("hugetlb", path))
-			if err == nil {
-				updateHugeTlbUsageMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], hugeTlbUsage)
-			} else {
-				log.Error("failed to collect hugetlb stats for %s: %v", path, err)
-			}
-		},
-		func(path string, re *regexp.Regexp) {
+	workers := numWorkers
+	if workers > len(containers) {
+		workers = len(containers)
+	}
+	if workers < 1 && len(containers) > 0 {
+		workers = 1
+	}
+
+	wg.Add(workers)
+	for i := 0; i < workers; i++ {
+		go func() {
 			defer wg.Done()
-			blkioDeviceUsage, err := cgroups.GetBlkioThrottleBytes(cgroupPath("blkio", path))
-			if err == nil {
-				updateBlkioDeviceUsageMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], blkioDeviceUsage)
-			} else {
-				log.Error("failed to collect blkio stats for %s: %v", path, err)
+			for ctr := range queue {
+				ctr.collect(ch)
 			}
-		},
+		}()
 	}
 
-	containerIDRegexp := regexp.MustCompile(`[a-z0-9]{64}`)
-
-	for _, path := range walkCgroups() {
-		wg.Add(len(collectors))
-		for _, fn := range collectors {
-			go fn(path, containerIDRegexp)
-		}
+	for _, ctr := range containers {
+		queue <- ctr
 	}
+	close(queue)
 
 	// We need to wait so that the response channel doesn't get closed.
 	wg.Wait()
 }
 
+// collect collects all statistics of a single container.
+func (ctr *container) collect(ch chan<- prometheus.Metric) {
+	ctr.Lock()
+	defer ctr.Unlock()
+
+	// We don't bail out on errors because those can happen if there is a race condition between
+	// the destruction of a container and us getting to read the cgroup data. We just don't report
+	// the values we don't get.
+
+	r, id, path := ctr.reader, ctr.id, ctr.dir
+	if r == nil {
+		return
+	}
+
+	if numa, err := r.NumaStats(); err == nil {
+		updateNumaStatMetric(ch, id, numa)
+	} else {
+		log.Error("failed to collect NUMA stats for %s: %v", path, err)
+	}
+	if memory, err := r.MemoryUsage(); err == nil {
+		updateMemoryUsageMetric(ch, id, memory)
+	} else {
+		log.Error("failed to collect memory usage stats for %s: %v", path, err)
+	}
+	if migrate, err := r.CPUSetMemoryMigrate(); err == nil {
+		updateMemoryMigrateMetric(ch, id, migrate)
+	} else {
+		log.Error("failed to collect memory migration stats for %s: %v", path, err)
+	}
+	if cpuAcctUsage, err := r.CPUAcctStats(); err == nil {
+		updateCPUAcctUsageMetric(ch, id, cpuAcctUsage)
+	} else {
+		log.Error("failed to collect CPU accounting stats for %s: %v", path, err)
+	}
+	if hugeTlbUsage, err := r.HugetlbUsage(); err == nil {
+		updateHugeTlbUsageMetric(ch, id, hugeTlbUsage)
+	} else {
+		log.Error("failed to collect hugetlb stats for %s: %v", path, err)
+	}
+	if blkioDeviceUsage, err := r.BlkioThrottleBytes(); err == nil {
+		updateBlkioDeviceUsageMetric(ch, id, blkioDeviceUsage)
+	} else {
+		log.Error("failed to collect blkio stats for %s: %v", path, err)
+	}
+}
+
 func init() {
 	flag.StringVar(&cgroupRoot, "cgroup-path", cgroupRoot,
 		"Path to cgroup filesystem mountpoint")
+	flag.IntVar(&numWorkers, "cgroupstats-workers", numWorkers,
+		"Number of goroutines used to collect cgroup statistics")
 
 	err := metrics.RegisterCollector("cgroupstats", NewCollector)
 	if err != nil {
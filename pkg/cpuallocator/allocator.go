@@ -54,12 +54,18 @@ type allocatorHelper struct {
 
 	pkgs []sysfs.CPUPackage // physical CPU packages, sorted by preference
 	cpus []sysfs.CPU        // CPU cores, sorted by preference
+
+	fromMask   cpuMask // mask of CPUs to allocate from
+	resultMask cpuMask // mask of CPUs allocated
+	offline    cpuMask // mask of offline CPUs
 }
 
 // CPUAllocator is an interface for a generic CPU allocator
 type CPUAllocator interface {
 	AllocateCpus(from *cpuset.CPUSet, cnt int, prefer CPUPriority) (cpuset.CPUSet, error)
 	ReleaseCpus(from *cpuset.CPUSet, cnt int, prefer CPUPriority) (cpuset.CPUSet, error)
+	AllocateWideVectorCpus(from *cpuset.CPUSet, cnt int, prefer CPUPriority) (cpuset.CPUSet, error)
+	SetWideVectorCpus(cpus cpuset.CPUSet)
 }
 
 type CPUPriority int
@@ -76,6 +82,7 @@ type cpuAllocator struct {
 	logger.Logger
 	sys           sysfs.System  // wrapped sysfs.System instance
 	topologyCache topologyCache // topology lookups
+	wideVector    cpuset.CPUSet // CPUs dedicated to wide-vector (AVX512) workloads
 }
 
 // topologyCache caches topology lookups
@@ -85,10 +92,27 @@ type topologyCache struct {
 	core map[sysfs.ID]cpuset.CPUSet
 
 	cpuPriorities cpuPriorities // CPU priority mapping
+
+	// Topology as fixed-width CPU masks, and precalculated priority counts,
+	// for allocating CPUs without set operations. Masks and counts are
+	// indexed by package or CPU ID.
+	words    int                       // width of CPU masks
+	pkgIDs   []sysfs.ID                // sorted package IDs
+	cpuIDs   []sysfs.ID                // sorted CPU IDs
+	cpuPkg   []sysfs.ID                // package of each CPU
+	pkgMask  []cpuMask                 // CPUs of each package
+	coreMask []cpuMask                 // thread siblings of each CPU
+	prioMask [NumCPUPriorities]cpuMask // CPUs of each priority
+	pkgPrio  []priorityCounts          // number of CPUs by priority in each package
+	corePrio []priorityCounts          // number of CPUs by priority in each core
+	cpuPrio  []priorityCounts          // priority of each CPU, as counts
 }
 
 type cpuPriorities [NumCPUPriorities]cpuset.CPUSet
 
+// priorityCounts is the number of CPUs in a set with each priority.
+type priorityCounts [NumCPUPriorities]int
+
 // IDFilter helps filtering Ids.
 type IDFilter func(sysfs.ID) bool
 
@@ -104,26 +128,12 @@ func NewCPUAllocator(sys sysfs.System) CPUAllocator {
 		Logger:        log,
 		sys:           sys,
 		topologyCache: newTopologyCache(sys),
+		wideVector:    cpuset.NewCPUSet(),
 	}
 
 	return &ca
 }
 
-// Pick packages, nodes or CPUs by filtering according to a function.
-func pickIds(idSlice []sysfs.ID, f IDFilter) []sysfs.ID {
-	ids := make([]sysfs.ID, len(idSlice))
-
-	idx := 0
-	for _, id := range idSlice {
-		if f == nil || f(id) {
-			ids[idx] = id
-			idx++
-		}
-	}
-
-	return ids[0:idx]
-}
-
 // newAllocatorHelper creates a new CPU allocatorHelper.
 func newAllocatorHelper(sys sysfs.System, topo topologyCache) *allocatorHelper {
 	a := &allocatorHelper{
@@ -136,23 +146,49 @@ func newAllocatorHelper(sys sysfs.System, topo topologyCache) *allocatorHelper {
 	return a
 }
 
+// setupMasks sets up the CPU masks used for allocation.
+func (a *allocatorHelper) setupMasks() {
+	offline := a.sys.Offlined()
+
+	words := a.topology.words
+	for _, cset := range []cpuset.CPUSet{a.from, a.result, offline} {
+		if w := cpuSetWords(cset); w > words {
+			words = w
+		}
+	}
+
+	a.fromMask = newCPUMaskFromCPUSet(a.from, words)
+	a.resultMask = newCPUMaskFromCPUSet(a.result, words)
+	a.offline = newCPUMaskFromCPUSet(offline, words)
+}
+
+// take moves the online CPUs of a topology mask from the free to the allocated ones.
+func (a *allocatorHelper) take(m cpuMask) {
+	for i, w := range m {
+		w &^= a.offline[i]
+		a.resultMask[i] |= w
+		a.fromMask[i] &^= w
+	}
+}
+
 // Allocate full idle CPU packages.
 func (a *allocatorHelper) takeIdlePackages() {
 	a.Debug("* takeIdlePackages()...")
 
-	offline := a.sys.Offlined()
+	topo := &a.topology
 
 	// pick idle packages
-	pkgs := pickIds(a.sys.PackageIDs(),
-		func(id sysfs.ID) bool {
-			cset := a.topology.pkg[id].Difference(offline)
-			return cset.Intersection(a.from).Equals(cset)
-		})
+	pkgs := make([]sysfs.ID, 0, len(topo.pkgIDs))
+	for _, id := range topo.pkgIDs {
+		if topo.pkgMask[id].coveredBy(a.fromMask, a.offline) {
+			pkgs = append(pkgs, id)
+		}
+	}
 
 	// sorted by number of preferred cpus and then by cpu id
 	sort.Slice(pkgs,
 		func(i, j int) bool {
-			if res := a.topology.cpuPriorities.cmpCPUSet(a.topology.pkg[pkgs[i]], a.topology.pkg[pkgs[j]], a.prefer, -1); res != 0 {
+			if res := cmpPriorityCounts(&topo.pkgPrio[pkgs[i]], &topo.pkgPrio[pkgs[j]], a.prefer, -1); res != 0 {
 				return res > 0
 			}
 			return pkgs[i] < pkgs[j]
@@ -162,13 +198,13 @@ func (a *allocatorHelper) takeIdlePackages() {
 
 	// take as many idle packages as we need/can
 	for _, id := range pkgs {
-		cset := a.topology.pkg[id].Difference(offline)
-		a.Debug(" => considering package %v (#%s)...", id, cset)
-		if a.cnt >= cset.Size() {
+		mask := topo.pkgMask[id]
+		size := mask.andNotCount(a.offline)
+		a.Debug(" => considering package %v (%d CPUs)...", id, size)
+		if a.cnt >= size {
 			a.Debug(" => taking package %v...", id)
-			a.result = a.result.Union(cset)
-			a.from = a.from.Difference(cset)
-			a.cnt -= cset.Size()
+			a.take(mask)
+			a.cnt -= size
 
 			if a.cnt == 0 {
 				break
@@ -181,22 +217,21 @@ func (a *allocatorHelper) takeIdlePackages() {
 func (a *allocatorHelper) takeIdleCores() {
 	a.Debug("* takeIdleCores()...")
 
-	offline := a.sys.Offlined()
+	topo := &a.topology
 
 	// pick (first id for all) idle cores
-	cores := pickIds(a.sys.CPUIDs(),
-		func(id sysfs.ID) bool {
-			cset := a.topology.core[id].Difference(offline)
-			if cset.IsEmpty() {
-				return false
-			}
-			return cset.Intersection(a.from).Equals(cset) && cset.ToSlice()[0] == int(id)
-		})
+	cores := make([]sysfs.ID, 0, len(topo.cpuIDs))
+	for _, id := range topo.cpuIDs {
+		mask := topo.coreMask[id]
+		if mask.firstNotIn(a.offline) == int(id) && mask.coveredBy(a.fromMask, a.offline) {
+			cores = append(cores, id)
+		}
+	}
 
 	// sorted by id
 	sort.Slice(cores,
 		func(i, j int) bool {
-			if res := a.topology.cpuPriorities.cmpCPUSet(a.topology.core[cores[i]], a.topology.core[cores[j]], a.prefer, -1); res != 0 {
+			if res := cmpPriorityCounts(&topo.corePrio[cores[i]], &topo.corePrio[cores[j]], a.prefer, -1); res != 0 {
 				return res > 0
 			}
 			return cores[i] < cores[j]
@@ -206,13 +241,13 @@ func (a *allocatorHelper) takeIdleCores() {
 
 	// take as many idle cores as we can
 	for _, id := range cores {
-		cset := a.topology.core[id].Difference(offline)
-		a.Debug(" => considering core %v (#%s)...", id, cset)
-		if a.cnt >= cset.Size() {
+		mask := topo.coreMask[id]
+		size := mask.andNotCount(a.offline)
+		a.Debug(" => considering core %v (%d CPUs)...", id, size)
+		if a.cnt >= size {
 			a.Debug(" => taking core %v...", id)
-			a.result = a.result.Union(cset)
-			a.from = a.from.Difference(cset)
-			a.cnt -= cset.Size()
+			a.take(mask)
+			a.cnt -= size
 
 			if a.cnt == 0 {
 				break
@@ -223,16 +258,36 @@ func (a *allocatorHelper) takeIdleCores() {
 
 // Allocate idle CPU hyperthreads.
 func (a *allocatorHelper) takeIdleThreads() {
-	offline := a.sys.Offlined()
+	topo := &a.topology
 
 	// pick all threads with free capacity
-	cores := pickIds(a.sys.CPUIDs(),
-		func(id sysfs.ID) bool {
-			return a.from.Difference(offline).Contains(int(id))
-		})
+	cores := make([]sysfs.ID, 0, len(topo.cpuIDs))
+	for _, id := range topo.cpuIDs {
+		if a.fromMask.has(int(id)) && !a.offline.has(int(id)) {
+			cores = append(cores, id)
+		}
+	}
 
 	a.Debug(" => idle threads unsorted: %v", cores)
 
+	// Precalculate the per-package and per-core sort keys, which stay the
+	// same while sorting, instead of recalculating them for each comparison.
+	pkgColo := make([]int, len(topo.pkgMask))
+	pkgFree := make([]int, len(topo.pkgMask))
+	pkgPrio := make([]priorityCounts, len(topo.pkgMask))
+	for _, id := range topo.pkgIDs {
+		mask := topo.pkgMask[id]
+		pkgColo[id] = mask.andCount(a.resultMask)
+		pkgFree[id] = mask.andCount(a.fromMask)
+		for prio := range pkgPrio[id] {
+			pkgPrio[id][prio] = mask.and3Count(a.fromMask, topo.prioMask[prio])
+		}
+	}
+	coreFree := make([]int, len(topo.coreMask))
+	for _, id := range cores {
+		coreFree[id] = topo.coreMask[id].andCount(a.fromMask)
+	}
+
 	// sorted for preference by id, mimicking cpus_assignment.go for now:
 	//   IOW, prefer CPUs
 	//     - from packages with higher number of CPUs/cores already in a.result
@@ -247,44 +302,31 @@ func (a *allocatorHelper) takeIdleThreads() {
 		func(i, j int) bool {
 			iCore := cores[i]
 			jCore := cores[j]
-			iPkg := a.sys.CPU(iCore).PackageID()
-			jPkg := a.sys.CPU(jCore).PackageID()
-
-			iCoreSet := a.topology.core[iCore]
-			jCoreSet := a.topology.core[jCore]
-			iPkgSet := a.topology.pkg[iPkg]
-			jPkgSet := a.topology.pkg[jPkg]
-
-			iPkgColo := iPkgSet.Intersection(a.result).Size()
-			jPkgColo := jPkgSet.Intersection(a.result).Size()
-			if iPkgColo != jPkgColo {
-				return iPkgColo > jPkgColo
+			iPkg := topo.cpuPkg[iCore]
+			jPkg := topo.cpuPkg[jCore]
+
+			if pkgColo[iPkg] != pkgColo[jPkg] {
+				return pkgColo[iPkg] > pkgColo[jPkg]
 			}
 
 			// Always sort cores in package order
-			if res := a.topology.cpuPriorities.cmpCPUSet(iPkgSet.Intersection(a.from), jPkgSet.Intersection(a.from), a.prefer, a.cnt); res != 0 {
+			if res := cmpPriorityCounts(&pkgPrio[iPkg], &pkgPrio[jPkg], a.prefer, a.cnt); res != 0 {
 				return res > 0
 			}
 			if iPkg != jPkg {
 				return iPkg < jPkg
 			}
 
-			iCset := cpuset.NewCPUSet(int(cores[i]))
-			jCset := cpuset.NewCPUSet(int(cores[j]))
-			if res := a.topology.cpuPriorities.cmpCPUSet(iCset, jCset, a.prefer, 0); res != 0 {
+			if res := cmpPriorityCounts(&topo.cpuPrio[iCore], &topo.cpuPrio[jCore], a.prefer, 0); res != 0 {
 				return res > 0
 			}
 
-			iPkgFree := iPkgSet.Intersection(a.from).Size()
-			jPkgFree := jPkgSet.Intersection(a.from).Size()
-			if iPkgFree != jPkgFree {
-				return iPkgFree < jPkgFree
+			if pkgFree[iPkg] != pkgFree[jPkg] {
+				return pkgFree[iPkg] < pkgFree[jPkg]
 			}
 
-			iCoreFree := iCoreSet.Intersection(a.from).Size()
-			jCoreFree := jCoreSet.Intersection(a.from).Size()
-			if iCoreFree != jCoreFree {
-				return iCoreFree < jCoreFree
+			if coreFree[iCore] != coreFree[jCore] {
+				return coreFree[iCore] < coreFree[jCore]
 			}
 
 			return iCore < jCore
@@ -294,12 +336,10 @@ func (a *allocatorHelper) takeIdleThreads() {
 
 	// take as many idle cores as we can
 	for _, id := range cores {
-		cset := a.topology.core[id].Difference(offline)
-		a.Debug(" => considering thread %v (#%s)...", id, cset)
-		cset = cpuset.NewCPUSet(int(id))
-		a.result = a.result.Union(cset)
-		a.from = a.from.Difference(cset)
-		a.cnt -= cset.Size()
+		a.Debug(" => considering thread %v...", id)
+		a.resultMask.set(int(id))
+		a.fromMask.clear(int(id))
+		a.cnt--
 
 		if a.cnt == 0 {
 			break
@@ -324,6 +364,7 @@ func (a *allocatorHelper) takeAny() {
 // Perform CPU allocation.
 func (a *allocatorHelper) allocate() cpuset.CPUSet {
 	if a.sys != nil {
+		a.setupMasks()
 		if (a.flags & AllocIdlePackages) != 0 {
 			a.takeIdlePackages()
 		}
@@ -333,6 +374,7 @@ func (a *allocatorHelper) allocate() cpuset.CPUSet {
 		if a.cnt > 0 {
 			a.takeIdleThreads()
 		}
+		a.from, a.result = a.fromMask.CPUSet(), a.resultMask.CPUSet()
 	} else {
 		a.takeAny()
 	}
@@ -368,10 +410,62 @@ func (ca *cpuAllocator) allocateCpus(from *cpuset.CPUSet, cnt int, prefer CPUPri
 
 // AllocateCpus allocates a number of CPUs from the given set.
 func (ca *cpuAllocator) AllocateCpus(from *cpuset.CPUSet, cnt int, prefer CPUPriority) (cpuset.CPUSet, error) {
+	// Keep clear of wide-vector CPUs as long as we can satisfy the request without them.
+	if !ca.wideVector.IsEmpty() {
+		wide := from.Intersection(ca.wideVector)
+		rest := from.Difference(wide)
+		if !wide.IsEmpty() && rest.Size() >= cnt {
+			result, err := ca.allocateCpus(&rest, cnt, prefer)
+			*from = rest.Union(wide)
+			return result, err
+		}
+	}
+
 	result, err := ca.allocateCpus(from, cnt, prefer)
 	return result, err
 }
 
+// AllocateWideVectorCpus allocates a number of CPUs for a wide-vector (AVX512) workload.
+// CPUs are packed onto the dedicated wide-vector CPUs first, overflowing to the rest of
+// the given set if necessary.
+func (ca *cpuAllocator) AllocateWideVectorCpus(from *cpuset.CPUSet, cnt int, prefer CPUPriority) (cpuset.CPUSet, error) {
+	if from.Size() < cnt {
+		return cpuset.NewCPUSet(), fmt.Errorf("cpuset %s does not have %d CPUs", from, cnt)
+	}
+
+	result := cpuset.NewCPUSet()
+	wide := from.Intersection(ca.wideVector)
+	if take := wide.Size(); take > 0 {
+		if take > cnt {
+			take = cnt
+		}
+		cset, err := ca.allocateCpus(&wide, take, prefer)
+		if err != nil {
+			return cpuset.NewCPUSet(), err
+		}
+		*from = from.Difference(cset)
+		result = cset
+	}
+
+	if cnt > result.Size() {
+		cset, err := ca.allocateCpus(from, cnt-result.Size(), prefer)
+		if err != nil {
+			*from = from.Union(result)
+			return cpuset.NewCPUSet(), err
+		}
+		result = result.Union(cset)
+	}
+
+	ca.Debug("AllocateWideVectorCpus(%d, preferring #%v) => #%s", cnt, prefer, result)
+
+	return result, nil
+}
+
+// SetWideVectorCpus sets the CPUs dedicated to wide-vector (AVX512) workloads.
+func (ca *cpuAllocator) SetWideVectorCpus(cpus cpuset.CPUSet) {
+	ca.wideVector = cpus.Clone()
+}
+
 // ReleaseCpus releases a number of CPUs from the given set.
 func (ca *cpuAllocator) ReleaseCpus(from *cpuset.CPUSet, cnt int, prefer CPUPriority) (cpuset.CPUSet, error) {
 	oset := from.Clone()
@@ -398,6 +492,7 @@ func newTopologyCache(sys sysfs.System) topologyCache {
 		for _, id := range sys.CPUIDs() {
 			c.core[id] = sys.CPU(id).ThreadCPUSet()
 		}
+		c.setupMasks(sys)
 	}
 
 	c.discoverCPUPriorities(sys)
@@ -405,6 +500,87 @@ func newTopologyCache(sys sysfs.System) topologyCache {
 	return c
 }
 
+// setupMasks sets up the CPU masks of the topology.
+func (c *topologyCache) setupMasks(sys sysfs.System) {
+	c.pkgIDs = sys.PackageIDs()
+	c.cpuIDs = sys.CPUIDs()
+
+	maxPkg, maxCPU := 0, 0
+	for _, id := range c.pkgIDs {
+		if int(id) > maxPkg {
+			maxPkg = int(id)
+		}
+	}
+	for _, id := range c.cpuIDs {
+		if int(id) > maxCPU {
+			maxCPU = int(id)
+		}
+	}
+	for _, cset := range c.core {
+		for _, id := range cset.ToSliceNoSort() {
+			if id > maxCPU {
+				maxCPU = id
+			}
+		}
+	}
+
+	c.words = cpuMaskWords(maxCPU)
+	c.pkgMask = make([]cpuMask, maxPkg+1)
+	c.cpuPkg = make([]sysfs.ID, maxCPU+1)
+	c.coreMask = make([]cpuMask, maxCPU+1)
+	for id := range c.pkgMask {
+		c.pkgMask[id] = newCPUMask(c.words)
+	}
+	for id := range c.coreMask {
+		c.coreMask[id] = newCPUMask(c.words)
+	}
+	for id, cset := range c.pkg {
+		c.pkgMask[id] = newCPUMaskFromCPUSet(cset, c.words)
+	}
+	for id, cset := range c.core {
+		c.coreMask[id] = newCPUMaskFromCPUSet(cset, c.words)
+		c.cpuPkg[id] = sys.CPU(id).PackageID()
+	}
+}
+
+// setCPUPriorities sets the CPU priority mapping, updating the related masks and counts.
+func (c *topologyCache) setCPUPriorities(prio cpuPriorities) {
+	c.cpuPriorities = prio
+
+	if c.words == 0 {
+		return
+	}
+
+	for p, cset := range prio {
+		if w := cpuSetWords(cset); w > c.words {
+			log.Warn("ignoring %s priority CPUs outside of the topology: %s", CPUPriority(p), cset)
+		}
+		c.prioMask[p] = newCPUMask(c.words)
+		for _, id := range cset.ToSliceNoSort() {
+			if id < c.words*64 {
+				c.prioMask[p].set(id)
+			}
+		}
+	}
+
+	c.pkgPrio = make([]priorityCounts, len(c.pkgMask))
+	for id, mask := range c.pkgMask {
+		for p := range c.prioMask {
+			c.pkgPrio[id][p] = mask.andCount(c.prioMask[p])
+		}
+	}
+	c.corePrio = make([]priorityCounts, len(c.coreMask))
+	c.cpuPrio = make([]priorityCounts, len(c.coreMask))
+	for id, mask := range c.coreMask {
+		for p := range c.prioMask {
+			c.corePrio[id][p] = mask.andCount(c.prioMask[p])
+			if c.prioMask[p].has(id) {
+				c.cpuPrio[id][p] = 1
+			}
+		}
+	}
+}
+
 func (c *topologyCache) discoverCPUPriorities(sys sysfs.System) {
 	if sys == nil {
 		return
@@ -426,6 +602,8 @@ func (c *topologyCache) discoverCPUPriorities(sys sysfs.System) {
 			prio[p] = prio[p].Union(cset)
 		}
 	}
+
+	c.setCPUPriorities(prio)
 }
 
 func (c *topologyCache) discoverSstCPUPriority(sys sysfs.System, pkgID sysfs.ID) ([NumCPUPriorities][]sysfs.ID, bool) {
@@ -637,10 +815,26 @@ func (c *cpuPriorities) cmpCPUSet(csetA, csetB cpuset.CPUSet, prefer CPUPriority
 		return 0
 	}
 
+	var cntA, cntB priorityCounts
+	for prio := range c {
+		cntA[prio] = csetA.Intersection(c[prio]).Size()
+		cntB[prio] = csetB.Intersection(c[prio]).Size()
+	}
+
+	return cmpPriorityCounts(&cntA, &cntB, prefer, cpuCnt)
+}
+
+// cmpPriorityCounts compares two sets of CPUs, given as the number of CPUs
+// with each priority, in terms of preferred cpu priority, like cmpCPUSet.
+func cmpPriorityCounts(cntA, cntB *priorityCounts, prefer CPUPriority, cpuCnt int) int {
+	if prefer == PriorityNone {
+		return 0
+	}
+
 	// Favor cpuset having CPUs with priorities equal to or lower than what was requested
 	for prio := prefer; prio < NumCPUPriorities; prio++ {
-		prefA := csetA.Intersection(c[prio]).Size()
-		prefB := csetB.Intersection(c[prio]).Size()
+		prefA := cntA[prio]
+		prefB := cntB[prio]
 		if cpuCnt > 0 && prio == prefer && prefA >= cpuCnt && prefB >= cpuCnt {
 			// Prefer the tightest fitting if both cpusets satisfy the
 			// requested amount of CPUs with the preferred priority
@@ -652,8 +846,8 @@ func (c *cpuPriorities) cmpCPUSet(csetA, csetB cpuset.CPUSet, prefer CPUPriority
 	}
 	// Repel cpuset having CPUs with higher priority than what was requested
 	for prio := PriorityHigh; prio < prefer; prio++ {
-		nonprefA := csetA.Intersection(c[prio]).Size()
-		nonprefB := csetB.Intersection(c[prio]).Size()
+		nonprefA := cntA[prio]
+		nonprefB := cntB[prio]
 		if nonprefA != nonprefB {
 			return nonprefB - nonprefA
 		}
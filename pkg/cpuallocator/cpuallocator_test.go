@@ -18,6 +18,7 @@ import (
 	"io/ioutil"
 	"os"
 	"path"
+	"strconv"
 	"testing"
 
 	"k8s.io/kubernetes/pkg/kubelet/cm/cpuset"
@@ -26,15 +27,16 @@ import (
 	"github.com/intel/cri-resource-manager/pkg/utils"
 )
 
-func TestAllocatorHelper(t *testing.T) {
+// discoverTestSystem discovers the mock system from the testdata.
+func discoverTestSystem(t testing.TB) (sysfs.System, func()) {
 	// Create tmpdir and decompress testdata there
 	tmpdir, err := ioutil.TempDir("", "cri-resource-manager-test-")
 	if err != nil {
 		t.Fatalf("failed to create tmpdir: %v", err)
 	}
-	defer os.RemoveAll(tmpdir)
 
 	if err := utils.UncompressTbz2(path.Join("testdata", "sysfs.tar.bz2"), tmpdir); err != nil {
+		os.RemoveAll(tmpdir)
 		t.Fatalf("failed to decompress testdata: %v", err)
 	}
 
@@ -43,17 +45,26 @@ func TestAllocatorHelper(t *testing.T) {
 		path.Join(tmpdir, "sysfs", "2-socket-4-node-40-core", "sys"),
 		sysfs.DiscoverCPUTopology, sysfs.DiscoverMemTopology)
 	if err != nil {
+		os.RemoveAll(tmpdir)
 		t.Fatalf("failed to discover mock system: %v", err)
 	}
+
+	return sys, func() { os.RemoveAll(tmpdir) }
+}
+
+func TestAllocatorHelper(t *testing.T) {
+	sys, cleanup := discoverTestSystem(t)
+	defer cleanup()
+
 	topoCache := newTopologyCache(sys)
 
 	// Fake cpu priorities: 5 cores from pkg #0 as high prio
 	// Package CPUs: #0: [0-19,40-59], #1: [20-39,60-79]
-	topoCache.cpuPriorities = [NumCPUPriorities]cpuset.CPUSet{
+	topoCache.setCPUPriorities(cpuPriorities{
 		cpuset.MustParse("2,5,8,15,17,42,45,48,55,57"),
 		cpuset.MustParse("20-39,60-79"),
 		cpuset.MustParse("0,1,3,4,6,7,9-14,16,18,19,40,41,43,44,46,47,49-54,56,58,59"),
-	}
+	})
 
 	tcs := []struct {
 		description string
@@ -99,3 +110,167 @@ func TestAllocatorHelper(t *testing.T) {
 		})
 	}
 }
+
+func TestWideVectorAllocation(t *testing.T) {
+	sys, cleanup := discoverTestSystem(t)
+	defer cleanup()
+
+	// Fake cpu priorities, as in TestAllocatorHelper, and dedicate
+	// 5 low priority cores from pkg #0 to wide-vector workloads.
+	ca := &cpuAllocator{
+		Logger:        log,
+		sys:           sys,
+		topologyCache: newTopologyCache(sys),
+		wideVector:    cpuset.MustParse("10-14,50-54"),
+	}
+	ca.topologyCache.setCPUPriorities(cpuPriorities{
+		cpuset.MustParse("2,5,8,15,17,42,45,48,55,57"),
+		cpuset.MustParse("20-39,60-79"),
+		cpuset.MustParse("0,1,3,4,6,7,9-14,16,18,19,40,41,43,44,46,47,49-54,56,58,59"),
+	})
+
+	tcs := []struct {
+		description string
+		from        cpuset.CPUSet
+		wide        bool
+		prefer      CPUPriority
+		cnt         int
+		expected    cpuset.CPUSet
+	}{
+		{
+			description: "wide-vector CPUs packed onto full cores",
+			from:        cpuset.MustParse("0-79"),
+			wide:        true,
+			prefer:      PriorityLow,
+			cnt:         4,
+			expected:    cpuset.MustParse("10,11,50,51"),
+		},
+		{
+			description: "wide-vector CPUs overflow to low priority cores",
+			from:        cpuset.MustParse("0-79"),
+			wide:        true,
+			prefer:      PriorityLow,
+			cnt:         12,
+			expected:    cpuset.MustParse("0,10-14,40,50-54"),
+		},
+		{
+			description: "normal CPUs avoid wide-vector cores",
+			from:        cpuset.MustParse("10-19,50-59"),
+			prefer:      PriorityLow,
+			cnt:         4,
+			expected:    cpuset.MustParse("16,18,56,58"),
+		},
+		{
+			description: "normal CPUs fall back to wide-vector cores",
+			from:        cpuset.MustParse("12-16,52-56"),
+			prefer:      PriorityLow,
+			cnt:         8,
+			expected:    cpuset.MustParse("12-14,16,52-54,56"),
+		},
+		{
+			description: "too few available CPUs",
+			from:        cpuset.MustParse("10-13"),
+			wide:        true,
+			prefer:      PriorityLow,
+			cnt:         5,
+			expected:    cpuset.NewCPUSet(),
+		},
+	}
+
+	for _, tc := range tcs {
+		t.Run(tc.description, func(t *testing.T) {
+			var result cpuset.CPUSet
+			from := tc.from.Clone()
+			if tc.wide {
+				result, _ = ca.AllocateWideVectorCpus(&from, tc.cnt, tc.prefer)
+			} else {
+				result, _ = ca.AllocateCpus(&from, tc.cnt, tc.prefer)
+			}
+			if !result.Equals(tc.expected) {
+				t.Errorf("expected %q, result was %q", tc.expected, result)
+			}
+			if !result.IsEmpty() && !from.Union(result).Equals(tc.from) {
+				t.Errorf("expected %q to be left, was %q", tc.from.Difference(result), from)
+			}
+		})
+	}
+}
+
+func BenchmarkAllocateCpus(b *testing.B) {
+	sys, cleanup := discoverTestSystem(b)
+	defer cleanup()
+
+	for _, bc := range []struct {
+		name string
+		wide string
+	}{
+		{name: "plain"},
+		{name: "wide-vector", wide: "10-14,50-54"},
+	} {
+		ca := NewCPUAllocator(sys)
+		if bc.wide != "" {
+			ca.SetWideVectorCpus(cpuset.MustParse(bc.wide))
+		}
+		b.Run(bc.name, func(b *testing.B) {
+			for i := 0; i < b.N; i++ {
+				from := cpuset.MustParse("0-79")
+				if bc.wide != "" {
+					ca.AllocateWideVectorCpus(&from, 4, PriorityLow)
+				}
+				ca.AllocateCpus(&from, 4, PriorityHigh)
+			}
+		})
+	}
+}
+
+func BenchmarkAllocatorHelper(b *testing.B) {
+	sys, cleanup := discoverTestSystem(b)
+	defer cleanup()
+
+	topoCache := newTopologyCache(sys)
+	topoCache.setCPUPriorities(cpuPriorities{
+		cpuset.MustParse("2,5,8,15,17,42,45,48,55,57"),
+		cpuset.MustParse("20-39,60-79"),
+		cpuset.MustParse("0,1,3,4,6,7,9-14,16,18,19,40,41,43,44,46,47,49-54,56,58,59"),
+	})
+
+	for _, bc := range []struct {
+		name   string
+		from   string
+		prefer CPUPriority
+		cnt    int
+	}{
+		{name: "idle-package", from: "0-79", prefer: PriorityNormal, cnt: 40},
+		{name: "idle-cores", from: "0-79", prefer: PriorityHigh, cnt: 8},
+		{name: "threads", from: "1-78", prefer: PriorityLow, cnt: 3},
+		{name: "fragmented", from: "0-9,25-34,48-55,70-71", prefer: PriorityNormal, cnt: 12},
+	} {
+		from := cpuset.MustParse(bc.from)
+		b.Run(bc.name, func(b *testing.B) {
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				a := newAllocatorHelper(sys, topoCache)
+				a.from = from
+				a.prefer = bc.prefer
+				a.cnt = bc.cnt
+				a.allocate()
+			}
+		})
+	}
+}
+
+func BenchmarkReleaseCpus(b *testing.B) {
+	sys, cleanup := discoverTestSystem(b)
+	defer cleanup()
+
+	ca := NewCPUAllocator(sys)
+	for _, cnt := range []int{1, 4, 16, 40} {
+		b.Run(strconv.Itoa(cnt), func(b *testing.B) {
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				from := cpuset.MustParse("0-79")
+				ca.ReleaseCpus(&from, cnt, PriorityNormal)
+			}
+		})
+	}
+}
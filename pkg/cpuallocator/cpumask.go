@@ -0,0 +1,158 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cpuallocator
+
+import (
+	"math/bits"
+
+	"k8s.io/kubernetes/pkg/kubelet/cm/cpuset"
+)
+
+// cpuMask is a bitmask of CPUs.
+//
+// Masks of the cached topology all have the same width, wide enough for
+// all CPUs of the system. Masks used for allocation can be wider, but
+// never narrower, than those. Binary operations iterate over the words
+// of the receiver, which therefore must be the narrower topology mask.
+type cpuMask []uint64
+
+// cpuMaskWords returns the number of words needed for a mask with the given CPU.
+func cpuMaskWords(maxID int) int {
+	return maxID/64 + 1
+}
+
+// newCPUMask creates an empty mask of the given width.
+func newCPUMask(words int) cpuMask {
+	return make(cpuMask, words)
+}
+
+// cpuSetWords returns the number of words needed for a mask with the CPUs of a CPUSet.
+func cpuSetWords(cset cpuset.CPUSet) int {
+	words := 0
+	for _, id := range cset.ToSliceNoSort() {
+		if w := cpuMaskWords(id); w > words {
+			words = w
+		}
+	}
+	return words
+}
+
+// newCPUMaskFromCPUSet creates a mask of the given width for a CPUSet.
+func newCPUMaskFromCPUSet(cset cpuset.CPUSet, words int) cpuMask {
+	m := newCPUMask(words)
+	for _, id := range cset.ToSliceNoSort() {
+		m.set(id)
+	}
+	return m
+}
+
+// set adds a CPU to the mask.
+func (m cpuMask) set(id int) {
+	m[id/64] |= 1 << uint(id%64)
+}
+
+// clear removes a CPU from the mask.
+func (m cpuMask) clear(id int) {
+	m[id/64] &^= 1 << uint(id%64)
+}
+
+// has checks if a CPU is in the mask.
+func (m cpuMask) has(id int) bool {
+	return m[id/64]&(1<<uint(id%64)) != 0
+}
+
+// count returns the number of CPUs in the mask.
+func (m cpuMask) count() int {
+	cnt := 0
+	for _, w := range m {
+		cnt += bits.OnesCount64(w)
+	}
+	return cnt
+}
+
+// andCount returns the number of CPUs in both masks.
+func (m cpuMask) andCount(o cpuMask) int {
+	cnt := 0
+	for i, w := range m {
+		cnt += bits.OnesCount64(w & o[i])
+	}
+	return cnt
+}
+
+// and3Count returns the number of CPUs in all three masks.
+func (m cpuMask) and3Count(o, p cpuMask) int {
+	cnt := 0
+	for i, w := range m {
+		cnt += bits.OnesCount64(w & o[i] & p[i])
+	}
+	return cnt
+}
+
+// andNotCount returns the number of CPUs in the mask but not in the other.
+func (m cpuMask) andNotCount(o cpuMask) int {
+	cnt := 0
+	for i, w := range m {
+		cnt += bits.OnesCount64(w &^ o[i])
+	}
+	return cnt
+}
+
+// coveredBy checks if all CPUs in the mask, except the excluded ones, are in the other one.
+func (m cpuMask) coveredBy(o, exclude cpuMask) bool {
+	for i, w := range m {
+		if w&^exclude[i]&^o[i] != 0 {
+			return false
+		}
+	}
+	return true
+}
+
+// firstNotIn returns the lowest CPU in the mask but not in the other, or -1.
+func (m cpuMask) firstNotIn(o cpuMask) int {
+	for i, w := range m {
+		if w &^= o[i]; w != 0 {
+			return i*64 + bits.TrailingZeros64(w)
+		}
+	}
+	return -1
+}
+
+// forEach calls fn for each CPU in the mask, in increasing order, until fn returns false.
+func (m cpuMask) forEach(fn func(int) bool) {
+	for i, w := range m {
+		for w != 0 {
+			b := bits.TrailingZeros64(w)
+			if !fn(i*64 + b) {
+				return
+			}
+			w &^= 1 << uint(b)
+		}
+	}
+}
+
+// CPUSet returns the CPUs in the mask as a CPUSet.
+func (m cpuMask) CPUSet() cpuset.CPUSet {
+	b := cpuset.NewBuilder()
+	m.forEach(func(id int) bool {
+		b.Add(id)
+		return true
+	})
+	return b.Result()
+}
+
+// String returns the CPUs in the mask as a string.
+func (m cpuMask) String() string {
+	return m.CPUSet().String()
+}
@@ -22,7 +22,7 @@ import (
 )
 
 func (r *relay) dump(method string, req interface{}) {
-	if r.DebugEnabled() {
+	if dump.Enabled(method) && r.DebugEnabled() {
 		qualif := r.qualifier(req)
 		dump.RequestMessage("relayed", method, qualif, req, true)
 	}
@@ -51,6 +51,8 @@ const (
 
 	// TagAVX512 tags containers that use AVX512 instructions.
 	TagAVX512 = "AVX512"
+	// TagMemBandwidthHog tags containers that use a lot of memory bandwidth.
+	TagMemBandwidthHog = "MemBandwidthHog"
 
 	// RDTClassKey is the pod annotation key for specifying a container RDT class.
 	RDTClassKey = "rdtclass" + "." + kubernetes.ResmgrKeyNamespace
@@ -632,6 +634,8 @@ type cache struct {
 	pending map[string]struct{} // cache IDs of containers with pending changes
 
 	implicit map[string]*ImplicitAffinity // implicit affinities
+
+	journal *journal // journal of changes since the last snapshot
 }
 
 // Make sure cache implements Cache.
@@ -656,6 +660,7 @@ func NewCache(options Options) (Cache, error) {
 		PolicyJSON: make(map[string]string),
 		implicit:   make(map[string]*ImplicitAffinity),
 	}
+	cch.journal = newJournal(cch.filePath, cch.Logger)
 
 	if _, err := cch.checkPerm("cache", cch.filePath, false, cacheFilePerm); err != nil {
 		return nil, cacheError("refusing to use existing cache file: %v", err)
@@ -670,6 +675,16 @@ func NewCache(options Options) (Cache, error) {
 		return nil, err
 	}
 
+	// Start a fresh journal on top of a snapshot of what we loaded.
+	cch.journal.start()
+	done := make(chan error, 1)
+	if err := cch.compactJournal(done); err != nil {
+		return nil, err
+	}
+	if err := <-done; err != nil {
+		return nil, err
+	}
+
 	return cch, nil
 }
 
@@ -681,6 +696,7 @@ func (cch *cache) GetActivePolicy() string {
 // SetActivePolicy updaes the name of the active policy stored in the cache.
 func (cch *cache) SetActivePolicy(policy string) error {
 	cch.PolicyName = policy
+	cch.markStateDirty()
 	return cch.Save()
 }
 
@@ -692,6 +708,8 @@ func (cch *cache) ResetActivePolicy() error {
 	cch.PolicyName = ""
 	cch.policyData = make(map[string]interface{})
 	cch.PolicyJSON = make(map[string]string)
+	cch.markStateDirty()
+	cch.markPolicyReset()
 
 	return cch.Save()
 }
@@ -700,9 +718,11 @@ func (cch *cache) ResetActivePolicy() error {
 func (cch *cache) SetConfig(cfg *config.RawConfig) error {
 	old := cch.Cfg
 	cch.Cfg = cfg
+	cch.markStateDirty()
 
 	if err := cch.Save(); err != nil {
 		cch.Cfg = old
+		cch.markStateDirty()
 		return err
 	}
 
@@ -718,9 +738,11 @@ func (cch *cache) GetConfig() *config.RawConfig {
 func (cch *cache) ResetConfig() error {
 	old := cch.Cfg
 	cch.Cfg = nil
+	cch.markStateDirty()
 
 	if err := cch.Save(); err != nil {
 		cch.Cfg = old
+		cch.markStateDirty()
 		return err
 	}
 
@@ -848,6 +870,7 @@ func (cch *cache) createCacheID(c *container) string {
 	cch.Warn("can't find unique id for pod %s, assigning local cache id", c.PodID)
 	id := "cache:" + strconv.FormatUint(cch.NextID, 16)
 	cch.NextID++
+	cch.markStateDirty()
 
 	return id
 }
@@ -873,6 +896,7 @@ func (cch *cache) InsertPod(id string, msg interface{}, status *PodStatus) Pod {
 	}
 
 	cch.Pods[p.ID] = p
+	cch.markPodDirty(p.ID)
 
 	cch.Save()
 
@@ -888,6 +912,7 @@ func (cch *cache) DeletePod(id string) Pod {
 
 	cch.Debug("removing pod %s (%s)", p.Name, p.ID)
 	delete(cch.Pods, id)
+	cch.markPodDirty(id)
 
 	cch.Save()
 
@@ -938,6 +963,7 @@ func (cch *cache) InsertContainer(msg interface{}) (Container, error) {
 	case len(adjustments) == 1:
 		c.setEffectiveAdjustment(adjustments[0])
 	}
+	cch.markContainerDirty(c)
 
 	cch.Save()
 
@@ -960,6 +986,7 @@ func (cch *cache) UpdateContainerID(cacheID string, msg interface{}) (Container,
 
 	c.ID = reply.ContainerId
 	cch.Containers[c.ID] = c
+	cch.markContainerDirty(c)
 
 	cch.Save()
 
@@ -977,6 +1004,7 @@ func (cch *cache) DeleteContainer(id string) Container {
 	cch.removeContainerDirectory(c.CacheID)
 	delete(cch.Containers, c.ID)
 	delete(cch.Containers, c.CacheID)
+	cch.markContainerDirty(c)
 
 	cch.Save()
 
@@ -1177,6 +1205,7 @@ func (cch *cache) GetContainers() []Container {
 // Set the policy entry for a key.
 func (cch *cache) SetPolicyEntry(key string, obj interface{}) {
 	cch.policyData[key] = obj
+	cch.markPolicyDirty(key)
 
 	if cch.DebugEnabled() {
 		if data, err := marshalEntry(obj); err != nil {
@@ -1430,6 +1459,7 @@ func (cch *cache) mkdirAll(what, path string, p *permissions) error {
 // snapshot is used to serialize the cache into a saveable/loadable state.
 type snapshot struct {
 	Version    string
+	Generation uint64 `json:",omitempty"`
 	Pods       map[string]*pod
 	Containers map[string]*container
 	NextID     uint64
@@ -1442,6 +1472,7 @@ type snapshot struct {
 func (cch *cache) Snapshot() ([]byte, error) {
 	s := snapshot{
 		Version:    CacheVersion,
+		Generation: cch.journal.generation,
 		Pods:       make(map[string]*pod),
 		Containers: make(map[string]*container),
 		Cfg:        cch.Cfg,
@@ -1501,6 +1532,7 @@ func (cch *cache) Restore(data []byte) error {
 	cch.PolicyJSON = s.PolicyJSON
 	cch.PolicyName = s.PolicyName
 	cch.policyData = make(map[string]interface{})
+	cch.journal.generation = s.Generation
 
 	for _, p := range cch.Pods {
 		p.cache = cch
@@ -1518,24 +1550,13 @@ func (cch *cache) Restore(data []byte) error {
 }
 
 // Save the state of the cache.
+//
+// Only the changes since the last save are serialized and queued for
+// writing to the journal in the background. Any error returned is from
+// serializing the changes or from writing earlier ones.
 func (cch *cache) Save() error {
-	cch.Debug("saving cache to file '%s'...", cch.filePath)
-
-	data, err := cch.Snapshot()
-	if err != nil {
-		return cacheError("failed to save cache: %v", err)
-	}
-
-	tmpPath := cch.filePath + ".saving"
-	if err = ioutil.WriteFile(tmpPath, data, cacheFilePerm.prefer); err != nil {
-		return cacheError("failed to write cache to file %q: %v", tmpPath, err)
-	}
-	if err := os.Rename(tmpPath, cch.filePath); err != nil {
-		return cacheError("failed to rename %q to %q: %v",
-			tmpPath, cch.filePath, err)
-	}
-
-	return nil
+	cch.Debug("saving cache to file '%s'...", cch.journal.path)
+	return cch.saveJournal()
 }
 
 // Load loads the last saved state of the cache.
@@ -1555,7 +1576,11 @@ func (cch *cache) Load() error {
 		return cacheError("failed to load cache from file '%s': %v", cch.filePath, err)
 	}
 
-	return cch.Restore(data)
+	if err := cch.Restore(data); err != nil {
+		return err
+	}
+
+	return cch.replayJournal(cch.journal.generation)
 }
 
 func (cch *cache) ContainerDirectory(id string) string {
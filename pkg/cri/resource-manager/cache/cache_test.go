@@ -24,6 +24,7 @@ import (
 	v1 "k8s.io/api/core/v1"
 	cri "k8s.io/cri-api/pkg/apis/runtime/v1alpha2"
 	kubecm "k8s.io/kubernetes/pkg/kubelet/cm"
+	"k8s.io/kubernetes/pkg/kubelet/cm/cpuset"
 	kubetypes "k8s.io/kubernetes/pkg/kubelet/types"
 
 	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/kubernetes"
@@ -414,3 +415,148 @@ func TestCPULimitCalculationAccuracy(t *testing.T) {
 		}
 	}
 }
+
+func TestJournalReplay(t *testing.T) {
+	tcases := []struct {
+		name         string
+		minRecords   int
+		compactRatio int
+	}{
+		{
+			name:         "replay journal",
+			minRecords:   1024,
+			compactRatio: 4,
+		},
+		{
+			name:         "replay compacted journal",
+			minRecords:   1,
+			compactRatio: 0,
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			savedMin, savedRatio := journalMinRecords, journalCompactRatio
+			journalMinRecords, journalCompactRatio = tc.minRecords, tc.compactRatio
+			defer func() { journalMinRecords, journalCompactRatio = savedMin, savedRatio }()
+
+			cch, dir, err := createTmpCache()
+			if err != nil {
+				t.Fatalf("failed to create cache: %v", err)
+			}
+			defer removeTmpCache(dir)
+
+			fp := &fakePod{name: "pod1"}
+			if _, err := createFakePod(cch, fp); err != nil {
+				t.Fatalf("failed to create fake pod: %v", err)
+			}
+			var containers []Container
+			for _, name := range []string{"container1", "container2", "container3"} {
+				c, err := createFakeContainer(cch, &fakeContainer{fakePod: fp, name: name})
+				if err != nil {
+					t.Fatalf("failed to create fake container %s: %v", name, err)
+				}
+				containers = append(containers, c)
+			}
+
+			containers[0].SetCpusetCpus("1-3")
+			containers[1].UpdateState(ContainerStateRunning)
+			cch.DeleteContainer(containers[2].GetCacheID())
+			cch.SetPolicyEntry("cpus", cpuset.NewCPUSet(4, 5))
+			if err := cch.SetActivePolicy("test"); err != nil {
+				t.Errorf("failed to set active policy: %v", err)
+			}
+			if err := cch.(*cache).journal.flush(); err != nil {
+				t.Fatalf("failed to flush journal: %v", err)
+			}
+
+			chk, err := NewCache(Options{CacheDir: dir})
+			if err != nil {
+				t.Fatalf("failed to reload cache: %v", err)
+			}
+
+			if _, ok := chk.LookupPod(fp.id); !ok {
+				t.Errorf("pod %s not restored", fp.id)
+			}
+			if ids := chk.GetContainerIds(); len(ids) != 2 {
+				t.Errorf("expected 2 restored containers, got %v", ids)
+			}
+			if c, ok := chk.LookupContainer(containers[0].GetID()); !ok || c.GetCpusetCpus() != "1-3" {
+				t.Errorf("container %s not properly restored", containers[0].PrettyName())
+			}
+			if c, ok := chk.LookupContainer(containers[1].GetCacheID()); !ok || c.GetState() != ContainerStateRunning {
+				t.Errorf("container %s not properly restored", containers[1].PrettyName())
+			}
+			if _, ok := chk.LookupContainer(containers[2].GetID()); ok {
+				t.Errorf("deleted container %s restored", containers[2].PrettyName())
+			}
+			if policy := chk.GetActivePolicy(); policy != "test" {
+				t.Errorf("expected active policy test, got %q", policy)
+			}
+			cpus := cpuset.NewCPUSet()
+			if !chk.GetPolicyEntry("cpus", &cpus) || cpus.String() != "4-5" {
+				t.Errorf("expected policy entry 4-5, got %s", cpus.String())
+			}
+		})
+	}
+}
+
+func TestNoopResourceUpdates(t *testing.T) {
+	tcases := []struct {
+		name    string
+		update  func(Container)
+		pending bool
+	}{
+		{
+			name:    "same cpuset",
+			update:  func(c Container) { c.SetCpusetCpus("0-3"); c.SetCpusetMems("0") },
+			pending: false,
+		},
+		{
+			name:    "changed cpuset",
+			update:  func(c Container) { c.SetCpusetCpus("0-5") },
+			pending: true,
+		},
+		{
+			name:    "same shares",
+			update:  func(c Container) { c.SetCPUShares(1024) },
+			pending: false,
+		},
+		{
+			name:    "changed memory limit",
+			update:  func(c Container) { c.SetMemoryLimit(1 << 30) },
+			pending: true,
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			cch, dir, err := createTmpCache()
+			if err != nil {
+				t.Fatalf("failed to create cache: %v", err)
+			}
+			defer removeTmpCache(dir)
+
+			fp := &fakePod{name: "pod1"}
+			if _, err := createFakePod(cch, fp); err != nil {
+				t.Fatalf("failed to create fake pod: %v", err)
+			}
+			c, err := createFakeContainer(cch, &fakeContainer{
+				fakePod: fp,
+				name:    "container1",
+				resources: cri.LinuxContainerResources{
+					CpusetCpus: "0-3",
+					CpusetMems: "0",
+					CpuShares:  1024,
+				},
+			})
+			if err != nil {
+				t.Fatalf("failed to create fake container: %v", err)
+			}
+			c.ClearPending(CRI)
+
+			tc.update(c)
+			if pending := c.HasPending(CRI); pending != tc.pending {
+				t.Errorf("expected pending CRI changes %v, got %v", tc.pending, pending)
+			}
+		})
+	}
+}
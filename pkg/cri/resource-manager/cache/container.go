@@ -250,6 +250,7 @@ func (c *container) GetNamespace() string {
 
 func (c *container) UpdateState(state ContainerState) {
 	c.State = state
+	c.cache.markContainerDirty(c)
 }
 
 func (c *container) GetState() ContainerState {
@@ -489,6 +490,7 @@ func (c *container) GetLinuxResources() *cri.LinuxContainerResources {
 func (c *container) setEffectiveAdjustment(name string) string {
 	previous := c.Adjustment
 	c.Adjustment = name
+	c.cache.markContainerDirty(c)
 	return previous
 }
 
@@ -648,6 +650,8 @@ func (c *container) SetLinuxResources(req *cri.LinuxContainerResources) {
 func (c *container) SetCPUPeriod(value int64) {
 	if c.LinuxReq == nil {
 		c.LinuxReq = &cri.LinuxContainerResources{}
+	} else if c.LinuxReq.CpuPeriod == value {
+		return
 	}
 	c.LinuxReq.CpuPeriod = value
 	c.markPending(CRI)
@@ -656,6 +660,8 @@ func (c *container) SetCPUPeriod(value int64) {
 func (c *container) SetCPUQuota(value int64) {
 	if c.LinuxReq == nil {
 		c.LinuxReq = &cri.LinuxContainerResources{}
+	} else if c.LinuxReq.CpuQuota == value {
+		return
 	}
 	c.LinuxReq.CpuQuota = value
 	c.markPending(CRI)
@@ -664,6 +670,8 @@ func (c *container) SetCPUQuota(value int64) {
 func (c *container) SetCPUShares(value int64) {
 	if c.LinuxReq == nil {
 		c.LinuxReq = &cri.LinuxContainerResources{}
+	} else if c.LinuxReq.CpuShares == value {
+		return
 	}
 	c.LinuxReq.CpuShares = value
 	c.markPending(CRI)
@@ -672,6 +680,8 @@ func (c *container) SetCPUShares(value int64) {
 func (c *container) SetMemoryLimit(value int64) {
 	if c.LinuxReq == nil {
 		c.LinuxReq = &cri.LinuxContainerResources{}
+	} else if c.LinuxReq.MemoryLimitInBytes == value {
+		return
 	}
 	c.LinuxReq.MemoryLimitInBytes = value
 	c.markPending(CRI)
@@ -680,6 +690,8 @@ func (c *container) SetMemoryLimit(value int64) {
 func (c *container) SetOomScoreAdj(value int64) {
 	if c.LinuxReq == nil {
 		c.LinuxReq = &cri.LinuxContainerResources{}
+	} else if c.LinuxReq.OomScoreAdj == value {
+		return
 	}
 	c.LinuxReq.OomScoreAdj = value
 	c.markPending(CRI)
@@ -688,6 +700,8 @@ func (c *container) SetOomScoreAdj(value int64) {
 func (c *container) SetCpusetCpus(value string) {
 	if c.LinuxReq == nil {
 		c.LinuxReq = &cri.LinuxContainerResources{}
+	} else if c.LinuxReq.CpusetCpus == value {
+		return
 	}
 	c.LinuxReq.CpusetCpus = value
 	c.markPending(CRI)
@@ -696,6 +710,8 @@ func (c *container) SetCpusetCpus(value string) {
 func (c *container) SetCpusetMems(value string) {
 	if c.LinuxReq == nil {
 		c.LinuxReq = &cri.LinuxContainerResources{}
+	} else if c.LinuxReq.CpusetMems == value {
+		return
 	}
 	c.LinuxReq.CpusetMems = value
 	c.markPending(CRI)
@@ -924,6 +940,7 @@ func (c *container) markPending(controllers ...string) {
 		c.pending[ctrl] = struct{}{}
 		c.cache.markPending(c)
 	}
+	c.cache.markContainerDirty(c)
 }
 
 func (c *container) ClearPending(controller string) {
@@ -961,12 +978,14 @@ func (c *container) GetTag(key string) (string, bool) {
 func (c *container) SetTag(key string, value string) (string, bool) {
 	prev, ok := c.Tags[key]
 	c.Tags[key] = value
+	c.cache.markContainerDirty(c)
 	return prev, ok
 }
 
 func (c *container) DeleteTag(key string) (string, bool) {
 	value, ok := c.Tags[key]
 	delete(c.Tags, key)
+	c.cache.markContainerDirty(c)
 	return value, ok
 }
 
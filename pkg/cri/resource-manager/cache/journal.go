@@ -0,0 +1,503 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cache
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/json"
+	"os"
+	"sync"
+
+	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/config"
+	logger "github.com/intel/cri-resource-manager/pkg/log"
+)
+
+//
+// Instead of rewriting a full snapshot of the cache on every change, the
+// cache only records the pods, containers, and policy entries which have
+// changed since the last save. Saving the cache appends these as journal
+// records to a file next to the last snapshot. Once the journal has grown
+// large compared to the cache itself, it is compacted into a new snapshot.
+//
+// All file I/O is done by a background goroutine. Saves only serialize the
+// changed records and queue them for writing, so changes which happen while
+// the previous ones are being written get coalesced into a single write.
+//
+// Snapshots and journals carry a generation number. A journal is replayed
+// on top of a snapshot only if their generations match. This protects us
+// from replaying an old journal on top of a newer snapshot if we crash in
+// the middle of compaction.
+//
+
+const (
+	// journal record operations
+	journalHeader          = "header"
+	journalState           = "state"
+	journalPolicyReset     = "policy-reset"
+	journalPolicyEntry     = "policy"
+	journalPod             = "pod"
+	journalDeletePod       = "delete-pod"
+	journalContainer       = "container"
+	journalDeleteContainer = "delete-container"
+)
+
+var (
+	// journalMinRecords is the smallest journal we ever compact.
+	journalMinRecords = 1024
+	// journalCompactRatio is the journal records per cached object ratio we compact at.
+	journalCompactRatio = 4
+)
+
+// journalRecord is a single journal entry.
+type journalRecord struct {
+	Op         string            `json:"op"`
+	Generation uint64            `json:",omitempty"`
+	ID         string            `json:",omitempty"`
+	Pod        *pod              `json:",omitempty"`
+	Container  *container        `json:",omitempty"`
+	Data       string            `json:",omitempty"`
+	NextID     uint64            `json:",omitempty"`
+	Cfg        *config.RawConfig `json:",omitempty"`
+	PolicyName string            `json:",omitempty"`
+}
+
+// journalBatch is a batch of journal records or a snapshot queued for writing.
+type journalBatch struct {
+	generation uint64     // generation of snapshot
+	snapshot   []byte     // snapshot to compact to, or nil
+	records    []byte     // records to append to the journal
+	done       chan error // optional channel to notify about completion
+}
+
+// journal tracks changes to the cache and saves them to the journal file.
+type journal struct {
+	sync.Mutex                    // protects the write queue and errors
+	logger.Logger                 // cache logger instance
+	snapshotPath  string          // snapshot file path
+	path          string          // journal file path
+	file          *os.File        // journal file, owned by the writer
+	queue         []*journalBatch // batches queued for writing
+	kick          chan struct{}   // wake up the writer
+	err           error           // last write error
+	retry         bool            // last compaction failed, retry it
+	generation    uint64          // current journal generation
+	records       int             // number of records in the current generation
+
+	// changes since the last save, protected by the cache lock
+	state       bool
+	policyReset bool
+	policy      map[string]struct{}
+	pods        map[string]struct{}
+	containers  map[string]struct{}
+}
+
+// newJournal creates a journal for the given snapshot file.
+func newJournal(snapshotPath string, log logger.Logger) *journal {
+	j := &journal{
+		Logger:       log,
+		snapshotPath: snapshotPath,
+		path:         snapshotPath + ".journal",
+		kick:         make(chan struct{}, 1),
+	}
+	j.reset()
+	return j
+}
+
+// reset forgets about all changes since the last save.
+func (j *journal) reset() {
+	j.state = false
+	j.policyReset = false
+	j.policy = make(map[string]struct{})
+	j.pods = make(map[string]struct{})
+	j.containers = make(map[string]struct{})
+}
+
+// start starts the journal writer.
+func (j *journal) start() {
+	go j.writer()
+}
+
+// enqueue queues a batch for writing, returning any pending earlier write error.
+func (j *journal) enqueue(b *journalBatch) error {
+	j.Lock()
+	j.queue = append(j.queue, b)
+	err := j.err
+	j.err = nil
+	j.Unlock()
+
+	select {
+	case j.kick <- struct{}{}:
+	default:
+	}
+
+	return err
+}
+
+// flush waits until all queued batches have been written.
+func (j *journal) flush() error {
+	done := make(chan error, 1)
+	j.enqueue(&journalBatch{done: done})
+	return <-done
+}
+
+// writer writes queued batches, coalescing appended records into single writes.
+func (j *journal) writer() {
+	var records bytes.Buffer
+
+	for range j.kick {
+		j.Lock()
+		queue := j.queue
+		j.queue = nil
+		j.Unlock()
+
+		var failed error
+		for i, b := range queue {
+			var err error
+
+			if b.snapshot != nil {
+				if err = j.compact(b); err != nil {
+					j.Error("failed to compact cache journal: %v", err)
+					failed = err
+					j.Lock()
+					j.retry = true
+					j.Unlock()
+				}
+				if b.done != nil {
+					b.done <- err
+				}
+				continue
+			}
+
+			records.Write(b.records)
+
+			// write out records once we hit a snapshot, a waiter, or the end of the queue
+			if b.done == nil && i < len(queue)-1 && queue[i+1].snapshot == nil {
+				continue
+			}
+			if records.Len() > 0 {
+				if err = j.append(records.Bytes()); err != nil {
+					j.Error("failed to save cache journal: %v", err)
+					failed = err
+				}
+				records.Reset()
+			}
+			if b.done != nil {
+				b.done <- err
+			}
+		}
+
+		if failed != nil {
+			j.Lock()
+			j.err = failed
+			j.Unlock()
+		}
+	}
+}
+
+// append appends records to the journal file.
+func (j *journal) append(records []byte) error {
+	if j.file == nil {
+		return cacheError("journal %q not open", j.path)
+	}
+	if _, err := j.file.Write(records); err != nil {
+		return cacheError("failed to write journal %q: %v", j.path, err)
+	}
+	return j.file.Sync()
+}
+
+// compact replaces the snapshot and starts a new journal of a new generation.
+func (j *journal) compact(b *journalBatch) error {
+	tmpPath := j.snapshotPath + ".saving"
+	if err := writeFileSync(tmpPath, b.snapshot); err != nil {
+		return cacheError("failed to write cache to file %q: %v", tmpPath, err)
+	}
+	if err := os.Rename(tmpPath, j.snapshotPath); err != nil {
+		return cacheError("failed to rename %q to %q: %v", tmpPath, j.snapshotPath, err)
+	}
+
+	header, err := json.Marshal(&journalRecord{Op: journalHeader, Generation: b.generation})
+	if err != nil {
+		return cacheError("failed to marshal journal header: %v", err)
+	}
+
+	tmpPath = j.path + ".saving"
+	if err := writeFileSync(tmpPath, append(header, '\n')); err != nil {
+		return cacheError("failed to write journal %q: %v", tmpPath, err)
+	}
+	if err := os.Rename(tmpPath, j.path); err != nil {
+		return cacheError("failed to rename %q to %q: %v", tmpPath, j.path, err)
+	}
+
+	if j.file != nil {
+		j.file.Close()
+	}
+	j.file, err = os.OpenFile(j.path, os.O_WRONLY|os.O_APPEND, cacheFilePerm.prefer)
+	if err != nil {
+		return cacheError("failed to open journal %q: %v", j.path, err)
+	}
+
+	j.Debug("compacted cache to generation %d", b.generation)
+
+	return nil
+}
+
+// writeFileSync writes and syncs a file.
+func writeFileSync(path string, data []byte) error {
+	f, err := os.OpenFile(path, os.O_WRONLY|os.O_CREATE|os.O_TRUNC, cacheFilePerm.prefer)
+	if err != nil {
+		return err
+	}
+	if _, err = f.Write(data); err == nil {
+		err = f.Sync()
+	}
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	return err
+}
+
+// markPodDirty marks a pod changed.
+func (cch *cache) markPodDirty(id string) {
+	cch.journal.pods[id] = struct{}{}
+}
+
+// markContainerDirty marks a container changed.
+func (cch *cache) markContainerDirty(c *container) {
+	if c.CacheID != "" {
+		cch.journal.containers[c.CacheID] = struct{}{}
+	}
+}
+
+// markStateDirty marks the cache-wide state, like configuration or policy name, changed.
+func (cch *cache) markStateDirty() {
+	cch.journal.state = true
+}
+
+// markPolicyDirty marks a policy entry changed.
+func (cch *cache) markPolicyDirty(key string) {
+	cch.journal.policy[key] = struct{}{}
+}
+
+// markPolicyReset marks all policy data cleared.
+func (cch *cache) markPolicyReset() {
+	cch.journal.policyReset = true
+	cch.journal.policy = make(map[string]struct{})
+}
+
+// saveJournal saves changes since the last save, compacting the journal if necessary.
+func (cch *cache) saveJournal() error {
+	j := cch.journal
+
+	j.Lock()
+	retry := j.retry
+	j.retry = false
+	j.Unlock()
+
+	if retry || j.records >= journalMinRecords &&
+		j.records >= journalCompactRatio*(len(cch.Pods)+len(cch.Containers)+len(cch.PolicyJSON)) {
+		return cch.compactJournal(nil)
+	}
+
+	var buf bytes.Buffer
+	cnt, err := cch.journalRecords(json.NewEncoder(&buf))
+	if err != nil {
+		return cacheError("failed to save cache: %v", err)
+	}
+	if cnt == 0 {
+		return nil
+	}
+
+	j.records += cnt
+	return j.enqueue(&journalBatch{records: buf.Bytes()})
+}
+
+// compactJournal queues a new snapshot of the cache for writing.
+func (cch *cache) compactJournal(done chan error) error {
+	j := cch.journal
+
+	j.generation++
+	data, err := cch.Snapshot()
+	if err != nil {
+		j.generation--
+		return cacheError("failed to save cache: %v", err)
+	}
+
+	j.records = 0
+	j.reset()
+
+	return j.enqueue(&journalBatch{generation: j.generation, snapshot: data, done: done})
+}
+
+// journalRecords encodes journal records for all changes since the last save.
+func (cch *cache) journalRecords(enc *json.Encoder) (int, error) {
+	j := cch.journal
+	cnt := 0
+	defer j.reset()
+
+	write := func(r *journalRecord) error {
+		cnt++
+		return enc.Encode(r)
+	}
+
+	if j.state {
+		err := write(&journalRecord{
+			Op:         journalState,
+			NextID:     cch.NextID,
+			Cfg:        cch.Cfg,
+			PolicyName: cch.PolicyName,
+		})
+		if err != nil {
+			return 0, err
+		}
+	}
+
+	if j.policyReset {
+		if err := write(&journalRecord{Op: journalPolicyReset}); err != nil {
+			return 0, err
+		}
+	}
+
+	for key := range j.policy {
+		obj, ok := cch.policyData[key]
+		if !ok {
+			continue
+		}
+		data, err := marshalEntry(obj)
+		if err != nil {
+			return 0, cacheError("failed to marshal policy entry '%s': %v", key, err)
+		}
+		cch.PolicyJSON[key] = string(data)
+		if err := write(&journalRecord{Op: journalPolicyEntry, ID: key, Data: string(data)}); err != nil {
+			return 0, err
+		}
+	}
+
+	for id := range j.pods {
+		r := &journalRecord{Op: journalDeletePod, ID: id}
+		if p, ok := cch.Pods[id]; ok {
+			r.Op, r.Pod = journalPod, p
+		}
+		if err := write(r); err != nil {
+			return 0, err
+		}
+	}
+
+	for id := range j.containers {
+		r := &journalRecord{Op: journalDeleteContainer, ID: id}
+		if c, ok := cch.Containers[id]; ok && c.CacheID == id {
+			r.Op, r.Container = journalContainer, c
+		}
+		if err := write(r); err != nil {
+			return 0, err
+		}
+	}
+
+	return cnt, nil
+}
+
+// replayJournal replays the journal of the given generation on top of the restored snapshot.
+func (cch *cache) replayJournal(generation uint64) error {
+	path := cch.journal.path
+
+	f, err := os.Open(path)
+	switch {
+	case os.IsNotExist(err):
+		return nil
+	case err != nil:
+		return cacheError("failed to open journal %q: %v", path, err)
+	}
+	defer f.Close()
+
+	scanner := bufio.NewScanner(f)
+	scanner.Buffer(make([]byte, 64*1024), 64*1024*1024)
+
+	cnt := 0
+	for scanner.Scan() {
+		r := &journalRecord{}
+		if err := json.Unmarshal(scanner.Bytes(), r); err != nil {
+			// Most likely a partially written last record, from a crash.
+			cch.Warn("stopping replay of journal %q at corrupt record #%d: %v", path, cnt, err)
+			break
+		}
+
+		if cnt == 0 {
+			if r.Op != journalHeader {
+				return cacheError("journal %q has no header", path)
+			}
+			if r.Generation != generation {
+				cch.Info("ignoring stale journal %q (generation %d, snapshot %d)",
+					path, r.Generation, generation)
+				return nil
+			}
+		} else {
+			cch.replayRecord(r)
+		}
+		cnt++
+	}
+	if err := scanner.Err(); err != nil {
+		return cacheError("failed to read journal %q: %v", path, err)
+	}
+
+	cch.Debug("replayed %d records from journal %q", cnt, path)
+
+	return nil
+}
+
+// replayRecord replays a single journal record.
+func (cch *cache) replayRecord(r *journalRecord) {
+	switch r.Op {
+	case journalState:
+		cch.NextID = r.NextID
+		cch.Cfg = r.Cfg
+		cch.PolicyName = r.PolicyName
+
+	case journalPolicyReset:
+		cch.PolicyJSON = make(map[string]string)
+		cch.policyData = make(map[string]interface{})
+
+	case journalPolicyEntry:
+		cch.PolicyJSON[r.ID] = r.Data
+		delete(cch.policyData, r.ID)
+
+	case journalPod:
+		if p := r.Pod; p != nil {
+			p.cache = cch
+			p.containers = make(map[string]string)
+			cch.Pods[p.ID] = p
+		}
+
+	case journalDeletePod:
+		delete(cch.Pods, r.ID)
+
+	case journalContainer:
+		if c := r.Container; c != nil {
+			c.cache = cch
+			cch.Containers[c.CacheID] = c
+			if c.ID != "" {
+				cch.Containers[c.ID] = c
+			}
+		}
+
+	case journalDeleteContainer:
+		if c, ok := cch.Containers[r.ID]; ok {
+			delete(cch.Containers, c.ID)
+			delete(cch.Containers, c.CacheID)
+		}
+
+	default:
+		cch.Warn("ignoring unknown journal record %q", r.Op)
+	}
+}
@@ -0,0 +1,119 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroupstats
+
+import (
+	"github.com/intel/cri-resource-manager/pkg/cgroupstats"
+	"github.com/intel/cri-resource-manager/pkg/cri/client"
+	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/cache"
+	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/control"
+	logger "github.com/intel/cri-resource-manager/pkg/log"
+)
+
+const (
+	// CgroupStatsController is the name of the cgroup statistics controller.
+	CgroupStatsController = "cgroupstats"
+)
+
+// statsctl feeds the container lifecycle to the cgroup statistics collector.
+//
+// Without this controller the collector discovers containers by walking
+// the cgroup hierarchy on every collection. With the controller running
+// containers are registered and unregistered as they start and stop.
+type statsctl struct {
+	cache cache.Cache // resource manager cache
+}
+
+// Our logger instance.
+var log logger.Logger = logger.NewLogger(CgroupStatsController)
+
+// Our singleton cgroup statistics controller instance.
+var singleton *statsctl
+
+// getStatsController returns our singleton cgroup statistics controller instance.
+func getStatsController() *statsctl {
+	if singleton == nil {
+		singleton = &statsctl{}
+	}
+	return singleton
+}
+
+// Start initializes the controller for tracking containers.
+func (ctl *statsctl) Start(cache cache.Cache, client client.Client) error {
+	ctl.cache = cache
+
+	containers := make(map[string]string)
+	for _, c := range cache.GetContainers() {
+		if dir := ctl.cgroupDir(c); dir != "" {
+			containers[c.GetID()] = dir
+		}
+	}
+	cgroupstats.SyncContainers(containers)
+
+	log.Info("tracking cgroup statistics of %d containers", len(containers))
+
+	return nil
+}
+
+// Stop shuts down the controller.
+func (ctl *statsctl) Stop() {
+	cgroupstats.StopTracking()
+}
+
+// PreCreateHook is the cgroup statistics controller pre-create hook.
+func (ctl *statsctl) PreCreateHook(c cache.Container) error {
+	return nil
+}
+
+// PreStartHook is the cgroup statistics controller pre-start hook.
+func (ctl *statsctl) PreStartHook(c cache.Container) error {
+	return nil
+}
+
+// PostStartHook is the cgroup statistics controller post-start hook.
+func (ctl *statsctl) PostStartHook(c cache.Container) error {
+	if dir := ctl.cgroupDir(c); dir != "" {
+		cgroupstats.AddContainer(c.GetID(), dir)
+	}
+	return nil
+}
+
+// PostUpdateHook is the cgroup statistics controller post-update hook.
+func (ctl *statsctl) PostUpdateHook(c cache.Container) error {
+	return nil
+}
+
+// PostStopHook is the cgroup statistics controller post-stop hook.
+func (ctl *statsctl) PostStopHook(c cache.Container) error {
+	cgroupstats.RemoveContainer(c.GetID())
+	return nil
+}
+
+// cgroupDir returns the cgroup directory of a container we should track.
+func (ctl *statsctl) cgroupDir(c cache.Container) string {
+	if c.GetState() != cache.ContainerStateRunning {
+		return ""
+	}
+	dir := c.GetCgroupDir()
+	if dir == "" {
+		log.Warn("%q: failed to determine cgroup directory", c.PrettyName())
+	}
+	return dir
+}
+
+// init registers this controller.
+func init() {
+	control.Register(CgroupStatsController, "cgroup statistics controller", getStatsController())
+}
@@ -0,0 +1,183 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package pagemigrate
+
+import (
+	"encoding/binary"
+	"io/ioutil"
+	"os"
+	"sort"
+)
+
+const (
+	// SoftDirtyTracker considers pages not written since the last scan idle.
+	SoftDirtyTracker = "soft-dirty"
+	// IdlePageTracker considers pages not accessed since the last scan idle.
+	IdlePageTracker = "idle-page"
+	// DamonTracker considers pages in regions DAMON found unaccessed idle.
+	DamonTracker = "damon"
+
+	// idlePageBitmapPath is the kernel idle page tracking bitmap.
+	idlePageBitmapPath = "/sys/kernel/mm/page_idle/bitmap"
+)
+
+// accessTracker detects pages which have not been accessed during a tracking period.
+type accessTracker interface {
+	// name returns the name of the access tracker.
+	name() string
+	// idlePages appends the idle pages in the given ranges of a process.
+	idlePages(pid int, pagemap *os.File, ranges []addrRange, pages []page) []page
+	// restart starts a new tracking period for the given processes.
+	restart(pids []string) error
+	// stop stops access tracking.
+	stop()
+}
+
+// newAccessTracker creates an access tracker of the given kind.
+func newAccessTracker(kind string, s *pageScanner) (accessTracker, error) {
+	switch kind {
+	case SoftDirtyTracker, "":
+		return &softDirtyTracker{scanner: s}, nil
+	case IdlePageTracker:
+		return newIdlePageTracker(s)
+	case DamonTracker:
+		return newDamonTracker(s)
+	}
+	return nil, migrationError("unknown page access tracker %q", kind)
+}
+
+// softDirtyTracker tracks page accesses using the soft-dirty PTE bits.
+//
+// See https://www.kernel.org/doc/html/latest/admin-guide/mm/soft-dirty.html.
+// Notably, pages which are only read are considered idle.
+type softDirtyTracker struct {
+	scanner *pageScanner
+}
+
+func (t *softDirtyTracker) name() string {
+	return SoftDirtyTracker
+}
+
+func (t *softDirtyTracker) idlePages(pid int, pagemap *os.File, ranges []addrRange, pages []page) []page {
+	return t.scanner.scanPagemap(pid, pagemap, ranges, pages, func(addr, entry uint64) bool {
+		return entry&pagemapSoftDirtyBit == 0
+	})
+}
+
+func (t *softDirtyTracker) restart(pids []string) error {
+	var failed error
+	for _, pid := range pids {
+		// Write magic value "4" to the clear_refs file. This resets the dirty bit.
+		path := "/proc/" + pid + "/clear_refs"
+		if err := ioutil.WriteFile(path, []byte("4"), 0600); err != nil {
+			// Probably the process just died?
+			log.Error("failed to reset dirty bit for process %s: %v", pid, err)
+			if failed == nil {
+				failed = err
+			}
+		}
+	}
+	return failed
+}
+
+func (t *softDirtyTracker) stop() {
+}
+
+// idlePageTracker tracks page accesses using the kernel idle page tracking bitmap.
+//
+// See https://www.kernel.org/doc/html/latest/admin-guide/mm/idle_page_tracking.html.
+// Pages found idle, or accessed, during a scan are marked idle again for the next
+// period, so the cost of tracking is proportional to the scanned ranges.
+type idlePageTracker struct {
+	scanner *pageScanner
+	bitmap  *os.File          // idle page bitmap
+	marks   map[uint64]uint64 // bitmap words of PFNs to mark idle
+	buf     []byte            // buffer for reading and writing bitmap words
+}
+
+func newIdlePageTracker(s *pageScanner) (*idlePageTracker, error) {
+	bitmap, err := os.OpenFile(idlePageBitmapPath, os.O_RDWR, 0)
+	if err != nil {
+		return nil, migrationError("failed to open idle page bitmap: %v", err)
+	}
+	return &idlePageTracker{
+		scanner: s,
+		bitmap:  bitmap,
+		marks:   make(map[uint64]uint64),
+		buf:     make([]byte, 8),
+	}, nil
+}
+
+func (t *idlePageTracker) name() string {
+	return IdlePageTracker
+}
+
+func (t *idlePageTracker) idlePages(pid int, pagemap *os.File, ranges []addrRange, pages []page) []page {
+	word, bits := ^uint64(0), uint64(0)
+
+	pages = t.scanner.scanPagemap(pid, pagemap, ranges, pages, func(addr, entry uint64) bool {
+		pfn := entry & pagemapPFNMask
+		if pfn == 0 {
+			// no PFNs without CAP_SYS_ADMIN
+			return false
+		}
+		t.marks[pfn/64] |= 1 << (pfn % 64)
+
+		// consecutive pages are often backed by consecutive PFNs, cache the last word
+		if pfn/64 != word {
+			word = pfn / 64
+			if _, err := t.bitmap.ReadAt(t.buf, int64(word*8)); err != nil {
+				word, bits = ^uint64(0), 0
+				return false
+			}
+			bits = binary.LittleEndian.Uint64(t.buf)
+		}
+		return bits&(1<<(pfn%64)) != 0
+	})
+
+	t.markIdle()
+
+	return pages
+}
+
+// markIdle marks all PFNs we have seen idle, starting a new tracking period for them.
+func (t *idlePageTracker) markIdle() {
+	words := make([]uint64, 0, len(t.marks))
+	for word := range t.marks {
+		words = append(words, word)
+	}
+	sort.Slice(words, func(i, j int) bool { return words[i] < words[j] })
+
+	for _, word := range words {
+		binary.LittleEndian.PutUint64(t.buf, t.marks[word])
+		if _, err := t.bitmap.WriteAt(t.buf, int64(word*8)); err != nil {
+			log.Error("failed to mark pages idle: %v", err)
+			break
+		}
+	}
+
+	for word := range t.marks {
+		delete(t.marks, word)
+	}
+}
+
+func (t *idlePageTracker) restart(pids []string) error {
+	// pages are marked idle when they are scanned
+	return nil
+}
+
+func (t *idlePageTracker) stop() {
+	t.bitmap.Close()
+}
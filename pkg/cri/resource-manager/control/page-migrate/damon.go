@@ -0,0 +1,340 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package pagemigrate
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+	"time"
+)
+
+const (
+	// damonAdminPath is the root of the DAMON sysfs interface.
+	damonAdminPath = "/sys/kernel/mm/damon/admin"
+	// damonSampleInterval is the DAMON access sampling interval.
+	damonSampleInterval = 5 * time.Millisecond
+	// damonUpdateInterval is the DAMON target regions update interval.
+	damonUpdateInterval = time.Second
+	// default DAMON aggregation interval, if we have no page scan interval
+	damonDefaultAggrInterval = 100 * time.Millisecond
+)
+
+// damonMaxValue is ULONG_MAX, used as an unlimited access pattern bound.
+var damonMaxValue = strconv.FormatUint(uint64(^uint(0)), 10)
+
+// damonTracker tracks page accesses using DAMON.
+//
+// See https://www.kernel.org/doc/html/latest/admin-guide/mm/damon/usage.html.
+// We run a kdamond per process, with a single 'stat' scheme matching regions
+// without any accesses during an aggregation interval. The regions the scheme
+// was tried on are then used to find idle pages. The DAMON per-context target
+// limitation and the lack of target info for tried regions is why we need a
+// kdamond per process. Kdamonds are started and stopped as processes come
+// and go. Since the number of kdamonds can only be changed with all of them
+// stopped, all kdamonds are restarted only when we run out of stopped ones.
+type damonTracker struct {
+	scanner  *pageScanner
+	root     string              // DAMON sysfs admin directory
+	nr       int                 // number of kdamonds we have set up
+	kdamonds map[string]int      // kdamond index by pid
+	failed   map[string]struct{} // pids we failed to start a kdamond for
+	aggr     time.Duration       // aggregation interval
+	regions  []addrRange         // reused buffer for idle regions
+}
+
+func newDamonTracker(s *pageScanner) (*damonTracker, error) {
+	if _, err := os.Stat(filepath.Join(damonAdminPath, "kdamonds", "nr_kdamonds")); err != nil {
+		return nil, migrationError("DAMON sysfs interface not available: %v", err)
+	}
+
+	aggr := time.Duration(opt.PageScanInterval)
+	if aggr <= 0 {
+		aggr = damonDefaultAggrInterval
+	}
+
+	return &damonTracker{
+		scanner:  s,
+		root:     damonAdminPath,
+		kdamonds: make(map[string]int),
+		failed:   make(map[string]struct{}),
+		aggr:     aggr,
+	}, nil
+}
+
+func (t *damonTracker) name() string {
+	return DamonTracker
+}
+
+func (t *damonTracker) idlePages(pid int, pagemap *os.File, ranges []addrRange, pages []page) []page {
+	idx, ok := t.kdamonds[strconv.Itoa(pid)]
+	if !ok {
+		return pages
+	}
+
+	regions, err := t.idleRegions(idx)
+	if err != nil {
+		log.Error("failed to get DAMON idle regions of process %d: %v", pid, err)
+		return pages
+	}
+
+	return t.scanner.scanPagemap(pid, pagemap, clipRanges(ranges, regions, t.scanner.pageSize), pages,
+		func(addr, entry uint64) bool {
+			return true
+		})
+}
+
+// idleRegions returns the regions with no accesses found by a kdamond.
+func (t *damonTracker) idleRegions(idx int) ([]addrRange, error) {
+	kdamond := t.kdamondPath(idx)
+	if err := t.write(filepath.Join(kdamond, "state"), "update_schemes_tried_regions"); err != nil {
+		return nil, err
+	}
+
+	dir := filepath.Join(kdamond, "contexts", "0", "schemes", "0", "tried_regions")
+	entries, err := ioutil.ReadDir(dir)
+	if err != nil {
+		return nil, err
+	}
+
+	t.regions = t.regions[:0]
+	for _, e := range entries {
+		if !e.IsDir() {
+			continue
+		}
+		start, err := t.readUint(filepath.Join(dir, e.Name(), "start"))
+		if err != nil {
+			return nil, err
+		}
+		end, err := t.readUint(filepath.Join(dir, e.Name(), "end"))
+		if err != nil {
+			return nil, err
+		}
+		// we abuse addrRange.length for the end of the region here
+		t.regions = append(t.regions, addrRange{addr: start, length: end})
+	}
+	sort.Slice(t.regions, func(i, j int) bool { return t.regions[i].addr < t.regions[j].addr })
+
+	return t.regions, nil
+}
+
+// clipRanges returns the parts of sorted page ranges within sorted [start, end) regions.
+func clipRanges(ranges, regions []addrRange, pageSize uint64) []addrRange {
+	var clipped []addrRange
+
+	sorted := make([]addrRange, len(ranges))
+	copy(sorted, ranges)
+	sort.Slice(sorted, func(i, j int) bool { return sorted[i].addr < sorted[j].addr })
+
+	j := 0
+	for _, r := range sorted {
+		rStart, rEnd := r.addr, r.addr+r.length*pageSize
+		for j < len(regions) && regions[j].length <= rStart {
+			j++
+		}
+		for k := j; k < len(regions) && regions[k].addr < rEnd; k++ {
+			start, end := regions[k].addr, regions[k].length
+			if start < rStart {
+				start = rStart
+			}
+			if end > rEnd {
+				end = rEnd
+			}
+			// DAMON regions are page aligned
+			if end > start {
+				clipped = append(clipped, addrRange{addr: start, length: (end - start) / pageSize})
+			}
+		}
+	}
+
+	return clipped
+}
+
+func (t *damonTracker) restart(pids []string) error {
+	wanted := make(map[string]struct{}, len(pids))
+	for _, pid := range pids {
+		wanted[pid] = struct{}{}
+	}
+
+	// stop kdamonds of processes gone, forget the ones which stopped on their own
+	for pid, idx := range t.kdamonds {
+		if _, ok := wanted[pid]; !ok {
+			t.stopKdamond(pid, idx)
+			delete(t.kdamonds, pid)
+			continue
+		}
+		if t.readString(filepath.Join(t.kdamondPath(idx), "state")) != "on" {
+			delete(t.kdamonds, pid)
+		}
+	}
+	for pid := range t.failed {
+		if _, ok := wanted[pid]; !ok {
+			delete(t.failed, pid)
+		}
+	}
+
+	added := []string{}
+	for _, pid := range pids {
+		_, running := t.kdamonds[pid]
+		_, failed := t.failed[pid]
+		if !running && !failed {
+			added = append(added, pid)
+		}
+	}
+	if len(added) == 0 {
+		return nil
+	}
+
+	free := t.freeKdamonds()
+	if len(added) > len(free) {
+		// nr_kdamonds can only be changed with all kdamonds stopped, and
+		// changing it resets all of them, so grow with some headroom.
+		nr := 2 * t.nr
+		if need := len(t.kdamonds) + len(added); nr < need {
+			nr = need
+		}
+		for pid, idx := range t.kdamonds {
+			t.stopKdamond(pid, idx)
+			delete(t.kdamonds, pid)
+			added = append(added, pid)
+		}
+		path := filepath.Join(t.root, "kdamonds", "nr_kdamonds")
+		if err := t.write(path, strconv.Itoa(nr)); err != nil {
+			return migrationError("failed to set up DAMON: %v", err)
+		}
+		t.nr = nr
+		free = t.freeKdamonds()
+	}
+
+	sort.Strings(added)
+	for i, pid := range added {
+		idx := free[i]
+		if err := t.setup(idx, pid); err != nil {
+			log.Error("failed to set up DAMON for process %s: %v", pid, err)
+			t.failed[pid] = struct{}{}
+			continue
+		}
+		if err := t.write(filepath.Join(t.kdamondPath(idx), "state"), "on"); err != nil {
+			// Probably the process just died?
+			log.Error("failed to start DAMON for process %s: %v", pid, err)
+			t.failed[pid] = struct{}{}
+			continue
+		}
+		t.kdamonds[pid] = idx
+	}
+
+	return nil
+}
+
+// freeKdamonds returns the indices of kdamonds not tracking any process.
+func (t *damonTracker) freeKdamonds() []int {
+	used := make(map[int]struct{}, len(t.kdamonds))
+	for _, idx := range t.kdamonds {
+		used[idx] = struct{}{}
+	}
+	free := []int{}
+	for idx := 0; idx < t.nr; idx++ {
+		if _, ok := used[idx]; !ok {
+			free = append(free, idx)
+		}
+	}
+	return free
+}
+
+// setup configures a kdamond to track idle regions of a process.
+func (t *damonTracker) setup(idx int, pid string) error {
+	ctx := filepath.Join(t.kdamondPath(idx), "contexts")
+	scheme := filepath.Join(ctx, "0", "schemes", "0")
+	pattern := filepath.Join(scheme, "access_pattern")
+	attrs := filepath.Join(ctx, "0", "monitoring_attrs", "intervals")
+	us := func(d time.Duration) string {
+		return strconv.FormatInt(d.Microseconds(), 10)
+	}
+
+	// access pattern ranges default to [0, 0], so we set all bounds
+	for _, w := range []struct {
+		path  string
+		value string
+	}{
+		{filepath.Join(ctx, "nr_contexts"), "1"},
+		{filepath.Join(ctx, "0", "operations"), "vaddr"},
+		{filepath.Join(attrs, "sample_us"), us(damonSampleInterval)},
+		{filepath.Join(attrs, "aggr_us"), us(t.aggr)},
+		{filepath.Join(attrs, "update_us"), us(damonUpdateInterval)},
+		{filepath.Join(ctx, "0", "targets", "nr_targets"), "1"},
+		{filepath.Join(ctx, "0", "targets", "0", "pid_target"), pid},
+		{filepath.Join(ctx, "0", "schemes", "nr_schemes"), "1"},
+		{filepath.Join(scheme, "action"), "stat"},
+		{filepath.Join(pattern, "sz", "min"), "0"},
+		{filepath.Join(pattern, "sz", "max"), damonMaxValue},
+		{filepath.Join(pattern, "nr_accesses", "min"), "0"},
+		{filepath.Join(pattern, "nr_accesses", "max"), "0"},
+		{filepath.Join(pattern, "age", "min"), "1"},
+		{filepath.Join(pattern, "age", "max"), damonMaxValue},
+	} {
+		if err := t.write(w.path, w.value); err != nil {
+			return err
+		}
+	}
+
+	return nil
+}
+
+func (t *damonTracker) stop() {
+	for pid, idx := range t.kdamonds {
+		t.stopKdamond(pid, idx)
+		delete(t.kdamonds, pid)
+	}
+	for pid := range t.failed {
+		delete(t.failed, pid)
+	}
+}
+
+// stopKdamond stops the kdamond tracking a process.
+func (t *damonTracker) stopKdamond(pid string, idx int) {
+	state := filepath.Join(t.kdamondPath(idx), "state")
+	if t.readString(state) == "on" {
+		if err := t.write(state, "off"); err != nil {
+			log.Error("failed to stop DAMON for process %s: %v", pid, err)
+		}
+	}
+}
+
+func (t *damonTracker) kdamondPath(idx int) string {
+	return filepath.Join(t.root, "kdamonds", strconv.Itoa(idx))
+}
+
+func (t *damonTracker) write(path, value string) error {
+	return ioutil.WriteFile(path, []byte(value), 0644)
+}
+
+func (t *damonTracker) readString(path string) string {
+	data, err := ioutil.ReadFile(path)
+	if err != nil {
+		return ""
+	}
+	return strings.TrimSpace(string(data))
+}
+
+func (t *damonTracker) readUint(path string) (uint64, error) {
+	data, err := ioutil.ReadFile(path)
+	if err != nil {
+		return 0, err
+	}
+	return strconv.ParseUint(strings.TrimSpace(string(data)), 10, 64)
+}
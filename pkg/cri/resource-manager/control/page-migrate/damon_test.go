@@ -0,0 +1,209 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package pagemigrate
+
+import (
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+func TestClipRanges(t *testing.T) {
+	const pageSize = 4096
+
+	tcases := []struct {
+		name     string
+		ranges   []addrRange
+		regions  []addrRange // {start, end}
+		expected []addrRange
+	}{
+		{
+			name:    "no idle regions",
+			ranges:  []addrRange{{0x10000, 16}},
+			regions: nil,
+		},
+		{
+			name:     "region covers range",
+			ranges:   []addrRange{{0x10000, 16}},
+			regions:  []addrRange{{0x0, 0x100000}},
+			expected: []addrRange{{0x10000, 16}},
+		},
+		{
+			name:     "regions within and overlapping ranges",
+			ranges:   []addrRange{{0x40000, 16}, {0x10000, 16}},
+			regions:  []addrRange{{0x8000, 0x12000}, {0x14000, 0x15000}, {0x4f000, 0x60000}},
+			expected: []addrRange{{0x10000, 2}, {0x14000, 1}, {0x4f000, 1}},
+		},
+		{
+			name:    "regions between ranges",
+			ranges:  []addrRange{{0x10000, 16}, {0x40000, 16}},
+			regions: []addrRange{{0x20000, 0x40000}},
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			clipped := clipRanges(tc.ranges, tc.regions, pageSize)
+			if fmt.Sprintf("%v", clipped) != fmt.Sprintf("%v", tc.expected) {
+				t.Errorf("expected ranges %x, got %x", tc.expected, clipped)
+			}
+		})
+	}
+}
+
+// newFakeDamon creates a DAMON sysfs admin tree with nr kdamonds.
+func newFakeDamon(t *testing.T, nr int) *damonTracker {
+	root, err := ioutil.TempDir("", "damon-test-")
+	if err != nil {
+		t.Fatalf("failed to create tmpdir: %v", err)
+	}
+	for idx := 0; idx < nr; idx++ {
+		ctx := filepath.Join(root, "kdamonds", fmt.Sprintf("%d", idx), "contexts", "0")
+		for _, dir := range []string{
+			filepath.Join("monitoring_attrs", "intervals"),
+			filepath.Join("targets", "0"),
+			filepath.Join("schemes", "0", "access_pattern", "sz"),
+			filepath.Join("schemes", "0", "access_pattern", "nr_accesses"),
+			filepath.Join("schemes", "0", "access_pattern", "age"),
+		} {
+			if err := os.MkdirAll(filepath.Join(ctx, dir), 0755); err != nil {
+				t.Fatalf("failed to create fake DAMON sysfs: %v", err)
+			}
+		}
+	}
+	return &damonTracker{
+		root:     root,
+		kdamonds: make(map[string]int),
+		failed:   make(map[string]struct{}),
+		aggr:     damonDefaultAggrInterval,
+	}
+}
+
+func TestDamonSetup(t *testing.T) {
+	d := newFakeDamon(t, 1)
+	defer os.RemoveAll(d.root)
+
+	if err := d.setup(0, "1234"); err != nil {
+		t.Fatalf("failed to set up DAMON: %v", err)
+	}
+
+	ctx := filepath.Join(d.kdamondPath(0), "contexts", "0")
+	pattern := filepath.Join(ctx, "schemes", "0", "access_pattern")
+	expected := map[string]string{
+		filepath.Join(ctx, "operations"):                               "vaddr",
+		filepath.Join(ctx, "monitoring_attrs", "intervals", "aggr_us"): fmt.Sprintf("%d", damonDefaultAggrInterval/time.Microsecond),
+		filepath.Join(ctx, "targets", "0", "pid_target"):               "1234",
+		filepath.Join(ctx, "schemes", "0", "action"):                   "stat",
+		filepath.Join(pattern, "sz", "min"):                            "0",
+		filepath.Join(pattern, "sz", "max"):                            damonMaxValue,
+		filepath.Join(pattern, "nr_accesses", "min"):                   "0",
+		filepath.Join(pattern, "nr_accesses", "max"):                   "0",
+		filepath.Join(pattern, "age", "min"):                           "1",
+		filepath.Join(pattern, "age", "max"):                           damonMaxValue,
+	}
+	for path, value := range expected {
+		if written := d.readString(path); written != value {
+			t.Errorf("expected %s to be %q, got %q", path, value, written)
+		}
+	}
+}
+
+func TestDamonRestart(t *testing.T) {
+	const nr = 4
+	d := newFakeDamon(t, nr)
+	defer os.RemoveAll(d.root)
+
+	// mark marks all kdamonds to detect which ones get set up again
+	operations := func(idx int) string {
+		return filepath.Join(d.kdamondPath(idx), "contexts", "0", "operations")
+	}
+	mark := func() {
+		for idx := 0; idx < nr; idx++ {
+			d.write(operations(idx), "untouched")
+		}
+	}
+
+	tcases := []struct {
+		name     string
+		pids     []string
+		nr       int
+		expected map[string]int
+		touched  []int
+	}{
+		{
+			name:     "start kdamonds",
+			pids:     []string{"1", "2"},
+			nr:       2,
+			expected: map[string]int{"1": 0, "2": 1},
+			touched:  []int{0, 1},
+		},
+		{
+			name:     "unchanged processes",
+			pids:     []string{"2", "1"},
+			nr:       2,
+			expected: map[string]int{"1": 0, "2": 1},
+		},
+		{
+			name:     "replace a process",
+			pids:     []string{"1", "3"},
+			nr:       2,
+			expected: map[string]int{"1": 0, "3": 1},
+			touched:  []int{1},
+		},
+		{
+			name:     "grow kdamonds",
+			pids:     []string{"1", "3", "4"},
+			nr:       4,
+			expected: map[string]int{"1": 0, "3": 1, "4": 2},
+			touched:  []int{0, 1, 2},
+		},
+		{
+			name:     "drop a process",
+			pids:     []string{"1", "4"},
+			nr:       4,
+			expected: map[string]int{"1": 0, "4": 2},
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			mark()
+			if err := d.restart(tc.pids); err != nil {
+				t.Fatalf("failed to restart DAMON: %v", err)
+			}
+			if d.nr != tc.nr {
+				t.Errorf("expected %d kdamonds, got %d", tc.nr, d.nr)
+			}
+			if fmt.Sprintf("%v", d.kdamonds) != fmt.Sprintf("%v", tc.expected) {
+				t.Errorf("expected kdamonds %v, got %v", tc.expected, d.kdamonds)
+			}
+			touched := []int{}
+			for idx := 0; idx < nr; idx++ {
+				if d.readString(operations(idx)) != "untouched" {
+					touched = append(touched, idx)
+				}
+			}
+			if fmt.Sprintf("%v", touched) != fmt.Sprintf("%v", tc.touched) {
+				t.Errorf("expected kdamonds %v to be set up, got %v", tc.touched, touched)
+			}
+			for pid, idx := range d.kdamonds {
+				if state := d.readString(filepath.Join(d.kdamondPath(idx), "state")); state != "on" {
+					t.Errorf("kdamond %d of process %s is %q", idx, pid, state)
+				}
+			}
+		})
+	}
+}
@@ -15,14 +15,9 @@
 package pagemigrate
 
 import (
-	"encoding/binary"
-	"fmt"
-	"io"
-	"io/ioutil"
-	"math/rand"
+	"container/heap"
 	"os"
 	"strconv"
-	"strings"
 	"time"
 
 	"github.com/intel/cri-resource-manager/pkg/cgroups"
@@ -43,13 +38,19 @@ import (
 //
 // How to figure out which pages are not part of the working set:
 //
-// 1. Clear soft-dirty bits on the PTEs:
+// 1. Start a new access tracking period for the processes, for instance by
+//    clearing soft-dirty bits on the PTEs:
 //    https://www.kernel.org/doc/html/latest/admin-guide/mm/soft-dirty.html
 // 2. Wait for a while.
 // 3. Read out the process page maps:
 //    https://www.kernel.org/doc/html/latest/admin-guide/mm/pagemap.html The pages
-//    which don't have the soft-dirty bit are considered to be outside of the
+//    which the access tracker considers idle (for soft-dirty tracking, the pages
+//    which don't have the soft-dirty bit) are considered to be outside of the
 //    working set.
+//
+// The access tracker is configurable. Besides soft-dirty bits, which miss pages
+// which are only read, the kernel idle page tracking bitmap and DAMON can be used.
+// See access-tracker.go and damon.go for details.
 
 type page struct {
 	pid  int
@@ -69,11 +70,17 @@ type demoter struct {
 	dirtyBitStop  chan interface{} // Channel for stopping the ticker.
 
 	// Moving pages
+	pageScanner       *pageScanner
+	accessTracker     accessTracker
 	pageMover         PageMover
+	movePipeline      *movePipeline
 	containerDemoters map[string]chan interface{} // Channel for sending pagemap updates to demoters.
 	pageScanInterval  config.Duration             // How often should we scan pages.
 	pageMoveInterval  config.Duration             // How often should we move pages for a container.
 	maxPageMoveCount  uint                        // How many pages to move at once.
+	accessTrackerKind string                      // Kind of access tracker to use.
+	pageMoveWorkers   uint                        // Number of workers for moving pages.
+	pageMoveBandwidth uint64                      // Max. bytes/second to move to a node.
 }
 
 type pagePool struct {
@@ -102,14 +109,18 @@ func newDemoter(m *migration) *demoter {
 	return &demoter{
 		migration:         m,
 		containerDemoters: make(map[string]chan interface{}, 0),
+		pageScanner:       newPageScanner(),
 		pageMover:         &linuxPageMover{},
 	}
 }
 
 func (d *demoter) start() {
 	if d.pageScanInterval > 0 && d.pageMoveInterval > 0 && d.maxPageMoveCount > 0 {
-		log.Info("scanning pages every %s, moving max. %d pages every %s",
-			d.pageScanInterval.String(), d.maxPageMoveCount, d.pageMoveInterval.String())
+		d.startAccessTracker()
+		d.startMovePipeline()
+		log.Info("scanning pages every %s using %s tracking, moving max. %d pages every %s",
+			d.pageScanInterval.String(), d.accessTracker.name(),
+			d.maxPageMoveCount, d.pageMoveInterval.String())
 		d.startDirtyBitResetTimer()
 	} else {
 		log.Info("scanning pages is disabled")
@@ -122,17 +133,69 @@ func (d *demoter) Stop() {
 	d.migration.Lock()
 	defer d.migration.Unlock()
 	d.stopDemoters()
+	d.stopAccessTracker()
+	d.stopMovePipeline()
+}
+
+// startAccessTracker creates our access tracker, falling back to soft-dirty bits on errors.
+func (d *demoter) startAccessTracker() {
+	d.migration.Lock()
+	defer d.migration.Unlock()
+
+	if d.accessTracker != nil {
+		return
+	}
+
+	t, err := newAccessTracker(d.accessTrackerKind, d.pageScanner)
+	if err != nil {
+		log.Error("failed to set up %q page access tracking, falling back to %q: %v",
+			d.accessTrackerKind, SoftDirtyTracker, err)
+		t, _ = newAccessTracker(SoftDirtyTracker, d.pageScanner)
+	}
+	d.accessTracker = t
+}
+
+// startMovePipeline creates our page move pipeline.
+func (d *demoter) startMovePipeline() {
+	d.migration.Lock()
+	defer d.migration.Unlock()
+
+	if d.movePipeline == nil {
+		d.movePipeline = newMovePipeline(d.pageMover, d.pageMoveWorkers, d.pageMoveBandwidth)
+	}
+}
+
+// stopMovePipeline stops our page move pipeline. Demoters must be stopped already.
+func (d *demoter) stopMovePipeline() {
+	if d.movePipeline != nil {
+		d.movePipeline.stop()
+		d.movePipeline = nil
+	}
+}
+
+// stopAccessTracker stops and releases our access tracker.
+func (d *demoter) stopAccessTracker() {
+	if d.accessTracker != nil {
+		d.accessTracker.stop()
+		d.accessTracker = nil
+	}
 }
 
 // Reconfigure restarts, if necessary, page scanning and demotion with new options.
 func (d *demoter) Reconfigure() {
 	if d.pageScanInterval != opt.PageScanInterval ||
 		d.pageMoveInterval != opt.PageMoveInterval ||
-		d.maxPageMoveCount != opt.MaxPageMoveCount {
+		d.maxPageMoveCount != opt.MaxPageMoveCount ||
+		d.accessTrackerKind != opt.AccessTracker ||
+		d.pageMoveWorkers != opt.PageMoveWorkers ||
+		d.pageMoveBandwidth != opt.PageMoveBandwidth {
 		d.Stop()
 		d.pageScanInterval = opt.PageScanInterval
 		d.pageMoveInterval = opt.PageMoveInterval
 		d.maxPageMoveCount = opt.MaxPageMoveCount
+		d.accessTrackerKind = opt.AccessTracker
+		d.pageMoveWorkers = opt.PageMoveWorkers
+		d.pageMoveBandwidth = opt.PageMoveBandwidth
 	}
 	d.start()
 }
@@ -240,38 +303,16 @@ func (d *demoter) startDirtyBitResetTimer() {
 	d.dirtyBitStop = stop
 }
 
-func resetDirtyBit(pid string) error {
-	// Write magic value "4" to the clear_refs file. This resets the dirty bit.
-	path := "/proc/" + pid + "/clear_refs"
-	err := ioutil.WriteFile(path, []byte("4"), 0600)
-	return err
-}
-
-// resetDirtyBit unsets soft-dirty bits for all processes in a container.
-func (d *demoter) resetDirtyBit(c *container) error {
-	group := cgroups.Memory.Group(c.cgroupDir)
-
-	pids, err := group.GetProcesses()
-	if err != nil {
-		return err
-	}
-
-	for _, pid := range pids {
-		err = resetDirtyBit(pid)
-		if err != nil {
-			log.Error("%s: failed to reset dirty but for process %s: %v",
-				c.prettyName, pid, err)
-			return err
-		}
-	}
-	return nil
-}
-
 // scanPages scans pages of tracked containers to detect idle ones.
 func (d *demoter) scanPages() {
 	d.migration.Lock()
 	defer d.migration.Unlock()
 
+	if d.accessTracker == nil {
+		return
+	}
+
+	var pids []string
 	for _, container := range d.migration.containers {
 		pm := container.GetPageMigration()
 		if pm == nil {
@@ -284,7 +325,8 @@ func (d *demoter) scanPages() {
 		}
 
 		// Gather the known pages which need to be moved.
-		pagePool, err := d.getPagesForContainer(container, dramNodes)
+		pagePool, containerPids, err := d.getPagesForContainer(container, dramNodes)
+		pids = append(pids, containerPids...)
 		if err != nil {
 			log.Error("failed to get pages for container %v", container.prettyName)
 			continue
@@ -296,17 +338,20 @@ func (d *demoter) scanPages() {
 		}
 		log.Debug("%d pages for (maybe) demoting for %v", count, container.prettyName)
 
-		// Reset the dirty bit from all pages.
-		d.resetDirtyBit(container)
-
 		// Give the pages to the page moving goroutine. Copy the page pool so that there's no race.
 		d.updateDemoter(container.GetCacheID(), copyPagePool(pagePool), pmemNodes.Clone())
 	}
 
+	// Start a new access tracking period for all processes we scanned.
+	if err := d.accessTracker.restart(pids); err != nil {
+		log.Error("failed to restart %s page access tracking: %v", d.accessTracker.name(), err)
+	}
+
 	d.stopUnusedDemoters(d.migration.containers)
 }
 
-func (d *demoter) getPagesForContainer(c *container, sourceNodes system.IDSet) (pagePool, error) {
+// getPagesForContainer returns the idle pages and the processes of a container.
+func (d *demoter) getPagesForContainer(c *container, sourceNodes system.IDSet) (pagePool, []string, error) {
 	pool := pagePool{
 		pages:        make(map[int][]page, 0),
 		longestRange: 0,
@@ -315,253 +360,110 @@ func (d *demoter) getPagesForContainer(c *container, sourceNodes system.IDSet) (
 	group := cgroups.Memory.Group(c.cgroupDir)
 	pids, err := group.GetProcesses()
 	if err != nil {
-		return pagePool{}, err
+		return pagePool{}, nil, err
 	}
 
+	var addressRanges []addrRange
 	for _, pid := range pids {
-		addressRanges := make([]addrRange, 0)
 		pidNumber64, err := strconv.ParseInt(pid, 10, 32)
 		if err != nil {
 			log.Error("Failed to parse addr to int: %v", err)
 			continue
 		}
 		pidNumber := int(pidNumber64)
-		// Read /proc/pid/numa_maps and /proc/pid/maps
-		numaMapsPath := "/proc/" + pid + "/numa_maps"
-		numaMapsBytes, err := ioutil.ReadFile(numaMapsPath)
+
+		// Read /proc/pid/numa_maps and /proc/pid/maps for interesting page ranges.
+		addressRanges, err = d.pageScanner.heapRanges(pid, sourceNodes, addressRanges[:0])
 		if err != nil {
-			log.Error("Could not read numa_maps: %v", err)
+			log.Error("Could not read memory maps of process %s: %v", pid, err)
 			continue
 		}
-		mapsPath := "/proc/" + pid + "/maps"
-		mapsBytes, err := ioutil.ReadFile(mapsPath)
-		if err != nil {
-			log.Error("Could not read maps: %v\n", err)
-			os.Exit(1)
-		}
-		mapsLines := strings.Split(string(mapsBytes), "\n")
-
-		for _, line := range strings.Split(string(numaMapsBytes), "\n") {
-			tokens := strings.Split(line, " ")
-			if len(tokens) < 3 {
-				continue
-			}
-			attrs := strings.Join(tokens[2:], " ")
-			// Filter out lines which don't have "anonymous", since we are not
-			// interested in file-mapped or shared pages. Save the interesting ranges.
-			// TODO: consider dropping the "heap" requirement. There are often ranges
-			// in the file which don't have any attributes indicating the memory
-			// location.
-			if !strings.Contains(attrs, "heap") || !strings.Contains(attrs, "anon=") {
-				continue
-			}
-			// We only find out if *any* pages in the range are in a DRAM node. The
-			// more fine-grained analysis is done later by running the move_pages()
-			// system call twice.
-			locatedOnDRAMNode := false
-			for node := range sourceNodes {
-				number := strconv.FormatInt(int64(node), 10)
-				str := "N" + number + "="
-				if strings.Contains(attrs, str) {
-					locatedOnDRAMNode = true
-					break
-				}
-			}
-			if !locatedOnDRAMNode {
-				continue
-			}
-
-			for _, mapLine := range mapsLines {
-				if strings.HasPrefix(mapLine, tokens[0]+"-") {
-					spaceIndex := strings.Index(mapLine, " ")
-					if spaceIndex > len(tokens[0]+"-") {
-						endAddrStr := mapLine[len(tokens[0]+"-"):spaceIndex]
-						startAddr, err := strconv.ParseInt(tokens[0], 16, 64)
-						if err != nil {
-							log.Error("Failed to parse addr to int: %v\n", err)
-							break
-						}
-						endAddr, err := strconv.ParseInt(endAddrStr, 16, 64)
-						if err != nil {
-							log.Error("Failed to parse addr to int: %v\n", err)
-							break
-						}
-						rangeLength := endAddr - startAddr
-						addressRanges = append(addressRanges, addrRange{uint64(startAddr), uint64(rangeLength / int64(os.Getpagesize()))})
-						// log.Debug("found interesting page range for pid %s: %v", pid, addressRanges[len(addressRanges)-1])
-						break
-					}
-				}
-			}
-		}
 
 		// Read /proc/pid/pagemap and process only interesting page ranges. For
-		// every read-only page and for every page with the soft-dirty bit on, mark
-		// them as candidates to be moved by adding them to pagePool.
+		// every page the access tracker considers idle, mark them as candidates
+		// to be moved by adding them to pagePool.
 
 		if len(addressRanges) > 0 {
-			// log.Debug("Getting pages for PID %s for ranges %v", pid, addressRanges)
-			pages := make([]page, 0)
 			path := "/proc/" + pid + "/pagemap"
 			pageMap, err := os.OpenFile(path, os.O_RDONLY, 0)
 			if err != nil {
 				// Probably the process just died?
-				fmt.Printf("Could not read pagemaps: %v\n", err)
-				break
-			}
-			for _, addressRange := range addressRanges {
-				idx := int64(addressRange.addr / uint64(os.Getpagesize()) * 8)
-				offset, err := pageMap.Seek(idx, io.SeekStart)
-				if err != nil {
-					// Maybe there was a race condition and the maps changed?
-					log.Error("Failed to seek: %v\n", err)
-					continue
-				}
-				for i := uint64(0); i < addressRange.length; i++ {
-					bytes := make([]byte, 8)
-					// Read exactly 8 bytes (because the file interface breaks otherwise).
-					_, err = io.ReadAtLeast(pageMap, bytes, 8)
-					if err != nil {
-						// Possibly the maps changed.
-						log.Error("Could not read data from pagemaps(%v)(page size: %d, seek offset: %d): %v\n", idx, os.Getpagesize(), offset, err)
-						break
-					}
-					data := binary.LittleEndian.Uint64(bytes)
-
-					// Check that the page is present (not swapped), exclusively
-					// mapped (not used by any other process), and it has the
-					// soft-dirty bit off.
-
-					// Note: there appears to be no way to see from the pagemap entry what the NUMA node is.
-					// We could map this back to the physical address ranges if needed. Currently this is handled
-					// in movePages() by calling move_pages() first with an empty node array.
-
-					softDirtyBit := uint64(0x1) << 55
-					exclusiveBit := uint64(0x1) << 56
-					presentBit := uint64(0x1) << 63
-					present := (data&presentBit == presentBit)
-					exclusive := (data&exclusiveBit == exclusiveBit)
-					softDirty := (data&softDirtyBit == softDirtyBit)
-
-					if present && exclusive && !softDirty {
-						// log.Debug("page a candidate for moving: 0x%08x", addressRange.addr+i*uint64(os.Getpagesize()))
-						pages = append(pages, page{addr: addressRange.addr + i*uint64(os.Getpagesize()), pid: pidNumber})
-					}
-				}
-			}
-			if _, found := pool.pages[pidNumber]; found {
-				pool.pages[pidNumber] = append(pool.pages[pidNumber], pages...)
-			} else {
-				pool.pages[pidNumber] = pages
+				log.Error("Could not read pagemaps: %v", err)
+				continue
 			}
+			pool.pages[pidNumber] = d.accessTracker.idlePages(pidNumber, pageMap, addressRanges, pool.pages[pidNumber])
+			pageMap.Close()
+
 			if uint(len(addressRanges)) > pool.longestRange {
 				pool.longestRange = uint(len(addressRanges))
 			}
 		}
 	}
 
-	return pool, nil
-}
-
-func pickClosestPMEMNode(currentNode system.ID, targetNodes system.IDSet) system.ID {
-	// TODO: analyze the topology information (and possibly the amount of free memory) and choose the "best"
-	// PMEM node to demote the page to. The array targetNodes already contains only the subset of PMEM nodes
-	// available in this topology subtree. Right now just pick a random controller.
-	nodes := targetNodes.Members()
-	return nodes[rand.Intn(len(nodes))]
+	return pool, pids, nil
 }
 
-func (d *demoter) movePagesForPid(p []page, count uint, pid int, targetNodes system.IDSet) (uint, error) {
-	// We move at max count pages, but there might not be that much.
-	nPages := count
-	if uint(len(p)) < count {
-		nPages = uint(len(p))
-	}
-
-	// Gather memory page pointers.
-	pages := make([]uintptr, nPages)
-	var i uint
-	for i = 0; i < nPages; i++ {
-		pages[i] = uintptr(p[i].addr)
-	}
-
-	// MPOL_MF_MOVE - only move pages exclusive to this process. There will be
-	// permission denied errors for pages which couldn't be moved. FIXME: find
-	// out if the whole move_pages() syscall failed or if just the non-exclusive
-	// pages were not moved.
-	flags := 1 << 1
-
-	// Call move_pages() first with nil nodes array to find out the current controllers.
-	_, currentStatus, err := d.pageMover.MovePagesSyscall(pid, nPages, pages, nil, flags)
-	if err != nil {
-		log.Error("Failed to find out the current status of the pages: %v.", err)
-		return 0, err
-	}
-
-	dramPages := make([]uintptr, 0)
-	nodes := make([]int, 0)
-	// Choose a target node for every page. Drop the pages which already are on the right controller from the list.
-	for i, pageStatus := range currentStatus {
-		if pageStatus < 0 {
-			// There was an error regarding this page.
-			continue
+// pickClosestPMEMNode picks the PMEM node closest to the current node of a page.
+//
+// The array targetNodes already contains only the subset of PMEM nodes available
+// in this topology subtree. Ties, or unknown distances, are broken by picking the
+// lowest node ID, which keeps pages from a node together in a single move_pages().
+// TODO: consider also the amount of free memory on the PMEM nodes.
+func pickClosestPMEMNode(currentNode system.ID, targetNodes system.IDSet, getDistance nodeDistanceFn) system.ID {
+	closest, minDistance := system.ID(-1), -1
+	for _, node := range targetNodes.SortedMembers() {
+		distance := getDistance(currentNode, node)
+		if closest == -1 || (distance >= 0 && (minDistance < 0 || distance < minDistance)) {
+			closest, minDistance = node, distance
 		}
-		// log.Debug("page 0x%08X: old status %d", pages[i], pageStatus)
-		if !targetNodes.Has(system.ID(pageStatus)) {
-			// In case of many PMEM controllers choose the one that is the closest.
-			dramPages = append(dramPages, pages[i])
-			nodes = append(nodes, int(pickClosestPMEMNode(system.ID(pageStatus), targetNodes)))
-		} // else no need to move.
 	}
-
-	// Call move_pages() to actually move the pages.
-	_, _, err = d.pageMover.MovePagesSyscall(pid, uint(len(dramPages)), dramPages, nodes, flags)
-
-	// We processed (moved or ignored) at least nPages.
-	return nPages, err
+	return closest
 }
 
 func (d *demoter) movePages(p pagePool, count uint, targetNodes system.IDSet) error {
-	// Select pid for moving the pages so that the process with the largest number
-	// of non-dirty pages gets the pages moved first.
-	processedPids := make(map[int]bool, 0)
-
-	for count > 0 {
-		mostPagesPid := 0
-		nPagesForPid := uint(0)
-		for pid, pages := range p.pages {
-			_, alreadyProcessed := processedPids[pid]
-			if alreadyProcessed {
-				continue
-			}
-			if uint(len(pages)) > nPagesForPid {
-				mostPagesPid = pid
-				nPagesForPid = uint(len(pages))
-			}
-		}
+	pipeline := d.movePipeline
+	if pipeline == nil {
+		pipeline = newMovePipeline(d.pageMover, 0, 0)
+	}
 
-		if nPagesForPid == 0 {
-			return nil
-		}
+	// Select pids for moving the pages so that the processes with the largest
+	// number of non-dirty pages get the pages moved first.
+	queue := newPidQueue(p)
+	results := make(chan moveResult, queue.Len())
 
-		processedPids[mostPagesPid] = true
+	jobs := 0
+	for count > 0 && queue.Len() > 0 {
+		next := heap.Pop(queue).(pidPages)
 
-		nMovePages := nPagesForPid
-		if count < nPagesForPid {
+		nMovePages := next.count
+		if count < nMovePages {
 			nMovePages = count
-			count = 0
-		} else {
-			count -= nPagesForPid
 		}
+		count -= nMovePages
+
+		log.Debug("moving %d pages for pid %d", nMovePages, next.pid)
+		pipeline.submit(&moveJob{
+			pid:         next.pid,
+			pages:       p.pages[next.pid][:nMovePages],
+			targetNodes: targetNodes,
+			done:        results,
+		})
+		jobs++
+	}
 
-		log.Debug("moving %d pages for pid %d", nMovePages, mostPagesPid)
-		nPages, err := d.movePagesForPid(p.pages[mostPagesPid], nMovePages, mostPagesPid, targetNodes)
-		if err != nil {
-			log.Error("Failed to move pages: %v", err)
-			return err
+	var err error
+	for ; jobs > 0; jobs-- {
+		r := <-results
+		if r.err != nil {
+			log.Error("Failed to move pages: %v", r.err)
+			if err == nil {
+				err = r.err
+			}
+			continue
 		}
 		// Remove processed pages from the pagemap.
-		p.pages[mostPagesPid] = p.pages[mostPagesPid][nPages:]
+		p.pages[r.pid] = p.pages[r.pid][r.moved:]
 	}
-	return nil
+
+	return err
 }
@@ -16,6 +16,9 @@ package pagemigrate
 
 import (
 	"fmt"
+	"os"
+	"sort"
+	"sync"
 	"testing"
 
 	system "github.com/intel/cri-resource-manager/pkg/sysfs"
@@ -257,3 +260,132 @@ func TestMovePages(t *testing.T) {
 		})
 	}
 }
+
+type recordingPageMover struct {
+	sync.Mutex
+	calls map[int][]uint // sizes of page moving calls by pid
+}
+
+func (m *recordingPageMover) MovePagesSyscall(pid int, count uint, pages []uintptr, nodes []int, flags int) (uint, []int, error) {
+	if nodes == nil {
+		// all pages are on node 0
+		return 0, make([]int, count), nil
+	}
+
+	for _, node := range nodes {
+		if node != 1 {
+			return 0, nil, fmt.Errorf("page moved to node %d instead of 1", node)
+		}
+	}
+
+	m.Lock()
+	defer m.Unlock()
+	m.calls[pid] = append(m.calls[pid], count)
+
+	return 0, make([]int, count), nil
+}
+
+// testNodeDistance has node 1 closer to node 0 than node 2 is.
+func testNodeDistance(from, to system.ID) int {
+	distance := [][]int{
+		{10, 17, 28},
+		{17, 10, 28},
+		{28, 28, 10},
+	}
+	return distance[from][to]
+}
+
+// stoppingPageMover stops a pipeline once it has moved some pages.
+type stoppingPageMover struct {
+	recordingPageMover
+	pipeline *movePipeline
+}
+
+func (m *stoppingPageMover) MovePagesSyscall(pid int, count uint, pages []uintptr, nodes []int, flags int) (uint, []int, error) {
+	moved, status, err := m.recordingPageMover.MovePagesSyscall(pid, count, pages, nodes, flags)
+	if nodes != nil {
+		m.pipeline.stop()
+	}
+	return moved, status, err
+}
+
+func TestMovePipeline(t *testing.T) {
+	pageSize := uint64(os.Getpagesize())
+
+	tcases := []struct {
+		name          string
+		workers       uint
+		bandwidth     uint64
+		count         uint
+		pages         map[int]int
+		expectedCalls map[int][]uint
+	}{
+		{
+			name:          "unlimited bandwidth",
+			workers:       2,
+			count:         10,
+			pages:         map[int]int{100: 8, 200: 4, 300: 2},
+			expectedCalls: map[int][]uint{100: {8}, 200: {2}},
+		},
+		{
+			name:          "limited bandwidth",
+			workers:       2,
+			bandwidth:     8 * pageSize,
+			count:         20,
+			pages:         map[int]int{100: 10, 200: 4},
+			expectedCalls: map[int][]uint{100: {8, 2}, 200: {4}},
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			mover := &recordingPageMover{calls: make(map[int][]uint)}
+			d := &demoter{
+				pageMover:    mover,
+				movePipeline: newMovePipeline(mover, tc.workers, tc.bandwidth),
+			}
+			d.movePipeline.distance = testNodeDistance
+			defer d.movePipeline.stop()
+
+			pool := pagePool{pages: make(map[int][]page)}
+			for pid, count := range tc.pages {
+				for i := 0; i < count; i++ {
+					pool.pages[pid] = append(pool.pages[pid], page{pid: pid, addr: uint64(i) * pageSize})
+				}
+			}
+
+			if err := d.movePages(pool, tc.count, system.NewIDSet(1, 2)); err != nil {
+				t.Errorf("unexpected error: %v", err)
+			}
+
+			for _, calls := range mover.calls {
+				sort.Slice(calls, func(i, j int) bool { return calls[i] > calls[j] })
+			}
+			if fmt.Sprintf("%v", mover.calls) != fmt.Sprintf("%v", tc.expectedCalls) {
+				t.Errorf("expected calls %v, got %v", tc.expectedCalls, mover.calls)
+			}
+		})
+	}
+}
+
+func TestMovePipelineStop(t *testing.T) {
+	pageSize := uint64(os.Getpagesize())
+
+	mover := &stoppingPageMover{recordingPageMover: recordingPageMover{calls: make(map[int][]uint)}}
+	pipeline := newMovePipeline(mover, 0, 8*pageSize)
+	pipeline.distance = testNodeDistance
+	mover.pipeline = pipeline
+
+	pages := []page{}
+	for i := 0; i < 20; i++ {
+		pages = append(pages, page{pid: 100, addr: uint64(i) * pageSize})
+	}
+
+	buf := pipeline.buffers.Get().(*moveBuffers)
+	moved, err := pipeline.movePagesForPid(buf, 100, pages, system.NewIDSet(1, 2))
+	if err != nil {
+		t.Errorf("unexpected error: %v", err)
+	}
+	if moved != 8 {
+		t.Errorf("expected 8 pages moved before stopping, got %d", moved)
+	}
+}
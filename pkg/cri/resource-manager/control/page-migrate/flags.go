@@ -26,6 +26,12 @@ type options struct {
 	PageMoveInterval config.Duration
 	// MaxPageMoveCount controls how many pages we can move in a single go.
 	MaxPageMoveCount uint
+	// AccessTracker selects how we detect idle pages: soft-dirty, idle-page, or damon.
+	AccessTracker string
+	// PageMoveWorkers controls how many processes we can move pages for in parallel.
+	PageMoveWorkers uint
+	// PageMoveBandwidth limits how many bytes per second we move to a single node, 0 for no limit.
+	PageMoveBandwidth uint64
 }
 
 // Our runtime configuration.
@@ -33,7 +39,10 @@ var opt = defaultOptions().(*options)
 
 // defaultOptions returns a new options instance, all initialized to defaults.
 func defaultOptions() interface{} {
-	return &options{}
+	return &options{
+		AccessTracker:   SoftDirtyTracker,
+		PageMoveWorkers: 4,
+	}
 }
 
 // Register us for configuration handling.
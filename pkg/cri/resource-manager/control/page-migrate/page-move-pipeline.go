@@ -0,0 +1,324 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package pagemigrate
+
+import (
+	"container/heap"
+	"context"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+
+	"golang.org/x/time/rate"
+
+	system "github.com/intel/cri-resource-manager/pkg/sysfs"
+)
+
+const (
+	// MPOL_MF_MOVE - only move pages exclusive to this process. There will be
+	// permission denied errors for pages which couldn't be moved. FIXME: find
+	// out if the whole move_pages() syscall failed or if just the non-exclusive
+	// pages were not moved.
+	movePagesFlags = 1 << 1
+	// sysfs path of NUMA node distance vectors
+	nodeDistancePath = "/sys/devices/system/node/node%d/distance"
+)
+
+// movePipeline moves pages of processes using a fixed pool of workers.
+//
+// Pages are moved to their closest target node. The pages of a process
+// are grouped by target node so that each node gets a single move_pages()
+// call, split into smaller chunks if we have a per-node bandwidth budget.
+// Workers reuse their buffers from one request to another.
+type movePipeline struct {
+	sync.Mutex
+	mover     PageMover                   // actual page mover
+	jobs      chan *moveJob               // pending requests
+	wg        sync.WaitGroup              // for waiting for workers to stop
+	bandwidth uint64                      // per-node budget in bytes per second, 0 for unlimited
+	limiters  map[system.ID]*rate.Limiter // per-node bandwidth limiters
+	pageSize  uint64                      // system page size
+	buffers   sync.Pool                   // reusable moveBuffers
+	distance  nodeDistanceFn              // NUMA node distance lookup
+	ctx       context.Context             // cancelled when stopping
+	cancel    context.CancelFunc          // for cancelling ctx
+	inline    bool                        // move pages in the caller's goroutine
+	stopOnce  sync.Once                   // for stopping exactly once
+}
+
+// nodeDistanceFn returns the distance between two nodes, or -1 if unknown.
+type nodeDistanceFn func(from, to system.ID) int
+
+// moveJob is a request to move the pages of a single process.
+type moveJob struct {
+	pid         int
+	pages       []page
+	targetNodes system.IDSet
+	done        chan<- moveResult
+}
+
+// moveResult is the result of a moveJob.
+type moveResult struct {
+	pid   int
+	moved uint
+	err   error
+}
+
+// moveBuffers are the buffers used by a worker for moving pages.
+type moveBuffers struct {
+	pages  []uintptr               // addresses of all pages to move
+	nodes  []int                   // target nodes for the pages of a single move_pages() call
+	groups map[system.ID][]uintptr // addresses of pages by target node
+}
+
+// newMovePipeline creates a page move pipeline with the given number of workers.
+//
+// With zero workers pages are moved synchronously by the submitter.
+func newMovePipeline(mover PageMover, workers uint, bandwidth uint64) *movePipeline {
+	m := &movePipeline{
+		mover:     mover,
+		bandwidth: bandwidth,
+		limiters:  make(map[system.ID]*rate.Limiter),
+		pageSize:  uint64(os.Getpagesize()),
+		distance:  getNodeDistance,
+		inline:    workers == 0,
+	}
+	m.ctx, m.cancel = context.WithCancel(context.Background())
+	m.buffers.New = func() interface{} {
+		return &moveBuffers{groups: make(map[system.ID][]uintptr)}
+	}
+
+	if !m.inline {
+		m.jobs = make(chan *moveJob, workers)
+		for i := uint(0); i < workers; i++ {
+			m.wg.Add(1)
+			go m.worker()
+		}
+	}
+
+	return m
+}
+
+// stop stops the pipeline, waiting for any ongoing requests to finish.
+func (m *movePipeline) stop() {
+	m.stopOnce.Do(func() {
+		m.cancel()
+		if !m.inline {
+			close(m.jobs)
+			m.wg.Wait()
+		}
+	})
+}
+
+// submit submits a request for moving pages.
+func (m *movePipeline) submit(job *moveJob) {
+	if m.inline {
+		m.run(job)
+		return
+	}
+	m.jobs <- job
+}
+
+// worker processes requests until the pipeline is stopped.
+func (m *movePipeline) worker() {
+	defer m.wg.Done()
+	for job := range m.jobs {
+		m.run(job)
+	}
+}
+
+// run processes a single request.
+func (m *movePipeline) run(job *moveJob) {
+	buf := m.buffers.Get().(*moveBuffers)
+	moved, err := m.movePagesForPid(buf, job.pid, job.pages, job.targetNodes)
+	m.buffers.Put(buf)
+	job.done <- moveResult{pid: job.pid, moved: moved, err: err}
+}
+
+// movePagesForPid moves the given pages of a process to their closest target nodes.
+func (m *movePipeline) movePagesForPid(buf *moveBuffers, pid int, p []page, targetNodes system.IDSet) (uint, error) {
+	nPages := uint(len(p))
+
+	// Gather memory page pointers.
+	buf.pages = buf.pages[:0]
+	for _, pg := range p {
+		buf.pages = append(buf.pages, uintptr(pg.addr))
+	}
+
+	// Call move_pages() first with nil nodes array to find out the current controllers.
+	_, currentStatus, err := m.mover.MovePagesSyscall(pid, nPages, buf.pages, nil, movePagesFlags)
+	if err != nil {
+		log.Error("Failed to find out the current status of the pages: %v.", err)
+		return 0, err
+	}
+
+	// Group pages by target node, dropping the ones which already are on a target node.
+	moved := uint(0)
+	for node, pages := range buf.groups {
+		buf.groups[node] = pages[:0]
+	}
+	for i, pageStatus := range currentStatus {
+		if pageStatus < 0 {
+			// There was an error regarding this page.
+			moved++
+			continue
+		}
+		current := system.ID(pageStatus)
+		if targetNodes.Has(current) {
+			moved++
+			continue
+		}
+		// In case of many PMEM controllers choose the one that is the closest.
+		target := pickClosestPMEMNode(current, targetNodes, m.distance)
+		buf.groups[target] = append(buf.groups[target], buf.pages[i])
+	}
+
+	// Call move_pages() to actually move the pages, within our per-node budget.
+	for _, target := range targetNodes.SortedMembers() {
+		pages := buf.groups[target]
+		for len(pages) > 0 {
+			chunk := m.throttle(target, len(pages))
+			if chunk == 0 {
+				// We're stopping.
+				return moved, nil
+			}
+			buf.nodes = buf.nodes[:0]
+			for i := 0; i < chunk; i++ {
+				buf.nodes = append(buf.nodes, int(target))
+			}
+			_, _, err = m.mover.MovePagesSyscall(pid, uint(chunk), pages[:chunk], buf.nodes, movePagesFlags)
+			if err != nil {
+				return moved, err
+			}
+			moved += uint(chunk)
+			pages = pages[chunk:]
+		}
+	}
+
+	// We processed (moved or ignored) all nPages.
+	return moved, nil
+}
+
+// throttle waits until at most count pages can be moved to a node, returning
+// the number of pages allowed to move.
+func (m *movePipeline) throttle(node system.ID, count int) int {
+	if m.bandwidth == 0 {
+		return count
+	}
+
+	limiter := m.limiter(node)
+	if max := limiter.Burst() / int(m.pageSize); count > max {
+		count = max
+	}
+
+	if err := limiter.WaitN(m.ctx, count*int(m.pageSize)); err != nil {
+		return 0
+	}
+	return count
+}
+
+// limiter returns the bandwidth limiter for a node.
+func (m *movePipeline) limiter(node system.ID) *rate.Limiter {
+	m.Lock()
+	defer m.Unlock()
+
+	limiter, ok := m.limiters[node]
+	if !ok {
+		// Allow bursts of up to a second worth of budget, but at least a page.
+		burst := m.bandwidth
+		if burst < m.pageSize {
+			burst = m.pageSize
+		}
+		limiter = rate.NewLimiter(rate.Limit(m.bandwidth), int(burst))
+		m.limiters[node] = limiter
+	}
+	return limiter
+}
+
+// pidPages is the number of pages to move for a process.
+type pidPages struct {
+	pid   int
+	count uint
+}
+
+// pidQueue is a priority queue of processes, the one with most pages first.
+type pidQueue []pidPages
+
+func (q pidQueue) Len() int { return len(q) }
+func (q pidQueue) Less(i, j int) bool {
+	if q[i].count != q[j].count {
+		return q[i].count > q[j].count
+	}
+	return q[i].pid < q[j].pid
+}
+func (q pidQueue) Swap(i, j int)       { q[i], q[j] = q[j], q[i] }
+func (q *pidQueue) Push(x interface{}) { *q = append(*q, x.(pidPages)) }
+func (q *pidQueue) Pop() interface{} {
+	old := *q
+	n := len(old)
+	x := old[n-1]
+	*q = old[:n-1]
+	return x
+}
+
+// newPidQueue creates a priority queue for the processes in a page pool.
+func newPidQueue(p pagePool) *pidQueue {
+	q := make(pidQueue, 0, len(p.pages))
+	for pid, pages := range p.pages {
+		if len(pages) > 0 {
+			q = append(q, pidPages{pid: pid, count: uint(len(pages))})
+		}
+	}
+	heap.Init(&q)
+	return &q
+}
+
+// nodeDistances caches NUMA node distance vectors.
+var nodeDistances = struct {
+	sync.Mutex
+	distance map[system.ID][]int
+}{
+	distance: make(map[system.ID][]int),
+}
+
+// getNodeDistance returns the distance between two nodes, or -1 if unknown.
+func getNodeDistance(from, to system.ID) int {
+	nodeDistances.Lock()
+	defer nodeDistances.Unlock()
+
+	distance, ok := nodeDistances.distance[from]
+	if !ok {
+		path := fmt.Sprintf(nodeDistancePath, from)
+		if data, err := ioutil.ReadFile(path); err == nil {
+			for _, field := range strings.Fields(string(data)) {
+				d, err := strconv.Atoi(field)
+				if err != nil {
+					distance = nil
+					break
+				}
+				distance = append(distance, d)
+			}
+		}
+		nodeDistances.distance[from] = distance
+	}
+
+	if int(to) < 0 || int(to) >= len(distance) {
+		return -1
+	}
+	return distance[to]
+}
@@ -0,0 +1,278 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package pagemigrate
+
+import (
+	"bytes"
+	"encoding/binary"
+	"io"
+	"os"
+
+	system "github.com/intel/cri-resource-manager/pkg/sysfs"
+)
+
+const (
+	// initial size of the buffers used for reading maps and numa_maps
+	mapsBufferSize = 64 * 1024
+	// number of pagemap entries to read with a single pread(2)
+	pagemapBatchSize = 8192
+	// size of a single pagemap entry
+	pagemapEntrySize = 8
+
+	// pagemap entry bits we're interested in
+	pagemapPFNMask      = uint64(0x1)<<55 - 1
+	pagemapSoftDirtyBit = uint64(0x1) << 55
+	pagemapExclusiveBit = uint64(0x1) << 56
+	pagemapPresentBit   = uint64(0x1) << 63
+)
+
+var (
+	heapAttr = []byte("heap")
+	anonAttr = []byte("anon=")
+)
+
+// pageScanner finds pages to demote, reusing its buffers from one process to another.
+type pageScanner struct {
+	maps     []byte // buffer for /proc/<pid>/maps
+	numaMaps []byte // buffer for /proc/<pid>/numa_maps
+	pagemap  []byte // buffer for /proc/<pid>/pagemap entries
+	pageSize uint64 // system page size
+}
+
+// newPageScanner creates a new page scanner.
+func newPageScanner() *pageScanner {
+	return &pageScanner{
+		pageSize: uint64(os.Getpagesize()),
+	}
+}
+
+// readFile reads the full content of a file into the given buffer, growing it if necessary.
+func readFile(path string, buf *[]byte) ([]byte, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+
+	if *buf == nil {
+		*buf = make([]byte, mapsBufferSize)
+	}
+
+	n := 0
+	for {
+		if n == len(*buf) {
+			*buf = append(*buf, make([]byte, len(*buf))...)
+		}
+		cnt, err := f.Read((*buf)[n:])
+		n += cnt
+		if err == io.EOF {
+			return (*buf)[:n], nil
+		}
+		if err != nil {
+			return nil, err
+		}
+	}
+}
+
+// heapRanges appends the anonymous heap ranges of a process with pages on any of the given nodes.
+func (s *pageScanner) heapRanges(pid string, nodes system.IDSet, ranges []addrRange) ([]addrRange, error) {
+	numaMaps, err := readFile("/proc/"+pid+"/numa_maps", &s.numaMaps)
+	if err != nil {
+		return ranges, err
+	}
+	maps, err := readFile("/proc/"+pid+"/maps", &s.maps)
+	if err != nil {
+		return ranges, err
+	}
+
+	scanHeapRanges(maps, numaMaps, nodes, func(start, end uint64) {
+		ranges = append(ranges, addrRange{start, (end - start) / s.pageSize})
+	})
+
+	return ranges, nil
+}
+
+// scanHeapRanges calls fn for anonymous heap ranges with pages on any of the given nodes.
+//
+// Both maps and numa_maps list the memory mappings of a process sorted by
+// their start address, so we can merge the two in a single pass. numa_maps
+// tells us which ranges are interesting, maps tells us where they end.
+func scanHeapRanges(maps, numaMaps []byte, nodes system.IDSet, fn func(start, end uint64)) {
+	for len(numaMaps) > 0 {
+		var line []byte
+		line, numaMaps = nextLine(numaMaps)
+
+		// A numa_maps line looks like this:
+		//
+		// 55d1b8a6e000 default heap anon=33 dirty=33 active=0 N0=33 kernelpagesize_kB=4
+		start, rest, ok := parseHex(line)
+		if !ok || len(rest) == 0 || rest[0] != ' ' {
+			continue
+		}
+		policyEnd := bytes.IndexByte(rest[1:], ' ')
+		if policyEnd < 0 {
+			continue
+		}
+		attrs := rest[1+policyEnd+1:]
+
+		// Filter out lines which don't have "anonymous", since we are not
+		// interested in file-mapped or shared pages. Save the interesting ranges.
+		// TODO: consider dropping the "heap" requirement. There are often ranges
+		// in the file which don't have any attributes indicating the memory
+		// location.
+		if !bytes.Contains(attrs, heapAttr) || !bytes.Contains(attrs, anonAttr) {
+			continue
+		}
+		// We only find out if *any* pages in the range are in a DRAM node. The
+		// more fine-grained analysis is done later by running the move_pages()
+		// system call twice.
+		if !hasPagesOnNodes(attrs, nodes) {
+			continue
+		}
+
+		// Find the matching maps line, which looks like this:
+		//
+		// 55d1b8a6e000-55d1b8a8f000 rw-p 00000000 00:00 0          [heap]
+		for len(maps) > 0 {
+			var mapsStart, mapsEnd uint64
+
+			mapsLine, next := nextLine(maps)
+			mapsStart, mapsLine, ok = parseHex(mapsLine)
+			if !ok || mapsStart < start {
+				maps = next
+				continue
+			}
+			if mapsStart == start {
+				if len(mapsLine) > 0 && mapsLine[0] == '-' {
+					if mapsEnd, _, ok = parseHex(mapsLine[1:]); ok && mapsEnd > start {
+						fn(start, mapsEnd)
+					}
+				}
+				maps = next
+			}
+			break
+		}
+	}
+}
+
+// hasPagesOnNodes checks if numa_maps attributes show any pages on the given nodes.
+func hasPagesOnNodes(attrs []byte, nodes system.IDSet) bool {
+	for len(attrs) > 0 {
+		var attr []byte
+		if end := bytes.IndexByte(attrs, ' '); end >= 0 {
+			attr, attrs = attrs[:end], attrs[end+1:]
+		} else {
+			attr, attrs = attrs, nil
+		}
+
+		// node page counts look like N<node>=<count>
+		if len(attr) < 4 || attr[0] != 'N' {
+			continue
+		}
+		node, rest, ok := parseDecimal(attr[1:])
+		if !ok || len(rest) < 2 || rest[0] != '=' {
+			continue
+		}
+		if count, _, ok := parseDecimal(rest[1:]); ok && count > 0 && nodes.Has(system.ID(node)) {
+			return true
+		}
+	}
+	return false
+}
+
+// scanPagemap appends the pages of the given ranges for which fn returns true.
+//
+// fn is called with the page address and its pagemap entry for every present
+// page exclusively mapped by the process, IOW not used by any other process.
+func (s *pageScanner) scanPagemap(pid int, pagemap *os.File, ranges []addrRange, pages []page,
+	fn func(addr, entry uint64) bool) []page {
+	if s.pagemap == nil {
+		s.pagemap = make([]byte, pagemapBatchSize*pagemapEntrySize)
+	}
+
+	for _, r := range ranges {
+		offset := int64(r.addr / s.pageSize * pagemapEntrySize)
+		for done := uint64(0); done < r.length; {
+			batch := r.length - done
+			if batch > pagemapBatchSize {
+				batch = pagemapBatchSize
+			}
+			buf := s.pagemap[:batch*pagemapEntrySize]
+			cnt, err := pagemap.ReadAt(buf, offset+int64(done*pagemapEntrySize))
+			if err != nil && err != io.EOF || cnt < len(buf) {
+				// Possibly the maps changed.
+				log.Error("Could not read data from pagemaps (offset %d, range 0x%x+%d pages): %v",
+					offset, r.addr, r.length, err)
+				break
+			}
+
+			for i := uint64(0); i < batch; i++ {
+				entry := binary.LittleEndian.Uint64(buf[i*pagemapEntrySize:])
+
+				// Note: there appears to be no way to see from the pagemap entry what the NUMA node is.
+				// We could map this back to the physical address ranges if needed. Currently this is handled
+				// in movePages() by calling move_pages() first with an empty node array.
+
+				if entry&pagemapPresentBit == 0 || entry&pagemapExclusiveBit == 0 {
+					continue
+				}
+				if addr := r.addr + (done+i)*s.pageSize; fn(addr, entry) {
+					pages = append(pages, page{addr: addr, pid: pid})
+				}
+			}
+			done += batch
+		}
+	}
+
+	return pages
+}
+
+// nextLine splits off the first line of data.
+func nextLine(data []byte) ([]byte, []byte) {
+	if end := bytes.IndexByte(data, '\n'); end >= 0 {
+		return data[:end], data[end+1:]
+	}
+	return data, nil
+}
+
+// parseHex parses a leading hexadecimal number, returning it with the rest of data.
+func parseHex(data []byte) (uint64, []byte, bool) {
+	var v uint64
+	i := 0
+	for ; i < len(data) && i < 16; i++ {
+		c := data[i]
+		switch {
+		case '0' <= c && c <= '9':
+			v = v<<4 | uint64(c-'0')
+		case 'a' <= c && c <= 'f':
+			v = v<<4 | uint64(c-'a'+10)
+		case 'A' <= c && c <= 'F':
+			v = v<<4 | uint64(c-'A'+10)
+		default:
+			return v, data[i:], i > 0
+		}
+	}
+	return v, data[i:], i > 0
+}
+
+// parseDecimal parses a leading decimal number, returning it with the rest of data.
+func parseDecimal(data []byte) (uint64, []byte, bool) {
+	var v uint64
+	i := 0
+	for ; i < len(data) && i < 19 && '0' <= data[i] && data[i] <= '9'; i++ {
+		v = v*10 + uint64(data[i]-'0')
+	}
+	return v, data[i:], i > 0
+}
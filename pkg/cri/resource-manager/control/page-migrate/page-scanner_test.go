@@ -0,0 +1,158 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package pagemigrate
+
+import (
+	"encoding/binary"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"strings"
+	"testing"
+
+	system "github.com/intel/cri-resource-manager/pkg/sysfs"
+)
+
+const (
+	testMaps = `55d1b8a6e000-55d1b8a8f000 rw-p 00000000 00:00 0                          [heap]
+7f0c1c000000-7f0c1c021000 rw-p 00000000 00:00 0
+7f0c20000000-7f0c20400000 rw-p 00000000 00:00 0                          [heap]
+7f0c24000000-7f0c24010000 r-xp 00000000 08:01 1234                       /usr/lib/libc.so
+7ffd3e2f1000-7ffd3e312000 rw-p 00000000 00:00 0                          [stack]
+`
+	testNumaMaps = `55d1b8a6e000 default heap anon=33 dirty=33 active=0 N0=33 kernelpagesize_kB=4
+7f0c1c000000 default anon=1 dirty=1 N0=1 kernelpagesize_kB=4
+7f0c20000000 default heap anon=1024 dirty=1024 N10=1000 N2=24 kernelpagesize_kB=4
+7f0c24000000 default file=/usr/lib/libc.so mapped=16 mapmax=40 N0=16 kernelpagesize_kB=4
+7ffd3e2f1000 default stack anon=5 dirty=5 N0=5 kernelpagesize_kB=4
+`
+)
+
+func TestScanHeapRanges(t *testing.T) {
+	tcases := []struct {
+		name     string
+		maps     string
+		numaMaps string
+		nodes    system.IDSet
+		expected []addrRange
+	}{
+		{
+			name:     "heap on node 0",
+			maps:     testMaps,
+			numaMaps: testNumaMaps,
+			nodes:    system.NewIDSet(0),
+			expected: []addrRange{{0x55d1b8a6e000, 0x55d1b8a8f000}},
+		},
+		{
+			name:     "node prefix does not match",
+			maps:     testMaps,
+			numaMaps: testNumaMaps,
+			nodes:    system.NewIDSet(1),
+		},
+		{
+			name:     "heap on nodes 0 and 2",
+			maps:     testMaps,
+			numaMaps: testNumaMaps,
+			nodes:    system.NewIDSet(0, 2),
+			expected: []addrRange{{0x55d1b8a6e000, 0x55d1b8a8f000}, {0x7f0c20000000, 0x7f0c20400000}},
+		},
+		{
+			name:     "range missing from maps",
+			maps:     strings.SplitN(testMaps, "\n", 2)[1],
+			numaMaps: testNumaMaps,
+			nodes:    system.NewIDSet(0, 10),
+			expected: []addrRange{{0x7f0c20000000, 0x7f0c20400000}},
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			var ranges []addrRange
+			scanHeapRanges([]byte(tc.maps), []byte(tc.numaMaps), tc.nodes, func(start, end uint64) {
+				ranges = append(ranges, addrRange{start, end})
+			})
+			if fmt.Sprintf("%v", ranges) != fmt.Sprintf("%v", tc.expected) {
+				t.Errorf("expected ranges %x, got %x", tc.expected, ranges)
+			}
+		})
+	}
+}
+
+func TestScanPagemap(t *testing.T) {
+	const pageSize = 4096
+
+	f, err := ioutil.TempFile("", "pagemap-test-")
+	if err != nil {
+		t.Fatalf("failed to create pagemap: %v", err)
+	}
+	defer os.Remove(f.Name())
+	defer f.Close()
+
+	// pages at even indices are idle, at odd ones dirty or not exclusive
+	entries := 3*pagemapBatchSize + 10
+	buf := make([]byte, entries*pagemapEntrySize)
+	for i := 0; i < entries; i++ {
+		data := pagemapPresentBit | pagemapExclusiveBit
+		switch i % 4 {
+		case 1:
+			data |= pagemapSoftDirtyBit
+		case 3:
+			data &^= pagemapExclusiveBit
+		}
+		binary.LittleEndian.PutUint64(buf[i*pagemapEntrySize:], data)
+	}
+	if _, err := f.Write(buf); err != nil {
+		t.Fatalf("failed to write pagemap: %v", err)
+	}
+
+	s := &pageScanner{pageSize: pageSize}
+	ranges := []addrRange{
+		{addr: 2 * pageSize, length: 4},
+		{addr: 100 * pageSize, length: uint64(entries - 100)},
+		{addr: uint64(entries) * pageSize, length: 4}, // beyond the end of pagemap
+	}
+	pages := s.scanPagemap(1, f, ranges, nil, func(addr, entry uint64) bool {
+		return entry&pagemapSoftDirtyBit == 0
+	})
+
+	if len(pages) != 2+(entries-100)/2 {
+		t.Errorf("expected %d idle pages, got %d", 2+(entries-100)/2, len(pages))
+	}
+	for _, p := range pages {
+		if p.pid != 1 || (p.addr/pageSize)%2 != 0 {
+			t.Errorf("unexpected idle page %+v", p)
+		}
+	}
+}
+
+func BenchmarkScanHeapRanges(b *testing.B) {
+	maps, numaMaps := &strings.Builder{}, &strings.Builder{}
+	for i := uint64(0); i < 20000; i++ {
+		start, end := 0x7f0000000000+i*0x200000, 0x7f0000000000+i*0x200000+0x100000
+		fmt.Fprintf(maps, "%x-%x rw-p 00000000 00:00 0          [heap]\n", start, end)
+		fmt.Fprintf(numaMaps, "%x default heap anon=256 dirty=256 N%d=256 kernelpagesize_kB=4\n", start, i%4)
+	}
+	mapsData, numaData := []byte(maps.String()), []byte(numaMaps.String())
+	nodes := system.NewIDSet(0, 1)
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		cnt := 0
+		scanHeapRanges(mapsData, numaData, nodes, func(start, end uint64) { cnt++ })
+		if cnt != 10000 {
+			b.Fatalf("expected 10000 ranges, got %d", cnt)
+		}
+	}
+}
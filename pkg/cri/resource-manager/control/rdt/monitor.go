@@ -0,0 +1,302 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package rdt
+
+import (
+	"bufio"
+	"io"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+
+	"github.com/intel/goresctrl/pkg/rdt"
+	"github.com/prometheus/client_golang/prometheus"
+)
+
+const (
+	// monCollectorName is the name of our container monitoring data collector.
+	monCollectorName = "rdt-monitor"
+	// monDomainPrefix is the prefix of L3 monitoring domain directories.
+	monDomainPrefix = "mon_L3_"
+)
+
+var (
+	// monLabels are the labels of container monitoring metrics.
+	monLabels = []string{"container_id", "pod_name", "container_name", "cache_id"}
+
+	// llcOccupancyDesc describes container LLC occupancy.
+	llcOccupancyDesc = prometheus.NewDesc("rdt_container_llc_occupancy_bytes",
+		"LLC occupancy of a container.", monLabels, nil)
+	// mbmTotalRateDesc describes container total memory bandwidth.
+	mbmTotalRateDesc = prometheus.NewDesc("rdt_container_mbm_total_bytes_per_second",
+		"Total memory bandwidth of a container.", monLabels, nil)
+	// mbmLocalRateDesc describes container local memory bandwidth.
+	mbmLocalRateDesc = prometheus.NewDesc("rdt_container_mbm_local_bytes_per_second",
+		"Local memory bandwidth of a container.", monLabels, nil)
+)
+
+// monFile is a resctrl monitoring data file kept open for repeated reads.
+type monFile struct {
+	path  string
+	file  *os.File
+	value uint64 // last value read
+	valid bool   // whether value is valid
+}
+
+// monDomain is a single L3 monitoring domain of a monitoring group.
+type monDomain struct {
+	cacheID   string
+	occupancy *monFile
+	total     *monFile
+	local     *monFile
+}
+
+// monReader reads the monitoring data of a single container.
+type monReader struct {
+	id      string       // container ID
+	pod     string       // pod name
+	name    string       // container name
+	domains []*monDomain // L3 monitoring domains
+	stamp   time.Time    // time of the last read
+}
+
+// monitors tracks the monitoring data readers of containers.
+type monitors struct {
+	sync.Mutex
+	root    string                // resctrl mount point
+	readers map[string]*monReader // readers by container ID
+}
+
+// resctrlMountPoint returns the mount point of the resctrl filesystem.
+func resctrlMountPoint() (string, error) {
+	f, err := os.Open("/proc/mounts")
+	if err != nil {
+		return "", err
+	}
+	defer f.Close()
+
+	s := bufio.NewScanner(f)
+	for s.Scan() {
+		fields := strings.Fields(s.Text())
+		if len(fields) > 2 && fields[2] == "resctrl" {
+			return fields[1], nil
+		}
+	}
+	if err := s.Err(); err != nil {
+		return "", err
+	}
+
+	return "", rdtError("resctrl filesystem not mounted")
+}
+
+// monGroupDir returns the directory of a monitoring group.
+func (m *monitors) monGroupDir(cls rdt.CtrlGroup, group string) (string, error) {
+	if m.root == "" {
+		root, err := resctrlMountPoint()
+		if err != nil {
+			return "", err
+		}
+		m.root = root
+	}
+
+	// Classes and monitoring groups we create have a prefix, discovered ones don't.
+	ctrlDirs := []string{m.root}
+	if cls.Name() != rdt.RootClassName {
+		ctrlDirs = []string{
+			filepath.Join(m.root, resctrlGroupPrefix+cls.Name()),
+			filepath.Join(m.root, cls.Name()),
+		}
+	}
+	for _, ctrl := range ctrlDirs {
+		for _, mon := range []string{resctrlGroupPrefix + group, group} {
+			dir := filepath.Join(ctrl, "mon_groups", mon)
+			if _, err := os.Stat(filepath.Join(dir, "mon_data")); err == nil {
+				return dir, nil
+			}
+		}
+	}
+
+	return "", rdtError("failed to find directory of monitoring group %q", cls.Name()+"/"+group)
+}
+
+// start starts reading the monitoring data of a container.
+func (m *monitors) start(cls rdt.CtrlGroup, group, id, pod, name string) error {
+	m.Lock()
+	defer m.Unlock()
+
+	dir, err := m.monGroupDir(cls, group)
+	if err != nil {
+		return err
+	}
+
+	domains, err := filepath.Glob(filepath.Join(dir, "mon_data", monDomainPrefix+"*"))
+	if err != nil {
+		return rdtError("failed to find monitoring domains of %q: %v", dir, err)
+	}
+
+	r := &monReader{id: id, pod: pod, name: name}
+	for _, d := range domains {
+		r.domains = append(r.domains, &monDomain{
+			cacheID:   strings.TrimPrefix(filepath.Base(d), monDomainPrefix),
+			occupancy: &monFile{path: filepath.Join(d, "llc_occupancy")},
+			total:     &monFile{path: filepath.Join(d, "mbm_total_bytes")},
+			local:     &monFile{path: filepath.Join(d, "mbm_local_bytes")},
+		})
+	}
+
+	if m.readers == nil {
+		m.readers = make(map[string]*monReader)
+	}
+	if old, ok := m.readers[id]; ok {
+		old.close()
+	}
+	m.readers[id] = r
+
+	return nil
+}
+
+// stop stops reading the monitoring data of a container.
+func (m *monitors) stop(id string) {
+	m.Lock()
+	defer m.Unlock()
+
+	if r, ok := m.readers[id]; ok {
+		r.close()
+		delete(m.readers, id)
+	}
+}
+
+// stopAll stops reading the monitoring data of all containers.
+func (m *monitors) stopAll() {
+	m.Lock()
+	defer m.Unlock()
+
+	for id, r := range m.readers {
+		r.close()
+		delete(m.readers, id)
+	}
+}
+
+// collect reads and reports the monitoring data of all containers.
+func (m *monitors) collect(ch chan<- prometheus.Metric) {
+	m.Lock()
+	defer m.Unlock()
+
+	for _, r := range m.readers {
+		r.collect(ch)
+	}
+}
+
+// collect reads and reports the monitoring data of the container.
+func (r *monReader) collect(ch chan<- prometheus.Metric) {
+	now := time.Now()
+	period := now.Sub(r.stamp).Seconds()
+	first := r.stamp.IsZero()
+	r.stamp = now
+
+	for _, d := range r.domains {
+		labels := []string{r.id, r.pod, r.name, d.cacheID}
+
+		if value, ok := d.occupancy.read(); ok {
+			ch <- prometheus.MustNewConstMetric(llcOccupancyDesc,
+				prometheus.GaugeValue, float64(value), labels...)
+		}
+		for _, c := range []struct {
+			file *monFile
+			desc *prometheus.Desc
+		}{
+			{d.total, mbmTotalRateDesc},
+			{d.local, mbmLocalRateDesc},
+		} {
+			prev, valid := c.file.value, c.file.valid
+			value, ok := c.file.read()
+			// Skip the first sample and counters which have wrapped around or been reset.
+			if !ok || !valid || first || value < prev || period <= 0 {
+				continue
+			}
+			ch <- prometheus.MustNewConstMetric(c.desc,
+				prometheus.GaugeValue, float64(value-prev)/period, labels...)
+		}
+	}
+}
+
+// close closes all monitoring data files of the reader.
+func (r *monReader) close() {
+	for _, d := range r.domains {
+		d.occupancy.close()
+		d.total.close()
+		d.local.close()
+	}
+}
+
+// read re-reads the monitoring data file, returning its value.
+func (f *monFile) read() (uint64, bool) {
+	f.valid = false
+
+	if f.file == nil {
+		file, err := os.Open(f.path)
+		if err != nil {
+			return 0, false
+		}
+		f.file = file
+	}
+
+	var buf [32]byte
+	n, err := f.file.ReadAt(buf[:], 0)
+	if err != nil && err != io.EOF {
+		return 0, false
+	}
+
+	// The kernel reports 'Unavailable' or 'Error' if it fails to read a counter.
+	value, err := strconv.ParseUint(strings.TrimSpace(string(buf[:n])), 10, 64)
+	if err != nil {
+		return 0, false
+	}
+
+	f.value, f.valid = value, true
+	return value, true
+}
+
+// close closes the monitoring data file.
+func (f *monFile) close() {
+	if f.file != nil {
+		f.file.Close()
+		f.file = nil
+	}
+	f.valid = false
+}
+
+// monCollector is the prometheus collector for container monitoring data.
+type monCollector struct{}
+
+// newMonCollector creates a collector for container monitoring data.
+func newMonCollector() (prometheus.Collector, error) {
+	return &monCollector{}, nil
+}
+
+// Describe implements prometheus.Collector.
+func (c *monCollector) Describe(ch chan<- *prometheus.Desc) {
+	ch <- llcOccupancyDesc
+	ch <- mbmTotalRateDesc
+	ch <- mbmLocalRateDesc
+}
+
+// Collect implements prometheus.Collector.
+func (c *monCollector) Collect(ch chan<- prometheus.Metric) {
+	getRDTController().monitors.collect(ch)
+}
@@ -44,6 +44,7 @@ type rdtctl struct {
 	noQoSClasses bool          // true if we run without any classes configured
 	mode         OperatingMode // track the mode here to capture mode changes
 	opt          *config
+	monitors     monitors // container monitoring data readers
 }
 
 type config struct {
@@ -240,12 +241,16 @@ func (ctl *rdtctl) monitor(cls rdt.CtrlGroup, pod, name, id, pretty string, pids
 				pretty, cls.Name()+"/"+mg.Name(), err)
 		}
 		log.Info("%q: assigned to monitoring group %q", pretty, cls.Name()+"/"+mg.Name())
+		if err := ctl.monitors.start(cls, mg.Name(), id, pod, name); err != nil {
+			log.Warn("%q: failed to read monitoring data: %v", pretty, err)
+		}
 	}
 	return nil
 }
 
 // stopMonitor stops monitoring a container.
 func (ctl *rdtctl) stopMonitor(c cache.Container) error {
+	ctl.monitors.stop(c.GetID())
 	name := c.PrettyName()
 	for _, cls := range rdt.GetClasses() {
 		if mg, ok := cls.GetMonGroup(name); ok {
@@ -261,6 +266,7 @@ func (ctl *rdtctl) stopMonitor(c cache.Container) error {
 
 // stopMonitorAll removes all monitoring groups
 func (ctl *rdtctl) stopMonitorAll() error {
+	ctl.monitors.stopAll()
 	for _, cls := range rdt.GetClasses() {
 		if err := cls.DeleteMonGroups(); err != nil {
 			return err
@@ -379,5 +385,6 @@ func rdtError(format string, args ...interface{}) error {
 // Register us as a controller.
 func init() {
 	control.Register(RDTController, "RDT controller", getRDTController())
+	metrics.RegisterCollector(monCollectorName, newMonCollector)
 	pkgcfg.Register(ConfigModuleName, "RDT control", getRDTController().opt, getRDTController().defaultOptions)
 }
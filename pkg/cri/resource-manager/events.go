@@ -23,6 +23,11 @@ import (
 	logger "github.com/intel/cri-resource-manager/pkg/log"
 )
 
+const (
+	// time to hold back AVX512 first use of cgroups not resolving to a container
+	avxQueueTimeout = time.Minute
+)
+
 // Our logger instance for events.
 var evtlog = logger.NewLogger("events")
 
@@ -49,6 +54,8 @@ func (m *resmgr) startEventProcessing() error {
 		return nil
 	}
 
+	m.seedMetrics()
+
 	if err := m.metrics.Start(); err != nil {
 		return resmgrError("failed to start metrics (pre)processor: %v", err)
 	}
@@ -72,7 +79,19 @@ func (m *resmgr) startEventProcessing() error {
 				}
 				return
 			case event := <-m.events:
-				m.processEvent(event)
+				// Process any queued events before rebalancing, so that a burst
+				// of events triggers at most a single rebalancing cycle.
+				rebalance := m.processEvent(event)
+				for pending := len(m.events); pending > 0; pending-- {
+					if m.processEvent(<-m.events) {
+						rebalance = true
+					}
+				}
+				if rebalance {
+					if err := m.RebalanceContainers(); err != nil {
+						evtlog.Error("rebalancing failed: %v", err)
+					}
+				}
 			case _ = <-rebalanceChan:
 				if err := m.RebalanceContainers(); err != nil {
 					evtlog.Error("rebalancing failed: %v", err)
@@ -107,50 +126,170 @@ func (m *resmgr) SendEvent(event interface{}) error {
 	}
 }
 
-// processEvent processes the given event.
-func (m *resmgr) processEvent(e interface{}) {
+// processEvent processes the given event, returning true if rebalancing is needed.
+func (m *resmgr) processEvent(e interface{}) bool {
 	evtlog.Debug("received event of type %T...", e)
 
+	rebalance := false
 	switch event := e.(type) {
 	case string:
 		evtlog.Debug("'%s'...", event)
 	case *events.Metrics:
-		m.processAvx(event.Avx)
+		// Move the containers with changed AVX512 usage or memory bandwidth
+		// hogging right away. Rebalancing would leave Guaranteed containers
+		// where they are.
+		if changed := m.processAvx(event.Avx); len(changed) > 0 {
+			method := "AvxUpdate"
+			if event.Avx.Urgent {
+				method = "AvxFirstUse"
+			}
+			if err := m.reallocateContainers(method, changed); err != nil {
+				evtlog.Error("reallocating AVX512 containers failed: %v", err)
+			}
+		}
+		if changed := m.processRdt(event.Rdt); len(changed) > 0 {
+			if err := m.reallocateContainers("MemBandwidthUpdate", changed); err != nil {
+				evtlog.Error("reallocating memory bandwidth hogs failed: %v", err)
+			}
+			// spread the rest of the containers around the moved hogs
+			rebalance = true
+		}
 	case *events.Policy:
 		m.DeliverPolicyEvent(event)
 	default:
 		evtlog.Warn("event of unexpected type %T...", e)
 	}
+	return rebalance
+}
+
+// seedMetrics restores the metrics preprocessor filter state from cached container tags.
+func (m *resmgr) seedMetrics() {
+	avx, mbw := []string{}, []string{}
+	for _, c := range m.cache.GetContainers() {
+		if _, ok := c.GetTag(cache.TagAVX512); ok {
+			if dir := c.GetCgroupDir(); dir != "" {
+				avx = append(avx, dir)
+			}
+		}
+		if _, ok := c.GetTag(cache.TagMemBandwidthHog); ok {
+			mbw = append(mbw, c.GetID())
+		}
+	}
+	m.metrics.SeedAvx(avx)
+	m.metrics.SeedMbw(mbw)
 }
 
-// processAvx processes AVX512 events.
-func (m *resmgr) processAvx(e *events.Avx) bool {
+// processAvx processes AVX512 events, returning the containers with changed tags.
+func (m *resmgr) processAvx(e *events.Avx) []cache.Container {
 	if e == nil {
-		return false
+		return nil
 	}
 
 	m.Lock()
 	defer m.Unlock()
 
-	changes := false
+	changed := []cache.Container{}
 	for cgroup, active := range e.Updates {
 		c, ok := m.resolveCgroupPath(cgroup)
 		if !ok {
+			// first use might be noticed before the container is in the cache
+			if e.Urgent && active {
+				m.queueAvx(cgroup)
+			}
 			continue
 		}
-		// XXX This is just for testing, we should effectively drive state transitions
-		//     through a low-pass filter.
+		delete(m.avxQueued, cgroup)
+		// State transitions are already low-pass filtered with hysteresis
+		// by the metrics preprocessor, so we can act on them directly.
 		if active {
 			if _, wasTagged := c.SetTag(cache.TagAVX512, "true"); !wasTagged {
 				evtlog.Info("container %s STARTED using AVX512 instructions", c.PrettyName())
+				changed = append(changed, c)
 			}
 		} else {
 			if _, wasTagged := c.DeleteTag(cache.TagAVX512); wasTagged {
 				evtlog.Info("container %s STOPPED using AVX512 instructions", c.PrettyName())
+				changed = append(changed, c)
+			}
+		}
+	}
+	return changed
+}
+
+// queueAvx holds back AVX512 first use of a cgroup until it resolves to a container.
+func (m *resmgr) queueAvx(cgroup string) {
+	if m.avxQueued == nil {
+		m.avxQueued = make(map[string]time.Time)
+	}
+	if _, ok := m.avxQueued[cgroup]; !ok {
+		evtlog.Debug("queueing AVX512 first use of unknown cgroup %s", cgroup)
+		m.avxQueued[cgroup] = time.Now()
+	}
+}
+
+// requeueAvx redelivers queued AVX512 first use of cgroups which now resolve
+// to a container. It is called with the lock held, when containers show up.
+func (m *resmgr) requeueAvx() {
+	if len(m.avxQueued) == 0 {
+		return
+	}
+
+	now := time.Now()
+	updates := map[string]bool{}
+	for cgroup, since := range m.avxQueued {
+		if now.Sub(since) > avxQueueTimeout {
+			delete(m.avxQueued, cgroup)
+			continue
+		}
+		if _, ok := m.resolveCgroupPath(cgroup); ok {
+			updates[cgroup] = true
+			delete(m.avxQueued, cgroup)
+		}
+	}
+	if len(updates) == 0 {
+		return
+	}
+
+	event := &events.Metrics{
+		Avx: &events.Avx{
+			Updates: updates,
+			Urgent:  true,
+		},
+	}
+	if err := m.SendEvent(event); err != nil {
+		evtlog.Error("failed to redeliver AVX512 first use: %v", err)
+	}
+}
+
+// processRdt processes RDT monitoring events, returning the containers with changed tags.
+func (m *resmgr) processRdt(e *events.Rdt) []cache.Container {
+	if e == nil {
+		return nil
+	}
+
+	m.Lock()
+	defer m.Unlock()
+
+	changed := []cache.Container{}
+	for id, hog := range e.Updates {
+		c, ok := m.cache.LookupContainer(id)
+		if !ok {
+			continue
+		}
+		// Like for AVX512, hog status changes are already low-pass filtered.
+		if hog {
+			if _, wasTagged := c.SetTag(cache.TagMemBandwidthHog, "true"); !wasTagged {
+				evtlog.Info("container %s STARTED hogging memory bandwidth", c.PrettyName())
+				changed = append(changed, c)
+			}
+		} else {
+			if _, wasTagged := c.DeleteTag(cache.TagMemBandwidthHog); wasTagged {
+				evtlog.Info("container %s STOPPED hogging memory bandwidth", c.PrettyName())
+				changed = append(changed, c)
 			}
 		}
 	}
-	return changes
+	return changed
 }
 
 // resolveCgroupPath resolves a cgroup path to a container.
@@ -18,12 +18,37 @@ package events
 type Metrics struct {
 	// Avx describes changes in container AVX512 instruction usage.
 	Avx *Avx
+	// Rdt describes container cache and memory bandwidth usage.
+	Rdt *Rdt
 }
 
 // AVX contains data related to container AVX512 instruction usage.
 type Avx struct {
-	// Updates contains containers with a change in their AVX512 instruction usage.
+	// Updates contains the filtered AVX512 instruction usage state of containers,
+	// for all tracked containers, not only the ones with a change.
 	Updates map[string]bool
+	// Urgent is set for changes detected directly by the eBPF program instead of
+	// periodic metrics collection. These should be acted upon immediately.
+	Urgent bool
+}
+
+// Rdt contains data related to container cache and memory bandwidth usage.
+type Rdt struct {
+	// Usage contains the cache and memory bandwidth usage of containers, by container ID.
+	Usage map[string]*RdtUsage
+	// Updates contains the filtered memory bandwidth hog state of containers,
+	// for all tracked containers, not only the ones with a change.
+	Updates map[string]bool
+}
+
+// RdtUsage is the cache and memory bandwidth usage of a container.
+type RdtUsage struct {
+	// LLCOccupancy is the last-level cache occupancy in bytes.
+	LLCOccupancy uint64
+	// MBMTotal is the total memory bandwidth in bytes per second.
+	MBMTotal float64
+	// MBMLocal is the local memory bandwidth in bytes per second.
+	MBMLocal float64
 }
 
 // Policy is a policy-specific event to be handled by the active policy.
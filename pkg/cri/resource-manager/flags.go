@@ -38,6 +38,9 @@ type options struct {
 	ResetConfig         bool
 	MetricsTimer        time.Duration
 	RebalanceTimer      time.Duration
+	UpdateWindow        time.Duration
+	WarmRestart         bool
+	SyncConcurrency     int
 	DisableUI           bool
 }
 
@@ -72,11 +75,17 @@ func init() {
 		"Reset policy data stored in the cache, then exit.")
 	flag.BoolVar(&opt.DisablePolicySwitch, "disable-policy-switch", false,
 		"Disable switching policies during startup.")
+	flag.BoolVar(&opt.WarmRestart, "warm-restart", false,
+		"Start from the cached state and reconcile it with the runtime in the background.")
+	flag.IntVar(&opt.SyncConcurrency, "sync-concurrency", 8,
+		"Maximum number of concurrent runtime queries while synchronizing the cache.")
 
 	flag.DurationVar(&opt.MetricsTimer, "metrics-interval", 0,
 		"Interval for polling/gathering runtime metrics data. Use 'disable' for disabling.")
 	flag.DurationVar(&opt.RebalanceTimer, "rebalance-interval", 0,
 		"Minimum interval between two container rebalancing attempts. Use 'disable' for disabling.")
+	flag.DurationVar(&opt.UpdateWindow, "update-coalesce-window", 0,
+		"Time to collect resource updates of running containers for, before sending them to the runtime.")
 
 	flag.BoolVar(&opt.DisableUI, "disable-ui", false,
 		"Disable serving container placement visualization UIs.")
@@ -0,0 +1,26 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// +build !noavx
+
+package metrics
+
+import (
+	"github.com/intel/cri-resource-manager/pkg/avx"
+)
+
+// notifyAvxFirstUse subscribes to AVX512 first use notifications of the eBPF collector.
+func (m *Metrics) notifyAvxFirstUse() {
+	avx.NotifyFirstUse(m.avxFirstUse)
+}
@@ -17,21 +17,73 @@ package metrics
 import (
 	model "github.com/prometheus/client_model/go"
 	"path/filepath"
+	"time"
 
 	"github.com/intel/cri-resource-manager/pkg/cgroups"
 	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/events"
 )
 
+// collectAvxEvents returns the filtered AVX512 usage state of cgroups.
 func (m *Metrics) collectAvxEvents(raw map[string]*model.MetricFamily) *events.Avx {
+	usage, threshold := m.collectAvxUsage(raw)
+
+	updates := m.avx.states(m.avx.update(usage, threshold, time.Now()))
+	if len(updates) == 0 {
+		return nil
+	}
+
+	return &events.Avx{Updates: updates}
+}
+
+// SeedAvx restores the AVX512-active state of cgroups, for instance from a cache.
+func (m *Metrics) SeedAvx(cgroups []string) {
+	m.avx.seed(cgroups, time.Now())
+}
+
+// avxFirstUse delivers an urgent event about a cgroup starting to use AVX512.
+func (m *Metrics) avxFirstUse(path string) {
+	cgroup, err := filepath.Rel(cgroups.GetV2Dir(), path)
+	if err != nil {
+		return
+	}
+	cgroup = "/" + cgroup
+
+	if !m.avx.activate(cgroup, time.Now()) {
+		return
+	}
+
+	event := &events.Metrics{
+		Avx: &events.Avx{
+			Updates: map[string]bool{cgroup: true},
+			Urgent:  true,
+		},
+	}
+	if err := m.sendEvent(event); err != nil {
+		log.Error("failed to deliver AVX512 first use event: %v", err)
+	}
+}
+
+// collectAvxUsage returns the AVX512 usage of cgroups and the threshold for being AVX512-active.
+func (m *Metrics) collectAvxUsage(raw map[string]*model.MetricFamily) (map[string]float64, float64) {
+	usage := map[string]float64{}
+
+	if residency := m.collectAvxResidency(raw); residency != nil {
+		for cgroup, share := range residency {
+			log.Debug(" %s AVX512 CPU share = %f", cgroup, share)
+			usage["/"+cgroup] = share
+		}
+		return usage, m.opts.AvxResidencyThreshold
+	}
+
 	all, ok := raw["all_switch_count_per_cgroup"]
 	if !ok {
-		return nil
+		return usage, m.opts.AvxThreshold
 	}
 	dump("all context switches", all)
 
 	avx, ok := raw["avx_switch_count_per_cgroup"]
 	if !ok {
-		return nil
+		return usage, m.opts.AvxThreshold
 	}
 	dump("AVX context switches", avx)
 
@@ -51,12 +103,35 @@ func (m *Metrics) collectAvxEvents(raw map[string]*model.MetricFamily) *events.A
 		ratio[cgroup] /= v.Gauge.GetValue()
 	}
 
-	usage := map[string]bool{}
 	for cgroup, use := range ratio {
-		active := use >= m.opts.AvxThreshold
-		log.Debug(" %s AVX ratio = %f, active?: %v", cgroup, use, active)
-		usage["/"+cgroup] = active
+		log.Debug(" %s AVX ratio = %f", cgroup, use)
+		usage["/"+cgroup] = use
+	}
+
+	return usage, m.opts.AvxThreshold
+}
+
+// collectAvxResidency returns the share of a CPU per cgroup used with AVX512 since the last poll.
+func (m *Metrics) collectAvxResidency(raw map[string]*model.MetricFamily) map[string]float64 {
+	if m.opts.PollInterval <= 0 {
+		return nil
+	}
+
+	resi, ok := raw["avx512_residency_ns_per_cgroup"]
+	if !ok {
+		return nil
+	}
+	dump("AVX512 residency", resi)
+
+	period := float64(m.opts.PollInterval.Nanoseconds())
+	share := map[string]float64{}
+	for _, v := range resi.Metric {
+		cgroup, err := filepath.Rel(cgroups.GetV2Dir(), v.Label[0].GetValue())
+		if err != nil {
+			continue
+		}
+		share[cgroup] = v.Gauge.GetValue() / period
 	}
 
-	return &events.Avx{Updates: usage}
+	return share
 }
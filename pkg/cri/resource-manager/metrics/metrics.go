@@ -37,6 +37,16 @@ import (
 const (
 	// DefaultAvxThreshold is the cutoff below which a cgroup/container is not an AVX user.
 	DefaultAvxThreshold = float64(0.1)
+	// DefaultAvxResidencyThreshold is the cutoff for the share of a CPU used with AVX512.
+	DefaultAvxResidencyThreshold = float64(0.05)
+	// DefaultAvxSmoothing is the default EWMA smoothing factor for AVX512 usage.
+	DefaultAvxSmoothing = float64(0.3)
+	// DefaultAvxExitRatio is the default exit threshold relative to the AVX512-active threshold.
+	DefaultAvxExitRatio = float64(0.5)
+	// DefaultAvxMinDwell is the default minimum time between AVX512 state changes of a cgroup.
+	DefaultAvxMinDwell = 30 * time.Second
+	// DefaultMbwThreshold is the memory bandwidth (bytes/s) above which a container is a hog.
+	DefaultMbwThreshold = float64(4 << 30)
 )
 
 // Options describes options for metrics collection and processing.
@@ -47,6 +57,21 @@ type Options struct {
 	Events chan interface{}
 	// AvxThreshold is the threshold (0 - 1) for a cgroup to be considered AVX512-active
 	AvxThreshold float64
+	// AvxResidencyThreshold is the threshold for the share of a CPU (AVX512 residency
+	// per PollInterval) for a cgroup to be considered AVX512-active. It is used instead
+	// of AvxThreshold when residency metrics are available.
+	AvxResidencyThreshold float64
+	// AvxSmoothing is the EWMA smoothing factor (0 - 1) of AVX512 usage, 1 disables smoothing.
+	AvxSmoothing float64
+	// AvxExitRatio is the threshold for a cgroup to stop being AVX512-active, relative to
+	// the threshold for becoming one.
+	AvxExitRatio float64
+	// AvxMinDwell is the minimum time a cgroup stays in an AVX512 state before changing it.
+	AvxMinDwell time.Duration
+	// MbwThreshold is the total memory bandwidth (bytes/s) for a container to be considered
+	// a memory bandwidth hog. Memory bandwidth is filtered using the same smoothing factor,
+	// exit ratio and minimum dwell time as AVX512 usage.
+	MbwThreshold float64
 }
 
 // Metrics implements collecting, caching and processing of raw metrics.
@@ -57,6 +82,8 @@ type Metrics struct {
 	stop chan interface{}      // channel to stop polling goroutine
 	raw  []*model.MetricFamily // latest set of raw metrics
 	pend []*model.MetricFamily // pending metrics for forwarding
+	avx  *usageFilter          // AVX512 usage low-pass filter
+	mbw  *usageFilter          // memory bandwidth usage low-pass filter
 }
 
 // Our logger instance.
@@ -70,6 +97,21 @@ func NewMetrics(opts Options) (*Metrics, error) {
 	if opts.AvxThreshold == 0.0 {
 		opts.AvxThreshold = DefaultAvxThreshold
 	}
+	if opts.AvxResidencyThreshold == 0.0 {
+		opts.AvxResidencyThreshold = DefaultAvxResidencyThreshold
+	}
+	if opts.AvxSmoothing == 0.0 {
+		opts.AvxSmoothing = DefaultAvxSmoothing
+	}
+	if opts.AvxExitRatio == 0.0 {
+		opts.AvxExitRatio = DefaultAvxExitRatio
+	}
+	if opts.AvxMinDwell == 0 {
+		opts.AvxMinDwell = DefaultAvxMinDwell
+	}
+	if opts.MbwThreshold == 0.0 {
+		opts.MbwThreshold = DefaultMbwThreshold
+	}
 
 	g, err := metrics.NewMetricGatherer()
 	if err != nil {
@@ -80,10 +122,13 @@ func NewMetrics(opts Options) (*Metrics, error) {
 		opts: opts,
 		raw:  make([]*model.MetricFamily, 0),
 		g:    g,
+		avx:  newAvxFilter(opts.AvxSmoothing, opts.AvxExitRatio, opts.AvxMinDwell),
+		mbw:  newMbwFilter(opts.AvxSmoothing, opts.AvxExitRatio, opts.AvxMinDwell),
 	}
 
 	m.poll()
 	instrumentation.RegisterGatherer(m)
+	m.notifyAvxFirstUse()
 
 	return m, nil
 }
@@ -162,6 +207,7 @@ func (m *Metrics) process() error {
 
 	event := &events.Metrics{
 		Avx: m.collectAvxEvents(raw),
+		Rdt: m.collectRdtEvents(raw),
 	}
 
 	return m.sendEvent(event)
@@ -0,0 +1,104 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metrics
+
+import (
+	"time"
+
+	model "github.com/prometheus/client_model/go"
+
+	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/events"
+)
+
+const (
+	// rdtLLCOccupancy is the metric family of container LLC occupancy.
+	rdtLLCOccupancy = "rdt_container_llc_occupancy_bytes"
+	// rdtMBMTotal is the metric family of container total memory bandwidth.
+	rdtMBMTotal = "rdt_container_mbm_total_bytes_per_second"
+	// rdtMBMLocal is the metric family of container local memory bandwidth.
+	rdtMBMLocal = "rdt_container_mbm_local_bytes_per_second"
+	// rdtContainerLabel is the label for the container ID in RDT metrics.
+	rdtContainerLabel = "container_id"
+)
+
+// collectRdtEvents returns the cache and memory bandwidth usage of containers.
+func (m *Metrics) collectRdtEvents(raw map[string]*model.MetricFamily) *events.Rdt {
+	usage := m.collectRdtUsage(raw)
+	if len(usage) == 0 {
+		return nil
+	}
+
+	bandwidth := make(map[string]float64, len(usage))
+	for id, u := range usage {
+		bandwidth[id] = u.MBMTotal
+	}
+
+	return &events.Rdt{
+		Usage:   usage,
+		Updates: m.mbw.states(m.mbw.update(bandwidth, m.opts.MbwThreshold, time.Now())),
+	}
+}
+
+// SeedMbw restores the memory bandwidth hog state of containers, for instance from a cache.
+func (m *Metrics) SeedMbw(ids []string) {
+	m.mbw.seed(ids, time.Now())
+}
+
+// collectRdtUsage sums up the usage of containers over all cache monitoring domains.
+func (m *Metrics) collectRdtUsage(raw map[string]*model.MetricFamily) map[string]*events.RdtUsage {
+	usage := map[string]*events.RdtUsage{}
+
+	for _, name := range []string{rdtLLCOccupancy, rdtMBMTotal, rdtMBMLocal} {
+		f, ok := raw[name]
+		if !ok {
+			continue
+		}
+		for _, v := range f.Metric {
+			id := ""
+			for _, l := range v.Label {
+				if l.GetName() == rdtContainerLabel {
+					id = l.GetValue()
+					break
+				}
+			}
+			if id == "" {
+				continue
+			}
+
+			u, ok := usage[id]
+			if !ok {
+				u = &events.RdtUsage{}
+				usage[id] = u
+			}
+
+			value := v.Gauge.GetValue()
+			switch name {
+			case rdtLLCOccupancy:
+				u.LLCOccupancy += uint64(value)
+			case rdtMBMTotal:
+				u.MBMTotal += value
+			case rdtMBMLocal:
+				u.MBMLocal += value
+			}
+		}
+	}
+
+	for id, u := range usage {
+		log.Debug(" %s LLC occupancy = %d, memory bandwidth = %f (local %f)",
+			id, u.LLCOccupancy, u.MBMTotal, u.MBMLocal)
+	}
+
+	return usage
+}
@@ -0,0 +1,129 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metrics
+
+import (
+	"testing"
+
+	model "github.com/prometheus/client_model/go"
+
+	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/events"
+)
+
+func rdtFamily(name string, samples map[[2]string]float64) *model.MetricFamily {
+	str := func(s string) *string { return &s }
+	f := &model.MetricFamily{Name: str(name)}
+	for key, value := range samples {
+		value := value
+		f.Metric = append(f.Metric, &model.Metric{
+			Label: []*model.LabelPair{
+				{Name: str("container_id"), Value: str(key[0])},
+				{Name: str("cache_id"), Value: str(key[1])},
+			},
+			Gauge: &model.Gauge{Value: &value},
+		})
+	}
+	return f
+}
+
+func TestRdtEvents(t *testing.T) {
+	m := &Metrics{
+		opts: Options{MbwThreshold: 1000},
+		mbw:  newMbwFilter(1.0, 0.5, 0),
+	}
+
+	tcases := []struct {
+		name     string
+		raw      []*model.MetricFamily
+		usage    map[string]events.RdtUsage
+		expected map[string]bool
+	}{
+		{
+			name: "no monitoring data",
+		},
+		{
+			name: "usage is summed up over cache domains",
+			raw: []*model.MetricFamily{
+				rdtFamily(rdtLLCOccupancy, map[[2]string]float64{{"c0", "0"}: 1024, {"c0", "1"}: 2048, {"c1", "0"}: 512}),
+				rdtFamily(rdtMBMTotal, map[[2]string]float64{{"c0", "0"}: 600, {"c0", "1"}: 600, {"c1", "0"}: 100}),
+				rdtFamily(rdtMBMLocal, map[[2]string]float64{{"c0", "0"}: 500, {"c1", "0"}: 50}),
+			},
+			usage: map[string]events.RdtUsage{
+				"c0": {LLCOccupancy: 3072, MBMTotal: 1200, MBMLocal: 500},
+				"c1": {LLCOccupancy: 512, MBMTotal: 100, MBMLocal: 50},
+			},
+			expected: map[string]bool{"c0": true},
+		},
+		{
+			name: "hog status is only updated on changes",
+			raw: []*model.MetricFamily{
+				rdtFamily(rdtMBMTotal, map[[2]string]float64{{"c0", "0"}: 1100, {"c1", "0"}: 1500}),
+			},
+			usage: map[string]events.RdtUsage{
+				"c0": {MBMTotal: 1100},
+				"c1": {MBMTotal: 1500},
+			},
+			expected: map[string]bool{"c1": true},
+		},
+		{
+			name: "hogs are released below exit threshold",
+			raw: []*model.MetricFamily{
+				rdtFamily(rdtMBMTotal, map[[2]string]float64{{"c0", "0"}: 400, {"c1", "0"}: 600}),
+			},
+			usage: map[string]events.RdtUsage{
+				"c0": {MBMTotal: 400},
+				"c1": {MBMTotal: 600},
+			},
+			expected: map[string]bool{"c0": false},
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			raw := map[string]*model.MetricFamily{}
+			for _, f := range tc.raw {
+				raw[f.GetName()] = f
+			}
+
+			e := m.collectRdtEvents(raw)
+			if tc.usage == nil {
+				if e != nil {
+					t.Errorf("expected no event, got %v", *e)
+				}
+				return
+			}
+			if e == nil {
+				t.Fatalf("expected an event, got none")
+			}
+
+			if len(e.Usage) != len(tc.usage) {
+				t.Errorf("expected usage of %d containers, got %d", len(tc.usage), len(e.Usage))
+			}
+			for id, expected := range tc.usage {
+				if u, ok := e.Usage[id]; !ok || *u != expected {
+					t.Errorf("expected usage %v for %s, got %v", expected, id, u)
+				}
+			}
+
+			if len(e.Updates) != len(tc.expected) {
+				t.Errorf("expected updates %v, got %v", tc.expected, e.Updates)
+			}
+			for id, hog := range tc.expected {
+				if update, ok := e.Updates[id]; !ok || update != hog {
+					t.Errorf("expected update %s=%v, got %v", id, hog, e.Updates)
+				}
+			}
+		})
+	}
+}
@@ -0,0 +1,173 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metrics
+
+import (
+	"sync"
+	"time"
+)
+
+const (
+	// usageForgetRatio is the share of the threshold below which we forget inactive cgroups.
+	usageForgetRatio = 0.01
+)
+
+// usageFilter is a low-pass filter with hysteresis for cgroup resource usage,
+// like AVX512 or memory bandwidth.
+//
+// Usage is smoothed with an exponentially weighted moving average. A cgroup
+// becomes active once its estimate reaches the threshold and stops
+// being one only once the estimate drops below exit * threshold. A cgroup
+// needs to stay in a state at least for dwell before it can change state.
+type usageFilter struct {
+	sync.Mutex
+	name    string                 // name of the filtered usage, for logging
+	alpha   float64                // EWMA smoothing factor
+	exit    float64                // exit threshold relative to the enter threshold
+	dwell   time.Duration          // minimum time between state changes
+	cgroups map[string]*usageState // tracked cgroups
+	last    float64                // last threshold used
+}
+
+// usageState is the filtered usage state of a single cgroup.
+type usageState struct {
+	estimate float64   // smoothed usage
+	active   bool      // whether the cgroup is active
+	since    time.Time // time of the last state change
+	seeded   bool      // state restored without an estimate, start from the threshold
+}
+
+// newUsageFilter creates a new usage filter.
+func newUsageFilter(name string, alpha, exit float64, dwell time.Duration) *usageFilter {
+	return &usageFilter{
+		name:    name,
+		alpha:   alpha,
+		exit:    exit,
+		dwell:   dwell,
+		cgroups: make(map[string]*usageState),
+	}
+}
+
+// newAvxFilter creates a new AVX512 usage filter.
+func newAvxFilter(alpha, exit float64, dwell time.Duration) *usageFilter {
+	return newUsageFilter("AVX512", alpha, exit, dwell)
+}
+
+// newMbwFilter creates a new memory bandwidth usage filter.
+func newMbwFilter(alpha, exit float64, dwell time.Duration) *usageFilter {
+	return newUsageFilter("memory bandwidth", alpha, exit, dwell)
+}
+
+// update feeds a new set of samples to the filter and returns the resulting state changes.
+// Tracked cgroups not present in usage are considered to have had no usage.
+func (f *usageFilter) update(usage map[string]float64, threshold float64, now time.Time) map[string]bool {
+	f.Lock()
+	defer f.Unlock()
+
+	f.last = threshold
+	changes := map[string]bool{}
+
+	for cgroup := range usage {
+		if _, ok := f.cgroups[cgroup]; !ok {
+			f.cgroups[cgroup] = &usageState{}
+		}
+	}
+
+	for cgroup, s := range f.cgroups {
+		if s.seeded {
+			s.estimate = threshold
+			s.seeded = false
+		}
+		s.estimate = f.alpha*usage[cgroup] + (1.0-f.alpha)*s.estimate
+		dwelled := now.Sub(s.since) >= f.dwell
+
+		switch {
+		case !s.active && s.estimate >= threshold && dwelled:
+			s.active = true
+			s.since = now
+			changes[cgroup] = true
+		case s.active && s.estimate < f.exit*threshold && dwelled:
+			s.active = false
+			s.since = now
+			changes[cgroup] = false
+		}
+
+		log.Debug(" %s %s usage estimate = %f, active?: %v", cgroup, f.name, s.estimate, s.active)
+
+		if !s.active && s.estimate < usageForgetRatio*threshold {
+			delete(f.cgroups, cgroup)
+		}
+	}
+
+	return changes
+}
+
+// activate forces a cgroup active, returning true if this is a state change.
+func (f *usageFilter) activate(cgroup string, now time.Time) bool {
+	f.Lock()
+	defer f.Unlock()
+
+	s, ok := f.cgroups[cgroup]
+	if !ok {
+		s = &usageState{}
+		f.cgroups[cgroup] = s
+	}
+	if s.active {
+		return false
+	}
+
+	s.active = true
+	s.since = now
+	if s.estimate < f.last {
+		s.estimate = f.last
+	}
+
+	return true
+}
+
+// seed marks cgroups active with a state restored from elsewhere, like the cache.
+func (f *usageFilter) seed(cgroups []string, now time.Time) {
+	f.Lock()
+	defer f.Unlock()
+
+	for _, cgroup := range cgroups {
+		if _, ok := f.cgroups[cgroup]; ok {
+			continue
+		}
+		f.cgroups[cgroup] = &usageState{
+			active: true,
+			since:  now,
+			seeded: true,
+		}
+	}
+}
+
+// states adds the filtered state of all tracked cgroups to updates. Besides
+// the state changes of the last update, we report the current state of all
+// cgroups on every poll, so a change the receiver could not act on yet (for
+// instance for a container not in its cache yet) does not get lost.
+func (f *usageFilter) states(updates map[string]bool) map[string]bool {
+	f.Lock()
+	defer f.Unlock()
+
+	if updates == nil {
+		updates = make(map[string]bool, len(f.cgroups))
+	}
+	for cgroup, s := range f.cgroups {
+		updates[cgroup] = s.active
+	}
+
+	return updates
+}
@@ -0,0 +1,123 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metrics
+
+import (
+	"testing"
+	"time"
+)
+
+func TestUsageFilter(t *testing.T) {
+	const (
+		cgroup    = "/kubepods/pod0/ctr0"
+		threshold = 0.1
+		period    = 10 * time.Second
+	)
+
+	tcases := []struct {
+		name     string
+		alpha    float64
+		dwell    time.Duration
+		samples  []float64 // usage per period, negative for no sample
+		expected []int     // expected change per period, 1 = start, -1 = stop
+	}{
+		{
+			name:     "steady usage activates",
+			alpha:    0.5,
+			samples:  []float64{0.4, 0.4, 0.4},
+			expected: []int{1, 0, 0},
+		},
+		{
+			name:     "single burst is filtered out",
+			alpha:    0.3,
+			samples:  []float64{0.2, 0, 0, 0},
+			expected: []int{0, 0, 0, 0},
+		},
+		{
+			name:     "hysteresis prevents flapping",
+			alpha:    1.0,
+			samples:  []float64{0.2, 0.08, 0.12, 0.06, 0.04},
+			expected: []int{1, 0, 0, 0, -1},
+		},
+		{
+			name:     "missing samples decay the estimate",
+			alpha:    0.5,
+			samples:  []float64{0.4, -1, -1, -1},
+			expected: []int{1, 0, 0, -1},
+		},
+		{
+			name:     "dwell time delays deactivation",
+			alpha:    1.0,
+			dwell:    25 * time.Second,
+			samples:  []float64{0.4, 0, 0, 0},
+			expected: []int{1, 0, 0, -1},
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			f := newAvxFilter(tc.alpha, 0.5, tc.dwell)
+			now := time.Now()
+			for i, sample := range tc.samples {
+				usage := map[string]float64{}
+				if sample >= 0 {
+					usage[cgroup] = sample
+				}
+				changes := f.update(usage, threshold, now)
+
+				active, changed := changes[cgroup]
+				switch {
+				case tc.expected[i] == 0 && changed:
+					t.Errorf("period %d: unexpected change to active=%v", i, active)
+				case tc.expected[i] == 1 && !(changed && active):
+					t.Errorf("period %d: expected cgroup to become active", i)
+				case tc.expected[i] == -1 && !(changed && !active):
+					t.Errorf("period %d: expected cgroup to become inactive", i)
+				}
+				now = now.Add(period)
+			}
+		})
+	}
+}
+
+func TestUsageFilterStates(t *testing.T) {
+	const (
+		threshold = 0.1
+		period    = 10 * time.Second
+	)
+
+	f := newAvxFilter(1.0, 0.5, 0)
+	now := time.Now()
+
+	// restored cgroups are reported active until their usage drops
+	f.seed([]string{"/ctr0", "/ctr1"}, now)
+	usage := map[string]float64{"/ctr0": 0.4, "/ctr2": 0.2}
+	states := f.states(f.update(usage, threshold, now))
+	expected := map[string]bool{"/ctr0": true, "/ctr1": false, "/ctr2": true}
+	for cgroup, active := range expected {
+		if s, ok := states[cgroup]; !ok || s != active {
+			t.Errorf("period 0: expected %s active=%v, got %v (reported %v)", cgroup, active, s, ok)
+		}
+	}
+
+	// unchanged states are reported on every poll
+	now = now.Add(period)
+	states = f.states(f.update(usage, threshold, now))
+	if !states["/ctr0"] || !states["/ctr2"] {
+		t.Errorf("period 1: expected active /ctr0 and /ctr2 to be reported, got %v", states)
+	}
+	if _, ok := states["/ctr1"]; ok {
+		t.Errorf("period 1: unexpected report of forgotten /ctr1")
+	}
+}
@@ -0,0 +1,68 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package resmgr
+
+import (
+	"sync"
+)
+
+// podLocks serializes the processing of requests for the same pod.
+//
+// Requests for different pods are processed in parallel. They are only
+// serialized by the resource manager lock while they update the cache or
+// the policy, which is never held while a request is being processed by
+// the runtime.
+type podLocks struct {
+	sync.Mutex
+	locks map[string]*podLock // locks in use, by pod ID
+}
+
+// podLock is the lock for a single pod.
+type podLock struct {
+	sync.Mutex
+	users int // number of requests holding or waiting for the lock
+}
+
+// lock locks the given pod.
+func (p *podLocks) lock(podID string) {
+	p.Lock()
+	if p.locks == nil {
+		p.locks = make(map[string]*podLock)
+	}
+	l, ok := p.locks[podID]
+	if !ok {
+		l = &podLock{}
+		p.locks[podID] = l
+	}
+	l.users++
+	p.Unlock()
+
+	l.Lock()
+}
+
+// unlock unlocks the given pod.
+func (p *podLocks) unlock(podID string) {
+	p.Lock()
+	defer p.Unlock()
+
+	l, ok := p.locks[podID]
+	if !ok {
+		return
+	}
+	l.Unlock()
+	if l.users--; l.users == 0 {
+		delete(p.locks, podID)
+	}
+}
@@ -87,6 +87,12 @@ func (mca *mockCpuAllocator) ReleaseCpus(*cpuset.CPUSet, int, cpuallocator.CPUPr
 	return cpuset.NewCPUSet(), nil
 }
 
+func (mca *mockCpuAllocator) AllocateWideVectorCpus(from *cpuset.CPUSet, cnt int, prefer cpuallocator.CPUPriority) (cpuset.CPUSet, error) {
+	return mca.AllocateCpus(from, cnt, prefer)
+}
+
+func (mca *mockCpuAllocator) SetWideVectorCpus(cpuset.CPUSet) {}
+
 func TestApplyPoolDef(t *testing.T) {
 	reservedCpus1 := cpuset.CPUSet{}
 	reservedPoolDef := PoolDef{
@@ -122,6 +122,7 @@ type cachedGrant struct {
 	Memset      system.IDSet
 	MemoryLimit memoryMap
 	ColdStart   time.Duration
+	WideVector  bool `json:",omitempty"`
 }
 
 func newCachedGrant(cg Grant) *cachedGrant {
@@ -141,6 +142,7 @@ func newCachedGrant(cg Grant) *cachedGrant {
 	}
 
 	ccg.ColdStart = cg.ColdStart()
+	ccg.WideVector = cg.WideVector()
 
 	return ccg
 }
@@ -165,6 +167,7 @@ func (ccg *cachedGrant) ToGrant(policy *policy) (Grant, error) {
 		ccg.MemoryLimit,
 		ccg.ColdStart,
 	)
+	g.SetWideVector(ccg.WideVector)
 
 	if g.Memset().String() != ccg.Memset.String() {
 		log.Error("cache error: mismatch in stored/recalculated memset: %s != %s",
@@ -29,6 +29,12 @@ type options struct {
 	PreferIsolated bool `json:"PreferIsolatedCPUs"`
 	// PreferShared controls whether shared CPU allocation is always preferred by default.
 	PreferShared bool `json:"PreferSharedCPUs"`
+	// PackAVX512 controls whether AVX512-heavy containers are packed onto wide-vector CPUs.
+	PackAVX512 bool `json:"PackAVX512,omitempty"`
+	// WideVectorCPUs is the set of CPUs dedicated to AVX512-heavy containers.
+	WideVectorCPUs string `json:"WideVectorCPUs,omitempty"`
+	// AVX512LowPriority controls whether AVX512-heavy containers prefer low-priority CPUs.
+	AVX512LowPriority bool `json:"AVX512LowPriorityCPUs,omitempty"`
 	// FakeHints are the set of fake TopologyHints to use for testing purposes.
 	FakeHints fakehints `json:",omitempty"`
 }
@@ -258,6 +258,7 @@ type mockContainer struct {
 	cpuset                                cpuset.CPUSet
 	returnValueForQOSClass                v1.PodQOSClass
 	pod                                   cache.Pod
+	tags                                  map[string]string
 }
 
 func (m *mockContainer) PrettyName() string {
@@ -518,14 +519,22 @@ func (m *mockContainer) HasPending(string) bool {
 func (m *mockContainer) ClearPending(string) {
 	panic("unimplemented")
 }
-func (m *mockContainer) GetTag(string) (string, bool) {
-	panic("unimplemented")
+func (m *mockContainer) GetTag(key string) (string, bool) {
+	value, ok := m.tags[key]
+	return value, ok
 }
-func (m *mockContainer) SetTag(string, string) (string, bool) {
-	panic("unimplemented")
+func (m *mockContainer) SetTag(key string, value string) (string, bool) {
+	if m.tags == nil {
+		m.tags = make(map[string]string)
+	}
+	prev, ok := m.tags[key]
+	m.tags[key] = value
+	return prev, ok
 }
-func (m *mockContainer) DeleteTag(string) (string, bool) {
-	panic("unimplemented")
+func (m *mockContainer) DeleteTag(key string) (string, bool) {
+	prev, ok := m.tags[key]
+	delete(m.tags, key)
+	return prev, ok
 }
 func (m *mockContainer) String() string {
 	return "mockContainer"
@@ -652,6 +661,7 @@ type mockCache struct {
 	returnValueForGetPolicyEntry   bool
 	returnValue1ForLookupContainer cache.Container
 	returnValue2ForLookupContainer bool
+	returnValueForGetContainers    []cache.Container
 }
 
 func (m *mockCache) InsertPod(string, interface{}, *cache.PodStatus) cache.Pod {
@@ -685,7 +695,7 @@ func (m *mockCache) GetPods() []cache.Pod {
 	panic("unimplemented")
 }
 func (m *mockCache) GetContainers() []cache.Container {
-	panic("unimplemented")
+	return m.returnValueForGetContainers
 }
 func (m *mockCache) GetContainerCacheIds() []string {
 	panic("unimplemented")
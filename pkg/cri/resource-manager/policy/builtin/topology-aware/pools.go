@@ -695,6 +695,9 @@ func (p *policy) updateSharedAllocations(grant *Grant) {
 			if other.GetContainer().GetCacheID() == (*grant).GetContainer().GetCacheID() {
 				continue
 			}
+			if !sharesCPUsWith((*grant).GetCPUNode(), other.GetCPUNode()) {
+				continue
+			}
 		}
 
 		if other.CPUType() == cpuReserved {
@@ -723,6 +726,26 @@ func (p *policy) updateSharedAllocations(grant *Grant) {
 	}
 }
 
+// sharesCPUsWith checks if the shared CPUs of a pool are affected by grants in another.
+//
+// Exclusive CPUs are taken from the shared CPUs of the pool of the grant,
+// its subtree and its ancestors. Shared CPUs of other pools are unaffected.
+func sharesCPUsWith(pool, other Node) bool {
+	lower, upper := pool, other
+	if lower.RootDistance() < upper.RootDistance() {
+		lower, upper = upper, lower
+	}
+	for n := lower; !n.IsNil(); n = n.Parent() {
+		if n.IsSameNode(upper) {
+			return true
+		}
+		if n.RootDistance() <= upper.RootDistance() {
+			break
+		}
+	}
+	return false
+}
+
 // setDemotionPreferences sets the dynamic demotion preferences a container.
 func (p *policy) setDemotionPreferences(c cache.Container, g Grant) {
 	log.Debug("%s: setting demotion preferences...", c.PrettyName())
@@ -768,6 +791,13 @@ func (p *policy) addImplicitAffinities() error {
 			},
 			Affinity: cache.GlobalAntiAffinity("tags/"+cache.TagAVX512, 5),
 		},
+		PolicyName + ":MemBandwidthHog-push": {
+			Eligible: func(c cache.Container) bool {
+				_, ok := c.GetTag(cache.TagMemBandwidthHog)
+				return ok
+			},
+			Affinity: cache.GlobalAntiAffinity("tags/"+cache.TagMemBandwidthHog, 5),
+		},
 	})
 }
 
@@ -860,12 +890,94 @@ func (p *policy) filterInsufficientResources(req Request, originals []Node) []No
 	return sufficient
 }
 
+// poolCapacity is the allocatable CPU capacity of a pool.
+type poolCapacity struct {
+	reserved int // allocatable reserved CPU
+	shared   int // allocatable shared CPU
+}
+
+// poolSortKey is the request-specific sort key of a pool.
+type poolSortKey struct {
+	affinity float64 // affinity score
+	hints    float64 // combined hint score
+	nonzero  float64 // combined non-zero hint score
+}
+
+// allocatableCapacity calculates the allocatable CPU capacity of all pools.
+//
+// The result is the same as AllocatableReservedCPU() and AllocatableSharedCPU()
+// of the free supply of each pool, but calculated in two passes over the tree,
+// instead of walking the ancestors and their subtrees separately for each pool.
+func (p *policy) allocatableCapacity() map[int]poolCapacity {
+	// sum up granted capacity bottom-up for subtrees
+	granted := make(map[int]poolCapacity, p.nodeCnt)
+	p.root.DepthFirst(func(n Node) error {
+		g := granted[n.NodeID()]
+		supply := n.FreeSupply()
+		g.reserved += supply.GrantedReserved()
+		g.shared += supply.GrantedShared()
+		granted[n.NodeID()] = g
+		if parent := n.Parent(); !parent.IsNil() {
+			pg := granted[parent.NodeID()]
+			pg.reserved += g.reserved
+			pg.shared += g.shared
+			granted[parent.NodeID()] = pg
+		}
+		return nil
+	})
+
+	// cap free capacity top-down to avoid overcommitting any ancestor
+	capped := make(map[int]poolCapacity, p.nodeCnt)
+	capacity := make(map[int]poolCapacity, p.nodeCnt)
+	p.root.BreadthFirst(func(n Node) error {
+		supply := n.FreeSupply()
+		g := granted[n.NodeID()]
+		free := poolCapacity{
+			reserved: 1000*supply.ReservedCPUs().Size() - g.reserved,
+			shared:   1000*supply.SharableCPUs().Size() - g.shared,
+		}
+		if parent := n.Parent(); !parent.IsNil() {
+			pc := capped[parent.NodeID()]
+			if pc.reserved < free.reserved {
+				free.reserved = pc.reserved
+			}
+			if pc.shared < free.shared {
+				free.shared = pc.shared
+			}
+		}
+		capped[n.NodeID()] = free
+
+		if supply.ReservedCPUs().Size() == 0 {
+			// This supply has no room for reserved (not even of zero-sized)
+			free.reserved = -1
+		}
+		capacity[n.NodeID()] = free
+		return nil
+	})
+
+	return capacity
+}
+
+// colocatedContainers counts the containers of the given CPU type in each pool.
+func (p *policy) colocatedContainers(cpuType cpuClass) map[int]int {
+	colocated := make(map[int]int, p.nodeCnt)
+	for _, grant := range p.allocations.grants {
+		if grant.CPUType() == cpuType {
+			colocated[grant.GetCPUNode().NodeID()]++
+		}
+	}
+	return colocated
+}
+
 // Score pools against the request and sort them by score.
 func (p *policy) sortPoolsByScore(req Request, aff map[int]int32) (map[int]Score, []Node) {
 	scores := make(map[int]Score, p.nodeCnt)
+	capacity := p.allocatableCapacity()
+	colocated := p.colocatedContainers(req.CPUType())
 
 	p.root.DepthFirst(func(n Node) error {
-		scores[n.NodeID()] = n.GetScore(req)
+		c := capacity[n.NodeID()]
+		scores[n.NodeID()] = n.FreeSupply().(*supply).score(req, c.reserved, c.shared, colocated[n.NodeID()])
 		return nil
 	})
 
@@ -873,8 +985,17 @@ func (p *policy) sortPoolsByScore(req Request, aff map[int]int32) (map[int]Score
 	// (memory) to satisfy the request.
 	filteredPools := p.filterInsufficientResources(req, p.pools)
 
+	// Calculate the sort keys which only depend on the request and the pool
+	// once, instead of recalculating them for every comparison.
+	keys := make(map[int]*poolSortKey, len(filteredPools))
+	for _, n := range filteredPools {
+		key := &poolSortKey{affinity: affinityScore(aff, n)}
+		key.hints, key.nonzero = combineHintScores(scores[n.NodeID()].HintScores())
+		keys[n.NodeID()] = key
+	}
+
 	sort.Slice(filteredPools, func(i, j int) bool {
-		return p.compareScores(req, filteredPools, scores, aff, i, j)
+		return p.compareScores(req, filteredPools, scores, keys, i, j)
 	})
 
 	return scores, filteredPools
@@ -882,16 +1003,17 @@ func (p *policy) sortPoolsByScore(req Request, aff map[int]int32) (map[int]Score
 
 // Compare two pools by scores for allocation preference.
 func (p *policy) compareScores(request Request, pools []Node, scores map[int]Score,
-	affinity map[int]int32, i int, j int) bool {
+	keys map[int]*poolSortKey, i int, j int) bool {
 	node1, node2 := pools[i], pools[j]
 	depth1, depth2 := node1.RootDistance(), node2.RootDistance()
 	id1, id2 := node1.NodeID(), node2.NodeID()
 	score1, score2 := scores[id1], scores[id2]
+	key1, key2 := keys[id1], keys[id2]
 	cpuType := request.CPUType()
 	isolated1, reserved1, shared1 := score1.IsolatedCapacity(), score1.ReservedCapacity(), score1.SharedCapacity()
 	isolated2, reserved2, shared2 := score2.IsolatedCapacity(), score2.ReservedCapacity(), score2.SharedCapacity()
-	a1 := affinityScore(affinity, node1)
-	a2 := affinityScore(affinity, node2)
+	a1 := key1.affinity
+	a2 := key2.affinity
 
 	log.Debug("comparing scores for %s and %s", node1.Name(), node2.Name())
 	log.Debug("  %s: %s, affinity score %f", node1.Name(), score1.String(), a1)
@@ -972,9 +1094,8 @@ func (p *policy) compareScores(request Request, pools []Node, scores map[int]Sco
 	// 4) better topology hint score wins
 	hScores1 := score1.HintScores()
 	if len(hScores1) > 0 {
-		hScores2 := score2.HintScores()
-		hs1, nz1 := combineHintScores(hScores1)
-		hs2, nz2 := combineHintScores(hScores2)
+		hs1, nz1 := key1.hints, key1.nonzero
+		hs2, nz2 := key2.hints, key2.nonzero
 
 		if hs1 > hs2 {
 			log.Debug("  => %s WINS on hints", node1.Name())
@@ -404,6 +404,16 @@ func TestPoolCreation(t *testing.T) {
 				}
 			}
 
+			capacity := policy.allocatableCapacity()
+			for _, p := range policy.pools {
+				reserved := p.FreeSupply().AllocatableReservedCPU()
+				shared := p.FreeSupply().AllocatableSharedCPU(true)
+				if c := capacity[p.NodeID()]; c.reserved != reserved || c.shared != shared {
+					t.Errorf("Expected %s allocatable capacity %d/%d, got %d/%d",
+						p.Name(), reserved, shared, c.reserved, c.shared)
+				}
+			}
+
 			scores, filteredPools := policy.sortPoolsByScore(tc.req, tc.affinities)
 			fmt.Printf("scores: %v, remaining pools: %v\n", scores, filteredPools)
 
@@ -965,3 +975,96 @@ func TestAffinities(t *testing.T) {
 		})
 	}
 }
+
+func TestAVX512Repacking(t *testing.T) {
+
+	// Containers get tagged as AVX512 users only once they are running,
+	// long after their exclusive CPUs have been allocated. Rebalancing
+	// needs to move such Guaranteed containers to wide-vector CPUs.
+
+	// Create a temporary directory for the test data.
+	dir, err := ioutil.TempDir("", "cri-resource-manager-test-sysfs-")
+	if err != nil {
+		panic(err)
+	}
+	defer os.RemoveAll(dir)
+
+	// Uncompress the test data to the directory.
+	err = utils.UncompressTbz2(path.Join("testdata", "sysfs.tar.bz2"), dir)
+	if err != nil {
+		panic(err)
+	}
+
+	saved := *opt
+	defer func() { *opt = saved }()
+	opt.PackAVX512 = true
+	opt.WideVectorCPUs = "4-7"
+	opt.PinMemory = false
+
+	sys, err := system.DiscoverSystemAt(path.Join(dir, "sysfs", "server", "sys"))
+	if err != nil {
+		panic(err)
+	}
+
+	container := &mockContainer{
+		name: "avx512",
+		returnValueForGetResourceRequirements: v1.ResourceRequirements{
+			Limits: v1.ResourceList{
+				v1.ResourceCPU:    resapi.MustParse("2"),
+				v1.ResourceMemory: resapi.MustParse("1000"),
+			},
+		},
+		returnValueForGetCacheID: "avx512",
+	}
+
+	reserved, _ := resapi.ParseQuantity("750m")
+	policyOptions := &policyapi.BackendOptions{
+		Cache: &mockCache{
+			returnValueForGetContainers: []cache.Container{container},
+		},
+		System: sys,
+		Reserved: policyapi.ConstraintSet{
+			policyapi.DomainCPU: reserved,
+		},
+	}
+
+	policy := CreateTopologyAwarePolicy(policyOptions).(*policy)
+
+	if err := policy.AllocateResources(container); err != nil {
+		t.Fatalf("failed to allocate resources: %v", err)
+	}
+	grant, ok := policy.allocations.grants[container.GetCacheID()]
+	if !ok {
+		t.Fatalf("no grant for container %s", container.PrettyName())
+	}
+	if grant.WideVector() {
+		t.Errorf("untagged container %s packed onto wide-vector CPUs", container.PrettyName())
+	}
+	if policy.needsRepacking(container) {
+		t.Errorf("untagged container %s needs repacking", container.PrettyName())
+	}
+
+	container.SetTag(cache.TagAVX512, "true")
+	if !policy.needsRepacking(container) {
+		t.Errorf("tagged container %s does not need repacking", container.PrettyName())
+	}
+
+	if _, err := policy.Rebalance(); err != nil {
+		t.Fatalf("failed to rebalance: %v", err)
+	}
+	grant, ok = policy.allocations.grants[container.GetCacheID()]
+	if !ok {
+		t.Fatalf("no grant for container %s after rebalancing", container.PrettyName())
+	}
+	if !grant.WideVector() {
+		t.Errorf("tagged container %s not packed onto wide-vector CPUs", container.PrettyName())
+	}
+	if policy.needsRepacking(container) {
+		t.Errorf("repacked container %s still needs repacking", container.PrettyName())
+	}
+
+	container.DeleteTag(cache.TagAVX512)
+	if !policy.needsRepacking(container) {
+		t.Errorf("untagged container %s left on wide-vector CPUs", container.PrettyName())
+	}
+}
@@ -179,6 +179,10 @@ type Grant interface {
 	StopTimer()
 	// ClearTimer clears the cold start timer pointer.
 	ClearTimer()
+	// WideVector returns whether exclusive CPUs were packed onto wide-vector CPUs.
+	WideVector() bool
+	// SetWideVector sets whether exclusive CPUs were packed onto wide-vector CPUs.
+	SetWideVector(bool)
 }
 
 // Score represents how well a supply can satisfy a request.
@@ -251,6 +255,7 @@ type grant struct {
 	allocatedMem   memoryMap       // memory limit
 	coldStart      time.Duration   // how long until cold start is done
 	coldStartTimer *time.Timer     // timer to trigger cold start timeout
+	wideVector     bool            // exclusive CPUs packed onto wide-vector CPUs
 }
 
 var _ Grant = &grant{}
@@ -556,6 +561,7 @@ func (cs *supply) AllocateCPU(r Request) (Grant, error) {
 	fraction := cr.fraction
 
 	cpuType := cr.cpuType
+	wide := cr.wideVector()
 
 	if cpuType == cpuReserved && full > 0 {
 		log.Warn("exclusive reserved CPUs not supported, allocating %d full CPUs as fractions", full)
@@ -575,7 +581,7 @@ func (cs *supply) AllocateCPU(r Request) (Grant, error) {
 	// allocate isolated exclusive CPUs or slice them off the sharable set
 	switch {
 	case full > 0 && cs.isolated.Size() >= full && cr.isolate:
-		exclusive, err = cs.takeCPUs(&cs.isolated, nil, full)
+		exclusive, err = cs.takeCPUs(&cs.isolated, nil, full, wide)
 		if err != nil {
 			return nil, policyError("internal error: "+
 				"%s: can't take %d exclusive isolated CPUs from %s: %v",
@@ -583,7 +589,7 @@ func (cs *supply) AllocateCPU(r Request) (Grant, error) {
 		}
 
 	case full > 0 && cs.AllocatableSharedCPU() > 1000*full:
-		exclusive, err = cs.takeCPUs(&cs.sharable, nil, full)
+		exclusive, err = cs.takeCPUs(&cs.sharable, nil, full, wide)
 		if err != nil {
 			return nil, policyError("internal error: "+
 				"%s: can't take %d exclusive CPUs from %s: %v",
@@ -597,6 +603,7 @@ func (cs *supply) AllocateCPU(r Request) (Grant, error) {
 	}
 
 	grant := newGrant(cs.node, cr.GetContainer(), cpuType, exclusive, 0, 0, nil, 0)
+	grant.SetWideVector(wide && !exclusive.IsEmpty())
 	grant.AccountAllocateCPU()
 
 	if fraction > 0 {
@@ -764,8 +771,20 @@ func (cs *supply) ReserveMemory(g Grant) error {
 }
 
 // takeCPUs takes up to cnt CPUs from a given CPU set to another.
-func (cs *supply) takeCPUs(from, to *cpuset.CPUSet, cnt int) (cpuset.CPUSet, error) {
-	cset, err := cs.node.Policy().cpuAllocator.AllocateCpus(from, cnt, cpuallocator.PriorityHigh)
+func (cs *supply) takeCPUs(from, to *cpuset.CPUSet, cnt int, wide bool) (cpuset.CPUSet, error) {
+	var cset cpuset.CPUSet
+	var err error
+
+	allocator := cs.node.Policy().cpuAllocator
+	if wide {
+		prefer := cpuallocator.PriorityNormal
+		if opt.AVX512LowPriority {
+			prefer = cpuallocator.PriorityLow
+		}
+		cset, err = allocator.AllocateWideVectorCpus(from, cnt, prefer)
+	} else {
+		cset, err = allocator.AllocateCpus(from, cnt, cpuallocator.PriorityHigh)
+	}
 	if err != nil {
 		return cset, err
 	}
@@ -1039,6 +1058,15 @@ func (cr *request) Isolate() bool {
 	return cr.isolate
 }
 
+// wideVector returns whether this request should be packed onto wide-vector CPUs.
+func (cr *request) wideVector() bool {
+	if !opt.PackAVX512 || cr.container == nil {
+		return false
+	}
+	_, ok := cr.container.GetTag(cache.TagAVX512)
+	return ok
+}
+
 // MemAmountToAllocate retuns how much memory we need to reserve for a request.
 func (cr *request) MemAmountToAllocate() uint64 {
 	var amount uint64 = 0
@@ -1075,9 +1103,26 @@ func (cr *request) ColdStart() time.Duration {
 
 // Score collects data for scoring this supply wrt. the given request.
 func (cs *supply) GetScore(req Request) Score {
+	// calculate colocation score
+	colocated := 0
+	for _, grant := range cs.node.Policy().allocations.grants {
+		if req.CPUType() == grant.CPUType() && grant.GetCPUNode().NodeID() == cs.node.NodeID() {
+			colocated++
+		}
+	}
+
+	return cs.score(req, cs.AllocatableReservedCPU(), cs.AllocatableSharedCPU(), colocated)
+}
+
+// score calculates the score of the supply for a request, given the allocatable
+// reserved and shared CPU capacity, and the number of colocated containers.
+func (cs *supply) score(req Request, reserved, shared, colocated int) Score {
 	score := &score{
-		supply: cs,
-		req:    req,
+		supply:    cs,
+		req:       req,
+		reserved:  reserved,
+		shared:    shared,
+		colocated: colocated,
 	}
 
 	cr := req.(*request)
@@ -1086,9 +1131,6 @@ func (cs *supply) GetScore(req Request) Score {
 		part = 1
 	}
 
-	score.reserved = cs.AllocatableReservedCPU()
-	score.shared = cs.AllocatableSharedCPU()
-
 	if cr.CPUType() == cpuReserved {
 		// calculate free reserved capacity
 		score.reserved -= part
@@ -1107,13 +1149,6 @@ func (cs *supply) GetScore(req Request) Score {
 		score.shared -= part
 	}
 
-	// calculate colocation score
-	for _, grant := range cs.node.Policy().allocations.grants {
-		if cr.CPUType() == grant.CPUType() && grant.GetCPUNode().NodeID() == cs.node.NodeID() {
-			score.colocated++
-		}
-	}
-
 	// calculate real hint scores
 	hints := cr.container.GetTopologyHints()
 	score.hints = make(map[string]float64, len(hints))
@@ -1279,6 +1314,7 @@ func (cg *grant) Clone() Grant {
 		memset:       cg.Memset().Clone(),
 		allocatedMem: cg.MemLimit(),
 		coldStart:    cg.ColdStart(),
+		wideVector:   cg.WideVector(),
 	}
 }
 
@@ -1327,6 +1363,16 @@ func (cg *grant) CPUPortion() int {
 	return cg.cpuPortion
 }
 
+// WideVector returns whether exclusive CPUs were packed onto wide-vector CPUs.
+func (cg *grant) WideVector() bool {
+	return cg.wideVector
+}
+
+// SetWideVector sets whether exclusive CPUs were packed onto wide-vector CPUs.
+func (cg *grant) SetWideVector(wide bool) {
+	cg.wideVector = wide
+}
+
 // ExclusiveCPUs returns the non-isolated exclusive CPUSet in this grant.
 func (cg *grant) ExclusiveCPUs() cpuset.CPUSet {
 	return cg.exclusive
@@ -108,6 +108,7 @@ func createPolicy(opts *policyapi.BackendOptions, isAlias bool) policyapi.Backen
 	}
 
 	p.addImplicitAffinities()
+	p.configureAVX512Packing()
 
 	config.GetModule(policyapi.ConfigPath).AddNotify(p.configNotify)
 
@@ -198,7 +199,7 @@ func (p *policy) Rebalance() (bool, error) {
 	movable := []cache.Container{}
 
 	for _, c := range containers {
-		if c.GetQOSClass() != v1.PodQOSGuaranteed {
+		if c.GetQOSClass() != v1.PodQOSGuaranteed || p.needsRepacking(c) {
 			p.ReleaseResources(c)
 			movable = append(movable, c)
 		}
@@ -217,6 +218,22 @@ func (p *policy) Rebalance() (bool, error) {
 	return true, errors
 }
 
+// needsRepacking checks if the exclusive CPUs of a container are packed
+// differently than its AVX512 usage calls for. Containers get tagged as
+// AVX512 users only once they are running, so this is how Guaranteed
+// containers end up being moved to or off wide-vector CPUs.
+func (p *policy) needsRepacking(c cache.Container) bool {
+	if !opt.PackAVX512 {
+		return false
+	}
+	grant, ok := p.allocations.grants[c.GetCacheID()]
+	if !ok || grant.ExclusiveCPUs().Union(grant.IsolatedCPUs()).IsEmpty() {
+		return false
+	}
+	_, tagged := c.GetTag(cache.TagAVX512)
+	return tagged != grant.WideVector()
+}
+
 // HandleEvent handles policy-specific events.
 func (p *policy) HandleEvent(e *events.Policy) (bool, error) {
 	log.Debug("received policy event %s.%s with data %v...", e.Source, e.Type, e.Data)
@@ -383,6 +400,9 @@ func (p *policy) configNotify(event config.Event, source config.Source) error {
 	log.Info("  - pin containers to memory: %v", opt.PinMemory)
 	log.Info("  - prefer isolated CPUs: %v", opt.PreferIsolated)
 	log.Info("  - prefer shared CPUs: %v", opt.PreferShared)
+	log.Info("  - pack AVX512 containers: %v", opt.PackAVX512)
+
+	p.configureAVX512Packing()
 
 	var allowed, reserved cpuset.CPUSet
 	var reinit bool
@@ -463,6 +483,23 @@ func (p *policy) configNotify(event config.Event, source config.Source) error {
 	return nil
 }
 
+// configureAVX512Packing updates the set of CPUs dedicated to AVX512-heavy containers.
+func (p *policy) configureAVX512Packing() {
+	wide := cpuset.NewCPUSet()
+
+	if opt.PackAVX512 && opt.WideVectorCPUs != "" {
+		cset, err := cpuset.Parse(opt.WideVectorCPUs)
+		if err != nil {
+			log.Error("invalid wide-vector CPUs %q: %v", opt.WideVectorCPUs, err)
+		} else {
+			wide = cset
+			log.Info("  - wide-vector CPUs: %s", wide)
+		}
+	}
+
+	p.cpuAllocator.SetWideVectorCpus(wide)
+}
+
 // Initialize or reinitialize the policy.
 func (p *policy) initialize() error {
 	p.nodes = nil
@@ -63,6 +63,8 @@ type Options struct {
 	AgentCli agent.Interface
 	// SendEvent is the function for delivering events back to the resource manager.
 	SendEvent SendEventFn
+	// TopologySnapshot is the file to save discovered system topology in, if any.
+	TopologySnapshot string
 }
 
 // BackendOptions describes the options for a policy backend instance
@@ -188,7 +190,14 @@ func ActivePolicy() string {
 
 // NewPolicy creates a policy instance using the selected backend.
 func NewPolicy(cache cache.Cache, o *Options) (Policy, error) {
-	sys, err := system.DiscoverSystem()
+	var sys system.System
+	var err error
+
+	if o.TopologySnapshot != "" {
+		sys, err = system.DiscoverSystemWithSnapshot(o.TopologySnapshot)
+	} else {
+		sys, err = system.DiscoverSystem()
+	}
 	if err != nil {
 		return nil, policyError("failed to discover system topology: %v", err)
 	}
@@ -26,6 +26,7 @@ import (
 	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/events"
 	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/policy"
 	"github.com/intel/cri-resource-manager/pkg/cri/server"
+	"github.com/intel/cri-resource-manager/pkg/instrumentation"
 )
 
 // setupRequestProcessing prepares the resource manager for CRI request processing.
@@ -44,6 +45,14 @@ func (m *resmgr) setupRequestProcessing() error {
 		"UpdateContainerResources": m.UpdateContainer,
 	}
 
+	for method, fn := range interceptors {
+		// ListContainers is polled by kubelet, never hold it back
+		if method != "ListContainers" {
+			fn = m.syncedInterceptor(fn)
+		}
+		interceptors[method] = instrumentInterceptor(fn)
+	}
+
 	if err := m.relay.Server().RegisterInterceptors(interceptors); err != nil {
 		return resmgrError("failed to register resource-manager CRI interceptors: %v", err)
 	}
@@ -53,6 +62,14 @@ func (m *resmgr) setupRequestProcessing() error {
 	return nil
 }
 
+// instrumentInterceptor sets up instrumentation of request processing stages for an interceptor.
+func instrumentInterceptor(fn server.Interceptor) server.Interceptor {
+	return func(ctx context.Context, method string, request interface{},
+		handler server.Handler) (interface{}, error) {
+		return fn(instrumentation.WithMethod(ctx, method), method, request, handler)
+	}
+}
+
 // disambiguate produces disambiguation context for a request/reply dump.
 func (m *resmgr) disambiguate(msg interface{}) string {
 	var qualifier string
@@ -125,6 +142,11 @@ func (m *resmgr) disambiguate(msg interface{}) string {
 // startRequestProcessing starts request processing by starting the active policy.
 func (m *resmgr) startRequestProcessing() error {
 	ctx := context.Background()
+
+	if m.canWarmRestart() {
+		return m.startWarm(ctx)
+	}
+
 	add, del, err := m.syncWithCRI(ctx)
 
 	if err != nil {
@@ -170,14 +192,11 @@ func (m *resmgr) syncWithCRI(ctx context.Context) ([]cache.Container, []cache.Co
 		return nil, nil, resmgrError("cache synchronization pod query failed: %v", err)
 	}
 
-	status := map[string]*cache.PodStatus{}
+	podIDs := make([]string, 0, len(pods.Items))
 	for _, pod := range pods.Items {
-		if s, err := m.queryPodStatus(ctx, pod.Id); err != nil {
-			m.Error("%s: failed to query pod status: %v", pod.Id, err)
-		} else {
-			status[pod.Id] = s
-		}
+		podIDs = append(podIDs, pod.Id)
 	}
+	status := m.queryPodStatuses(ctx, podIDs)
 	_, _, deleted := m.cache.RefreshPods(pods, status)
 	for _, c := range deleted {
 		m.Info("discovered stale container %s...", c.GetID())
@@ -223,7 +242,7 @@ func (m *resmgr) queryPodStatus(ctx context.Context, podID string) (*cache.PodSt
 func (m *resmgr) RunPod(ctx context.Context, method string, request interface{},
 	handler server.Handler) (interface{}, error) {
 
-	reply, rqerr := handler(ctx, request)
+	reply, rqerr := m.relayRequest(ctx, handler, request)
 	if rqerr != nil {
 		m.Error("%s: failed to create pod: %v", method, rqerr)
 		return reply, rqerr
@@ -231,10 +250,13 @@ func (m *resmgr) RunPod(ctx context.Context, method string, request interface{},
 
 	podID := reply.(*criapi.RunPodSandboxResponse).PodSandboxId
 
-	m.Lock()
-	defer m.Unlock()
+	m.lock(ctx)
+	defer m.unlock(ctx, method)
 
-	pod := m.cache.InsertPod(podID, request, nil)
+	var pod cache.Pod
+	instrumentation.TimeStage(ctx, instrumentation.StageCache, func() {
+		pod = m.cache.InsertPod(podID, request, nil)
+	})
 	m.updateIntrospection()
 
 	// search for any lingering old version and clean up if found
@@ -247,19 +269,19 @@ func (m *resmgr) RunPod(ctx context.Context, method string, request interface{},
 		m.Warn("re-creation of pod %s, releasing old one", p.GetName())
 		for _, c := range pod.GetInitContainers() {
 			m.Info("%s: removing stale init-container %s...", method, c.PrettyName())
-			m.policy.ReleaseResources(c)
+			m.releaseResources(ctx, c)
 			c.UpdateState(cache.ContainerStateStale)
 			released = true
 			del = append(del, c)
 		}
 		for _, c := range pod.GetContainers() {
 			m.Info("%s: removing stale container %s...", method, c.PrettyName())
-			m.policy.ReleaseResources(c)
+			m.releaseResources(ctx, c)
 			c.UpdateState(cache.ContainerStateStale)
 			released = true
 			del = append(del, c)
 		}
-		m.cache.DeletePod(p.GetID())
+		m.deletePod(ctx, p.GetID())
 	}
 	if released {
 		if err := m.runPostReleaseHooks(ctx, method, del...); err != nil {
@@ -277,12 +299,15 @@ func (m *resmgr) RunPod(ctx context.Context, method string, request interface{},
 func (m *resmgr) StopPod(ctx context.Context, method string, request interface{},
 	handler server.Handler) (interface{}, error) {
 
-	reply, rqerr := handler(ctx, request)
+	podID := request.(*criapi.StopPodSandboxRequest).PodSandboxId
+	unlock := m.lockPod(ctx, podID)
+	defer unlock()
 
-	m.Lock()
-	defer m.Unlock()
+	reply, rqerr := m.relayRequest(ctx, handler, request)
+
+	m.lock(ctx)
+	defer m.unlock(ctx, method)
 
-	podID := request.(*criapi.StopPodSandboxRequest).PodSandboxId
 	pod, ok := m.cache.LookupPod(podID)
 
 	if !ok {
@@ -300,7 +325,7 @@ func (m *resmgr) StopPod(ctx context.Context, method string, request interface{}
 	released := []cache.Container{}
 	for _, c := range pod.GetInitContainers() {
 		m.Info("%s: releasing resources for %s...", method, c.PrettyName())
-		if err := m.policy.ReleaseResources(c); err != nil {
+		if err := m.releaseResources(ctx, c); err != nil {
 			m.Warn("%s: failed to release init-container %s: %v", method, c.PrettyName(), err)
 		}
 		c.UpdateState(cache.ContainerStateExited)
@@ -308,7 +333,7 @@ func (m *resmgr) StopPod(ctx context.Context, method string, request interface{}
 	}
 	for _, c := range pod.GetContainers() {
 		m.Info("%s: releasing resources for container %s...", method, c.PrettyName())
-		if err := m.policy.ReleaseResources(c); err != nil {
+		if err := m.releaseResources(ctx, c); err != nil {
 			m.Warn("%s: failed to release container %s: %v", method, c.PrettyName(), err)
 		}
 		c.UpdateState(cache.ContainerStateExited)
@@ -329,12 +354,15 @@ func (m *resmgr) StopPod(ctx context.Context, method string, request interface{}
 func (m *resmgr) RemovePod(ctx context.Context, method string, request interface{},
 	handler server.Handler) (interface{}, error) {
 
-	reply, rqerr := handler(ctx, request)
+	podID := request.(*criapi.RemovePodSandboxRequest).PodSandboxId
+	unlock := m.lockPod(ctx, podID)
+	defer unlock()
 
-	m.Lock()
-	defer m.Unlock()
+	reply, rqerr := m.relayRequest(ctx, handler, request)
+
+	m.lock(ctx)
+	defer m.unlock(ctx, method)
 
-	podID := request.(*criapi.RemovePodSandboxRequest).PodSandboxId
 	pod, ok := m.cache.LookupPod(podID)
 
 	if !ok {
@@ -351,7 +379,7 @@ func (m *resmgr) RemovePod(ctx context.Context, method string, request interface
 	released := []cache.Container{}
 	for _, c := range pod.GetInitContainers() {
 		m.Info("%s: removing stale init-container %s...", method, c.PrettyName())
-		if err := m.policy.ReleaseResources(c); err != nil {
+		if err := m.releaseResources(ctx, c); err != nil {
 			m.Warn("%s: failed to release init-container %s: %v", method, c.PrettyName(), err)
 		}
 		c.UpdateState(cache.ContainerStateStale)
@@ -359,7 +387,7 @@ func (m *resmgr) RemovePod(ctx context.Context, method string, request interface
 	}
 	for _, c := range pod.GetContainers() {
 		m.Info("%s: removing stale container %s...", method, c.PrettyName())
-		if err := m.policy.ReleaseResources(c); err != nil {
+		if err := m.releaseResources(ctx, c); err != nil {
 			m.Warn("%s: failed to release container %s: %v", method, c.PrettyName(), err)
 		}
 		c.UpdateState(cache.ContainerStateStale)
@@ -371,7 +399,7 @@ func (m *resmgr) RemovePod(ctx context.Context, method string, request interface
 			method, pod.GetName(), err)
 	}
 
-	m.cache.DeletePod(podID)
+	m.deletePod(ctx, podID)
 	m.updateIntrospection()
 
 	return reply, rqerr
@@ -381,8 +409,57 @@ func (m *resmgr) RemovePod(ctx context.Context, method string, request interface
 func (m *resmgr) CreateContainer(ctx context.Context, method string, request interface{},
 	handler server.Handler) (interface{}, error) {
 
-	m.Lock()
-	defer m.Unlock()
+	podID := ""
+	if msg, ok := request.(*criapi.CreateContainerRequest); ok {
+		podID = msg.PodSandboxId
+	}
+	unlock := m.lockPod(ctx, podID)
+	defer unlock()
+
+	container, err := m.allocateContainer(ctx, method, request)
+	if err != nil {
+		return nil, err
+	}
+
+	reply, rqerr := m.relayRequest(ctx, handler, request)
+
+	m.lock(ctx)
+	defer m.unlock(ctx, method)
+
+	if rqerr != nil {
+		m.Error("%s: failed to create container %s: %v", method, container.PrettyName(), rqerr)
+		m.releaseResources(ctx, container)
+		m.runPostReleaseHooks(ctx, method, container)
+		m.deleteContainer(ctx, container.GetCacheID())
+		return nil, resmgrError("failed to create container: %v", rqerr)
+	}
+
+	instrumentation.TimeStage(ctx, instrumentation.StageCache, func() {
+		m.cache.UpdateContainerID(container.GetCacheID(), reply)
+	})
+	container.UpdateState(cache.ContainerStateCreated)
+	m.requeueAvx()
+
+	// Notes:
+	//   Processing other requests might have changed the resources of the
+	//   container while it was being created by the runtime. If so, we need
+	//   to update the freshly created container with those changes now.
+	if len(container.GetPending()) > 0 {
+		if err := m.runPostUpdateHooks(ctx, method); err != nil {
+			m.Warn("%s: failed to run post-update hooks for %s: %v",
+				method, container.PrettyName(), err)
+		}
+	}
+
+	m.updateIntrospection()
+
+	return reply, nil
+}
+
+// allocateContainer inserts a container being created to the cache and allocates its resources.
+func (m *resmgr) allocateContainer(ctx context.Context, method string, request interface{}) (cache.Container, error) {
+	m.lock(ctx)
+	defer m.unlock(ctx, method)
 
 	// kubelet doesn't always clean up crashed containers so we try doing it here
 	if msg, ok := request.(*criapi.CreateContainerRequest); ok {
@@ -390,13 +467,17 @@ func (m *resmgr) CreateContainer(ctx context.Context, method string, request int
 			if msg.Config != nil && msg.Config.Metadata != nil {
 				if c, ok := pod.GetContainer(msg.Config.Metadata.Name); ok {
 					m.Warn("re-creation of container %s, releasing old one", c.PrettyName())
-					m.policy.ReleaseResources(c)
+					m.releaseResources(ctx, c)
 				}
 			}
 		}
 	}
 
-	container, err := m.cache.InsertContainer(request)
+	var container cache.Container
+	var err error
+	instrumentation.TimeStage(ctx, instrumentation.StageCache, func() {
+		container, err = m.cache.InsertContainer(request)
+	})
 	if err != nil {
 		m.Error("%s: failed to insert new container to cache: %v", method, err)
 		return nil, resmgrError("%s: failed to insert new container to cache: %v", method, err)
@@ -406,10 +487,10 @@ func (m *resmgr) CreateContainer(ctx context.Context, method string, request int
 
 	m.Info("%s: creating container %s...", method, container.PrettyName())
 
-	if err := m.policy.AllocateResources(container); err != nil {
+	if err := m.allocateResources(ctx, container); err != nil {
 		m.Error("%s: failed to allocate resources for container %s: %v",
 			method, container.PrettyName(), err)
-		m.cache.DeleteContainer(container.GetCacheID())
+		m.deleteContainer(ctx, container.GetCacheID())
 		return nil, resmgrError("failed to allocate container resources: %v", err)
 	}
 
@@ -423,62 +504,56 @@ func (m *resmgr) CreateContainer(ctx context.Context, method string, request int
 	if err := m.runPostAllocateHooks(ctx, method); err != nil {
 		m.Error("%s: failed to run post-allocate hooks for %s: %v",
 			method, container.PrettyName(), err)
-		m.policy.ReleaseResources(container)
+		m.releaseResources(ctx, container)
 		m.runPostReleaseHooks(ctx, method, container)
-		m.cache.DeleteContainer(container.GetCacheID())
+		m.deleteContainer(ctx, container.GetCacheID())
 		return nil, resmgrError("failed to allocate container resources: %v", err)
 	}
 
 	container.ClearCRIRequest()
-	reply, rqerr := handler(ctx, request)
-
-	if rqerr != nil {
-		m.Error("%s: failed to create container %s: %v", method, container.PrettyName(), rqerr)
-		m.policy.ReleaseResources(container)
-		m.runPostReleaseHooks(ctx, method, container)
-		m.cache.DeleteContainer(container.GetCacheID())
-		return nil, resmgrError("failed to create container: %v", rqerr)
-	}
-
-	m.cache.UpdateContainerID(container.GetCacheID(), reply)
-	container.UpdateState(cache.ContainerStateCreated)
-	m.updateIntrospection()
 
-	return reply, nil
+	return container, nil
 }
 
 // StartContainer intercepts CRI requests for starting Containers.
 func (m *resmgr) StartContainer(ctx context.Context, method string, request interface{},
 	handler server.Handler) (interface{}, error) {
 
-	m.Lock()
-	defer m.Unlock()
-
 	containerID := request.(*criapi.StartContainerRequest).ContainerId
+	unlock := m.lockContainerPod(ctx, containerID)
+	defer unlock()
+
+	m.lock(ctx)
 	container, ok := m.cache.LookupContainer(containerID)
 
 	if !ok {
+		m.Unlock()
 		m.Warn("%s: failed to look up container %s, just passing request through",
 			method, containerID)
-		return handler(ctx, request)
+		return m.relayRequest(ctx, handler, request)
 	}
 
 	m.Info("%s: starting container %s...", method, container.PrettyName())
 
-	if container.GetState() != cache.ContainerStateCreated {
+	if state := container.GetState(); state != cache.ContainerStateCreated {
+		m.Unlock()
 		m.Error("%s: refusing to start container %s in unexpected state %v",
-			method, container.PrettyName(), container.GetState())
+			method, container.PrettyName(), state)
 		return nil, resmgrError("refusing to start container %s in unexpexted state %v",
-			container.PrettyName(), container.GetState())
+			container.PrettyName(), state)
 	}
+	m.Unlock()
 
-	reply, rqerr := handler(ctx, request)
+	reply, rqerr := m.relayRequest(ctx, handler, request)
 
 	if rqerr != nil {
 		m.Error("%s: failed to start container %s: %v", method, container.PrettyName(), rqerr)
 		return nil, rqerr
 	}
 
+	m.lock(ctx)
+	defer m.Unlock()
+
 	container.UpdateState(cache.ContainerStateRunning)
 
 	e := &events.Policy{
@@ -504,12 +579,15 @@ func (m *resmgr) StartContainer(ctx context.Context, method string, request inte
 func (m *resmgr) StopContainer(ctx context.Context, method string, request interface{},
 	handler server.Handler) (interface{}, error) {
 
-	reply, rqerr := handler(ctx, request)
+	containerID := request.(*criapi.StopContainerRequest).ContainerId
+	unlock := m.lockContainerPod(ctx, containerID)
+	defer unlock()
 
-	m.Lock()
-	defer m.Unlock()
+	reply, rqerr := m.relayRequest(ctx, handler, request)
+
+	m.lock(ctx)
+	defer m.unlock(ctx, method)
 
-	containerID := request.(*criapi.StopContainerRequest).ContainerId
 	container, ok := m.cache.LookupContainer(containerID)
 
 	if !ok {
@@ -529,7 +607,7 @@ func (m *resmgr) StopContainer(ctx context.Context, method string, request inter
 	//   For now, we assume any error replies from CRI are about the container not
 	//   being found, in which case we still go ahead and finish locally stopping it...
 
-	if err := m.policy.ReleaseResources(container); err != nil {
+	if err := m.releaseResources(ctx, container); err != nil {
 		m.Error("%s: failed to release resources for container %s: %v",
 			method, container.PrettyName(), err)
 	}
@@ -550,12 +628,15 @@ func (m *resmgr) StopContainer(ctx context.Context, method string, request inter
 func (m *resmgr) RemoveContainer(ctx context.Context, method string, request interface{},
 	handler server.Handler) (interface{}, error) {
 
-	reply, rqerr := handler(ctx, request)
+	containerID := request.(*criapi.RemoveContainerRequest).ContainerId
+	unlock := m.lockContainerPod(ctx, containerID)
+	defer unlock()
 
-	m.Lock()
-	defer m.Unlock()
+	reply, rqerr := m.relayRequest(ctx, handler, request)
+
+	m.lock(ctx)
+	defer m.unlock(ctx, method)
 
-	containerID := request.(*criapi.RemoveContainerRequest).ContainerId
 	container, ok := m.cache.LookupContainer(containerID)
 
 	if !ok {
@@ -570,7 +651,7 @@ func (m *resmgr) RemoveContainer(ctx context.Context, method string, request int
 		m.Info("%s: removed container %s...", method, container.PrettyName())
 	}
 
-	if err := m.policy.ReleaseResources(container); err != nil {
+	if err := m.releaseResources(ctx, container); err != nil {
 		m.Error("%s: failed to release resources for container %s: %v",
 			method, container.PrettyName(), err)
 	}
@@ -591,7 +672,7 @@ func (m *resmgr) RemoveContainer(ctx context.Context, method string, request int
 func (m *resmgr) ListContainers(ctx context.Context, method string, request interface{},
 	handler server.Handler) (interface{}, error) {
 
-	reply, rqerr := handler(ctx, request)
+	reply, rqerr := m.relayRequest(ctx, handler, request)
 
 	if rqerr != nil {
 		return reply, rqerr
@@ -603,8 +684,13 @@ func (m *resmgr) ListContainers(ctx context.Context, method string, request inte
 		}
 	}
 
-	m.Lock()
-	defer m.Unlock()
+	// leave exited and absent containers to cache reconciliation, if in progress
+	if !m.isSynced() {
+		return reply, nil
+	}
+
+	m.lock(ctx)
+	defer m.unlock(ctx, method)
 
 	clistmap := map[string]*criapi.Container{}
 	released := []cache.Container{}
@@ -617,7 +703,7 @@ func (m *resmgr) ListContainers(ctx context.Context, method string, request inte
 			state := c.GetState()
 			if state == cache.ContainerStateRunning || state == cache.ContainerStateCreated {
 				m.Info("%s: exited, releasing its resources...", c.PrettyName())
-				if err := m.policy.ReleaseResources(c); err != nil {
+				if err := m.releaseResources(ctx, c); err != nil {
 					m.Error("%s: failed to release resources for container %s: %v",
 						method, c.PrettyName(), err)
 				}
@@ -631,7 +717,7 @@ func (m *resmgr) ListContainers(ctx context.Context, method string, request inte
 		if c.GetState() == cache.ContainerStateRunning {
 			if _, ok := clistmap[c.GetID()]; !ok {
 				m.Info("%s: absent from runtime, releasing its resources...", c.PrettyName())
-				if err := m.policy.ReleaseResources(c); err != nil {
+				if err := m.releaseResources(ctx, c); err != nil {
 					m.Error("%s: failed to release resources for container %s: %v",
 						method, c.PrettyName(), err)
 				}
@@ -656,7 +742,7 @@ func (m *resmgr) ListContainers(ctx context.Context, method string, request inte
 func (m *resmgr) UpdateContainer(ctx context.Context, method string, request interface{},
 	handler server.Handler) (interface{}, error) {
 
-	m.Lock()
+	m.lock(ctx)
 	defer m.Unlock()
 
 	containerID := request.(*criapi.UpdateContainerResourcesRequest).ContainerId
@@ -679,20 +765,24 @@ func (m *resmgr) UpdateContainer(ctx context.Context, method string, request int
 
 // RebalanceContainers tries to find a more optimal container resource allocation if necessary.
 func (m *resmgr) RebalanceContainers() error {
+	method := "Rebalance"
 	m.Lock()
-	defer m.Unlock()
+	defer m.unlock(instrumentation.WithMethod(context.Background(), method), method)
 
 	m.Info("rebalancing (reallocating) containers...")
 
-	return m.rebalance("Rebalance")
+	return m.rebalance(method)
 }
 
 // rebalance triggers a policy-specific rebalancing cycle of containers.
+// The caller must hold the lock, and send the resulting updates after
+// releasing it.
 func (m *resmgr) rebalance(method string) error {
 	if m.policy == nil {
 		return nil
 	}
 
+	ctx := instrumentation.WithMethod(context.Background(), method)
 	changes, err := m.policy.Rebalance()
 
 	if err != nil {
@@ -700,19 +790,56 @@ func (m *resmgr) rebalance(method string) error {
 	}
 
 	if changes {
-		if err := m.runPostUpdateHooks(context.Background(), method); err != nil {
+		if err := m.runPostUpdateHooks(ctx, method); err != nil {
 			m.Error("%s: failed to run post-update hooks: %v", method, err)
 			return resmgrError("%s: failed to run post-update hooks: %v", method, err)
 		}
 	}
 
-	return m.cache.Save()
+	return m.saveCache(ctx)
+}
+
+// reallocateContainers reallocates the resources of the given containers only.
+func (m *resmgr) reallocateContainers(method string, containers []cache.Container) error {
+	ctx := instrumentation.WithMethod(context.Background(), method)
+	m.Lock()
+	defer m.unlock(ctx, method)
+
+	for _, c := range containers {
+		// the container might have gone away since we last looked
+		if _, ok := m.cache.LookupContainer(c.GetCacheID()); !ok {
+			continue
+		}
+		switch c.GetState() {
+		case cache.ContainerStateRunning, cache.ContainerStateCreated:
+		default:
+			continue
+		}
+
+		m.Info("%s: reallocating container %s...", method, c.PrettyName())
+		if err := m.releaseResources(ctx, c); err != nil {
+			m.Error("%s: failed to release resources of %s: %v", method, c.PrettyName(), err)
+		}
+		if err := m.allocateResources(ctx, c); err != nil {
+			m.Error("%s: failed to reallocate resources for %s: %v", method, c.PrettyName(), err)
+		}
+	}
+
+	if err := m.runPostUpdateHooks(ctx, method); err != nil {
+		m.Error("%s: failed to run post-update hooks: %v", method, err)
+		return resmgrError("%s: failed to run post-update hooks: %v", method, err)
+	}
+	m.updateIntrospection()
+
+	return m.saveCache(ctx)
 }
 
 // DeliverPolicyEvent delivers a policy-specific event to the active policy.
 func (m *resmgr) DeliverPolicyEvent(e *events.Policy) error {
+	method := "DeliverPolicyEvent"
+	ctx := instrumentation.WithMethod(context.Background(), method)
 	m.Lock()
-	defer m.Unlock()
+	defer m.unlock(ctx, method)
 
 	if e.Source == "" {
 		e.Source = "unspecified"
@@ -720,7 +847,6 @@ func (m *resmgr) DeliverPolicyEvent(e *events.Policy) error {
 
 	m.Info("delivering policy event %s.%s...", e.Source, e.Type)
 
-	method := "DeliverPolicyEvent"
 	changes, err := m.policy.HandleEvent(e)
 
 	if err != nil {
@@ -729,13 +855,13 @@ func (m *resmgr) DeliverPolicyEvent(e *events.Policy) error {
 	}
 
 	if changes {
-		if err = m.runPostUpdateHooks(context.Background(), method); err != nil {
+		if err = m.runPostUpdateHooks(ctx, method); err != nil {
 			m.Error("%s: failed to run post-update hooks: %v", method, err)
 			return resmgrError("%s: failed to run post-update hooks: %v", method, err)
 		}
 	}
 
-	m.cache.Save()
+	m.saveCache(ctx)
 	return nil
 }
 
@@ -743,8 +869,9 @@ func (m *resmgr) DeliverPolicyEvent(e *events.Policy) error {
 func (m *resmgr) setConfig(v interface{}) error {
 	var err error
 
+	ctx := instrumentation.WithMethod(context.Background(), "setConfig")
 	m.Lock()
-	defer m.Unlock()
+	defer m.unlock(ctx, "setConfig")
 
 	switch cfg := v.(type) {
 	case *config.RawConfig:
@@ -765,7 +892,7 @@ func (m *resmgr) setConfig(v interface{}) error {
 		return resmgrError("failed to synchronize controllers with new configuration: %v", err)
 	}
 
-	if err = m.runPostUpdateHooks(context.Background(), "setConfig"); err != nil {
+	if err = m.runPostUpdateHooks(ctx, "setConfig"); err != nil {
 		m.Error("failed to run post-update hooks after reconfiguration: %v", err)
 		return resmgrError("failed to run post-update hooks after reconfiguration: %v", err)
 	}
@@ -785,19 +912,22 @@ func (m *resmgr) runPostAllocateHooks(ctx context.Context, method string) error
 	for _, c := range m.cache.GetPendingContainers() {
 		switch c.GetState() {
 		case cache.ContainerStateRunning, cache.ContainerStateCreated:
-			if err := m.control.RunPostUpdateHooks(c); err != nil {
+			if err := m.control.RunPostUpdateHooks(ctx, c); err != nil {
 				m.Warn("%s post-update hook failed for %s: %v",
 					method, c.PrettyName(), err)
 			}
 			if req, ok := c.ClearCRIRequest(); ok {
-				if _, err := m.sendCRIRequest(ctx, req); err != nil {
-					m.Warn("%s update of container %s failed: %v",
-						method, c.PrettyName(), err)
-				}
+				m.coalesceCRIRequest(ctx, method, c, req)
 			}
 			m.policy.ExportResourceData(c)
 		case cache.ContainerStateCreating:
-			if err := m.control.RunPreCreateHooks(c); err != nil {
+			if _, ok := c.GetCRIRequest(); !ok {
+				// being created by the runtime, gets updated once created
+				m.Debug("%s: deferring update of container %s being created", method,
+					c.PrettyName())
+				continue
+			}
+			if err := m.control.RunPreCreateHooks(ctx, c); err != nil {
 				m.Warn("%s pre-create hook failed for %s: %v",
 					method, c.PrettyName(), err)
 			}
@@ -812,7 +942,7 @@ func (m *resmgr) runPostAllocateHooks(ctx context.Context, method string) error
 
 // runPostStartHooks runs the necessary hooks after having started a container.
 func (m *resmgr) runPostStartHooks(ctx context.Context, method string, c cache.Container) error {
-	if err := m.control.RunPostStartHooks(c); err != nil {
+	if err := m.control.RunPostStartHooks(ctx, c); err != nil {
 		m.Error("%s: post-start hook failed for %s: %v", method, c.PrettyName(), err)
 	}
 	return nil
@@ -821,30 +951,28 @@ func (m *resmgr) runPostStartHooks(ctx context.Context, method string, c cache.C
 // runPostReleaseHooks runs the necessary hooks after releaseing resources of some containers
 func (m *resmgr) runPostReleaseHooks(ctx context.Context, method string, released ...cache.Container) error {
 	for _, c := range released {
-		if err := m.control.RunPostStopHooks(c); err != nil {
+		if err := m.control.RunPostStopHooks(ctx, c); err != nil {
 			m.Warn("post-stop hook failed for %s: %v", c.PrettyName(), err)
 		}
 		if c.GetState() == cache.ContainerStateStale {
-			m.cache.DeleteContainer(c.GetCacheID())
+			m.deleteContainer(ctx, c.GetCacheID())
 		}
 	}
 	for _, c := range m.cache.GetPendingContainers() {
 		switch state := c.GetState(); state {
 		case cache.ContainerStateStale, cache.ContainerStateExited:
-			if err := m.control.RunPostStopHooks(c); err != nil {
+			if err := m.control.RunPostStopHooks(ctx, c); err != nil {
 				m.Warn("post-stop hook failed for %s: %v", c.PrettyName(), err)
 			}
 			if state == cache.ContainerStateStale {
-				m.cache.DeleteContainer(c.GetCacheID())
+				m.deleteContainer(ctx, c.GetCacheID())
 			}
 		case cache.ContainerStateRunning, cache.ContainerStateCreated:
-			if err := m.control.RunPostUpdateHooks(c); err != nil {
+			if err := m.control.RunPostUpdateHooks(ctx, c); err != nil {
 				m.Warn("post-update hook failed for %s: %v", c.PrettyName(), err)
 			}
 			if req, ok := c.ClearCRIRequest(); ok {
-				if _, err := m.sendCRIRequest(ctx, req); err != nil {
-					m.Warn("update of container %s failed: %v", c.PrettyName(), err)
-				}
+				m.coalesceCRIRequest(ctx, method, c, req)
 			}
 			m.policy.ExportResourceData(c)
 		default:
@@ -856,20 +984,18 @@ func (m *resmgr) runPostReleaseHooks(ctx context.Context, method string, release
 }
 
 // runPostUpdateHooks runs the necessary hooks after reconcilation.
+//
+// Like the other hooks, it only posts the resulting CRI requests. They are
+// sent once the lock is released with unlock.
 func (m *resmgr) runPostUpdateHooks(ctx context.Context, method string) error {
 	for _, c := range m.cache.GetPendingContainers() {
 		switch c.GetState() {
 		case cache.ContainerStateRunning, cache.ContainerStateCreated:
-			if err := m.control.RunPostUpdateHooks(c); err != nil {
+			if err := m.control.RunPostUpdateHooks(ctx, c); err != nil {
 				return err
 			}
-			if req, ok := c.GetCRIRequest(); ok {
-				if _, err := m.sendCRIRequest(ctx, req); err != nil {
-					m.Warn("%s update of container %s failed: %v",
-						method, c.PrettyName(), err)
-				} else {
-					c.ClearCRIRequest()
-				}
+			if req, ok := c.ClearCRIRequest(); ok {
+				m.postCRIRequest(method, c, req)
 			}
 			m.policy.ExportResourceData(c)
 		default:
@@ -880,15 +1006,210 @@ func (m *resmgr) runPostUpdateHooks(ctx context.Context, method string) error {
 	return nil
 }
 
-// sendCRIRequest sends the given CRI request, returning the received reply and error.
-func (m *resmgr) sendCRIRequest(ctx context.Context, request interface{}) (interface{}, error) {
-	client := m.relay.Client()
-	switch request.(type) {
+// coalesceCRIRequest posts, defers or skips an update request for a container.
+func (m *resmgr) coalesceCRIRequest(ctx context.Context, method string, c cache.Container, request interface{}) {
+	if req, ok := request.(*criapi.UpdateContainerResourcesRequest); ok {
+		if m.updates.isNoop(req.ContainerId, req.Linux) {
+			m.Debug("%s: skipping no-op update of container %s", method, c.PrettyName())
+			return
+		}
+		if m.updates.deferUpdate(c.GetCacheID()) {
+			m.Debug("%s: deferring update of container %s", method, c.PrettyName())
+			return
+		}
+	}
+	m.postCRIRequest(method, c, request)
+}
+
+// flushCRIRequests sends the deferred update requests of containers.
+func (m *resmgr) flushCRIRequests() {
+	method := "CoalescedUpdate"
+	ctx := instrumentation.WithMethod(context.Background(), method)
+	m.Lock()
+	defer m.unlock(ctx, method)
+
+	for _, id := range m.updates.takeQueued() {
+		c, ok := m.cache.LookupContainer(id)
+		if !ok {
+			continue
+		}
+		switch c.GetState() {
+		case cache.ContainerStateRunning, cache.ContainerStateCreated:
+		default:
+			continue
+		}
+		// send the resources the container has now, not the ones it had when queued
+		resources := c.GetLinuxResources()
+		if resources == nil || m.updates.isNoop(c.GetID(), resources) {
+			continue
+		}
+		m.updates.post(&criapi.UpdateContainerResourcesRequest{
+			ContainerId: c.GetID(),
+			Linux:       resources,
+		})
+	}
+}
+
+// postCRIRequest posts a CRI request of a container, to be sent once the lock is released.
+func (m *resmgr) postCRIRequest(method string, c cache.Container, request interface{}) {
+	switch req := request.(type) {
 	case *criapi.UpdateContainerResourcesRequest:
-		req := request.(*criapi.UpdateContainerResourcesRequest)
-		m.Debug("sending update request for container %s...", req.ContainerId)
-		return client.UpdateContainerResources(ctx, req)
+		m.updates.post(req)
+	default:
+		m.Warn("%s: dropping unhandled %T request of container %s", method, request, c.PrettyName())
+	}
+}
+
+// sendCRIRequests sends the CRI requests posted while holding the lock.
+//
+// It must be called without holding the lock. Requests are sent by one
+// caller at a time, so a later update of a container never overtakes an
+// earlier one. Failed updates are posted again, to be retried the next
+// time the lock is released, unless the container has been updated or
+// has gone away since.
+func (m *resmgr) sendCRIRequests(ctx context.Context, method string) {
+	m.sending.Lock()
+	defer m.sending.Unlock()
+
+	failed := map[string]*criapi.UpdateContainerResourcesRequest{}
+	order := []string{}
+
+	client := m.relay.Client()
+	for {
+		m.Lock()
+		reqs := m.updates.takePosted()
+		if len(reqs) == 0 {
+			for _, id := range order {
+				if req, ok := failed[id]; ok {
+					m.repostCRIRequest(method, req)
+				}
+			}
+			m.Unlock()
+			return
+		}
+		m.Unlock()
+
+		for _, req := range reqs {
+			m.Debug("sending update request for container %s...", req.ContainerId)
+			rctx, stage := instrumentation.StartStage(ctx, instrumentation.StageRuntime)
+			_, err := client.UpdateContainerResources(rctx, req)
+			stage.End()
+
+			m.Lock()
+			if err != nil {
+				m.Warn("%s update of container %s failed: %v", method, req.ContainerId, err)
+				if _, ok := failed[req.ContainerId]; !ok {
+					order = append(order, req.ContainerId)
+				}
+				failed[req.ContainerId] = req
+			} else {
+				delete(failed, req.ContainerId)
+				if _, ok := m.cache.LookupContainer(req.ContainerId); ok {
+					// don't resurrect state of containers deleted meanwhile
+					m.updates.markSent(req.ContainerId, req.Linux)
+				}
+			}
+			m.Unlock()
+		}
+	}
+}
+
+// repostCRIRequest posts a failed update again, if it is still relevant.
+func (m *resmgr) repostCRIRequest(method string, req *criapi.UpdateContainerResourcesRequest) {
+	c, ok := m.cache.LookupContainer(req.ContainerId)
+	if !ok {
+		return
+	}
+	switch c.GetState() {
+	case cache.ContainerStateRunning, cache.ContainerStateCreated:
 	default:
-		return nil, resmgrError("sendCRIRequest: unhandled request type %T", request)
+		return
+	}
+	if m.updates.repost(req) {
+		m.Debug("%s: retrying failed update of container %s later", method, c.PrettyName())
+	}
+}
+
+// lockPod serializes processing requests for a pod, recording the time spent waiting.
+func (m *resmgr) lockPod(ctx context.Context, podID string) func() {
+	_, stage := instrumentation.StartStage(ctx, instrumentation.StagePodLock)
+	m.pods.lock(podID)
+	stage.End()
+
+	return func() { m.pods.unlock(podID) }
+}
+
+// lockContainerPod serializes processing requests for the pod of a container.
+func (m *resmgr) lockContainerPod(ctx context.Context, containerID string) func() {
+	m.lock(ctx)
+	c, ok := m.cache.LookupContainer(containerID)
+	podID := ""
+	if ok {
+		podID = c.GetPodID()
 	}
+	m.Unlock()
+
+	if podID == "" {
+		return func() {}
+	}
+	return m.lockPod(ctx, podID)
+}
+
+// lock acquires the resource manager lock, recording the time spent waiting for it.
+func (m *resmgr) lock(ctx context.Context) {
+	_, stage := instrumentation.StartStage(ctx, instrumentation.StageLock)
+	m.Lock()
+	stage.End()
+}
+
+// unlock releases the resource manager lock, then sends the CRI requests
+// posted while holding it.
+func (m *resmgr) unlock(ctx context.Context, method string) {
+	m.Unlock()
+	m.sendCRIRequests(ctx, method)
+}
+
+// relayRequest relays a request to the runtime, recording the time spent processing it.
+func (m *resmgr) relayRequest(ctx context.Context, handler server.Handler, request interface{}) (interface{}, error) {
+	ctx, stage := instrumentation.StartStage(ctx, instrumentation.StageRuntime)
+	defer stage.End()
+	return handler(ctx, request)
+}
+
+// allocateResources allocates resources for a container, recording the time spent in the policy.
+func (m *resmgr) allocateResources(ctx context.Context, c cache.Container) error {
+	_, stage := instrumentation.StartStage(ctx, instrumentation.StagePolicy)
+	defer stage.End()
+	return m.policy.AllocateResources(c)
+}
+
+// releaseResources releases resources of a container, recording the time spent in the policy.
+func (m *resmgr) releaseResources(ctx context.Context, c cache.Container) error {
+	_, stage := instrumentation.StartStage(ctx, instrumentation.StagePolicy)
+	defer stage.End()
+	return m.policy.ReleaseResources(c)
+}
+
+// saveCache saves the cache, recording the time spent saving it.
+func (m *resmgr) saveCache(ctx context.Context) error {
+	_, stage := instrumentation.StartStage(ctx, instrumentation.StageCache)
+	defer stage.End()
+	return m.cache.Save()
+}
+
+// deletePod deletes a pod from the cache, recording the time spent updating the cache.
+func (m *resmgr) deletePod(ctx context.Context, id string) {
+	instrumentation.TimeStage(ctx, instrumentation.StageCache, func() {
+		m.cache.DeletePod(id)
+	})
+}
+
+// deleteContainer deletes a container from the cache, recording the time spent updating the cache.
+func (m *resmgr) deleteContainer(ctx context.Context, id string) {
+	if c, ok := m.cache.LookupContainer(id); ok {
+		m.updates.forget(c.GetID(), c.GetCacheID())
+	}
+	instrumentation.TimeStage(ctx, instrumentation.StageCache, func() {
+		m.cache.DeleteContainer(id)
+	})
 }
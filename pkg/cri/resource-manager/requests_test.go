@@ -0,0 +1,108 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package resmgr
+
+import (
+	"context"
+	"fmt"
+	"testing"
+
+	criapi "k8s.io/cri-api/pkg/apis/runtime/v1alpha2"
+
+	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/cache"
+)
+
+func TestSendCRIRequestsRetry(t *testing.T) {
+	tcases := []struct {
+		name     string
+		fail     int
+		repost   string // cpuset of a newer update posted after the failure, if any
+		remove   bool   // remove the container after the failure
+		expected []string
+	}{
+		{
+			name:     "successful update is sent once",
+			expected: []string{"ctr0:0-1"},
+		},
+		{
+			name:     "failed update is resent",
+			fail:     1,
+			expected: []string{"ctr0:0-1", "ctr0:0-1"},
+		},
+		{
+			name:     "repeatedly failing update is resent",
+			fail:     2,
+			expected: []string{"ctr0:0-1", "ctr0:0-1", "ctr0:0-1"},
+		},
+		{
+			name:     "newer update replaces failed one",
+			fail:     1,
+			repost:   "2-3",
+			expected: []string{"ctr0:0-1", "ctr0:2-3"},
+		},
+		{
+			name:     "failed update of removed container is dropped",
+			fail:     1,
+			remove:   true,
+			expected: []string{"ctr0:0-1"},
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			rt := &fakeRuntime{failUpdates: tc.fail}
+			m, cleanup := newTestResmgr(t, rt)
+			defer cleanup()
+
+			m.cache.InsertPod("pod0", &criapi.PodSandbox{
+				Id:       "pod0",
+				Metadata: &criapi.PodSandboxMetadata{Name: "pod0", Uid: "pod0"},
+				State:    criapi.PodSandboxState_SANDBOX_READY,
+			}, &cache.PodStatus{CgroupParent: "/kubepods/pod0"})
+			if _, err := m.cache.InsertContainer(&criapi.Container{
+				Id:           "ctr0",
+				PodSandboxId: "pod0",
+				Metadata:     &criapi.ContainerMetadata{Name: "ctr0"},
+				State:        criapi.ContainerState_CONTAINER_RUNNING,
+			}); err != nil {
+				t.Fatalf("failed to insert container: %v", err)
+			}
+
+			ctx := context.Background()
+			update := func(cpus string) *criapi.UpdateContainerResourcesRequest {
+				return &criapi.UpdateContainerResourcesRequest{
+					ContainerId: "ctr0",
+					Linux:       &criapi.LinuxContainerResources{CpusetCpus: cpus},
+				}
+			}
+
+			m.updates.post(update("0-1"))
+			m.sendCRIRequests(ctx, "test")
+			if tc.remove {
+				m.cache.DeleteContainer("ctr0")
+			}
+			if tc.repost != "" {
+				m.updates.post(update(tc.repost))
+			}
+			// every release of the lock sends posted updates, including retries
+			for i := 0; i < 3; i++ {
+				m.sendCRIRequests(ctx, "test")
+			}
+
+			if fmt.Sprint(rt.updates) != fmt.Sprint(tc.expected) {
+				t.Errorf("expected updates %v, got %v", tc.expected, rt.updates)
+			}
+		})
+	}
+}
@@ -15,6 +15,7 @@
 package resmgr
 
 import (
+	"context"
 	"golang.org/x/sys/unix"
 	"os"
 	"os/signal"
@@ -58,24 +59,30 @@ type ResourceManager interface {
 type resmgr struct {
 	logger.Logger
 	sync.RWMutex
-	relay        relay.Relay        // our CRI relay
-	cache        cache.Cache        // cached state
-	policy       policy.Policy      // resource manager policy
-	policySwitch bool               // active policy is being switched
-	configServer config.Server      // configuration management server
-	control      control.Control    // policy controllers/enforcement
-	agent        agent.Interface    // connection to cri-resmgr agent
-	conf         *config.RawConfig  // pending for saving in cache
-	metrics      *metrics.Metrics   // metrics collector/pre-processor
-	events       chan interface{}   // channel for delivering events
-	stop         chan interface{}   // channel for signalling shutdown to goroutines
-	signals      chan os.Signal     // signal channel
-	introspect   *introspect.Server // server for external introspection
+	relay        relay.Relay          // our CRI relay
+	cache        cache.Cache          // cached state
+	policy       policy.Policy        // resource manager policy
+	policySwitch bool                 // active policy is being switched
+	configServer config.Server        // configuration management server
+	control      control.Control      // policy controllers/enforcement
+	agent        agent.Interface      // connection to cri-resmgr agent
+	conf         *config.RawConfig    // pending for saving in cache
+	metrics      *metrics.Metrics     // metrics collector/pre-processor
+	events       chan interface{}     // channel for delivering events
+	stop         chan interface{}     // channel for signalling shutdown to goroutines
+	signals      chan os.Signal       // signal channel
+	introspect   *introspect.Server   // server for external introspection
+	pods         podLocks             // per-pod request serialization
+	updates      *updateCoalescer     // container update coalescing
+	sending      sync.Mutex           // serializes sending posted CRI requests
+	synced       chan struct{}        // closed once cache is reconciled after a warm restart
+	avxQueued    map[string]time.Time // AVX512 first use of cgroups not in the cache yet
 }
 
 // NewResourceManager creates a new ResourceManager instance.
 func NewResourceManager() (ResourceManager, error) {
 	m := &resmgr{Logger: logger.NewLogger("resource-manager")}
+	m.updates = newUpdateCoalescer(opt.UpdateWindow, m.flushCRIRequests)
 
 	if err := m.setupCache(); err != nil {
 		return nil, err
@@ -138,7 +145,7 @@ func (m *resmgr) Start() error {
 	m.Info("starting...")
 
 	m.Lock()
-	defer m.Unlock()
+	defer m.unlock(context.Background(), "startup")
 
 	if err := m.startControllers(); err != nil {
 		return err
@@ -206,8 +213,9 @@ func (m *resmgr) SetConfig(conf *config.RawConfig) error {
 func (m *resmgr) SetAdjustment(adjustment *config.Adjustment) map[string]error {
 	m.Info("applying new adjustments from agent...")
 
+	method := "setAdjustment"
 	m.Lock()
-	defer m.Unlock()
+	defer m.unlock(instrumentation.WithMethod(context.Background(), method), method)
 	return m.setAdjustment(adjustment)
 }
 
@@ -430,7 +438,11 @@ func (m *resmgr) setupPolicy() error {
 		m.policySwitch = true
 	}
 
-	options := &policy.Options{AgentCli: m.agent, SendEvent: m.SendEvent}
+	options := &policy.Options{
+		AgentCli:         m.agent,
+		SendEvent:        m.SendEvent,
+		TopologySnapshot: filepath.Join(opt.RelayDir, "topology"),
+	}
 	if m.policy, err = policy.NewPolicy(m.cache, options); err != nil {
 		return resmgrError("failed to create policy %s: %v", active, err)
 	}
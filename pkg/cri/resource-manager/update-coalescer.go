@@ -0,0 +1,159 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package resmgr
+
+import (
+	"bytes"
+	"sort"
+	"time"
+
+	criapi "k8s.io/cri-api/pkg/apis/runtime/v1alpha2"
+)
+
+// updateCoalescer collapses container resource updates sent to the runtime.
+//
+// A single allocation can change the resources of many other containers,
+// for instance by shrinking or growing a shared pool. The coalescer skips
+// updates which would not change the resources last sent to the runtime
+// for a container. If an update window is set, updates of already running
+// containers are deferred until the window expires, so that the changes of
+// a burst of requests get written once per container, with the resources
+// the container has at that point.
+//
+// Updates are posted to the coalescer while holding the resource manager
+// lock, and sent to the runtime only after the lock has been released. If
+// a container gets updated again before its posted update is sent, only
+// the latest one is sent.
+//
+// The coalescer is not thread-safe, it is protected by the resource manager
+// lock. The flush function is called without holding any locks.
+type updateCoalescer struct {
+	window time.Duration                                      // time to collect updates for, 0 for no deferring
+	flush  func()                                             // function to flush deferred updates with
+	sent   map[string][]byte                                  // resources last sent to the runtime, by container ID
+	queued map[string]struct{}                                // containers with deferred updates, by cache ID
+	timer  *time.Timer                                        // timer for flushing deferred updates
+	posted map[string]*criapi.UpdateContainerResourcesRequest // updates to send, by container ID
+	order  []string                                           // container IDs in the order of posting
+}
+
+// newUpdateCoalescer creates a new update coalescer.
+func newUpdateCoalescer(window time.Duration, flush func()) *updateCoalescer {
+	return &updateCoalescer{
+		window: window,
+		flush:  flush,
+		sent:   make(map[string][]byte),
+		queued: make(map[string]struct{}),
+		posted: make(map[string]*criapi.UpdateContainerResourcesRequest),
+	}
+}
+
+// isNoop checks if the resources are the ones last sent for the container.
+func (u *updateCoalescer) isNoop(id string, resources *criapi.LinuxContainerResources) bool {
+	last, ok := u.sent[id]
+	if !ok || resources == nil {
+		return false
+	}
+	data, err := resources.Marshal()
+	if err != nil {
+		return false
+	}
+	return bytes.Equal(last, data)
+}
+
+// markSent records the resources last sent for a container.
+func (u *updateCoalescer) markSent(id string, resources *criapi.LinuxContainerResources) {
+	if resources == nil {
+		delete(u.sent, id)
+		return
+	}
+	data, err := resources.Marshal()
+	if err != nil {
+		delete(u.sent, id)
+		return
+	}
+	u.sent[id] = data
+}
+
+// deferUpdate queues an update for the container if we have an update window.
+func (u *updateCoalescer) deferUpdate(cacheID string) bool {
+	if u.window <= 0 {
+		return false
+	}
+	u.queued[cacheID] = struct{}{}
+	if u.timer == nil {
+		u.timer = time.AfterFunc(u.window, u.flush)
+	}
+	return true
+}
+
+// takeQueued returns the cache IDs of all containers with deferred updates,
+// emptying the queue.
+func (u *updateCoalescer) takeQueued() []string {
+	ids := make([]string, 0, len(u.queued))
+	for id := range u.queued {
+		ids = append(ids, id)
+	}
+	sort.Strings(ids)
+	u.queued = make(map[string]struct{})
+	if u.timer != nil {
+		u.timer.Stop()
+		u.timer = nil
+	}
+	return ids
+}
+
+// post queues an update to be sent once the resource manager lock is released.
+func (u *updateCoalescer) post(req *criapi.UpdateContainerResourcesRequest) {
+	if _, ok := u.posted[req.ContainerId]; !ok {
+		u.order = append(u.order, req.ContainerId)
+	}
+	u.posted[req.ContainerId] = req
+}
+
+// repost posts a failed update again, unless a newer update has been posted
+// for the container since. It returns true if the update got posted.
+func (u *updateCoalescer) repost(req *criapi.UpdateContainerResourcesRequest) bool {
+	if _, ok := u.posted[req.ContainerId]; ok {
+		return false
+	}
+	u.post(req)
+	return true
+}
+
+// takePosted returns all posted updates in the order of posting, emptying
+// the queue.
+func (u *updateCoalescer) takePosted() []*criapi.UpdateContainerResourcesRequest {
+	if len(u.posted) == 0 {
+		u.order = u.order[:0]
+		return nil
+	}
+	reqs := make([]*criapi.UpdateContainerResourcesRequest, 0, len(u.posted))
+	for _, id := range u.order {
+		if req, ok := u.posted[id]; ok {
+			reqs = append(reqs, req)
+		}
+	}
+	u.posted = make(map[string]*criapi.UpdateContainerResourcesRequest)
+	u.order = u.order[:0]
+	return reqs
+}
+
+// forget removes all state kept about a container.
+func (u *updateCoalescer) forget(id, cacheID string) {
+	delete(u.sent, id)
+	delete(u.queued, cacheID)
+	delete(u.posted, id)
+}
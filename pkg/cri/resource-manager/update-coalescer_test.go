@@ -0,0 +1,149 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package resmgr
+
+import (
+	"testing"
+	"time"
+
+	criapi "k8s.io/cri-api/pkg/apis/runtime/v1alpha2"
+)
+
+func TestUpdateCoalescerNoop(t *testing.T) {
+	tcases := []struct {
+		name     string
+		sent     *criapi.LinuxContainerResources
+		update   *criapi.LinuxContainerResources
+		expected bool
+	}{
+		{
+			name:     "nothing sent",
+			update:   &criapi.LinuxContainerResources{CpusetCpus: "0-3"},
+			expected: false,
+		},
+		{
+			name:     "same cpuset",
+			sent:     &criapi.LinuxContainerResources{CpusetCpus: "0-3", CpusetMems: "0"},
+			update:   &criapi.LinuxContainerResources{CpusetCpus: "0-3", CpusetMems: "0"},
+			expected: true,
+		},
+		{
+			name:     "changed cpuset",
+			sent:     &criapi.LinuxContainerResources{CpusetCpus: "0-3", CpusetMems: "0"},
+			update:   &criapi.LinuxContainerResources{CpusetCpus: "0-5", CpusetMems: "0"},
+			expected: false,
+		},
+		{
+			name:     "changed shares",
+			sent:     &criapi.LinuxContainerResources{CpusetCpus: "0-3", CpuShares: 2},
+			update:   &criapi.LinuxContainerResources{CpusetCpus: "0-3", CpuShares: 1024},
+			expected: false,
+		},
+		{
+			name:     "no resources",
+			sent:     &criapi.LinuxContainerResources{CpusetCpus: "0-3"},
+			expected: false,
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			u := newUpdateCoalescer(0, nil)
+			if tc.sent != nil {
+				u.markSent("container", tc.sent)
+			}
+			if noop := u.isNoop("container", tc.update); noop != tc.expected {
+				t.Errorf("expected no-op %v, got %v", tc.expected, noop)
+			}
+		})
+	}
+}
+
+func TestUpdateCoalescerForget(t *testing.T) {
+	u := newUpdateCoalescer(0, nil)
+	res := &criapi.LinuxContainerResources{CpusetCpus: "0-3"}
+	u.markSent("container", res)
+	u.forget("container", "cache-container")
+	if u.isNoop("container", res) {
+		t.Errorf("update considered no-op for forgotten container")
+	}
+}
+
+func TestUpdateCoalescerDefer(t *testing.T) {
+	if newUpdateCoalescer(0, nil).deferUpdate("c0") {
+		t.Errorf("update deferred without an update window")
+	}
+
+	flushed := make(chan struct{}, 4)
+	u := newUpdateCoalescer(10*time.Millisecond, func() { flushed <- struct{}{} })
+	for _, id := range []string{"c1", "c0", "c1", "c0", "c2"} {
+		if !u.deferUpdate(id) {
+			t.Fatalf("update of %s not deferred", id)
+		}
+	}
+
+	select {
+	case <-flushed:
+	case <-time.After(5 * time.Second):
+		t.Fatalf("deferred updates never flushed")
+	}
+
+	queued := u.takeQueued()
+	expected := []string{"c0", "c1", "c2"}
+	if len(queued) != len(expected) {
+		t.Fatalf("expected queued updates %v, got %v", expected, queued)
+	}
+	for i := range expected {
+		if queued[i] != expected[i] {
+			t.Errorf("expected queued updates %v, got %v", expected, queued)
+		}
+	}
+	if len(u.takeQueued()) != 0 {
+		t.Errorf("queue not emptied")
+	}
+}
+
+func TestUpdateCoalescerPost(t *testing.T) {
+	u := newUpdateCoalescer(0, nil)
+	for _, req := range []*criapi.UpdateContainerResourcesRequest{
+		{ContainerId: "c1", Linux: &criapi.LinuxContainerResources{CpusetCpus: "0"}},
+		{ContainerId: "c0", Linux: &criapi.LinuxContainerResources{CpusetCpus: "1"}},
+		{ContainerId: "c2", Linux: &criapi.LinuxContainerResources{CpusetCpus: "2"}},
+		{ContainerId: "c1", Linux: &criapi.LinuxContainerResources{CpusetCpus: "3"}},
+	} {
+		u.post(req)
+	}
+	u.forget("c2", "cache-c2")
+
+	posted := u.takePosted()
+	expected := []struct {
+		id   string
+		cpus string
+	}{
+		{"c1", "3"},
+		{"c0", "1"},
+	}
+	if len(posted) != len(expected) {
+		t.Fatalf("expected %d posted updates, got %d", len(expected), len(posted))
+	}
+	for i, e := range expected {
+		if posted[i].ContainerId != e.id || posted[i].Linux.CpusetCpus != e.cpus {
+			t.Errorf("expected update #%d for %s with cpuset %s, got %s with %s", i,
+				e.id, e.cpus, posted[i].ContainerId, posted[i].Linux.CpusetCpus)
+		}
+	}
+	if len(u.takePosted()) != 0 {
+		t.Errorf("posted updates not emptied")
+	}
+}
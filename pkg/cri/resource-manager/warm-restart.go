@@ -0,0 +1,291 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package resmgr
+
+import (
+	"context"
+	"sync"
+	"time"
+
+	criapi "k8s.io/cri-api/pkg/apis/runtime/v1alpha2"
+
+	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/cache"
+	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/policy"
+	"github.com/intel/cri-resource-manager/pkg/cri/server"
+	"github.com/intel/cri-resource-manager/pkg/instrumentation"
+)
+
+const (
+	// number of containers to allocate or release while holding the lock
+	warmRestartBatchSize = 32
+	// maximum delay between retrying failed runtime queries
+	warmRestartMaxRetryDelay = 30 * time.Second
+)
+
+var (
+	// initial delay before retrying failed runtime queries
+	warmRestartRetryDelay = time.Second
+)
+
+// Notes:
+//   With warm restarts we trust the cache restored from disk. The policy is
+//   started with the restored containers only and we start relaying requests
+//   right away. The cache is reconciled with the runtime in the background.
+//   Only pods unknown to the cache are queried for their status, and only
+//   containers which appeared or disappeared while we were down are allocated
+//   or released. Restored containers whose resources stay the same are not
+//   updated. Requests which would change the cache are held back until the
+//   reconciliation is done. Failed runtime queries are retried, so held back
+//   requests never get released with an unreconciled cache.
+
+// startWarm starts request processing from the restored cache.
+func (m *resmgr) startWarm(ctx context.Context) error {
+	m.Info("warm restart, starting from restored cache...")
+
+	if err := m.policy.Start(nil, nil); err != nil {
+		return resmgrError("failed to start policy %s: %v", policy.ActivePolicy(), err)
+	}
+
+	// push out the grants which diverged while restoring the policy
+	if err := m.runPostReleaseHooks(ctx, "startup"); err != nil {
+		m.Error("startup: failed to run post-release hooks: %v", err)
+	}
+
+	m.synced = make(chan struct{})
+	go m.reconcileWithCRI()
+
+	return m.cache.Save()
+}
+
+// canWarmRestart checks if we can start from the restored cache.
+func (m *resmgr) canWarmRestart() bool {
+	if !opt.WarmRestart || m.policySwitch {
+		return false
+	}
+	return !m.policy.Bypassed() && m.relay.Client().HasRuntimeService()
+}
+
+// isSynced checks if the cache has been reconciled with the runtime.
+func (m *resmgr) isSynced() bool {
+	if m.synced == nil {
+		return true
+	}
+	select {
+	case <-m.synced:
+		return true
+	default:
+		return false
+	}
+}
+
+// waitSynced waits until the cache has been reconciled with the runtime.
+func (m *resmgr) waitSynced(ctx context.Context) error {
+	if m.isSynced() {
+		return nil
+	}
+	_, stage := instrumentation.StartStage(ctx, instrumentation.StageSync)
+	defer stage.End()
+	select {
+	case <-m.synced:
+		return nil
+	case <-ctx.Done():
+		return resmgrError("gave up waiting for cache synchronization: %v", ctx.Err())
+	}
+}
+
+// syncedInterceptor holds back requests until the cache has been reconciled.
+func (m *resmgr) syncedInterceptor(fn server.Interceptor) server.Interceptor {
+	return func(ctx context.Context, method string, request interface{},
+		handler server.Handler) (interface{}, error) {
+		if err := m.waitSynced(ctx); err != nil {
+			return nil, err
+		}
+		return fn(ctx, method, request, handler)
+	}
+}
+
+// reconcileWithCRI reconciles the restored cache with the runtime.
+func (m *resmgr) reconcileWithCRI() {
+	defer close(m.synced)
+
+	method := "WarmRestart"
+	ctx := instrumentation.WithMethod(context.Background(), method)
+	start := time.Now()
+
+	m.Info("%s: reconciling cache with CRI runtime...", method)
+
+	rt := m.queryRuntime(ctx, method)
+
+	add, del := []cache.Container{}, []cache.Container{}
+	m.Lock()
+	_, _, deleted := m.cache.RefreshPods(rt.pods, rt.status)
+	del = append(del, deleted...)
+	added, deleted := m.cache.RefreshContainers(rt.containers)
+	del = append(del, deleted...)
+	for _, c := range added {
+		if c.GetState() != cache.ContainerStateRunning {
+			m.Info("%s: ignoring discovered container %s (in state %v)...",
+				method, c.GetID(), c.GetState())
+			continue
+		}
+		m.Info("%s: discovered out-of-sync running container %s...", method, c.GetID())
+		add = append(add, c)
+	}
+	for _, c := range del {
+		m.Info("%s: discovered stale container %s...", method, c.GetID())
+	}
+	m.Unlock()
+
+	forEachBatch(warmRestartBatchSize, add, del, func(add, del []cache.Container) {
+		m.Lock()
+		if err := m.policy.Sync(add, del); err != nil {
+			m.Error("%s: failed to synchronize policy: %v", method, err)
+		}
+		if err := m.runPostReleaseHooks(ctx, method, del...); err != nil {
+			m.Error("%s: failed to run post-release hooks: %v", method, err)
+		}
+		m.unlock(ctx, method)
+	})
+
+	m.Lock()
+	if err := m.saveCache(ctx); err != nil {
+		m.Error("%s: failed to save cache: %v", method, err)
+	}
+	m.updateIntrospection()
+	m.requeueAvx()
+	m.Unlock()
+
+	m.Info("%s: cache reconciled in %v (%d pods queried, %d containers added, %d released)",
+		method, time.Since(start), rt.queried, len(add), len(del))
+}
+
+// runtimeState is the state of the runtime the cache is reconciled with.
+type runtimeState struct {
+	pods       *criapi.ListPodSandboxResponse
+	status     map[string]*cache.PodStatus
+	containers *criapi.ListContainersResponse
+	queried    int // number of pods queried for their status
+}
+
+// queryRuntime queries the runtime for reconciliation, retrying with backoff
+// until it succeeds.
+func (m *resmgr) queryRuntime(ctx context.Context, method string) *runtimeState {
+	delay := warmRestartRetryDelay
+	for {
+		rt, err := m.tryQueryRuntime(ctx)
+		if err == nil {
+			return rt
+		}
+		m.Error("%s: %v, retrying in %v...", method, err, delay)
+		time.Sleep(delay)
+		if delay *= 2; delay > warmRestartMaxRetryDelay {
+			delay = warmRestartMaxRetryDelay
+		}
+	}
+}
+
+// tryQueryRuntime queries the pods and containers of the runtime, and the
+// status of pods unknown to the cache.
+func (m *resmgr) tryQueryRuntime(ctx context.Context) (*runtimeState, error) {
+	client := m.relay.Client()
+
+	pods, err := client.ListPodSandbox(ctx, &criapi.ListPodSandboxRequest{})
+	if err != nil {
+		return nil, resmgrError("cache reconciliation pod query failed: %v", err)
+	}
+
+	// only pods we don't know about need a status query
+	unknown := []string{}
+	m.RLock()
+	for _, pod := range pods.Items {
+		if _, ok := m.cache.LookupPod(pod.Id); !ok {
+			unknown = append(unknown, pod.Id)
+		}
+	}
+	m.RUnlock()
+	status := m.queryPodStatuses(ctx, unknown)
+
+	containers, err := client.ListContainers(ctx, &criapi.ListContainersRequest{})
+	if err != nil {
+		return nil, resmgrError("cache reconciliation container query failed: %v", err)
+	}
+
+	return &runtimeState{
+		pods:       pods,
+		status:     status,
+		containers: containers,
+		queried:    len(unknown),
+	}, nil
+}
+
+// forEachBatch calls fn with consecutive batches of at most size containers
+// to add and to delete, until both run out.
+func forEachBatch(size int, add, del []cache.Container, fn func(add, del []cache.Container)) {
+	for len(add) > 0 || len(del) > 0 {
+		a, d := size, size
+		if a > len(add) {
+			a = len(add)
+		}
+		if d > len(del) {
+			d = len(del)
+		}
+		fn(add[:a], del[:d])
+		add, del = add[a:], del[d:]
+	}
+}
+
+// queryPodStatuses queries the status of the given pods, with bounded concurrency.
+func (m *resmgr) queryPodStatuses(ctx context.Context, podIDs []string) map[string]*cache.PodStatus {
+	var (
+		lock sync.Mutex
+		wg   sync.WaitGroup
+	)
+
+	status := make(map[string]*cache.PodStatus, len(podIDs))
+	queue := make(chan string)
+
+	workers := opt.SyncConcurrency
+	if workers < 1 {
+		workers = 1
+	}
+	if workers > len(podIDs) {
+		workers = len(podIDs)
+	}
+
+	for i := 0; i < workers; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for id := range queue {
+				s, err := m.queryPodStatus(ctx, id)
+				if err != nil {
+					m.Error("%s: failed to query pod status: %v", id, err)
+					continue
+				}
+				lock.Lock()
+				status[id] = s
+				lock.Unlock()
+			}
+		}()
+	}
+
+	for _, id := range podIDs {
+		queue <- id
+	}
+	close(queue)
+	wg.Wait()
+
+	return status
+}
@@ -0,0 +1,343 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package resmgr
+
+import (
+	"context"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"sync"
+	"testing"
+	"time"
+
+	"google.golang.org/grpc"
+	criapi "k8s.io/cri-api/pkg/apis/runtime/v1alpha2"
+
+	"github.com/intel/cri-resource-manager/pkg/cri/client"
+	"github.com/intel/cri-resource-manager/pkg/cri/relay"
+	"github.com/intel/cri-resource-manager/pkg/cri/resource-manager/cache"
+	"github.com/intel/cri-resource-manager/pkg/cri/server"
+	logger "github.com/intel/cri-resource-manager/pkg/log"
+)
+
+// fakeRelay is a relay with a fake runtime client.
+type fakeRelay struct {
+	relay.Relay
+	client client.Client
+}
+
+func (r *fakeRelay) Client() client.Client {
+	return r.client
+}
+
+// fakeRuntime is a runtime client with pods, which fails queries on request.
+type fakeRuntime struct {
+	client.Client
+	sync.Mutex
+	pods        []string        // pods of the runtime
+	failPods    int             // number of pod queries to fail
+	failCtrs    int             // number of container queries to fail
+	failStatus  map[string]bool // pods to fail status queries for
+	podQueries  int             // number of pod queries
+	ctrQueries  int             // number of container queries
+	running     int             // number of status queries running
+	concurrency int             // maximum number of status queries running
+	failUpdates int             // number of container updates to fail
+	updates     []string        // sent container updates, as container:cpuset
+}
+
+func (r *fakeRuntime) ListPodSandbox(ctx context.Context, req *criapi.ListPodSandboxRequest,
+	_ ...grpc.CallOption) (*criapi.ListPodSandboxResponse, error) {
+	r.Lock()
+	defer r.Unlock()
+
+	if r.podQueries++; r.podQueries <= r.failPods {
+		return nil, fmt.Errorf("pod query #%d failed", r.podQueries)
+	}
+	reply := &criapi.ListPodSandboxResponse{}
+	for _, id := range r.pods {
+		reply.Items = append(reply.Items, &criapi.PodSandbox{
+			Id:       id,
+			Metadata: &criapi.PodSandboxMetadata{Name: id, Uid: id},
+			State:    criapi.PodSandboxState_SANDBOX_READY,
+		})
+	}
+	return reply, nil
+}
+
+func (r *fakeRuntime) ListContainers(ctx context.Context, req *criapi.ListContainersRequest,
+	_ ...grpc.CallOption) (*criapi.ListContainersResponse, error) {
+	r.Lock()
+	defer r.Unlock()
+
+	if r.ctrQueries++; r.ctrQueries <= r.failCtrs {
+		return nil, fmt.Errorf("container query #%d failed", r.ctrQueries)
+	}
+	return &criapi.ListContainersResponse{}, nil
+}
+
+func (r *fakeRuntime) PodSandboxStatus(ctx context.Context, req *criapi.PodSandboxStatusRequest,
+	_ ...grpc.CallOption) (*criapi.PodSandboxStatusResponse, error) {
+	r.Lock()
+	if r.running++; r.running > r.concurrency {
+		r.concurrency = r.running
+	}
+	fail := r.failStatus[req.PodSandboxId]
+	r.Unlock()
+
+	// give other queries a chance to overlap with us
+	time.Sleep(5 * time.Millisecond)
+
+	r.Lock()
+	r.running--
+	r.Unlock()
+
+	if fail {
+		return nil, fmt.Errorf("status query of pod %s failed", req.PodSandboxId)
+	}
+	return &criapi.PodSandboxStatusResponse{
+		Status: &criapi.PodSandboxStatus{
+			Id:       req.PodSandboxId,
+			Metadata: &criapi.PodSandboxMetadata{Name: req.PodSandboxId},
+		},
+		Info: map[string]string{
+			"info": `{"config":{"linux":{"cgroup_parent":"/kubepods/` + req.PodSandboxId + `"}}}`,
+		},
+	}, nil
+}
+
+func (r *fakeRuntime) UpdateContainerResources(ctx context.Context, req *criapi.UpdateContainerResourcesRequest,
+	_ ...grpc.CallOption) (*criapi.UpdateContainerResourcesResponse, error) {
+	r.Lock()
+	defer r.Unlock()
+
+	r.updates = append(r.updates, req.ContainerId+":"+req.Linux.GetCpusetCpus())
+	if len(r.updates) <= r.failUpdates {
+		return nil, fmt.Errorf("update #%d of container %s failed", len(r.updates), req.ContainerId)
+	}
+	return &criapi.UpdateContainerResourcesResponse{}, nil
+}
+
+// newTestResmgr creates a resource manager with an empty cache for the given runtime.
+func newTestResmgr(t *testing.T, rt *fakeRuntime) (*resmgr, func()) {
+	dir, err := ioutil.TempDir("", "resmgr-test-")
+	if err != nil {
+		t.Fatalf("failed to create tmpdir: %v", err)
+	}
+	cch, err := cache.NewCache(cache.Options{CacheDir: dir})
+	if err != nil {
+		os.RemoveAll(dir)
+		t.Fatalf("failed to create cache: %v", err)
+	}
+	m := &resmgr{
+		Logger:  logger.NewLogger("resource-manager"),
+		relay:   &fakeRelay{client: rt},
+		cache:   cch,
+		updates: newUpdateCoalescer(0, nil),
+	}
+	return m, func() { os.RemoveAll(dir) }
+}
+
+func TestQueryPodStatuses(t *testing.T) {
+	tcases := []struct {
+		name        string
+		pods        int
+		concurrency int
+		fail        []string
+	}{
+		{
+			name:        "serial queries",
+			pods:        4,
+			concurrency: 1,
+		},
+		{
+			name:        "bounded concurrency",
+			pods:        16,
+			concurrency: 4,
+		},
+		{
+			name:        "more workers than pods",
+			pods:        2,
+			concurrency: 8,
+		},
+		{
+			name:        "failed queries are skipped",
+			pods:        8,
+			concurrency: 4,
+			fail:        []string{"pod1", "pod6"},
+		},
+		{
+			name:        "no pods",
+			concurrency: 4,
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			rt := &fakeRuntime{failStatus: map[string]bool{}}
+			for _, id := range tc.fail {
+				rt.failStatus[id] = true
+			}
+			m, cleanup := newTestResmgr(t, rt)
+			defer cleanup()
+
+			concurrency := opt.SyncConcurrency
+			opt.SyncConcurrency = tc.concurrency
+			defer func() { opt.SyncConcurrency = concurrency }()
+
+			podIDs := []string{}
+			for i := 0; i < tc.pods; i++ {
+				podIDs = append(podIDs, fmt.Sprintf("pod%d", i))
+			}
+			status := m.queryPodStatuses(context.Background(), podIDs)
+
+			if len(status) != tc.pods-len(tc.fail) {
+				t.Errorf("expected %d pod statuses, got %d", tc.pods-len(tc.fail), len(status))
+			}
+			for _, id := range podIDs {
+				s, ok := status[id]
+				switch {
+				case rt.failStatus[id] && ok:
+					t.Errorf("unexpected status for failed pod %s", id)
+				case !rt.failStatus[id] && !ok:
+					t.Errorf("missing status for pod %s", id)
+				case ok && s.CgroupParent != "/kubepods/"+id:
+					t.Errorf("expected cgroup parent /kubepods/%s, got %s", id, s.CgroupParent)
+				}
+			}
+			if rt.concurrency > tc.concurrency {
+				t.Errorf("expected at most %d concurrent queries, got %d",
+					tc.concurrency, rt.concurrency)
+			}
+		})
+	}
+}
+
+func TestQueryRuntimeRetries(t *testing.T) {
+	delay := warmRestartRetryDelay
+	warmRestartRetryDelay = time.Millisecond
+	defer func() { warmRestartRetryDelay = delay }()
+
+	rt := &fakeRuntime{
+		pods:     []string{"pod0", "pod1"},
+		failPods: 2,
+		failCtrs: 1,
+	}
+	m, cleanup := newTestResmgr(t, rt)
+	defer cleanup()
+
+	state := m.queryRuntime(context.Background(), "test")
+
+	if rt.podQueries != 4 || rt.ctrQueries != 2 {
+		t.Errorf("expected 4 pod and 2 container queries, got %d and %d",
+			rt.podQueries, rt.ctrQueries)
+	}
+	if len(state.pods.Items) != 2 || len(state.status) != 2 || state.containers == nil {
+		t.Errorf("expected 2 pods with status and containers, got %d pods, %d statuses",
+			len(state.pods.Items), len(state.status))
+	}
+}
+
+func TestForEachBatch(t *testing.T) {
+	tcases := []struct {
+		name     string
+		add      int
+		del      int
+		expected [][2]int // expected number of containers to add and delete per batch
+	}{
+		{
+			name: "nothing to do",
+		},
+		{
+			name:     "single batch",
+			add:      3,
+			del:      2,
+			expected: [][2]int{{3, 2}},
+		},
+		{
+			name:     "full batches",
+			add:      64,
+			expected: [][2]int{{32, 0}, {32, 0}},
+		},
+		{
+			name:     "uneven adds and deletes",
+			add:      70,
+			del:      33,
+			expected: [][2]int{{32, 32}, {32, 1}, {6, 0}},
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			add := make([]cache.Container, tc.add)
+			del := make([]cache.Container, tc.del)
+			batches := [][2]int{}
+			forEachBatch(warmRestartBatchSize, add, del, func(a, d []cache.Container) {
+				batches = append(batches, [2]int{len(a), len(d)})
+			})
+			if fmt.Sprint(batches) != fmt.Sprint(tc.expected) {
+				t.Errorf("expected batches %v, got %v", tc.expected, batches)
+			}
+		})
+	}
+}
+
+func TestSyncedInterceptor(t *testing.T) {
+	m := &resmgr{
+		Logger: logger.NewLogger("resource-manager"),
+		synced: make(chan struct{}),
+	}
+	handled := make(chan struct{}, 2)
+	fn := m.syncedInterceptor(func(ctx context.Context, method string, request interface{},
+		handler server.Handler) (interface{}, error) {
+		handled <- struct{}{}
+		return request, nil
+	})
+
+	// held back requests give up with their context
+	ctx, cancel := context.WithTimeout(context.Background(), 10*time.Millisecond)
+	defer cancel()
+	if _, err := fn(ctx, "CreateContainer", "early", nil); err == nil {
+		t.Errorf("expected request to time out before synchronization")
+	}
+	if len(handled) != 0 {
+		t.Errorf("request handled before synchronization")
+	}
+
+	// held back requests proceed once synchronized
+	done := make(chan interface{})
+	go func() {
+		reply, _ := fn(context.Background(), "CreateContainer", "held", nil)
+		done <- reply
+	}()
+	select {
+	case <-done:
+		t.Fatalf("request handled before synchronization")
+	case <-time.After(20 * time.Millisecond):
+	}
+	close(m.synced)
+	select {
+	case reply := <-done:
+		if reply != "held" {
+			t.Errorf("expected reply held, got %v", reply)
+		}
+	case <-time.After(time.Second):
+		t.Fatalf("request still held back after synchronization")
+	}
+
+	// synchronized requests are not held back
+	if reply, err := fn(context.Background(), "CreateContainer", "late", nil); err != nil || reply != "late" {
+		t.Errorf("expected reply late, got %v (error %v)", reply, err)
+	}
+}
@@ -302,6 +302,23 @@ func (s *server) intercept(ctx context.Context, req interface{},
 	//   One thing that we currently fail to measure separately is the latency of
 	//   internally generated CRI requests (UpdateContainerResources). These are
 	//   now accounted to the local processing latency of the triggering request.
+	//
+	//   Requests which are neither intercepted nor dumped are relayed as such,
+	//   without looking up qualifiers, taking timestamps or flushing logs.
+	//   These are the frequently polled read-only requests (List*, *Status,
+	//   *Stats), so we try to keep their overhead and allocations at minimum.
+	//   Qualifiers are only looked up for dumped requests, since producing
+	//   one might need to take the resource manager lock. This matters for
+	//   requests which are intercepted but not dumped, like ListContainers.
+
+	fn, name := s.getInterceptor(info.FullMethod)
+	dumped := dump.Enabled(name)
+	if fn == nil && !dumped {
+		if span := trace.FromContext(ctx); span != nil {
+			span.AddAttributes(trace.StringAttribute("kind", "passthrough"))
+		}
+		return handler(ctx, req)
+	}
 
 	var kind string
 	var start, send, recv, end time.Time
@@ -314,7 +331,6 @@ func (s *server) intercept(ctx context.Context, req interface{},
 		return rpl, err
 	}
 
-	fn, name := s.getInterceptor(info.FullMethod)
 	if fn != nil {
 		kind = "intercepted"
 		sync = true
@@ -326,8 +342,11 @@ func (s *server) intercept(ctx context.Context, req interface{},
 		}
 	}
 
-	qualif := s.qualifier(req)
-	dump.RequestMessage(kind, info.FullMethod, qualif, req, sync)
+	var qualif string
+	if dumped {
+		qualif = s.qualifier(req)
+		dump.RequestMessage(kind, info.FullMethod, qualif, req, sync)
+	}
 
 	if span := trace.FromContext(ctx); span != nil {
 		span.AddAttributes(trace.StringAttribute("kind", kind))
@@ -338,9 +357,11 @@ func (s *server) intercept(ctx context.Context, req interface{},
 	end = time.Now()
 	elapsed := end.Sub(start)
 
-	if err != nil {
+	switch {
+	case !dumped:
+	case err != nil:
 		dump.ReplyMessage(kind, info.FullMethod, qualif, err, elapsed, false)
-	} else {
+	default:
 		dump.ReplyMessage(kind, info.FullMethod, qualif, rpl, elapsed, false)
 	}
 
@@ -0,0 +1,161 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package server
+
+import (
+	"context"
+	"testing"
+
+	"google.golang.org/grpc"
+
+	api "k8s.io/cri-api/pkg/apis/runtime/v1alpha2"
+
+	"github.com/intel/cri-resource-manager/pkg/config"
+	"github.com/intel/cri-resource-manager/pkg/dump"
+	logger "github.com/intel/cri-resource-manager/pkg/log"
+)
+
+const (
+	containerStats  = "/runtime.v1alpha2.RuntimeService/ContainerStats"
+	listContainers  = "/runtime.v1alpha2.RuntimeService/ListContainers"
+	createContainer = "/runtime.v1alpha2.RuntimeService/CreateContainer"
+)
+
+var (
+	statsRequest = &api.ContainerStatsRequest{}
+	statsReply   = &api.ContainerStatsResponse{}
+)
+
+// newTestServer creates a server with interceptors for ListContainers and
+// CreateContainer, which with the default dump configuration are intercepted
+// but not dumped, and intercepted and dumped.
+func newTestServer(tb testing.TB) *server {
+	cfg := map[string]string{"dump": `Config: "` + dump.DefaultConfig + `"`}
+	if err := config.SetConfig(cfg); err != nil {
+		tb.Fatalf("failed to configure message dumping: %v", err)
+	}
+	dump.Train([]string{"ContainerStats", "ListContainers", "CreateContainer"})
+	relay := func(ctx context.Context, method string, req interface{},
+		handler Handler) (interface{}, error) {
+		return handler(ctx, req)
+	}
+	return &server{
+		Logger: logger.NewLogger("cri/server"),
+		interceptors: map[string]Interceptor{
+			"ListContainers":  relay,
+			"CreateContainer": relay,
+		},
+		chkBypassFn: func() bool { return false },
+	}
+}
+
+// relayed is a handler for relaying a request to the runtime.
+func relayed(ctx context.Context, req interface{}) (interface{}, error) {
+	return statsReply, nil
+}
+
+func TestPassthroughAllocs(t *testing.T) {
+	s := newTestServer(t)
+	ctx := context.Background()
+	info := &grpc.UnaryServerInfo{FullMethod: containerStats}
+
+	if fn, name := s.getInterceptor(containerStats); fn != nil || dump.Enabled(name) {
+		t.Fatalf("expected %s to be neither intercepted nor dumped", name)
+	}
+
+	allocs := testing.AllocsPerRun(100, func() {
+		if _, err := s.intercept(ctx, statsRequest, info, relayed); err != nil {
+			t.Fatalf("passthrough request failed: %v", err)
+		}
+	})
+	if allocs != 0 {
+		t.Errorf("expected no allocations for passthrough request, got %v", allocs)
+	}
+}
+
+func TestQualifierLookup(t *testing.T) {
+	tcases := []struct {
+		name     string
+		method   string
+		expected int
+	}{
+		{
+			name:   "passthrough",
+			method: containerStats,
+		},
+		{
+			name:   "intercepted but not dumped",
+			method: listContainers,
+		},
+		{
+			name:     "intercepted and dumped",
+			method:   createContainer,
+			expected: 1,
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			lookups := 0
+			s := newTestServer(t)
+			s.options.QualifyReqFn = func(interface{}) string {
+				lookups++
+				return ""
+			}
+			info := &grpc.UnaryServerInfo{FullMethod: tc.method}
+
+			if _, err := s.intercept(context.Background(), statsRequest, info, relayed); err != nil {
+				t.Fatalf("request failed: %v", err)
+			}
+			if lookups != tc.expected {
+				t.Errorf("expected %d qualifier lookups, got %d", tc.expected, lookups)
+			}
+		})
+	}
+}
+
+func BenchmarkIntercept(b *testing.B) {
+	tcases := []struct {
+		name   string
+		method string
+	}{
+		{
+			name:   "passthrough",
+			method: containerStats,
+		},
+		{
+			name:   "intercepted",
+			method: listContainers,
+		},
+		{
+			name:   "intercepted and dumped",
+			method: createContainer,
+		},
+	}
+	for _, tc := range tcases {
+		b.Run(tc.name, func(b *testing.B) {
+			s := newTestServer(b)
+			ctx := context.Background()
+			info := &grpc.UnaryServerInfo{FullMethod: tc.method}
+
+			b.ReportAllocs()
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				if _, err := s.intercept(ctx, statsRequest, info, relayed); err != nil {
+					b.Fatalf("request failed: %v", err)
+				}
+			}
+		})
+	}
+}
@@ -34,6 +34,7 @@ import (
 	"sigs.k8s.io/yaml"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	logger "github.com/intel/cri-resource-manager/pkg/log"
@@ -51,6 +52,7 @@ type dumper struct {
 	sync.RWMutex                  // protect concurrent dumping/reconfiguration
 	rules        ruleset          // dumping rules
 	details      map[string]level // corresponding dump details per method
+	enabled      atomic.Value     // lock-free copy of details, for Enabled()
 	disabled     bool             // dumping globally disabled
 	debug        bool             // dump as debug messages
 	path         string           // extra dump file path
@@ -93,9 +95,23 @@ func Train(methods []string) {
 	dump.train(methods)
 }
 
+// Enabled checks if messages of the given method would get dumped.
+func Enabled(name string) bool {
+	if dump.disabled {
+		return false
+	}
+	details, _ := dump.enabled.Load().(map[string]level)
+	detail, ok := details[methodName(name)]
+	if !ok {
+		// not trained for this method, let the dumper decide
+		return true
+	}
+	return detail != Off
+}
+
 // RequestMessage dumps a CRI request.
 func RequestMessage(kind, name, qualifier string, req interface{}, sync bool) {
-	if !dump.disabled {
+	if Enabled(name) {
 		var ch chan struct{}
 		if sync {
 			ch = make(chan struct{})
@@ -116,7 +132,7 @@ func RequestMessage(kind, name, qualifier string, req interface{}, sync bool) {
 
 // ReplyMessage dumps a CRI reply.
 func ReplyMessage(kind, name, qualifier string, rpl interface{}, latency time.Duration, sync bool) {
-	if !dump.disabled {
+	if Enabled(name) {
 		var ch chan struct{}
 		if sync {
 			ch = make(chan struct{})
@@ -232,6 +248,8 @@ func (d *dumper) train(names []string) {
 		d.methods[idx] = method
 		d.details[method] = detail
 	}
+	// details are never modified once trained, only replaced
+	d.enabled.Store(d.details)
 }
 
 // name does a name-only dump of the given message.
@@ -0,0 +1,110 @@
+// +build ignore
+
+/*
+Copyright 2020 Intel Corporation
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package main
+
+import (
+	"encoding/hex"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"text/template"
+)
+
+const (
+	blocksPerRow = 12
+	sourceDir    = "../../elf"
+	objectDir    = "../../libexec"
+)
+
+type Object struct {
+	Name  string
+	Lines []string
+}
+
+type Program struct {
+	Objects []Object
+}
+
+func main() {
+	sources, err := filepath.Glob(filepath.Join(sourceDir, "*.c"))
+	if err != nil {
+		fmt.Println("elfdump:", err)
+		os.Exit(1)
+	}
+	sort.Strings(sources)
+
+	p := Program{}
+	for _, src := range sources {
+		name := strings.TrimSuffix(filepath.Base(src), ".c")
+		f, err := ioutil.ReadFile(filepath.Join(objectDir, name+".o"))
+		if err != nil {
+			fmt.Printf("Note: %s eBPF ELF not available.\n", name)
+			continue
+		}
+		enc := make([]byte, hex.EncodedLen(len(f)))
+		enclen := hex.Encode(enc, f)
+
+		var j int
+		var row strings.Builder
+		lines := make([]string, 0)
+
+		for i := 0; i < enclen-1; i = i + 2 {
+			fmt.Fprintf(&row, "0x%s, ", enc[i:i+2])
+			j++
+			if j%blocksPerRow == 0 {
+				lines = append(lines, row.String())
+				row.Reset()
+			}
+		}
+		// flush last row
+		lines = append(lines, row.String())
+
+		p.Objects = append(p.Objects, Object{Name: name, Lines: lines})
+	}
+
+	template := template.Must(template.New("").Parse(`// Code generated by go generate; DO NOT EDIT.
+
+package ebpf
+
+func init() {
+{{- range .Objects }}
+	register("{{ .Name }}", []byte{
+	{{- range .Lines }}
+		{{ printf "%s" . }}
+	{{- end }}
+	})
+{{- end }}
+}
+`))
+
+	outfile, err := os.Create("programs_gendata.go")
+	if err != nil {
+		fmt.Println("elfdump:", err)
+		os.Exit(1)
+	}
+	defer outfile.Close()
+
+	err = template.Execute(outfile, p)
+	if err != nil {
+		fmt.Println("elfdump:", err)
+	}
+}
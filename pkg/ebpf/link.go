@@ -0,0 +1,135 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ebpf
+
+import (
+	"io/ioutil"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"unsafe"
+
+	bpf "github.com/cilium/ebpf"
+	"github.com/pkg/errors"
+	"golang.org/x/sys/unix"
+)
+
+const (
+	// bpf(2) BPF_LINK_CREATE command
+	bpfLinkCreate = 28
+	// BPF_PERF_EVENT attach type, for perf event links
+	bpfPerfEvent = 41
+	// minimum kernel version for perf event links
+	perfLinkKernelVersion = 5<<16 + 15<<8
+)
+
+// bpfLinkCreateAttr is the link_create part of union bpf_attr.
+type bpfLinkCreateAttr struct {
+	progFd     uint32
+	targetFd   uint32
+	attachType uint32
+	flags      uint32
+	pad        [4]uint64
+}
+
+// Link is an attachment of an eBPF program to a perf event.
+//
+// If the kernel supports it, the program is attached with a bpf_link which
+// detaches the program once closed. Otherwise the program is attached with
+// an ioctl and stays attached until the perf event itself is closed.
+type Link struct {
+	fd  int // bpf_link fd, or -1
+	pfd int // perf event fd
+}
+
+// attachTracepoint attaches prog to the given kernel tracepoint.
+func attachTracepoint(prog *bpf.Program, tracepoint string) (*Link, error) {
+	id, err := ioutil.ReadFile(filepath.Join(TracepointPath, tracepoint, "id"))
+	if err != nil {
+		return nil, errors.Wrap(err, "unable to read tracepoint ID")
+	}
+
+	tid, err := strconv.Atoi(strings.TrimSpace(string(id)))
+	if err != nil {
+		return nil, errors.New("unable to convert tracepoint ID")
+	}
+
+	attr := unix.PerfEventAttr{
+		Type:        unix.PERF_TYPE_TRACEPOINT,
+		Config:      uint64(tid), // tracepoint id
+		Sample_type: unix.PERF_SAMPLE_RAW,
+		Sample:      1,
+		Wakeup:      1,
+	}
+
+	pfd, err := unix.PerfEventOpen(&attr, -1, 0, -1, unix.PERF_FLAG_FD_CLOEXEC)
+	if err != nil {
+		return nil, errors.Wrap(err, "unable to open perf events")
+	}
+
+	l := &Link{fd: -1, pfd: pfd}
+	if err := l.attach(prog); err != nil {
+		l.Close()
+		return nil, err
+	}
+
+	if _, _, errno := unix.Syscall(unix.SYS_IOCTL, uintptr(pfd), unix.PERF_EVENT_IOC_ENABLE, 0); errno != 0 {
+		l.Close()
+		return nil, errors.Errorf("unable to set up perf events: %s", errno)
+	}
+
+	return l, nil
+}
+
+// attach attaches prog to the perf event of the link.
+func (l *Link) attach(prog *bpf.Program) error {
+	if KernelVersion() >= perfLinkKernelVersion {
+		attr := bpfLinkCreateAttr{
+			progFd:     uint32(prog.FD()),
+			targetFd:   uint32(l.pfd),
+			attachType: bpfPerfEvent,
+		}
+		fd, _, errno := unix.Syscall(unix.SYS_BPF, bpfLinkCreate, uintptr(unsafe.Pointer(&attr)), unsafe.Sizeof(attr))
+		if errno == 0 {
+			l.fd = int(fd)
+			return nil
+		}
+		log.Debug("failed to create perf event link, falling back to ioctl: %v", errno)
+	}
+
+	if _, _, errno := unix.Syscall(unix.SYS_IOCTL, uintptr(l.pfd), unix.PERF_EVENT_IOC_SET_BPF, uintptr(prog.FD())); errno != 0 {
+		return errors.Errorf("unable to attach bpf program to perf events: %s", errno)
+	}
+
+	return nil
+}
+
+// Close detaches the program and closes the perf event.
+func (l *Link) Close() error {
+	var err error
+
+	if l.fd >= 0 {
+		err = unix.Close(l.fd)
+		l.fd = -1
+	}
+	if l.pfd >= 0 {
+		if perr := unix.Close(l.pfd); err == nil {
+			err = perr
+		}
+		l.pfd = -1
+	}
+
+	return err
+}
@@ -0,0 +1,294 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ebpf
+
+//go:generate go run elfdump.go
+
+import (
+	"bytes"
+	"flag"
+	"fmt"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"sync"
+
+	bpf "github.com/cilium/ebpf"
+	logger "github.com/intel/cri-resource-manager/pkg/log"
+	"github.com/pkg/errors"
+	"golang.org/x/sys/unix"
+)
+
+const (
+	// TracepointPath is the path to kernel tracepoints.
+	TracepointPath = "/sys/kernel/debug/tracing/events"
+	// ObjectSuffix is the suffix of eBPF object files in the install directory.
+	ObjectSuffix = ".o"
+)
+
+var (
+	// installPath is the directory of user provided eBPF objects.
+	installPath = "/usr/libexec/bpf"
+
+	// programs are the embedded eBPF objects, registered by programs_gendata.go.
+	programs = map[string][]byte{}
+
+	// memlockMu serializes memlock rlimit adjustments.
+	memlockMu sync.Mutex
+
+	// our logger instance
+	log = logger.NewLogger("ebpf")
+)
+
+// Options are the options for loading an eBPF object.
+type Options struct {
+	// MapSizes overrides the max_entries of maps in the object.
+	MapSizes map[string]uint32
+	// MemLock is the locked memory rlimit the object needs.
+	MemLock uint64
+	// Pin lists the maps of the object to pin in bpffs and reuse across
+	// restarts. Only maps with counters, cumulative or not yet collected,
+	// should be listed, maps with transient state referring to the previous
+	// instance should not.
+	Pin []string
+}
+
+// Object is a loaded eBPF object, with maps and programs, and its attachments.
+type Object struct {
+	// Name is the name of the object.
+	Name string
+	// Collection contains the maps and programs of the object.
+	*bpf.Collection
+	// links are the attachments of the programs.
+	links []*Link
+	// pin are the names of the maps to pin in bpffs.
+	pin map[string]struct{}
+	// pinned is true if the maps of the object are pinned in bpffs.
+	pinned bool
+}
+
+// register registers an embedded eBPF object.
+func register(name string, object []byte) {
+	programs[name] = object
+}
+
+// Load loads the named eBPF object, from the install directory if it has one,
+// otherwise using the embedded object, and creates its maps and programs.
+//
+// Load refuses to load objects built for a newer kernel than the host one.
+// Maps listed in the options are pinned in bpffs and reused from there if a
+// previous instance of us has left them behind.
+func Load(name string, opts *Options) (*Object, error) {
+	if opts == nil {
+		opts = &Options{}
+	}
+
+	if opts.MemLock != 0 {
+		if err := raiseMemlock(opts.MemLock); err != nil {
+			return nil, err
+		}
+	}
+
+	spec, err := loadSpec(name)
+	if err != nil {
+		return nil, err
+	}
+
+	if err := checkKernelVersion(name, spec); err != nil {
+		return nil, err
+	}
+
+	for mapName, size := range opts.MapSizes {
+		if m, ok := spec.Maps[mapName]; ok {
+			m.MaxEntries = size
+		}
+	}
+
+	o := &Object{Name: name, pin: make(map[string]struct{})}
+	for _, mapName := range opts.Pin {
+		o.pin[mapName] = struct{}{}
+	}
+
+	var reused map[string]*bpf.Map
+	if len(o.pin) > 0 && pinPath != "" {
+		if reused, err = o.loadPinnedMaps(spec); err != nil {
+			log.Warn("%s: not pinning maps: %v", name, err)
+			reused = nil
+		} else {
+			o.pinned = true
+		}
+	}
+
+	if o.Collection, err = bpf.NewCollection(spec); err != nil {
+		for _, m := range reused {
+			m.Close()
+		}
+		return nil, errors.Wrapf(err, "%s: unable to create new Collection", name)
+	}
+	for mapName, m := range reused {
+		o.Maps[mapName] = m
+	}
+
+	if o.pinned {
+		if err := o.pinMaps(reused); err != nil {
+			log.Warn("%s: failed to pin maps: %v", name, err)
+		}
+	}
+
+	return o, nil
+}
+
+// loadSpec loads the spec of the named eBPF object.
+func loadSpec(name string) (*bpf.CollectionSpec, error) {
+	path := filepath.Join(installPath, name+ObjectSuffix)
+	spec, err := bpf.LoadCollectionSpec(path)
+	if err == nil {
+		log.Info("%s: using user eBPF object %s", name, path)
+		return spec, nil
+	}
+
+	object, ok := programs[name]
+	if !ok || len(object) == 0 {
+		return nil, errors.Wrapf(err, "%s: no user or embedded eBPF object", name)
+	}
+
+	log.Info("%s: unable to load user eBPF (%v), using embedded object", name, err)
+	spec, err = bpf.LoadCollectionSpecFromReader(bytes.NewReader(object))
+	if err != nil {
+		return nil, errors.Wrapf(err, "%s: unable to load embedded eBPF object", name)
+	}
+
+	return spec, nil
+}
+
+// checkKernelVersion checks that the host kernel can run all programs of the spec.
+func checkKernelVersion(name string, spec *bpf.CollectionSpec) error {
+	hostVer := KernelVersion()
+	for progName, prog := range spec.Programs {
+		if hostVer < prog.KernelVersion {
+			return errors.Errorf("%s: the host kernel version (v%s) is too old to run eBPF program %s, minimum version is v%s",
+				name, KernelVersionString(hostVer), progName, KernelVersionString(prog.KernelVersion))
+		}
+	}
+	return nil
+}
+
+// Program returns the named program of the object.
+func (o *Object) Program(name string) (*bpf.Program, error) {
+	prog, ok := o.Programs[name]
+	if !ok {
+		return nil, errors.Errorf("%s: no eBPF program %s", o.Name, name)
+	}
+	return prog, nil
+}
+
+// AttachTracepoint attaches the named program to a kernel tracepoint.
+func (o *Object) AttachTracepoint(name, tracepoint string) error {
+	prog, err := o.Program(name)
+	if err != nil {
+		return err
+	}
+
+	l, err := attachTracepoint(prog, tracepoint)
+	if err != nil {
+		return errors.Wrapf(err, "%s: unable to attach %s to tracepoint %s", o.Name, name, tracepoint)
+	}
+	o.links = append(o.links, l)
+
+	return nil
+}
+
+// Close detaches all programs of the object and releases its maps and programs.
+// Pinned maps and their content survive until the next time the object is loaded.
+func (o *Object) Close() {
+	for _, l := range o.links {
+		if err := l.Close(); err != nil {
+			log.Warn("%s: failed to detach program: %v", o.Name, err)
+		}
+	}
+	o.links = nil
+	if o.Collection != nil {
+		o.Collection.Close()
+		o.Collection = nil
+	}
+}
+
+// raiseMemlock raises the locked memory rlimit to at least the given value.
+func raiseMemlock(limit uint64) error {
+	memlockMu.Lock()
+	defer memlockMu.Unlock()
+
+	rlim := &unix.Rlimit{}
+	if err := unix.Getrlimit(unix.RLIMIT_MEMLOCK, rlim); err != nil {
+		return errors.Wrap(err, "unable to get rlimit")
+	}
+	if rlim.Cur >= limit && rlim.Max >= limit {
+		return nil
+	}
+
+	if rlim.Cur < limit {
+		rlim.Cur = limit
+	}
+	if rlim.Max < limit {
+		rlim.Max = limit
+	}
+	if err := unix.Setrlimit(unix.RLIMIT_MEMLOCK, rlim); err != nil {
+		return errors.Wrap(err, "unable to set rlimit")
+	}
+
+	return nil
+}
+
+// KernelVersion returns the version of the host kernel, in the encoding of
+// KERNEL_VERSION(), or 0 if it can't be determined.
+func KernelVersion() uint32 {
+	var uts unix.Utsname
+
+	if err := unix.Uname(&uts); err != nil {
+		return 0
+	}
+
+	return parseKernelVersion(string(bytes.SplitN(uts.Release[:], []byte{0}, 2)[0]))
+}
+
+// parseKernelVersion parses a kernel release string, ignoring the patch version.
+func parseKernelVersion(release string) uint32 {
+	ver := strings.SplitN(release, ".", 3)
+
+	major, err := strconv.ParseUint(ver[0], 10, 8)
+	if err != nil {
+		return 0
+	}
+	if len(ver) < 2 {
+		return uint32(major << 16)
+	}
+	minor, err := strconv.ParseUint(ver[1], 10, 8)
+	if err != nil {
+		return uint32(major << 16)
+	}
+
+	// ignore patch version
+	return uint32(major<<16 + minor<<8)
+}
+
+// KernelVersionString returns the given kernel version as a string.
+func KernelVersionString(v uint32) string {
+	return fmt.Sprintf("%d.%d.0", v>>16, (v>>8)&0xff)
+}
+
+func init() {
+	flag.StringVar(&installPath, "bpf-install-path", installPath,
+		"Path to eBPF install directory")
+}
@@ -0,0 +1,102 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ebpf
+
+import (
+	"testing"
+
+	bpf "github.com/cilium/ebpf"
+)
+
+func TestParseKernelVersion(t *testing.T) {
+	tcases := []struct {
+		name     string
+		release  string
+		expected uint32
+	}{
+		{
+			name:     "distro kernel",
+			release:  "5.4.0-91-generic",
+			expected: 5<<16 + 4<<8,
+		},
+		{
+			name:     "upstream kernel",
+			release:  "5.15.12",
+			expected: 5<<16 + 15<<8,
+		},
+		{
+			name:     "release candidate",
+			release:  "6.1-rc3",
+			expected: 6 << 16,
+		},
+		{
+			name:     "major version only",
+			release:  "5",
+			expected: 5 << 16,
+		},
+		{
+			name:    "invalid release",
+			release: "unknown",
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			if v := parseKernelVersion(tc.release); v != tc.expected {
+				t.Errorf("expected version %s, got %s",
+					KernelVersionString(tc.expected), KernelVersionString(v))
+			}
+		})
+	}
+}
+
+func TestPinnable(t *testing.T) {
+	o := &Object{
+		Name: "test",
+		pin: map[string]struct{}{
+			"counters": {},
+			"events":   {},
+		},
+	}
+	tcases := []struct {
+		name     string
+		mapName  string
+		mapType  bpf.MapType
+		expected bool
+	}{
+		{
+			name:     "listed counter map",
+			mapName:  "counters",
+			mapType:  bpf.LRUCPUHash,
+			expected: true,
+		},
+		{
+			name:    "unlisted transient map",
+			mapName: "timestamps",
+			mapType: bpf.PerCPUArray,
+		},
+		{
+			name:    "listed perf event array",
+			mapName: "events",
+			mapType: bpf.PerfEventArray,
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			if pinnable := o.pinnable(tc.mapName, tc.mapType); pinnable != tc.expected {
+				t.Errorf("expected pinnable %v for map %s, got %v", tc.expected, tc.mapName, pinnable)
+			}
+		})
+	}
+}
@@ -0,0 +1,132 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ebpf
+
+import (
+	"flag"
+	"os"
+	"path/filepath"
+
+	bpf "github.com/cilium/ebpf"
+	"github.com/pkg/errors"
+	"golang.org/x/sys/unix"
+)
+
+var (
+	// pinPath is the bpffs directory maps are pinned under, empty to disable pinning.
+	pinPath = "/sys/fs/bpf/cri-resmgr"
+)
+
+// pinnable returns true if the map should be pinned and reused by a later instance.
+func (o *Object) pinnable(name string, typ bpf.MapType) bool {
+	// perf event arrays refer to our perf events which go away with us
+	if typ == bpf.PerfEventArray {
+		return false
+	}
+	_, ok := o.pin[name]
+	return ok
+}
+
+// compatible returns true if a pinned map can be used in place of the given map.
+func compatible(m *bpf.Map, spec *bpf.MapSpec) bool {
+	abi := m.ABI()
+	return abi.Type == spec.Type &&
+		abi.KeySize == spec.KeySize &&
+		abi.ValueSize == spec.ValueSize &&
+		abi.MaxEntries == spec.MaxEntries
+}
+
+// pinDir returns the bpffs directory of the pinned maps of the object.
+func (o *Object) pinDir() string {
+	return filepath.Join(pinPath, o.Name)
+}
+
+// loadPinnedMaps loads the pinned maps matching the spec, removing them from it.
+func (o *Object) loadPinnedMaps(spec *bpf.CollectionSpec) (map[string]*bpf.Map, error) {
+	var stat unix.Statfs_t
+
+	dir := o.pinDir()
+	if err := os.MkdirAll(dir, 0700); err != nil {
+		return nil, errors.Wrapf(err, "failed to create %s", dir)
+	}
+	if err := unix.Statfs(dir, &stat); err != nil {
+		return nil, errors.Wrapf(err, "failed to stat %s", dir)
+	}
+	if stat.Type != unix.BPF_FS_MAGIC {
+		return nil, errors.Errorf("%s is not on a bpf filesystem", dir)
+	}
+
+	reused := make(map[string]*bpf.Map)
+	for name, ms := range spec.Maps {
+		path := filepath.Join(dir, name)
+		if !o.pinnable(name, ms.Type) {
+			// drop any stale state pinned by an earlier version
+			if err := os.Remove(path); err == nil {
+				log.Info("%s: removed unpinnable pinned map %s", o.Name, path)
+			}
+			continue
+		}
+		m, err := bpf.LoadPinnedMap(path)
+		if err != nil {
+			if !os.IsNotExist(errors.Cause(err)) {
+				log.Warn("%s: failed to load pinned map %s: %v", o.Name, path, err)
+			}
+			continue
+		}
+		if !compatible(m, ms) {
+			log.Info("%s: discarding incompatible pinned map %s", o.Name, path)
+			m.Close()
+			os.Remove(path)
+			continue
+		}
+		log.Debug("%s: reusing pinned map %s", o.Name, path)
+		reused[name] = m
+	}
+
+	if err := spec.RewriteMaps(reused); err != nil {
+		for _, m := range reused {
+			m.Close()
+		}
+		return nil, errors.Wrap(err, "failed to use pinned maps")
+	}
+	for name := range reused {
+		delete(spec.Maps, name)
+	}
+
+	return reused, nil
+}
+
+// pinMaps pins the pinnable maps of the object not reused from bpffs.
+func (o *Object) pinMaps(reused map[string]*bpf.Map) error {
+	for name, m := range o.Maps {
+		if _, ok := reused[name]; ok {
+			continue
+		}
+		if !o.pinnable(name, m.ABI().Type) {
+			continue
+		}
+		path := filepath.Join(o.pinDir(), name)
+		os.Remove(path)
+		if err := m.Pin(path); err != nil {
+			return errors.Wrapf(err, "failed to pin map %s", name)
+		}
+	}
+	return nil
+}
+
+func init() {
+	flag.StringVar(&pinPath, "bpf-pin-path", pinPath,
+		"bpffs directory to pin eBPF maps under, empty to disable pinning")
+}
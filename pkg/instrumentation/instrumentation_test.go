@@ -15,10 +15,13 @@
 package instrumentation
 
 import (
+	"context"
 	"io/ioutil"
 	"net/http"
 	"strings"
 	"testing"
+
+	"go.opencensus.io/stats/view"
 )
 
 func TestSamplingIdempotency(t *testing.T) {
@@ -72,6 +75,61 @@ func TestPrometheusConfiguration(t *testing.T) {
 	s.Stop()
 }
 
+func TestStageLatency(t *testing.T) {
+	if err := registerStageViews(); err != nil {
+		t.Fatalf("failed to register stage views: %v", err)
+	}
+	defer unregisterStageViews()
+
+	tcases := []struct {
+		method string
+		stage  string
+		count  int
+	}{
+		{method: "CreateContainer", stage: StageLock, count: 1},
+		{method: "CreateContainer", stage: StagePolicy, count: 2},
+		{method: "", stage: StageCache, count: 3},
+	}
+	for _, tc := range tcases {
+		ctx := context.Background()
+		if tc.method != "" {
+			ctx = WithMethod(ctx, tc.method)
+		}
+		for i := 0; i < tc.count; i++ {
+			TimeStage(ctx, tc.stage, func() {})
+		}
+	}
+
+	rows, err := view.RetrieveData(stageLatencyView.Name)
+	if err != nil {
+		t.Fatalf("failed to retrieve stage latency data: %v", err)
+	}
+
+	for _, tc := range tcases {
+		method := tc.method
+		if method == "" {
+			method = "unknown"
+		}
+		found := false
+		for _, row := range rows {
+			tags := map[string]string{}
+			for _, tag := range row.Tags {
+				tags[tag.Key.Name()] = tag.Value
+			}
+			if tags["method"] != method || tags["stage"] != tc.stage {
+				continue
+			}
+			found = true
+			if data, ok := row.Data.(*view.DistributionData); !ok || data.Count != int64(tc.count) {
+				t.Errorf("expected %d samples for %s/%s, got %v", tc.count, method, tc.stage, row.Data)
+			}
+		}
+		if !found {
+			t.Errorf("no samples for %s/%s", method, tc.stage)
+		}
+	}
+}
+
 func checkPrometheus(t *testing.T, server string, shouldFail bool) {
 	rpl, err := http.Get("http://" + server + "/metrics")
 
@@ -63,6 +63,13 @@ func (s *service) Start() error {
 		s.http.Stop()
 		return err
 	}
+	if err := registerStageViews(); err != nil {
+		unregisterGrpcViews()
+		s.metrics.stop()
+		s.tracing.stop()
+		s.http.Stop()
+		return err
+	}
 
 	return nil
 }
@@ -72,6 +79,7 @@ func (s *service) Stop() {
 	s.Lock()
 	defer s.Unlock()
 
+	unregisterStageViews()
 	unregisterGrpcViews()
 	s.metrics.stop()
 	s.tracing.stop()
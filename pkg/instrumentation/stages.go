@@ -0,0 +1,137 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package instrumentation
+
+import (
+	"context"
+	"time"
+
+	"go.opencensus.io/stats"
+	"go.opencensus.io/stats/view"
+	"go.opencensus.io/tag"
+	"go.opencensus.io/trace"
+)
+
+const (
+	// StageLock is the stage of waiting for the resource manager lock.
+	StageLock = "lock"
+	// StagePodLock is the stage of waiting for other requests for the same pod.
+	StagePodLock = "pod-lock"
+	// StageSync is the stage of waiting for the cache to get reconciled with the runtime.
+	StageSync = "sync"
+	// StagePolicy is the stage of policy resource allocation or release.
+	StagePolicy = "policy"
+	// StageCache is the stage of updating and saving the cache.
+	StageCache = "cache"
+	// StageRuntime is the stage of waiting for the runtime to process a request.
+	StageRuntime = "runtime"
+	// StageHookPrefix is the prefix for controller hook stages, <hook>:<controller>.
+	StageHookPrefix = "hook:"
+)
+
+var (
+	// stageLatency measures the duration of request processing stages.
+	stageLatency = stats.Float64("cri/request_stage_latency",
+		"Duration of request processing stages", stats.UnitMilliseconds)
+	// methodKey tags stage measurements with the request method.
+	methodKey = tag.MustNewKey("method")
+	// stageKey tags stage measurements with the stage.
+	stageKey = tag.MustNewKey("stage")
+
+	// stageLatencyView is the histogram view of stage durations.
+	stageLatencyView = &view.View{
+		Name:        "cri/request_stage_latency",
+		Description: "Latency distribution of request processing stages.",
+		Measure:     stageLatency,
+		TagKeys:     []tag.Key{methodKey, stageKey},
+		Aggregation: view.Distribution(0.01, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10,
+			25, 50, 100, 250, 500, 1000, 2500, 5000, 10000),
+	}
+)
+
+// methodCtxKey is the context key for the method of the request being processed.
+type methodCtxKey struct{}
+
+// WithMethod returns a context for instrumenting stages of processing a request.
+func WithMethod(ctx context.Context, method string) context.Context {
+	return context.WithValue(ctx, methodCtxKey{}, method)
+}
+
+// Stage is a stage of processing a request, timed and traced.
+type Stage struct {
+	ctx   context.Context
+	name  string
+	start time.Time
+	span  *trace.Span
+}
+
+// StartStage starts a stage of processing the request of the context.
+//
+// The returned context carries a tracing span for the stage, to be used
+// for any nested stages or outgoing requests made during the stage.
+func StartStage(ctx context.Context, name string) (context.Context, *Stage) {
+	method, _ := ctx.Value(methodCtxKey{}).(string)
+	if method == "" {
+		method = "unknown"
+	}
+
+	ctx, span := trace.StartSpan(ctx, method+"/"+name)
+	s := &Stage{
+		ctx:   ctx,
+		name:  name,
+		start: time.Now(),
+		span:  span,
+	}
+
+	return ctx, s
+}
+
+// End ends a stage, recording its duration.
+func (s *Stage) End() {
+	duration := time.Since(s.start)
+	s.span.End()
+
+	method, _ := s.ctx.Value(methodCtxKey{}).(string)
+	if method == "" {
+		method = "unknown"
+	}
+
+	stats.RecordWithTags(s.ctx,
+		[]tag.Mutator{tag.Upsert(methodKey, method), tag.Upsert(stageKey, s.name)},
+		stageLatency.M(float64(duration)/float64(time.Millisecond)))
+}
+
+// TimeStage runs fn as a stage of processing the request of the context.
+func TimeStage(ctx context.Context, name string, fn func()) {
+	_, s := StartStage(ctx, name)
+	fn()
+	s.End()
+}
+
+// registerStageViews registers the request stage latency views.
+func registerStageViews() error {
+	log.Debug("registering request stage views...")
+
+	if err := view.Register(stageLatencyView); err != nil {
+		return instrumentationError("failed to register request stage views: %v", err)
+	}
+
+	return nil
+}
+
+// unregisterStageViews unregisters the request stage latency views.
+func unregisterStageViews() {
+	view.Unregister(stageLatencyView)
+}
@@ -0,0 +1,8 @@
+// +build !noschedlat
+
+package register
+
+import (
+	// Pull in scheduling latency collector.
+	_ "github.com/intel/cri-resource-manager/pkg/schedlat"
+)
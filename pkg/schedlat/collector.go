@@ -0,0 +1,338 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package schedlat
+
+import (
+	"flag"
+	"path/filepath"
+	"regexp"
+	"time"
+
+	bpf "github.com/cilium/ebpf"
+	"github.com/intel/cri-resource-manager/pkg/cgroups"
+	"github.com/intel/cri-resource-manager/pkg/ebpf"
+	logger "github.com/intel/cri-resource-manager/pkg/log"
+	"github.com/intel/cri-resource-manager/pkg/sysfs"
+	"github.com/pkg/errors"
+	"github.com/prometheus/client_golang/prometheus"
+)
+
+const (
+	// RunqLatencyName is the Prometheus Histogram name for run queue latency per cgroup.
+	RunqLatencyName = "runqueue_latency_seconds_per_cgroup"
+	// MigrationsName is the Prometheus Counter name for task migrations per cgroup.
+	MigrationsName = "task_migrations_per_cgroup"
+	// CrossNodeMigrationsName is the Prometheus Counter name for cross-NUMA task migrations per cgroup.
+	CrossNodeMigrationsName = "cross_node_task_migrations_per_cgroup"
+	// Path to kernel tracepoints
+	kernelTracepointPath = ebpf.TracepointPath
+	// rlimit value (2M) needed to lock map data in memory
+	mapMemLockLimit = 2 * 1024 * 1024
+	// default capacity of the per-cgroup eBPF map
+	defaultCgroupMapSize = 1024
+	// interval for sweeping cgroups that no longer exist from the eBPF map
+	sweepInterval = 5 * time.Minute
+	// number of log2 run queue latency buckets, SCHEDLAT_SLOTS in elf/schedlat.c
+	numSlots = 24
+)
+
+// Prometheus Metric descriptor indices and descriptor table
+const (
+	runqLatencyDesc = iota
+	migrationsDesc
+	crossNodeMigrationsDesc
+	numDescriptors
+)
+
+var descriptors = [numDescriptors]*prometheus.Desc{
+	runqLatencyDesc: prometheus.NewDesc(
+		RunqLatencyName,
+		"Time tasks of a particular cgroup spent runnable on a run queue waiting for a CPU.",
+		[]string{
+			"container_id",
+		}, nil,
+	),
+	migrationsDesc: prometheus.NewDesc(
+		MigrationsName,
+		"Number of times tasks of a particular cgroup were migrated to another CPU.",
+		[]string{
+			"container_id",
+		}, nil,
+	),
+	crossNodeMigrationsDesc: prometheus.NewDesc(
+		CrossNodeMigrationsName,
+		"Number of times tasks of a particular cgroup were migrated to a CPU in another NUMA node.",
+		[]string{
+			"container_id",
+		}, nil,
+	),
+}
+
+var (
+	// bpfObjectName is the name of our eBPF object, elf/schedlat.c.
+	bpfObjectName = "schedlat"
+
+	// cgroupMapSize is the capacity of the per-cgroup eBPF map.
+	cgroupMapSize uint = defaultCgroupMapSize
+
+	// pinnedMaps are the cumulative eBPF maps kept in bpffs across restarts.
+	// The per-task maps refer to runqueue state of the previous instance.
+	pinnedMaps = []string{
+		"schedlat_cgroup_stats_hash",
+	}
+
+	// tracepoints are the programs of elf/schedlat.c and the tracepoints they attach to.
+	tracepoints = map[string]string{
+		"tracepoint__sched_wakeup":       "sched/sched_wakeup",
+		"tracepoint__sched_wakeup_new":   "sched/sched_wakeup_new",
+		"tracepoint__sched_switch":       "sched/sched_switch",
+		"tracepoint__sched_migrate_task": "sched/sched_migrate_task",
+	}
+
+	// slotBounds are the upper bounds (in seconds) of all but the last, open-ended bucket.
+	slotBounds = func() []float64 {
+		bounds := make([]float64, numSlots-1)
+		for i := range bounds {
+			bounds[i] = float64(uint64(2)<<uint(i)) / 1e6
+		}
+		return bounds
+	}()
+
+	// containerIDRegexp matches container IDs in cgroup directory names.
+	containerIDRegexp = regexp.MustCompile(`[a-z0-9]{64}`)
+
+	// our logger instance
+	log = logger.NewLogger("schedlat")
+)
+
+// cgroupStats is struct cgroup_stats in elf/schedlat.c.
+type cgroupStats struct {
+	Slots      [numSlots]uint64
+	WaitNs     uint64
+	Migrations uint64
+	CrossNode  uint64
+}
+
+// add adds the given statistics to s.
+func (s *cgroupStats) add(o *cgroupStats) {
+	for i := range s.Slots {
+		s.Slots[i] += o.Slots[i]
+	}
+	s.WaitNs += o.WaitNs
+	s.Migrations += o.Migrations
+	s.CrossNode += o.CrossNode
+}
+
+// histogram returns the cumulative bucket counts, total count and sum of the latency histogram.
+func (s *cgroupStats) histogram() (map[float64]uint64, uint64, float64) {
+	buckets := make(map[float64]uint64, len(slotBounds))
+	count := uint64(0)
+	for i, n := range s.Slots {
+		count += n
+		if i < len(slotBounds) {
+			buckets[slotBounds[i]] = count
+		}
+	}
+	return buckets, count, float64(s.WaitNs) / 1e9
+}
+
+type collector struct {
+	cgid *cgroups.CgroupID
+	obj  *ebpf.Object
+	// time of the last sweep of removed cgroups
+	lastSweep time.Time
+}
+
+// cpuNodes returns the NUMA node of every CPU.
+func cpuNodes() (map[uint32]uint32, uint32, error) {
+	sys, err := sysfs.DiscoverSystem(sysfs.DiscoverCPUTopology)
+	if err != nil {
+		return nil, 0, err
+	}
+
+	nodes := make(map[uint32]uint32)
+	ncpu := uint32(0)
+	for _, id := range sys.CPUIDs() {
+		nodes[uint32(id)] = uint32(sys.CPU(id).NodeID())
+		if uint32(id)+1 > ncpu {
+			ncpu = uint32(id) + 1
+		}
+	}
+
+	return nodes, ncpu, nil
+}
+
+// NewCollector creates new Prometheus collector for scheduling latency metrics
+func NewCollector() (prometheus.Collector, error) {
+
+	if err := checkTracepointFormats(); err != nil {
+		return nil, err
+	}
+
+	nodes, ncpu, err := cpuNodes()
+	if err != nil {
+		return nil, errors.Wrap(err, "failed to discover CPU topology")
+	}
+
+	obj, err := ebpf.Load(bpfObjectName, &ebpf.Options{
+		MapSizes: map[string]uint32{
+			"schedlat_cgroup_stats_hash": uint32(cgroupMapSize),
+			"schedlat_cpu_node_array":    ncpu,
+		},
+		MemLock: mapMemLockLimit,
+		Pin:     pinnedMaps,
+	})
+	if err != nil {
+		return nil, err
+	}
+
+	for cpu, node := range nodes {
+		if err := obj.Maps["schedlat_cpu_node_array"].Put(cpu, node); err != nil {
+			obj.Close()
+			return nil, errors.Wrapf(err, "unable to set NUMA node of CPU #%d", cpu)
+		}
+	}
+
+	for name, tracepoint := range tracepoints {
+		if err := obj.AttachTracepoint(name, tracepoint); err != nil {
+			obj.Close()
+			return nil, err
+		}
+	}
+
+	return &collector{
+		cgid: cgroups.NewCgroupID(cgroups.GetV2Dir()),
+		obj:  obj,
+	}, nil
+}
+
+// Describe implements prometheus.Collector interface
+func (c *collector) Describe(ch chan<- *prometheus.Desc) {
+	for _, d := range descriptors {
+		ch <- d
+	}
+}
+
+// Collect implements prometheus.Collector interface
+func (c *collector) Collect(ch chan<- prometheus.Metric) {
+	if time.Since(c.lastSweep) >= sweepInterval {
+		c.sweepMap()
+	}
+
+	for id, stats := range c.readMap() {
+		buckets, count, sum := stats.histogram()
+		ch <- prometheus.MustNewConstHistogram(
+			descriptors[runqLatencyDesc],
+			count, sum, buckets,
+			id)
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[migrationsDesc],
+			prometheus.CounterValue,
+			float64(stats.Migrations),
+			id)
+		ch <- prometheus.MustNewConstMetric(
+			descriptors[crossNodeMigrationsDesc],
+			prometheus.CounterValue,
+			float64(stats.CrossNode),
+			id)
+	}
+}
+
+// readMap reads the cumulative per-cgroup statistics, summed up per container.
+func (c *collector) readMap() map[string]*cgroupStats {
+	var (
+		key       uint64
+		perCPUVal []cgroupStats
+	)
+
+	containers := make(map[string]*cgroupStats)
+
+	iter := c.obj.Maps["schedlat_cgroup_stats_hash"].Iterate()
+	for iter.Next(&key, &perCPUVal) {
+		// Unknown cgroups are resolved by a single walk shared by all lookups.
+		path, err := c.cgid.Find(key)
+		if err != nil {
+			log.Debug("failed to find cgroup by id: %v", err)
+			continue
+		}
+
+		id := containerIDRegexp.FindString(filepath.Base(path))
+		if id == "" {
+			continue
+		}
+
+		stats, ok := containers[id]
+		if !ok {
+			stats = &cgroupStats{}
+			containers[id] = stats
+		}
+		for i := range perCPUVal {
+			stats.add(&perCPUVal[i])
+		}
+	}
+	if iter.Err() != nil {
+		log.Error("unable to iterate all elements of schedlat_cgroup_stats: %+v", iter.Err())
+	}
+
+	return containers
+}
+
+// sweepMap removes entries of cgroups that no longer exist from the per-cgroup map.
+func (c *collector) sweepMap() {
+	var (
+		key  uint64
+		next uint64
+		gone []uint64
+	)
+
+	c.lastSweep = time.Now()
+
+	live, err := c.cgid.Refresh()
+	if err != nil {
+		log.Error("failed to list cgroups for sweeping eBPF map: %v", err)
+		return
+	}
+
+	m := c.obj.Maps["schedlat_cgroup_stats_hash"]
+
+	// collect keys first, deleting while walking the map might restart the walk
+	for k := interface{}(nil); ; k = key {
+		if err := m.NextKey(k, &next); err != nil {
+			if !errors.Is(err, bpf.ErrKeyNotExist) {
+				log.Error("unable to walk schedlat_cgroup_stats: %v", err)
+			}
+			break
+		}
+		if _, ok := live[next]; !ok {
+			gone = append(gone, next)
+		}
+		key = next
+	}
+
+	for _, key := range gone {
+		if err := m.Delete(key); err != nil && !errors.Is(err, bpf.ErrKeyNotExist) {
+			log.Error("unable to delete removed cgroup %d: %v", key, err)
+		}
+	}
+
+	if len(gone) > 0 {
+		log.Debug("swept %d removed cgroups from schedlat_cgroup_stats", len(gone))
+	}
+}
+
+func init() {
+	flag.UintVar(&cgroupMapSize, "schedlat-cgroup-map-size", cgroupMapSize,
+		"Maximum number of cgroups tracked in the scheduling latency eBPF map")
+}
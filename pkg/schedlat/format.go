@@ -0,0 +1,101 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package schedlat
+
+import (
+	"bufio"
+	"io"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+
+	"github.com/pkg/errors"
+)
+
+// tracepointArgs are the offsets of the tracepoint arguments used by elf/schedlat.c.
+var tracepointArgs = map[string]map[string]int{
+	"sched/sched_wakeup": {
+		"pid": 24,
+	},
+	"sched/sched_wakeup_new": {
+		"pid": 24,
+	},
+	"sched/sched_switch": {
+		"prev_pid":   24,
+		"prev_state": 32,
+		"next_pid":   56,
+	},
+	"sched/sched_migrate_task": {
+		"pid":      24,
+		"orig_cpu": 32,
+		"dest_cpu": 36,
+	},
+}
+
+// checkTracepointFormats verifies that the tracepoint arguments match those in elf/schedlat.c.
+func checkTracepointFormats() error {
+	for tracepoint, args := range tracepointArgs {
+		path := filepath.Join(kernelTracepointPath, tracepoint, "format")
+		f, err := os.Open(path)
+		if err != nil {
+			return errors.Wrapf(err, "unable to read %s tracepoint format", tracepoint)
+		}
+		err = checkFormat(f, args)
+		f.Close()
+		if err != nil {
+			return errors.Wrapf(err, "%s tracepoint", tracepoint)
+		}
+	}
+	return nil
+}
+
+// checkFormat verifies the offsets of the given arguments in a tracepoint format.
+func checkFormat(r io.Reader, args map[string]int) error {
+	found := 0
+
+	// the interesting lines look like
+	//     field:pid_t prev_pid;	offset:24;	size:4;	signed:1;
+	scanner := bufio.NewScanner(r)
+	for scanner.Scan() {
+		fields := strings.Split(strings.TrimSpace(scanner.Text()), ";")
+		if len(fields) < 2 || !strings.HasPrefix(fields[0], "field:") {
+			continue
+		}
+		decl := strings.Fields(fields[0])
+		name := decl[len(decl)-1]
+		expected, ok := args[name]
+		if !ok {
+			continue
+		}
+		offset, err := strconv.Atoi(strings.TrimPrefix(strings.TrimSpace(fields[1]), "offset:"))
+		if err != nil {
+			return errors.Wrapf(err, "invalid tracepoint format %q", scanner.Text())
+		}
+		if offset != expected {
+			return errors.Errorf("unexpected %s argument offset %d (!= %d)", name, offset, expected)
+		}
+		found++
+	}
+	if err := scanner.Err(); err != nil {
+		return errors.Wrap(err, "unable to read tracepoint format")
+	}
+
+	if found != len(args) {
+		return errors.Errorf("expected arguments %v missing from tracepoint format", args)
+	}
+
+	return nil
+}
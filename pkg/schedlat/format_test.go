@@ -0,0 +1,105 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package schedlat
+
+import (
+	"strings"
+	"testing"
+)
+
+const schedSwitchFormat = `name: sched_switch
+ID: 316
+format:
+	field:unsigned short common_type;	offset:0;	size:2;	signed:0;
+	field:unsigned char common_flags;	offset:2;	size:1;	signed:0;
+	field:unsigned char common_preempt_count;	offset:3;	size:1;	signed:0;
+	field:int common_pid;	offset:4;	size:4;	signed:1;
+
+	field:char prev_comm[16];	offset:8;	size:16;	signed:1;
+	field:pid_t prev_pid;	offset:24;	size:4;	signed:1;
+	field:int prev_prio;	offset:28;	size:4;	signed:1;
+	field:long prev_state;	offset:32;	size:8;	signed:1;
+	field:char next_comm[16];	offset:40;	size:16;	signed:1;
+	field:pid_t next_pid;	offset:56;	size:4;	signed:1;
+	field:int next_prio;	offset:60;	size:4;	signed:1;
+
+print fmt: "prev_comm=%s prev_pid=%d", REC->prev_comm, REC->prev_pid
+`
+
+func TestCheckFormat(t *testing.T) {
+	tcases := []struct {
+		name        string
+		format      string
+		expectedErr bool
+	}{
+		{
+			name:   "matching format",
+			format: schedSwitchFormat,
+		},
+		{
+			name:        "moved argument",
+			format:      strings.Replace(schedSwitchFormat, "next_pid;\toffset:56", "next_pid;\toffset:60", 1),
+			expectedErr: true,
+		},
+		{
+			name:        "missing argument",
+			format:      strings.Replace(schedSwitchFormat, "long prev_state;", "long state;", 1),
+			expectedErr: true,
+		},
+		{
+			name:        "empty format",
+			expectedErr: true,
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			err := checkFormat(strings.NewReader(tc.format), tracepointArgs["sched/sched_switch"])
+			if tc.expectedErr && err == nil {
+				t.Errorf("expected error, got none")
+			}
+			if !tc.expectedErr && err != nil {
+				t.Errorf("unexpected error: %v", err)
+			}
+		})
+	}
+}
+
+func TestHistogram(t *testing.T) {
+	s := &cgroupStats{WaitNs: 3000000000}
+	s.Slots[0] = 1
+	s.Slots[3] = 2
+	s.Slots[numSlots-1] = 4
+
+	buckets, count, sum := s.histogram()
+	if count != 7 {
+		t.Errorf("expected count 7, got %d", count)
+	}
+	if sum != 3.0 {
+		t.Errorf("expected sum 3.0, got %f", sum)
+	}
+	if len(buckets) != numSlots-1 {
+		t.Errorf("expected %d buckets, got %d", numSlots-1, len(buckets))
+	}
+	for bound, expected := range map[float64]uint64{
+		2e-6:                   1,
+		8e-6:                   1,
+		16e-6:                  3,
+		slotBounds[numSlots-2]: 3,
+	} {
+		if buckets[bound] != expected {
+			t.Errorf("expected %d in bucket %g, got %d", expected, bound, buckets[bound])
+		}
+	}
+}
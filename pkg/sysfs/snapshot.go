@@ -0,0 +1,263 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package sysfs
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+)
+
+const (
+	// snapshotVersion is the version of the topology snapshot format.
+	snapshotVersion = 1
+)
+
+// fingerprintEntries are the sysfs entries a topology fingerprint is calculated from.
+var fingerprintEntries = []string{
+	filepath.Join(sysfsCPUPath, "possible"),
+	filepath.Join(sysfsCPUPath, "present"),
+	filepath.Join(sysfsCPUPath, "online"),
+	filepath.Join(sysfsCPUPath, "offline"),
+	filepath.Join(sysfsCPUPath, "isolated"),
+	filepath.Join(sysfsNumaNodePath, "possible"),
+	filepath.Join(sysfsNumaNodePath, "online"),
+	filepath.Join(sysfsNumaNodePath, "has_cpu"),
+	filepath.Join(sysfsNumaNodePath, "has_memory"),
+	filepath.Join(sysfsNumaNodePath, "has_normal_memory"),
+}
+
+// snapshot is a saved snapshot of discovered system topology.
+type snapshot struct {
+	Version     int             `json:"version"`
+	Fingerprint string          `json:"fingerprint"`
+	CPUs        []*cpuSnapshot  `json:"cpus,omitempty"`
+	Nodes       []*nodeSnapshot `json:"nodes,omitempty"`
+}
+
+// cpuSnapshot is the saved topology of a CPU.
+type cpuSnapshot struct {
+	ID       ID    `json:"id"`
+	Package  ID    `json:"package"`
+	Die      ID    `json:"die"`
+	Node     ID    `json:"node"`
+	Core     ID    `json:"core"`
+	Threads  IDSet `json:"threads"`
+	Online   bool  `json:"online"`
+	Isolated bool  `json:"isolated"`
+}
+
+// nodeSnapshot is the saved topology of a NUMA node.
+type nodeSnapshot struct {
+	ID         ID         `json:"id"`
+	CPUs       IDSet      `json:"cpus"`
+	Distance   []int      `json:"distance"`
+	MemoryType MemoryType `json:"memoryType"`
+	NormalMem  bool       `json:"normalMem"`
+}
+
+// DiscoverSystemWithSnapshot performs discovery of the running systems details,
+// reusing the topology saved in the given snapshot file if it is still valid.
+//
+// The snapshot is valid if a fingerprint of the system, calculated from a few
+// sysfs entries describing the present and online CPUs and NUMA nodes, has not
+// changed since the snapshot was saved. Otherwise the system is rediscovered
+// and a new snapshot is saved.
+func DiscoverSystemWithSnapshot(file string, args ...DiscoveryFlag) (System, error) {
+	return discoverSystemWithSnapshot(SysfsRootPath, file, discoveryFlags(args))
+}
+
+// discoverSystemWithSnapshot discovers the system from sysfs mounted at path,
+// reusing the topology saved in a valid snapshot file.
+func discoverSystemWithSnapshot(path, file string, flags DiscoveryFlag) (*system, error) {
+	sys := newSystem(path)
+	fingerprint := sys.fingerprint(flags)
+
+	loadErr := sys.loadSnapshot(file, fingerprint)
+	if loadErr == nil {
+		sys.Info("using topology snapshot %s", file)
+	} else {
+		if !os.IsNotExist(loadErr) {
+			sys.Warn("ignoring topology snapshot %s: %v", file, loadErr)
+		}
+		sys = newSystem(path)
+	}
+
+	if err := sys.Discover(flags); err != nil {
+		return nil, err
+	}
+
+	if loadErr != nil {
+		if err := sys.saveSnapshot(file, fingerprint); err != nil {
+			sys.Warn("failed to save topology snapshot %s: %v", file, err)
+		}
+	}
+
+	return sys, nil
+}
+
+// fingerprint calculates a fingerprint of the system topology.
+func (sys *system) fingerprint(flags DiscoveryFlag) string {
+	h := sha256.New()
+	fmt.Fprintf(h, "version: %d\nflags: %x\n", snapshotVersion, flags&^DiscoverCache)
+
+	entries := append([]string{}, fingerprintEntries...)
+	nodes, _ := filepath.Glob(filepath.Join(sys.path, sysfsNumaNodePath, "node[0-9]*"))
+	for _, node := range nodes {
+		entries = append(entries, filepath.Join(sysfsNumaNodePath, filepath.Base(node), "cpulist"))
+	}
+
+	for _, entry := range entries {
+		if blob, err := ioutil.ReadFile(filepath.Join(sys.path, entry)); err != nil {
+			fmt.Fprintf(h, "%s: -\n", entry)
+		} else {
+			fmt.Fprintf(h, "%s: %s\n", entry, blob)
+		}
+	}
+
+	return hex.EncodeToString(h.Sum(nil))
+}
+
+// loadSnapshot loads the CPUs and nodes of a snapshot if its fingerprint matches.
+func (sys *system) loadSnapshot(file, fingerprint string) error {
+	blob, err := ioutil.ReadFile(file)
+	if err != nil {
+		return err
+	}
+
+	s := &snapshot{}
+	if err := json.Unmarshal(blob, s); err != nil {
+		return sysfsError(file, "failed to unmarshal snapshot: %v", err)
+	}
+	if s.Version != snapshotVersion {
+		return sysfsError(file, "snapshot version %d, expected %d", s.Version, snapshotVersion)
+	}
+	if s.Fingerprint != fingerprint {
+		return sysfsError(file, "system topology has changed")
+	}
+
+	if s.CPUs != nil {
+		sys.cpus = make(map[ID]*cpu)
+		sys.isolated = NewIDSet()
+		for _, c := range s.CPUs {
+			cpu := &cpu{
+				path:     filepath.Join(sys.path, sysfsCPUPath, fmt.Sprintf("cpu%d", c.ID)),
+				id:       c.ID,
+				pkg:      c.Package,
+				die:      c.Die,
+				node:     c.Node,
+				core:     c.Core,
+				threads:  c.Threads,
+				online:   c.Online,
+				isolated: c.Isolated,
+				sstClos:  -1,
+				sys:      sys,
+			}
+			if cpu.threads == nil {
+				cpu.threads = NewIDSet()
+			}
+			if cpu.isolated {
+				sys.isolated.Add(cpu.id)
+			}
+			if err := sys.addCPU(cpu); err != nil {
+				return err
+			}
+		}
+	}
+
+	if s.Nodes != nil {
+		sys.nodes = make(map[ID]*node)
+		for _, n := range s.Nodes {
+			node := &node{
+				path:       filepath.Join(sys.path, sysfsNumaNodePath, fmt.Sprintf("node%d", n.ID)),
+				id:         n.ID,
+				cpus:       n.CPUs,
+				distance:   n.Distance,
+				memoryType: n.MemoryType,
+				normalMem:  n.NormalMem,
+			}
+			if node.cpus == nil {
+				node.cpus = NewIDSet()
+			}
+			sys.nodes[node.id] = node
+		}
+	}
+
+	return nil
+}
+
+// saveSnapshot saves the discovered CPUs and nodes in a snapshot.
+func (sys *system) saveSnapshot(file, fingerprint string) error {
+	blob, err := json.Marshal(sys.snapshot(fingerprint))
+	if err != nil {
+		return sysfsError(file, "failed to marshal snapshot: %v", err)
+	}
+
+	tmp := file + ".saving"
+	if err := ioutil.WriteFile(tmp, blob, 0600); err != nil {
+		return sysfsError(tmp, "failed to write snapshot: %v", err)
+	}
+	if err := os.Rename(tmp, file); err != nil {
+		os.Remove(tmp)
+		return sysfsError(file, "failed to rename snapshot: %v", err)
+	}
+
+	return nil
+}
+
+// snapshot takes a snapshot of the discovered CPUs and nodes.
+func (sys *system) snapshot(fingerprint string) *snapshot {
+	s := &snapshot{
+		Version:     snapshotVersion,
+		Fingerprint: fingerprint,
+	}
+
+	if sys.cpus != nil {
+		s.CPUs = make([]*cpuSnapshot, 0, len(sys.cpus))
+		for _, id := range sys.CPUIDs() {
+			c := sys.cpus[id]
+			s.CPUs = append(s.CPUs, &cpuSnapshot{
+				ID:       c.id,
+				Package:  c.pkg,
+				Die:      c.die,
+				Node:     c.node,
+				Core:     c.core,
+				Threads:  c.threads,
+				Online:   c.online,
+				Isolated: c.isolated,
+			})
+		}
+	}
+
+	if sys.nodes != nil {
+		s.Nodes = make([]*nodeSnapshot, 0, len(sys.nodes))
+		for _, id := range sys.NodeIDs() {
+			n := sys.nodes[id]
+			s.Nodes = append(s.Nodes, &nodeSnapshot{
+				ID:         n.id,
+				CPUs:       n.cpus,
+				Distance:   n.distance,
+				MemoryType: n.memoryType,
+				NormalMem:  n.normalMem,
+			})
+		}
+	}
+
+	return s
+}
@@ -0,0 +1,188 @@
+// Copyright 2020 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package sysfs
+
+import (
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+const testFlags = DiscoverCPUTopology | DiscoverMemTopology
+
+// writeEntries writes the given sysfs entries below root.
+func writeEntries(t *testing.T, root string, entries map[string]string) {
+	for entry, value := range entries {
+		path := filepath.Join(root, entry)
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			t.Fatalf("failed to create directory for %s: %v", path, err)
+		}
+		if err := ioutil.WriteFile(path, []byte(value+"\n"), 0644); err != nil {
+			t.Fatalf("failed to write %s: %v", path, err)
+		}
+	}
+}
+
+// newFakeSysfs creates a sysfs tree with 2 NUMA nodes of 2 cores with 2 threads each.
+func newFakeSysfs(t *testing.T) string {
+	root, err := ioutil.TempDir("", "sysfs-test-")
+	if err != nil {
+		t.Fatalf("failed to create tmpdir: %v", err)
+	}
+
+	entries := map[string]string{
+		filepath.Join(sysfsCPUPath, "possible"):               "0-7",
+		filepath.Join(sysfsCPUPath, "present"):                "0-7",
+		filepath.Join(sysfsCPUPath, "online"):                 "0-7",
+		filepath.Join(sysfsCPUPath, "offline"):                "",
+		filepath.Join(sysfsCPUPath, "isolated"):               "7",
+		filepath.Join(sysfsNumaNodePath, "possible"):          "0-1",
+		filepath.Join(sysfsNumaNodePath, "online"):            "0-1",
+		filepath.Join(sysfsNumaNodePath, "has_cpu"):           "0-1",
+		filepath.Join(sysfsNumaNodePath, "has_memory"):        "0-1",
+		filepath.Join(sysfsNumaNodePath, "has_normal_memory"): "0-1",
+	}
+	for id := 0; id < 8; id++ {
+		node, core := id/4, id%4/2
+		cpu := filepath.Join(sysfsCPUPath, fmt.Sprintf("cpu%d", id))
+		entries[filepath.Join(cpu, "online")] = "1"
+		entries[filepath.Join(cpu, "topology", "physical_package_id")] = fmt.Sprintf("%d", node)
+		entries[filepath.Join(cpu, "topology", "die_id")] = "0"
+		entries[filepath.Join(cpu, "topology", "core_id")] = fmt.Sprintf("%d", core)
+		entries[filepath.Join(cpu, "topology", "thread_siblings_list")] =
+			fmt.Sprintf("%d,%d", id&^1, id|1)
+		entries[filepath.Join(cpu, "cpufreq", "base_frequency")] = "2000000"
+		entries[filepath.Join(cpu, "cpufreq", "cpuinfo_min_freq")] = "1000000"
+		entries[filepath.Join(cpu, "cpufreq", "cpuinfo_max_freq")] = "3000000"
+		entries[filepath.Join(cpu, fmt.Sprintf("node%d", node), "cpulist")] = fmt.Sprintf("%d-%d", 4*node, 4*node+3)
+	}
+	for id := 0; id < 2; id++ {
+		node := filepath.Join(sysfsNumaNodePath, fmt.Sprintf("node%d", id))
+		entries[filepath.Join(node, "cpulist")] = fmt.Sprintf("%d-%d", 4*id, 4*id+3)
+		entries[filepath.Join(node, "distance")] = map[int]string{0: "10 21", 1: "21 10"}[id]
+	}
+	writeEntries(t, root, entries)
+
+	return root
+}
+
+// topology returns the discovered topology of a system as a string.
+func topology(t *testing.T, sys *system) string {
+	blob, err := json.Marshal(sys.snapshot(""))
+	if err != nil {
+		t.Fatalf("failed to marshal topology: %v", err)
+	}
+	return string(blob)
+}
+
+func discoverTestSystem(t *testing.T, root string) *system {
+	sys := newSystem(root)
+	if err := sys.Discover(testFlags); err != nil {
+		t.Fatalf("failed to discover system: %v", err)
+	}
+	return sys
+}
+
+func TestSnapshotRoundTrip(t *testing.T) {
+	root := newFakeSysfs(t)
+	defer os.RemoveAll(root)
+	file := filepath.Join(root, "topology.snapshot")
+
+	discovered := discoverTestSystem(t, root)
+	fingerprint := discovered.fingerprint(testFlags)
+	if err := discovered.saveSnapshot(file, fingerprint); err != nil {
+		t.Fatalf("failed to save snapshot: %v", err)
+	}
+
+	restored := newSystem(root)
+	if err := restored.loadSnapshot(file, fingerprint); err != nil {
+		t.Fatalf("failed to load snapshot: %v", err)
+	}
+	if err := restored.Discover(testFlags); err != nil {
+		t.Fatalf("failed to discover restored system: %v", err)
+	}
+
+	if expected, got := topology(t, discovered), topology(t, restored); got != expected {
+		t.Errorf("expected restored topology %s, got %s", expected, got)
+	}
+	if !restored.Isolated().Contains(7) || restored.Offlined().Size() != 0 {
+		t.Errorf("expected isolated CPUs 7 and no offline CPUs, got %s and %s",
+			restored.Isolated(), restored.Offlined())
+	}
+	if freq := restored.CPU(3).BaseFrequency(); freq != 2000000 {
+		t.Errorf("expected base frequency 2000000 of restored CPU, got %d", freq)
+	}
+}
+
+func TestSnapshotInvalidation(t *testing.T) {
+	root := newFakeSysfs(t)
+	defer os.RemoveAll(root)
+	file := filepath.Join(root, "topology.snapshot")
+
+	if _, err := discoverSystemWithSnapshot(root, file, testFlags); err != nil {
+		t.Fatalf("failed to discover system: %v", err)
+	}
+	fingerprint := newSystem(root).fingerprint(testFlags)
+	if err := newSystem(root).loadSnapshot(file, fingerprint); err != nil {
+		t.Fatalf("failed to load saved snapshot: %v", err)
+	}
+
+	// take CPU 7 offline
+	writeEntries(t, root, map[string]string{
+		filepath.Join(sysfsCPUPath, "online"):         "0-6",
+		filepath.Join(sysfsCPUPath, "offline"):        "7",
+		filepath.Join(sysfsCPUPath, "cpu7", "online"): "0",
+	})
+
+	changed := newSystem(root).fingerprint(testFlags)
+	if changed == fingerprint {
+		t.Fatalf("fingerprint unchanged after topology change")
+	}
+	if err := newSystem(root).loadSnapshot(file, changed); err == nil {
+		t.Errorf("stale snapshot loaded after topology change")
+	}
+
+	sys, err := discoverSystemWithSnapshot(root, file, testFlags)
+	if err != nil {
+		t.Fatalf("failed to rediscover system: %v", err)
+	}
+	if !sys.Offlined().Contains(7) {
+		t.Errorf("expected CPU 7 offline after rediscovery, got offline CPUs %s", sys.Offlined())
+	}
+	if err := newSystem(root).loadSnapshot(file, changed); err != nil {
+		t.Errorf("failed to load snapshot saved after rediscovery: %v", err)
+	}
+}
+
+func TestParallelDiscovery(t *testing.T) {
+	root := newFakeSysfs(t)
+	defer os.RemoveAll(root)
+
+	workers := discoveryWorkers
+	defer func() { discoveryWorkers = workers }()
+
+	discoveryWorkers = 1
+	serial := topology(t, discoverTestSystem(t, root))
+
+	discoveryWorkers = 4
+	parallel := topology(t, discoverTestSystem(t, root))
+
+	if parallel != serial {
+		t.Errorf("expected parallel discovery to find %s, got %s", serial, parallel)
+	}
+}
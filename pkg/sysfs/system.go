@@ -18,9 +18,11 @@ import (
 	"fmt"
 	"io/ioutil"
 	"path/filepath"
+	"runtime"
 	"sort"
 	"strconv"
 	"strings"
+	"sync"
 
 	"k8s.io/kubernetes/pkg/kubelet/cm/cpuset"
 
@@ -103,6 +105,8 @@ type system struct {
 	offline       IDSet              // offlined CPUs
 	isolated      IDSet              // isolated CPUs
 	threads       int                // hyperthreads per core
+	workers       int                // maximum number of entries to discover in parallel
+	sstOnce       sync.Once          // lazy SST discovery
 }
 
 // CPUPackage is a physical package (a collection of CPUs).
@@ -124,6 +128,7 @@ type cpuPackage struct {
 	dieCPUs  map[ID]IDSet   // CPUs per die
 	dieNodes map[ID]IDSet   // NUMA nodes per die
 	sstInfo  SstPackageInfo // Speed Select Technology info
+	sys      *system        // system for lazy discovery
 }
 
 // Node represents a NUMA node.
@@ -168,19 +173,21 @@ type CPU interface {
 }
 
 type cpu struct {
-	path     string  // sysfs path
-	id       ID      // CPU id
-	pkg      ID      // package id
-	die      ID      // die id
-	node     ID      // node id
-	core     ID      // core id
-	threads  IDSet   // sibling/hyper-threads
-	baseFreq uint64  // CPU base frequency
-	freq     CPUFreq // CPU frequencies
-	epp      EPP     // Energy Performance Preference from cpufreq governor
-	online   bool    // whether this CPU is online
-	isolated bool    // whether this CPU is isolated
-	sstClos  int     // SST-CP CLOS the CPU is associated with
+	path     string    // sysfs path
+	id       ID        // CPU id
+	pkg      ID        // package id
+	die      ID        // die id
+	node     ID        // node id
+	core     ID        // core id
+	threads  IDSet     // sibling/hyper-threads
+	baseFreq uint64    // CPU base frequency
+	freq     CPUFreq   // CPU frequencies
+	epp      EPP       // Energy Performance Preference from cpufreq governor
+	online   bool      // whether this CPU is online
+	isolated bool      // whether this CPU is isolated
+	sstClos  int       // SST-CP CLOS the CPU is associated with
+	sys      *system   // system for lazy discovery
+	freqOnce sync.Once // lazy cpufreq discovery
 }
 
 // CPUFreq is a CPU frequency scaling range
@@ -241,31 +248,44 @@ func DiscoverSystem(args ...DiscoveryFlag) (System, error) {
 
 // DiscoverSystemAt performs discovery of the running systems details from sysfs mounted at path.
 func DiscoverSystemAt(path string, args ...DiscoveryFlag) (System, error) {
-	var flags DiscoveryFlag
+	sys := newSystem(path)
 
+	if err := sys.Discover(discoveryFlags(args)); err != nil {
+		return nil, err
+	}
+
+	return sys, nil
+}
+
+// discoveryFlags combines the given discovery flags, or returns the default ones.
+func discoveryFlags(args []DiscoveryFlag) DiscoveryFlag {
 	if len(args) < 1 {
-		flags = DiscoverDefault
-	} else {
-		flags = DiscoverNone
-		for _, flag := range args {
-			flags |= flag
-		}
+		return DiscoverDefault
+	}
+
+	flags := DiscoverNone
+	for _, flag := range args {
+		flags |= flag
 	}
+	return flags
+}
 
-	sys := &system{
+// newSystem creates a system for discovery from sysfs mounted at path.
+func newSystem(path string) *system {
+	return &system{
 		Logger:  logger.NewLogger("sysfs"),
 		path:    path,
 		offline: NewIDSet(),
+		workers: discoveryWorkers,
 	}
-
-	if err := sys.Discover(flags); err != nil {
-		return nil, err
-	}
-
-	return sys, nil
 }
 
 // Discover performs system/hardware discovery.
+//
+// CPUs and NUMA nodes are discovered in parallel. Details which are slow
+// to discover and are not needed for the topology itself, cpufreq settings
+// and Speed Select Technology information, are discovered in the background
+// and waited for when they are first needed.
 func (sys *system) Discover(flags DiscoveryFlag) error {
 	sys.flags |= (flags &^ DiscoverCache)
 
@@ -281,13 +301,6 @@ func (sys *system) Discover(flags DiscoveryFlag) error {
 		}
 	}
 
-	if (sys.flags & DiscoverSst) != 0 {
-		if err := sys.discoverSst(); err != nil {
-			// Just consider SST unsupported if our detection fails for some reason
-			sys.Warn("%v", err)
-		}
-	}
-
 	if (sys.flags & DiscoverMemTopology) != 0 {
 		if err := sys.discoverNodes(); err != nil {
 			return err
@@ -342,9 +355,6 @@ func (sys *system) Discover(flags DiscoveryFlag) error {
 			sys.Debug("       node: %d", cpu.node)
 			sys.Debug("       core: %d", cpu.core)
 			sys.Debug("    threads: %s", cpu.threads)
-			sys.Debug("  base freq: %d", cpu.baseFreq)
-			sys.Debug("       freq: %d - %d", cpu.freq.min, cpu.freq.max)
-			sys.Debug("        epp: %d", cpu.epp)
 		}
 
 		sys.Debug("offline CPUs: %s", sys.offline)
@@ -359,9 +369,73 @@ func (sys *system) Discover(flags DiscoveryFlag) error {
 		}
 	}
 
+	go sys.discoverLazyDetails()
+
 	return nil
 }
 
+// discoveryWorkers is the maximum number of sysfs entries to discover in parallel.
+var discoveryWorkers = runtime.NumCPU()
+
+// discoverParallel calls fn for all entries in parallel, returning the first error.
+func (sys *system) discoverParallel(entries []string, fn func(int, string) error) error {
+	workers := sys.workers
+	if workers > len(entries) {
+		workers = len(entries)
+	}
+	if workers < 2 {
+		for i, entry := range entries {
+			if err := fn(i, entry); err != nil {
+				return err
+			}
+		}
+		return nil
+	}
+
+	errors := make([]error, len(entries))
+	next := make(chan int)
+	wg := sync.WaitGroup{}
+	wg.Add(workers)
+	for w := 0; w < workers; w++ {
+		go func() {
+			defer wg.Done()
+			for i := range next {
+				errors[i] = fn(i, entries[i])
+			}
+		}()
+	}
+	for i := range entries {
+		next <- i
+	}
+	close(next)
+	wg.Wait()
+
+	for _, err := range errors {
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// discoverLazyDetails discovers details which are otherwise discovered when first needed.
+func (sys *system) discoverLazyDetails() {
+	if (sys.flags & DiscoverSst) != 0 {
+		sys.sstOnce.Do(sys.discoverSst)
+	}
+
+	cpus := make([]*cpu, 0, len(sys.cpus))
+	entries := make([]string, 0, len(sys.cpus))
+	for _, cpu := range sys.cpus {
+		cpus = append(cpus, cpu)
+		entries = append(entries, cpu.path)
+	}
+	sys.discoverParallel(entries, func(i int, _ string) error {
+		cpus[i].freqOnce.Do(cpus[i].discoverFrequencies)
+		return nil
+	})
+}
+
 // SetCpusOnline puts a set of CPUs online. Return the toggled set. Nil set implies all CPUs.
 func (sys *system) SetCpusOnline(online bool, cpus IDSet) (IDSet, error) {
 	var entries []string
@@ -550,18 +624,31 @@ func (sys *system) discoverCPUs() error {
 	}
 
 	entries, _ := filepath.Glob(filepath.Join(sys.path, sysfsCPUPath, "cpu[0-9]*"))
-	for _, entry := range entries {
-		if err := sys.discoverCPU(entry); err != nil {
+	cpus := make([]*cpu, len(entries))
+	err = sys.discoverParallel(entries, func(i int, entry string) error {
+		cpu, err := sys.discoverCPU(entry)
+		if err != nil {
 			return fmt.Errorf("failed to discover cpu for entry %s: %v", entry, err)
 		}
+		cpus[i] = cpu
+		return nil
+	})
+	if err != nil {
+		return err
+	}
+
+	for _, cpu := range cpus {
+		if err := sys.addCPU(cpu); err != nil {
+			return err
+		}
 	}
 
 	return nil
 }
 
 // Discover details of the given CPU.
-func (sys *system) discoverCPU(path string) error {
-	cpu := &cpu{path: path, id: getEnumeratedID(path), online: true, sstClos: -1}
+func (sys *system) discoverCPU(path string) (*cpu, error) {
+	cpu := &cpu{path: path, id: getEnumeratedID(path), online: true, sstClos: -1, sys: sys}
 
 	cpu.isolated = sys.isolated.Has(cpu.id)
 
@@ -571,35 +658,30 @@ func (sys *system) discoverCPU(path string) error {
 
 	if cpu.online {
 		if _, err := readSysfsEntry(path, "topology/physical_package_id", &cpu.pkg); err != nil {
-			return err
+			return nil, err
 		}
 		readSysfsEntry(path, "topology/die_id", &cpu.die)
 		if _, err := readSysfsEntry(path, "topology/core_id", &cpu.core); err != nil {
-			return err
+			return nil, err
 		}
 		if _, err := readSysfsEntry(path, "topology/thread_siblings_list", &cpu.threads, ","); err != nil {
-			return err
+			return nil, err
 		}
-	} else {
-		sys.offline.Add(cpu.id)
 	}
 
-	if _, err := readSysfsEntry(path, "cpufreq/base_frequency", &cpu.baseFreq); err != nil {
-		cpu.baseFreq = 0
-	}
-	if _, err := readSysfsEntry(path, "cpufreq/cpuinfo_min_freq", &cpu.freq.min); err != nil {
-		cpu.freq.min = 0
-	}
-	if _, err := readSysfsEntry(path, "cpufreq/cpuinfo_max_freq", &cpu.freq.max); err != nil {
-		cpu.freq.max = 0
-	}
-	if _, err := readSysfsEntry(path, "cpufreq/energy_performance_preference", &cpu.epp); err != nil {
-		cpu.epp = EPPUnknown
-	}
 	if node, _ := filepath.Glob(filepath.Join(path, "node[0-9]*")); len(node) == 1 {
 		cpu.node = getEnumeratedID(node[0])
 	} else {
-		return fmt.Errorf("exactly one node per cpu allowed")
+		return nil, fmt.Errorf("exactly one node per cpu allowed")
+	}
+
+	return cpu, nil
+}
+
+// Add a discovered CPU to the system.
+func (sys *system) addCPU(cpu *cpu) error {
+	if !cpu.online {
+		sys.offline.Add(cpu.id)
 	}
 
 	if sys.threads < 1 {
@@ -612,7 +694,7 @@ func (sys *system) discoverCPU(path string) error {
 	sys.cpus[cpu.id] = cpu
 
 	if (sys.flags & DiscoverCache) != 0 {
-		entries, _ := filepath.Glob(filepath.Join(path, "cache/index[0-9]*"))
+		entries, _ := filepath.Glob(filepath.Join(cpu.path, "cache/index[0-9]*"))
 		for _, entry := range entries {
 			if err := sys.discoverCache(entry); err != nil {
 				return err
@@ -623,6 +705,28 @@ func (sys *system) discoverCPU(path string) error {
 	return nil
 }
 
+// Discover the cpufreq details of the CPU.
+func (c *cpu) discoverFrequencies() {
+	if _, err := readSysfsEntry(c.path, "cpufreq/base_frequency", &c.baseFreq); err != nil {
+		c.baseFreq = 0
+	}
+	if _, err := readSysfsEntry(c.path, "cpufreq/cpuinfo_min_freq", &c.freq.min); err != nil {
+		c.freq.min = 0
+	}
+	if _, err := readSysfsEntry(c.path, "cpufreq/cpuinfo_max_freq", &c.freq.max); err != nil {
+		c.freq.max = 0
+	}
+	if _, err := readSysfsEntry(c.path, "cpufreq/energy_performance_preference", &c.epp); err != nil {
+		c.epp = EPPUnknown
+	}
+
+	// logged here, logging it with the topology would force discovery
+	if c.sys != nil && c.sys.DebugEnabled() {
+		c.sys.Debug("CPU #%d: base freq %d, freq %d - %d, epp %d",
+			c.id, c.baseFreq, c.freq.min, c.freq.max, c.epp)
+	}
+}
+
 // ID returns the id of this CPU.
 func (c *cpu) ID() ID {
 	return c.id
@@ -655,16 +759,19 @@ func (c *cpu) ThreadCPUSet() cpuset.CPUSet {
 
 // BaseFrequency returns the base frequency setting for this CPU.
 func (c *cpu) BaseFrequency() uint64 {
+	c.freqOnce.Do(c.discoverFrequencies)
 	return c.baseFreq
 }
 
 // FrequencyRange returns the frequency range for this CPU.
 func (c *cpu) FrequencyRange() CPUFreq {
+	c.freqOnce.Do(c.discoverFrequencies)
 	return c.freq
 }
 
 // EPP returns the energy performance profile of this CPU.
 func (c *cpu) EPP() EPP {
+	c.freqOnce.Do(c.discoverFrequencies)
 	return c.epp
 }
 
@@ -681,11 +788,13 @@ func (c *cpu) Isolated() bool {
 // SstClos returns the Speed Select Core Power CLOS number assigned to the CPU
 // -1 implies that no SST prioritization is in effect
 func (c *cpu) SstClos() int {
+	c.sys.waitSst()
 	return c.sstClos
 }
 
 // SetFrequencyLimits sets the frequency scaling limits for this CPU.
 func (c *cpu) SetFrequencyLimits(min, max uint64) error {
+	c.freqOnce.Do(c.discoverFrequencies)
 	if c.freq.min == 0 {
 		return nil
 	}
@@ -733,12 +842,23 @@ func (sys *system) discoverNodes() error {
 	}
 
 	sysNodesPath := filepath.Join(sys.path, sysfsNumaNodePath)
-	sys.nodes = make(map[ID]*node)
 	entries, _ := filepath.Glob(filepath.Join(sysNodesPath, "node[0-9]*"))
-	for _, entry := range entries {
-		if err := sys.discoverNode(entry); err != nil {
+	nodes := make([]*node, len(entries))
+	err := sys.discoverParallel(entries, func(i int, entry string) error {
+		node, err := sys.discoverNode(entry)
+		if err != nil {
 			return fmt.Errorf("failed to discover node for entry %s: %v", entry, err)
 		}
+		nodes[i] = node
+		return nil
+	})
+	if err != nil {
+		return err
+	}
+
+	sys.nodes = make(map[ID]*node)
+	for _, node := range nodes {
+		sys.nodes[node.id] = node
 	}
 
 	normalMemNodeIDs, err := readSysfsEntry(sysNodesPath, "has_normal_memory", nil)
@@ -832,19 +952,17 @@ func (sys *system) discoverNodes() error {
 }
 
 // Discover details of the given NUMA node.
-func (sys *system) discoverNode(path string) error {
+func (sys *system) discoverNode(path string) (*node, error) {
 	node := &node{path: path, id: getEnumeratedID(path)}
 
 	if _, err := readSysfsEntry(path, "cpulist", &node.cpus, ","); err != nil {
-		return err
+		return nil, err
 	}
 	if _, err := readSysfsEntry(path, "distance", &node.distance); err != nil {
-		return err
+		return nil, err
 	}
 
-	sys.nodes[node.id] = node
-
-	return nil
+	return node, nil
 }
 
 // ID returns id of this node.
@@ -939,6 +1057,7 @@ func (sys *system) discoverPackages() error {
 				dies:     NewIDSet(),
 				dieCPUs:  make(map[ID]IDSet),
 				dieNodes: make(map[ID]IDSet),
+				sys:      sys,
 			}
 			sys.packages[cpu.pkg] = pkg
 		}
@@ -961,7 +1080,22 @@ func (sys *system) discoverPackages() error {
 	return nil
 }
 
-func (sys *system) discoverSst() error {
+// waitSst waits for Speed Select Technology discovery to finish.
+func (sys *system) waitSst() {
+	if (sys.flags & DiscoverSst) != 0 {
+		sys.sstOnce.Do(sys.discoverSst)
+	}
+}
+
+// Discover Speed Select Technology details.
+func (sys *system) discoverSst() {
+	if err := sys.discoverSstPackages(); err != nil {
+		// Just consider SST unsupported if our detection fails for some reason
+		sys.Warn("%v", err)
+	}
+}
+
+func (sys *system) discoverSstPackages() error {
 	if !SstSupported() {
 		sys.Info("Speed Select Technology (SST) support not detected")
 		return nil
@@ -1027,6 +1161,7 @@ func (p *cpuPackage) DieCPUSet(id ID) cpuset.CPUSet {
 }
 
 func (p *cpuPackage) SstInfo() SstPackageInfo {
+	p.sys.waitSst()
 	return p.sstInfo
 }
 
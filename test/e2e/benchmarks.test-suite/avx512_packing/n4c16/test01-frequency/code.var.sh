@@ -0,0 +1,116 @@
+# AVX512 packing frequency benchmark
+#
+# Runs an AVX512-heavy Guaranteed pod next to a non-AVX Guaranteed
+# tenant with the topology-aware policy, first without and then with
+# PackAVX512. The frequency of the CPUs the tenant is pinned to is
+# sampled once the AVX512 user has been detected and repacked. The
+# difference between the two runs is the frequency recovered for the
+# non-AVX tenant. Results are appended as JSON lines to
+# $OUTPUT_DIR/benchmark/$vm/results.jsonl.
+#
+# The VM needs AVX512 capable CPUs with cpufreq exposed, so this is
+# meaningful only on real hardware or with CPU passthrough.
+
+BENCHMARK_PACKING="${BENCHMARK_PACKING:-false true}"
+BENCHMARK_ROUNDS="${BENCHMARK_ROUNDS:-3}"
+BENCHMARK_DURATION="${BENCHMARK_DURATION:-30}"
+BENCHMARK_WIDE_CPUS="${BENCHMARK_WIDE_CPUS:-8-15}"
+BENCHMARK_AVX_CPUS="${BENCHMARK_AVX_CPUS:-4}"
+BENCHMARK_TENANT_CPUS="${BENCHMARK_TENANT_CPUS:-4}"
+# stress-ng reaches turbo license level 1 at most, see ../../memtier_benchmark/n4c16/test01-memtier-stress-ng.
+BENCHMARK_AVX_LOAD="${BENCHMARK_AVX_LOAD:-stress-ng --ipsec-mb $BENCHMARK_AVX_CPUS --ipsec-mb-feature avx512}"
+BENCHMARK_TENANT_LOAD="${BENCHMARK_TENANT_LOAD:-stress-ng --cpu $BENCHMARK_TENANT_CPUS --cpu-method jmp}"
+BENCHMARK_METRICS_INTERVAL="${BENCHMARK_METRICS_INTERVAL:-5s}"
+
+benchmark_dir="$OUTPUT_DIR/benchmark/$vm"
+results="$benchmark_dir/results.jsonl"
+mkdir -p "$benchmark_dir"
+
+cri_resmgr_version="unknown"
+vm-command "cri-resmgr -version | awk '/version:/{print \$2}'" &&
+    cri_resmgr_version="$COMMAND_OUTPUT"
+
+benchmark-cleanup() {
+    vm-command "kubectl delete pods -l e2erole=avx512-packing --now; true"
+}
+
+benchmark-configure() {
+    # Usage: benchmark-configure PACKING
+    #
+    # Restart cri-resmgr with PackAVX512 set to PACKING.
+    local packing="$1"
+    local cfg="$benchmark_dir/cri-resmgr-pack-$packing.cfg"
+    cat > "$cfg" <<EOF
+policy:
+  Active: topology-aware
+  ReservedResources:
+    CPU: 750m
+  topology-aware:
+    PackAVX512: $packing
+    WideVectorCPUs: $BENCHMARK_WIDE_CPUS
+logger:
+  Debug: resource-manager,policy
+EOF
+    terminate cri-resmgr
+    vm-command "cri-resmgr -reset-policy"
+    # AVX512 usage is only tracked if metrics are polled.
+    cri_resmgr_cfg="$cfg" cri_resmgr_extra_args="-metrics-interval $BENCHMARK_METRICS_INTERVAL $cri_resmgr_extra_args" launch cri-resmgr
+}
+
+benchmark-cpus() {
+    # Usage: benchmark-cpus POD
+    #
+    # Print the CPUs the container of POD is allowed to run on.
+    vm-command-q "kubectl exec $1 -- awk '/^Cpus_allowed_list/{print \$2}' /proc/1/status"
+}
+
+benchmark-freq() {
+    # Usage: benchmark-freq CPUS
+    #
+    # Sample the frequency of CPUS once a second for BENCHMARK_DURATION
+    # seconds, print "average min max" MHz of all samples.
+    local cpus="$1" files="" cpu
+    for cpu in $(echo "$cpus" | awk -F, '{for (i = 1; i <= NF; i++) {n = split($i, r, "-"); for (c = r[1]; c <= r[n]; c++) print c}}'); do
+        files="$files /sys/devices/system/cpu/cpu$cpu/cpufreq/scaling_cur_freq"
+    done
+    vm-command-q "for i in \$(seq $BENCHMARK_DURATION); do cat $files; sleep 1; done | awk 'NR==1{min=\$1; max=\$1} {sum+=\$1; if (\$1<min) min=\$1; if (\$1>max) max=\$1} END{if (NR) printf \"%.0f %.0f %.0f\", sum/NR/1000, min/1000, max/1000; else print \"0 0 0\"}'"
+}
+
+benchmark-wait-tagged() {
+    # Usage: benchmark-wait-tagged POD
+    #
+    # Wait until cri-resmgr has detected POD using AVX512.
+    vm-run-until --timeout 120 "grep -q 'container $1:$1c0 STARTED using AVX512' cri-resmgr.output.txt" ||
+        echo "WARNING: AVX512 usage of $1 not detected, results are not representative"
+}
+
+for packing in $BENCHMARK_PACKING; do
+    benchmark-cleanup
+    benchmark-configure "$packing"
+    for round in $(seq 1 "$BENCHMARK_ROUNDS"); do
+        NAME=avx512 ROLE=avx512-packing CPU="$BENCHMARK_AVX_CPUS" MEM=500M ARGS="${BENCHMARK_AVX_LOAD#stress-ng }" create stress-ng-guaranteed
+        NAME=tenant ROLE=avx512-packing CPU="$BENCHMARK_TENANT_CPUS" MEM=500M ARGS="${BENCHMARK_TENANT_LOAD#stress-ng }" create stress-ng-guaranteed
+        benchmark-wait-tagged avx512
+        # Give the repacked containers time to settle.
+        sleep "${BENCHMARK_METRICS_INTERVAL%s}"
+
+        avx_cpus="$(benchmark-cpus avx512)"
+        tenant_cpus="$(benchmark-cpus tenant)"
+        read -r mhz_avg mhz_min mhz_max <<< "$(benchmark-freq "$tenant_cpus")"
+        printf '{"timestamp":"%s","cri_resmgr":"%s","vm":"%s","benchmark":"avx512-packing","packing":"%s","round":%s,"avx_load":"%s","avx_cpus":"%s","tenant_load":"%s","tenant_cpus":"%s","tenant_mhz_avg":%s,"tenant_mhz_min":%s,"tenant_mhz_max":%s}\n' \
+               "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$cri_resmgr_version" "$vm" \
+               "$packing" "$round" "$BENCHMARK_AVX_LOAD" "$avx_cpus" \
+               "$BENCHMARK_TENANT_LOAD" "$tenant_cpus" \
+               "${mhz_avg:-0}" "${mhz_min:-0}" "${mhz_max:-0}" | tee -a "$results"
+
+        benchmark-cleanup
+    done
+done
+
+# Frequency recovered for the tenant: average with packing minus without.
+awk -F'"tenant_mhz_avg":' '
+    /"packing":"false"/ { split($2, v, ","); off += v[1]; noff++ }
+    /"packing":"true"/  { split($2, v, ","); on += v[1]; non++ }
+    END {
+        if (noff && non) printf "tenant MHz without packing %.0f, with packing %.0f, recovered %.0f\n", off/noff, on/non, on/non - off/noff
+    }' < "$results"
@@ -0,0 +1,156 @@
+# Policy benchmark matrix
+#
+# Runs the same memtier_benchmark workload against redis, under every
+# background load, with every policy in BENCHMARK_POLICIES and every
+# controller combination in BENCHMARK_CONTROLLERS. Results are appended
+# as JSON lines to $OUTPUT_DIR/benchmark/$vm/results.jsonl, one line per
+# benchmark run.
+#
+# Without cri-resmgr in the container runtime stack (for instance
+# k8scri=containerd omit_cri_resmgr=1 omit_agent=1), the workload is run
+# once as the "baseline" policy. See ../../run-policy-matrix.sh.
+
+# Matrix parameters
+BENCHMARK_POLICIES="${BENCHMARK_POLICIES:-topology-aware static-pools podpools static-plus}"
+BENCHMARK_CONTROLLERS="${BENCHMARK_CONTROLLERS:-none avx page-migration avx,page-migration}"
+BENCHMARK_BGLOADS="${BENCHMARK_BGLOADS:-NOLOAD SHM MEMCPY STREAM CPUJMP CPUALL}"
+BENCHMARK_ROUNDS="${BENCHMARK_ROUNDS:-3}"
+BENCHMARK_CPUS="${BENCHMARK_CPUS:-4}"
+# Fixed request count and seed make runs comparable across releases.
+BENCHMARK_MEMTIER_ARGS="${BENCHMARK_MEMTIER_ARGS:---requests=20000 --clients=50 --threads=4 --ratio=1:10 --data-size=32 --key-pattern=R:R --randomize --distinct-client-seed}"
+BENCHMARK_METRICS_INTERVAL="${BENCHMARK_METRICS_INTERVAL:-5s}"
+
+# Redis parameters
+REDIS_PASS=abc123xyz
+
+# Background load parameters
+STRESS_NG_CPUS=16 # workers per container
+STRESS_NG_CONTS=8 # number of containers per pod
+STRESS_NG_PODS=2 # number of pods
+
+BG_NOLOAD=""
+BG_SHM="stress-ng --shm $STRESS_NG_CPUS"
+BG_MEMCPY="stress-ng --memcpy $STRESS_NG_CPUS"
+BG_STREAM="stress-ng --stream $STRESS_NG_CPUS"
+BG_CPUJMP="stress-ng --cpu $STRESS_NG_CPUS --cpu-method jmp"
+BG_CPUALL="stress-ng --cpu $STRESS_NG_CPUS"
+
+# Separate directory per VM lets baseline and cri-resmgr runs coexist.
+benchmark_dir="$OUTPUT_DIR/benchmark/$vm"
+results="$benchmark_dir/results.jsonl"
+mkdir -p "$benchmark_dir"
+
+cri_resmgr_version="baseline"
+if [ "$omit_cri_resmgr" == "1" ] || [[ "$k8scri" != cri-resmgr* ]]; then
+    BENCHMARK_POLICIES="baseline"
+    BENCHMARK_CONTROLLERS="none"
+else
+    vm-command "cri-resmgr -version | awk '/version:/{print \$2}'" &&
+        cri_resmgr_version="$COMMAND_OUTPUT"
+fi
+
+benchmark-cleanup() {
+    vm-command "kubectl delete jobs --all --now; kubectl delete deployment redis; kubectl delete service redis-service; kubectl delete secret redis; kubectl delete pods --all --now; true"
+}
+
+benchmark-configure() {
+    # Usage: benchmark-configure POLICY CONTROLLERS
+    #
+    # Restart cri-resmgr with POLICY and only the CONTROLLERS enabled.
+    local policy="$1" controllers="$2"
+    local cfg="$benchmark_dir/cri-resmgr-$policy-${controllers//,/+}.cfg"
+    local page_migration="disabled"
+    local extra_args=""
+    if [[ ",$controllers," == *",page-migration,"* ]]; then
+        page_migration="relaxed"
+    fi
+    if [[ ",$controllers," == *",avx,"* ]]; then
+        # AVX512 usage is only tracked if metrics are polled.
+        extra_args="-metrics-interval $BENCHMARK_METRICS_INTERVAL"
+    fi
+    cat "$TEST_DIR/policies/$policy.cfg" > "$cfg"
+    cat >> "$cfg" <<EOF
+resource-manager:
+  control:
+    Controllers:
+      page-migration: $page_migration
+EOF
+    terminate cri-resmgr
+    vm-command "cri-resmgr -reset-policy"
+    cri_resmgr_cfg="$cfg" cri_resmgr_extra_args="$extra_args $cri_resmgr_extra_args" launch cri-resmgr
+}
+
+benchmark-freq-start() {
+    # Sample the frequency of all CPUs once a second on the VM.
+    vm-command-q "rm -f cpu-mhz.txt; (while :; do awk '/^cpu MHz/{print \$4}' /proc/cpuinfo >> cpu-mhz.txt; sleep 1; done) >/dev/null 2>&1 & echo \$! > cpu-mhz.pid"
+}
+
+benchmark-freq-stop() {
+    # Stop sampling, print "average min max" MHz of all samples.
+    vm-command-q "kill \$(cat cpu-mhz.pid) 2>/dev/null; awk 'NR==1{min=\$1; max=\$1} {sum+=\$1; if (\$1<min) min=\$1; if (\$1>max) max=\$1} END{if (NR) printf \"%.0f %.0f %.0f\", sum/NR, min, max; else print \"0 0 0\"}' cpu-mhz.txt"
+}
+
+benchmark-record() {
+    # Usage: benchmark-record POLICY CONTROLLERS BGLOAD ROUND MEMTIER_LOG FREQ
+    local policy="$1" controllers="$2" bgload="$3" round="$4" log="$5" freq="$6"
+    local totals
+    # Totals columns: Ops/sec Hits/sec Misses/sec Avg-Latency p50 p99 p99.9 KB/sec
+    totals="$(awk '/^Totals/{print $2, $5, $6, $7, $8, $9}' < "$log")"
+    if [ -z "$totals" ]; then
+        echo "WARNING: no memtier totals in $log"
+        return 1
+    fi
+    read -r ops avg p50 p99 p999 kbs <<< "$totals"
+    read -r mhz_avg mhz_min mhz_max <<< "$freq"
+    printf '{"timestamp":"%s","cri_resmgr":"%s","k8scri":"%s","vm":"%s","policy":"%s","controllers":"%s","bgload":"%s","benchmark":"memtier","cpus":%s,"round":%s,"ops_per_sec":%s,"kb_per_sec":%s,"latency_avg_ms":%s,"latency_p50_ms":%s,"latency_p99_ms":%s,"latency_p999_ms":%s,"cpu_mhz_avg":%s,"cpu_mhz_min":%s,"cpu_mhz_max":%s}\n' \
+           "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$cri_resmgr_version" "$k8scri" "$vm" \
+           "$policy" "$controllers" "$bgload" "$BENCHMARK_CPUS" "$round" \
+           "$ops" "$kbs" "$avg" "$p50" "$p99" "$p999" \
+           "${mhz_avg:-0}" "${mhz_min:-0}" "${mhz_max:-0}" | tee -a "$results"
+}
+
+for policy in $BENCHMARK_POLICIES; do
+    for controllers in $BENCHMARK_CONTROLLERS; do
+        benchmark-cleanup
+        if [ "$policy" != "baseline" ]; then
+            benchmark-configure "$policy" "$controllers"
+        fi
+
+        # Setup Redis
+        wait="" create redis-secret
+        CPU=4 MEM=32G CPULIM=8 MEMLIM=64G NAME=redis wait="Available" create redis
+        NAME=redis-service wait="" create redis-service
+
+        for bgload in $BENCHMARK_BGLOADS; do
+            bg_cmd="BG_$bgload"
+            # Reset counters in order to keep creating pod0...
+            reset counters
+
+            run_output_dir="$benchmark_dir/$policy/${controllers//,/+}/$bgload"
+            mkdir -p "$run_output_dir"
+
+            # Start background noise
+            if [[ "${!bg_cmd}" == "stress-ng "* ]]; then
+                n="$STRESS_NG_PODS" ARGS="${!bg_cmd#stress-ng }" CONTCOUNT="$STRESS_NG_CONTS" CPU=50m MEM=50M CPULIM=$STRESS_NG_CPUS MEMLIM=1G wait_t=240s create stress-ng
+                # Stabilize
+                ( vm-run-until --timeout 60 "sh -c 'uptime; exit 1'" ) || echo "expected timeout"
+            fi
+
+            for round in $(seq 1 "$BENCHMARK_ROUNDS"); do
+                log="$run_output_dir/memtier-cpu-$BENCHMARK_CPUS-round-$round.txt"
+                benchmark-freq-start
+                AFFINITY=affinity CPU="$BENCHMARK_CPUS" MEM="16G" CPULIM="$BENCHMARK_CPUS" MEMLIM="24G" NAME=memtier-benchmark ARGS="--server=redis-service --authenticate=$REDIS_PASS $BENCHMARK_MEMTIER_ARGS" wait="Complete" wait_t="10m" create memtier-benchmark
+                freq="$(benchmark-freq-stop)"
+                vm-command-q "kubectl logs job/memtier-benchmark" > "$log"
+                benchmark-record "$policy" "$controllers" "$bgload" "$round" "$log" "$freq" ||
+                    command-error "failed to record benchmark results of $policy/$controllers/$bgload round $round"
+                vm-command "kubectl delete jobs --all --now"
+            done
+
+            # Stop background noise
+            vm-command "kubectl delete pods -l e2erole=bgload --now"
+        done
+    done
+done
+
+benchmark-cleanup
@@ -0,0 +1,52 @@
+#!/bin/bash
+
+# Run the policy benchmark matrix (n4c16/test02-policy-matrix) first
+# without cri-resmgr, then with it, and merge results of both runs
+# into a single JSON lines and CSV file.
+#
+# Usage: run-policy-matrix.sh [OUTPUT_FILE_PREFIX]
+#
+# The matrix can be narrowed down with the BENCHMARK_* variables of
+# the test, for instance:
+# BENCHMARK_POLICIES=podpools BENCHMARK_ROUNDS=1 run-policy-matrix.sh
+
+SCRIPT_DIR="$(dirname "${BASH_SOURCE[0]}")"
+TEST_DIR="$(realpath "$SCRIPT_DIR/n4c16/test02-policy-matrix")"
+RUN_TESTS_SH="$(realpath "$SCRIPT_DIR/../../run_tests.sh")"
+RESULTS="${1:-policy-matrix-$(date +%Y%m%d-%H%M%S)}"
+
+error() {
+    (echo ""; echo "error: $1" ) >&2
+    exit 1
+}
+
+if [ -z "$SKIP_BASELINE" ]; then
+    echo "Running baseline benchmarks without cri-resmgr"
+    k8scri=containerd omit_cri_resmgr=1 omit_agent=1 \
+        "$RUN_TESTS_SH" "$TEST_DIR" || error "baseline benchmarks failed"
+fi
+
+if [ -z "$SKIP_POLICIES" ]; then
+    echo "Running policy benchmarks with cri-resmgr"
+    "$RUN_TESTS_SH" "$TEST_DIR" || error "policy benchmarks failed"
+fi
+
+cat "$TEST_DIR"/output/benchmark/*/results.jsonl > "$RESULTS.jsonl" ||
+    error "no benchmark results found"
+
+# The JSON lines are flat objects with fields in a fixed order.
+awk -F'"?,"' '
+    {
+        gsub(/^\{"|"?\}$/, "")
+        hdr = ""; row = ""
+        for (i = 1; i <= NF; i++) {
+            split($i, kv, /":"?/)
+            if (kv[2] ~ /,/) kv[2] = "\"" kv[2] "\""
+            hdr = hdr (i > 1 ? "," : "") kv[1]
+            row = row (i > 1 ? "," : "") kv[2]
+        }
+        if (NR == 1) print hdr
+        print row
+    }' < "$RESULTS.jsonl" > "$RESULTS.csv"
+
+echo "Results: $RESULTS.jsonl $RESULTS.csv"